@@ -1,5 +1,17 @@
 -- @file premake5.lua
 
+-- Build Options
+newoption {
+    trigger     = "dispatch",
+    value       = "METHOD",
+    description = "Instruction dispatch used by the interpreter loop in tm_run_cpu",
+    default     = "goto",
+    allowed     = {
+        { "goto",   "Threaded dispatch through computed goto (GCC and Clang)" },
+        { "switch", "Portable switch statement" }
+    }
+}
+
 -- Workspace Settings
 workspace "project-tm"
     language "C"
@@ -33,6 +45,11 @@ workspace "project-tm"
         files {
             "./projects/tm/src/tm.*.c"
         }
+        filter { "options:dispatch=goto" }
+            defines { "TM_COMPUTED_GOTO" }
+        filter { "system:linux" }
+            links { "pthread" }
+        filter {}
 
     -- TM Virtual CPU Assembler (tmm)
     project "tmm"
@@ -93,4 +110,60 @@ workspace "project-tm"
         links {
             "tm", "m"
         }
-        
\ No newline at end of file
+
+    -- TM Virtual CPU Benchmark (tmbench)
+    project "tmbench"
+        kind "ConsoleApp"
+        location "./generated/tmbench"
+        targetdir "./build/bin/tmbench/%{cfg.buildcfg}"
+        objdir "./build/obj/tmbench/%{cfg.buildcfg}"
+        includedirs {
+            "./projects/tm/include"
+        }
+        files {
+            "./projects/tmbench/src/tmbench.*.c"
+        }
+        libdirs {
+            "./build/bin/tm/%{cfg.buildcfg}"
+        }
+        links {
+            "tm", "m"
+        }
+
+    -- TM Virtual CPU Multi-Instance Runner (tmrun)
+    project "tmrun"
+        kind "ConsoleApp"
+        location "./generated/tmrun"
+        targetdir "./build/bin/tmrun/%{cfg.buildcfg}"
+        objdir "./build/obj/tmrun/%{cfg.buildcfg}"
+        includedirs {
+            "./projects/tm/include"
+        }
+        files {
+            "./projects/tmrun/src/tmrun.*.c"
+        }
+        libdirs {
+            "./build/bin/tm/%{cfg.buildcfg}"
+        }
+        links {
+            "tm", "m"
+        }
+
+    -- TM Virtual CPU Trace Decoder (tmtrace)
+    project "tmtrace"
+        kind "ConsoleApp"
+        location "./generated/tmtrace"
+        targetdir "./build/bin/tmtrace/%{cfg.buildcfg}"
+        objdir "./build/obj/tmtrace/%{cfg.buildcfg}"
+        includedirs {
+            "./projects/tm/include"
+        }
+        files {
+            "./projects/tmtrace/src/tmtrace.*.c"
+        }
+        libdirs {
+            "./build/bin/tm/%{cfg.buildcfg}"
+        }
+        links {
+            "tm", "m"
+        }
@@ -1,29 +1,153 @@
 /// @file tm.cpu.h
 
 #pragma once
-#include <tm.common.h>
+#include <tm.program.h>
+#include <tm.trace.h>
 
 /* Public Constants ***********************************************************/
 
 #define TM_ERROR_STRLEN 512
+#define TM_PAGE_SHIFT       12
+#define TM_PAGE_SIZE        (1u << TM_PAGE_SHIFT)
+#define TM_ACCESS_READ      0x01
+#define TM_ACCESS_WRITE     0x02
+#define TM_ACCESS_EXECUTE   0x04
 
 /* Typedefs and Forward Declarations ******************************************/
 
 typedef struct tm_cpu tm_cpu_t;
-typedef bool (*tm_bus_read)     (addr_t, long_t*);
-typedef bool (*tm_bus_write)    (addr_t, long_t);
-typedef bool (*tm_cycle)        ();
+typedef bool (*tm_bus_read)         (addr_t, long_t*);
+typedef bool (*tm_bus_write)        (addr_t, long_t);
+typedef bool (*tm_cycle)            ();
+typedef bool (*tm_bus_read_ctx)     (void*, addr_t, long_t*);
+typedef bool (*tm_bus_write_ctx)    (void*, addr_t, long_t);
+typedef bool (*tm_cycle_ctx)        (void*);
+typedef bool (*tm_cycles_ctx)       (void*, size_t);
+typedef bool (*tm_event_handler)    (tm_cpu_t*, void*, uint64_t);
+
+/* Memory Region Structure ****************************************************/
+
+/**
+ * @brief Structure describing a region of the address space, mapped by the host
+ *        to its own memory or to its own handlers.
+ */
+typedef struct tm_region
+{
+    addr_t              m_start;        ///< First address. Must be a multiple of `TM_PAGE_SIZE`.
+    size_t              m_size;         ///< Size in bytes. Must be a multiple of `TM_PAGE_SIZE`.
+    byte_t              m_access;       ///< `TM_ACCESS_*` flags granted to the guest's instructions.
+    byte_t*             m_host;         ///< Host memory backing the region, or `nullptr`.
+    tm_bus_read_ctx     m_read;         ///< Called per byte read, without host memory.
+    tm_bus_write_ctx    m_write;        ///< Called per byte written, without host memory.
+    void*               m_user_data;    ///< Passed to the handlers.
+} tm_region_t;
+
+/* Profile Entry Structure ****************************************************/
+
+/**
+ * @brief Structure describing what the profiler counted at one guest address.
+ */
+typedef struct tm_profile_entry
+{
+    addr_t              m_address;      ///< Guest address.
+    uint64_t            m_instructions; ///< Instructions executed from this address.
+    uint64_t            m_cycles;       ///< Cycles those instructions took.
+    uint64_t            m_calls;        ///< Calls made to this address, by instructions or interrupts.
+} tm_profile_entry_t;
+
+/* Opcode Statistics Structure ************************************************/
+
+/**
+ * @brief Structure counting the instructions executed with one opcode.
+ */
+typedef struct tm_opcode_statistics
+{
+    uint64_t            m_executions;   ///< Instructions executed with this opcode.
+    uint64_t            m_cycles;       ///< Cycles those instructions took.
+    uint64_t            m_samples;      ///< Instructions timed on the host's clock.
+    uint64_t            m_nanoseconds;  ///< Host time spent executing the timed instructions.
+} tm_opcode_statistics_t;
+
+/* Debugger Enumerations ******************************************************/
+
+enum tm_break_reason
+{
+    TM_BREAK_NONE,              ///< The last step did not stop at a breakpoint or watchpoint.
+    TM_BREAK_BREAKPOINT,        ///< Stopped before executing the instruction at a breakpoint.
+    TM_BREAK_WATCHPOINT,        ///< Stopped after an instruction accessed a watched address.
+};
+
+enum tm_break_compare
+{
+    TM_COMPARE_EQ,
+    TM_COMPARE_NE,
+    TM_COMPARE_LT,
+    TM_COMPARE_LE,
+    TM_COMPARE_GT,
+    TM_COMPARE_GE,
+};
+
+/* Debugger Structures ********************************************************/
+
+/**
+ * @brief Structure describing the condition of a conditional breakpoint: the
+ *        value of a register, compared with a constant.
+ */
+typedef struct tm_break_condition
+{
+    enum_t              m_register;     ///< `TM_REGISTER_*` register compared.
+    enum_t              m_compare;      ///< `TM_COMPARE_*` comparison made, register first.
+    long_t              m_value;        ///< Value the register is compared with.
+} tm_break_condition_t;
+
+/**
+ * @brief Structure describing why the last step stopped at a breakpoint or
+ *        watchpoint.
+ */
+typedef struct tm_break
+{
+    enum_t              m_reason;       ///< `TM_BREAK_*` reason.
+    size_t              m_id;           ///< Breakpoint or watchpoint hit.
+    addr_t              m_address;      ///< Instruction address, or first address accessed.
+    byte_t              m_access;       ///< For watchpoints, `TM_ACCESS_READ` or `TM_ACCESS_WRITE`.
+    byte_t              m_size;         ///< For watchpoints, bytes accessed: 1, 2 or 4.
+    long_t              m_value;        ///< For watchpoints, value read or written.
+} tm_break_t;
 
 /* Public Functions ***********************************************************/
 
 tm_cpu_t* tm_create_cpu (tm_bus_read p_read, tm_bus_write p_write, tm_cycle p_cycle);
+tm_cpu_t* tm_create_cpu_ctx (tm_bus_read_ctx p_read, tm_bus_write_ctx p_write, tm_cycle_ctx p_cycle,
+    void* p_user_data);
 void tm_init_cpu (tm_cpu_t* p_cpu);
 void tm_destroy_cpu (tm_cpu_t* p_cpu);
+void* tm_get_user_data (tm_cpu_t* p_cpu);
+void tm_set_wide_bus (tm_cpu_t* p_cpu, tm_bus_read_ctx p_read_word, tm_bus_write_ctx p_write_word,
+    tm_bus_read_ctx p_read_long, tm_bus_write_ctx p_write_long);
+
+/* Public Functions - Decode Cache ********************************************/
+
+void tm_enable_decode_cache (tm_cpu_t* p_cpu, bool p_enable);
+void tm_enable_block_cache (tm_cpu_t* p_cpu, bool p_enable);
+void tm_enable_superoperators (tm_cpu_t* p_cpu, bool p_enable);
+void tm_flush_decode_cache (tm_cpu_t* p_cpu);
+
+/* Public Functions - JIT Compiler *******************************************/
+
+bool tm_enable_jit (tm_cpu_t* p_cpu, bool p_enable);
+
+/* Public Functions - Built-In Memory *****************************************/
+
+void tm_map_program (tm_cpu_t* p_cpu, tm_program_t* p_program);
+bool tm_map_region (tm_cpu_t* p_cpu, const tm_region_t* p_region);
+bool tm_unmap_region (tm_cpu_t* p_cpu, addr_t p_start);
 
 /* Public Functions - CPU Registers *******************************************/
 
+bool tm_read_cpu_flag (tm_cpu_t* p_cpu, enum_t p_flag);
 bool tm_read_cpu_register (tm_cpu_t* p_cpu, enum_t p_type, long_t* p_value);
 bool tm_write_cpu_register (tm_cpu_t* p_cpu, enum_t p_type, long_t p_value);
+long_t tm_get_program_counter (tm_cpu_t* p_cpu);
 
 /* Public Functions - Bus Read ************************************************/
 
@@ -40,14 +164,70 @@ bool tm_write_long (tm_cpu_t* p_cpu, addr_t p_address, long_t p_value);
 /* Public Functions - Interrupts **********************************************/
 
 void tm_request_interrupt (tm_cpu_t* p_cpu, byte_t p_id);
+void tm_request_interrupt_async (tm_cpu_t* p_cpu, byte_t p_id);
+void tm_enable_interrupts (tm_cpu_t* p_cpu, word_t p_mask);
+
+/* Public Functions - Event Scheduler *****************************************/
+
+size_t tm_schedule_event (tm_cpu_t* p_cpu, uint64_t p_cycle, tm_event_handler p_handler,
+    void* p_user_data);
+size_t tm_schedule_interrupt (tm_cpu_t* p_cpu, uint64_t p_cycle, byte_t p_id);
+bool tm_cancel_event (tm_cpu_t* p_cpu, size_t p_event);
 
 /* Public Functions - Cycle and Step ******************************************/
 
 bool tm_cycle_cpu (tm_cpu_t* p_cpu, size_t p_cycle_count);
 bool tm_advance_cpu (tm_cpu_t* p_cpu, size_t p_cycle_count);
+void tm_batch_cycles (tm_cpu_t* p_cpu, tm_cycles_ctx p_cycles, size_t p_deadline);
+bool tm_sync_cycles (tm_cpu_t* p_cpu);
+uint64_t tm_get_cycle_count (tm_cpu_t* p_cpu);
+uint64_t tm_get_idle_cycles (tm_cpu_t* p_cpu);
+uint64_t tm_get_halted_cycles (tm_cpu_t* p_cpu);
 bool tm_step_cpu (tm_cpu_t* p_cpu);
+size_t tm_run_cpu (tm_cpu_t* p_cpu, size_t p_budget);
+
+/* Public Functions - Saved State *********************************************/
+
+size_t tm_save_state (tm_cpu_t* p_cpu, byte_t* p_buffer, size_t p_size);
+bool tm_load_state (tm_cpu_t* p_cpu, const byte_t* p_buffer, size_t p_size);
+tm_cpu_t* tm_fork_cpu (tm_cpu_t* p_cpu);
+
+/* Public Functions - Profiler ************************************************/
+
+void tm_enable_profiler (tm_cpu_t* p_cpu, bool p_enable);
+void tm_reset_profile (tm_cpu_t* p_cpu);
+size_t tm_get_profile (tm_cpu_t* p_cpu, tm_profile_entry_t* p_entries, size_t p_count);
+bool tm_write_profile (tm_cpu_t* p_cpu, FILE* p_file, size_t p_limit);
+bool tm_write_profile_stacks (tm_cpu_t* p_cpu, FILE* p_file);
+
+/* Public Functions - Statistics **********************************************/
+
+void tm_enable_statistics (tm_cpu_t* p_cpu, bool p_enable, size_t p_sample_period);
+void tm_reset_statistics (tm_cpu_t* p_cpu);
+bool tm_get_opcode_statistics (tm_cpu_t* p_cpu, byte_t p_opcode, tm_opcode_statistics_t* p_stats);
+bool tm_write_statistics (tm_cpu_t* p_cpu, FILE* p_file, bool p_json);
+
+/* Public Functions - Trace ***************************************************/
+
+bool tm_start_trace (tm_cpu_t* p_cpu, const char* p_filename);
+bool tm_stop_trace (tm_cpu_t* p_cpu);
+
+/* Public Functions - Record and Replay ***************************************/
+
+void tm_start_recording (tm_cpu_t* p_cpu, uint64_t p_interval);
+void tm_stop_recording (tm_cpu_t* p_cpu);
+bool tm_rewind_cpu (tm_cpu_t* p_cpu, uint64_t p_cycle);
+
+/* Public Functions - Debugger ************************************************/
+
+size_t tm_add_breakpoint (tm_cpu_t* p_cpu, addr_t p_address, const tm_break_condition_t* p_condition);
+size_t tm_add_watchpoint (tm_cpu_t* p_cpu, addr_t p_start, size_t p_size, byte_t p_access);
+bool tm_remove_breakpoint (tm_cpu_t* p_cpu, size_t p_id);
+bool tm_remove_watchpoint (tm_cpu_t* p_cpu, size_t p_id);
+bool tm_get_break (tm_cpu_t* p_cpu, tm_break_t* p_break);
 
 /* Public Functions - Error Checking ******************************************/
 
 bool tm_has_error (tm_cpu_t* p_cpu);
+byte_t tm_get_error_code (tm_cpu_t* p_cpu);
 const char* tm_get_error (tm_cpu_t* p_cpu);
@@ -11,10 +11,11 @@
  */
 typedef struct tm_program
 {
-    char    m_name[TM_PROGRAM_NAME_SIZE];      ///< Program name.
-    char    m_author[TM_PROGRAM_AUTHOR_SIZE];  ///< Program author.
-    byte_t* m_rom;                             ///< Program ROM.
-    size_t  m_rom_size;                        ///< Program ROM size.
+    char    m_name[TM_PROGRAM_NAME_SIZE + 1];      ///< Program name.
+    char    m_author[TM_PROGRAM_AUTHOR_SIZE + 1];  ///< Program author.
+    byte_t* m_rom;                                 ///< Program ROM.
+    size_t  m_rom_size;                            ///< Program ROM size.
+    bool    m_mapped;                              ///< ROM is mapped from the program file, rather than allocated.
 } tm_program_t;
 
 /* Public Functions ***********************************************************/
@@ -24,3 +25,11 @@ tm_api bool          tm_init_program    (tm_program_t* p_program, const char* p_
 tm_api void          tm_destroy_program (tm_program_t* p_program);
 tm_api bool          tm_read_rom_byte   (tm_program_t* p_program, addr_t p_address, byte_t* p_byte);
 tm_api bool          tm_write_rom_byte  (tm_program_t* p_program, addr_t p_address, byte_t byte);
+
+/* Public Functions - ROM Spans ***********************************************/
+
+tm_api const byte_t* tm_get_rom_span    (tm_program_t* p_program, addr_t p_address, size_t p_size);
+tm_api bool          tm_read_rom        (tm_program_t* p_program, addr_t p_address, byte_t* p_buffer, size_t p_size);
+tm_api bool          tm_write_rom       (tm_program_t* p_program, addr_t p_address, const byte_t* p_buffer, size_t p_size);
+tm_api bool          tm_read_rom_word   (tm_program_t* p_program, addr_t p_address, word_t* p_value);
+tm_api bool          tm_read_rom_long   (tm_program_t* p_program, addr_t p_address, long_t* p_value);
@@ -0,0 +1,58 @@
+/// @file tm.runner.h
+/// @brief Runs many independent instances of one program across all cores.
+
+#pragma once
+#include <tm.cpu.h>
+
+/* Public Constants ***********************************************************/
+
+#define TM_RUNNER_DEFAULT_SLICE     4096    // Instructions an instance runs before it may move.
+
+/* Typedefs and Forward Declarations ******************************************/
+
+typedef void (*tm_instance_setup) (tm_cpu_t*, size_t, void*);
+
+/* Runner Enumerations ********************************************************/
+
+enum tm_instance_status
+{
+    TM_INSTANCE_STOPPED,        ///< Stopped by a `STOP` instruction, or by an error.
+    TM_INSTANCE_HALTED,         ///< Halted with nothing left which could wake it up.
+    TM_INSTANCE_LIMIT,          ///< Ran out of instructions before it stopped.
+};
+
+/* Runner Options Structure ***************************************************/
+
+/**
+ * @brief Structure describing how a program's instances are to be run.
+ */
+typedef struct tm_runner_options
+{
+    size_t              m_instances;        ///< Number of instances to run.
+    size_t              m_threads;          ///< Worker threads, or zero for one per core.
+    size_t              m_slice;            ///< Instructions per time slice, or zero for the default.
+    uint64_t            m_limit;            ///< Instructions each instance may run, or zero for no limit.
+    tm_instance_setup   m_setup;            ///< Called with each instance's CPU before it runs, or `nullptr`.
+    void*               m_user_data;        ///< Passed to `m_setup`.
+} tm_runner_options_t;
+
+/* Instance Result Structure **************************************************/
+
+/**
+ * @brief Structure describing the state an instance ended up in.
+ */
+typedef struct tm_instance_result
+{
+    enum_t              m_status;           ///< One of `tm_instance_status`.
+    byte_t              m_ec;               ///< The error code register.
+    byte_t              m_flags;            ///< The flags register.
+    long_t              m_registers[4];     ///< The `A`, `B`, `C` and `D` registers.
+    long_t              m_pc;               ///< The program counter.
+    uint64_t            m_cycles;           ///< Cycles spent.
+    uint64_t            m_instructions;     ///< Instructions executed, not counting cycles spent halted.
+} tm_instance_result_t;
+
+/* Public Functions ***********************************************************/
+
+tm_api bool tm_run_instances (tm_program_t* p_program, const tm_runner_options_t* p_options,
+    tm_instance_result_t* p_results);
@@ -0,0 +1,67 @@
+/// @file tm.trace.h
+/// @brief Compact binary traces of the instructions executed by the TM CPU.
+
+#pragma once
+#include <tm.common.h>
+
+/* Public Constants ***********************************************************/
+
+#define TM_TRACE_MAX_WRITES         8       // Memory writes recorded per instruction.
+
+/* Typedefs and Forward Declarations ******************************************/
+
+typedef struct tm_trace_writer tm_trace_writer_t;
+typedef struct tm_trace_reader tm_trace_reader_t;
+
+/* Trace Register Enumeration *************************************************/
+
+enum tm_trace_register
+{
+    TM_TRACE_A,
+    TM_TRACE_B,
+    TM_TRACE_C,
+    TM_TRACE_D,
+    TM_TRACE_SP,
+    TM_TRACE_RP,
+    TM_TRACE_FLAGS,
+    TM_TRACE_EC,
+    TM_TRACE_IE,
+    TM_TRACE_IF,
+    TM_TRACE_REGISTER_COUNT
+};
+
+/* Trace Record Structures ****************************************************/
+
+/**
+ * @brief Structure describing a write to memory made by a traced instruction.
+ */
+typedef struct tm_trace_write
+{
+    addr_t              m_address;      ///< First address written.
+    byte_t              m_size;         ///< Bytes written: 1, 2 or 4.
+    long_t              m_value;        ///< Value written, most significant byte first.
+} tm_trace_write_t;
+
+/**
+ * @brief Structure describing one executed instruction, and its effects.
+ */
+typedef struct tm_trace_record
+{
+    addr_t              m_address;      ///< Instruction address (`IA`).
+    word_t              m_instruction;  ///< Current instruction (`CI`).
+    uint32_t            m_cycles;       ///< Cycles the instruction took.
+    word_t              m_changed;      ///< Bit mask of the `tm_trace_register`s it changed.
+    long_t              m_registers[TM_TRACE_REGISTER_COUNT];   ///< Registers after the instruction.
+    size_t              m_write_count;
+    tm_trace_write_t    m_writes[TM_TRACE_MAX_WRITES];          ///< Memory writes, in order.
+} tm_trace_record_t;
+
+/* Public Functions ***********************************************************/
+
+tm_api tm_trace_writer_t* tm_create_trace_writer  (const char* p_filename);
+tm_api bool               tm_write_trace_record   (tm_trace_writer_t* p_writer, tm_trace_record_t* p_record);
+tm_api bool               tm_destroy_trace_writer (tm_trace_writer_t* p_writer);
+tm_api tm_trace_reader_t* tm_create_trace_reader  (const char* p_filename);
+tm_api bool               tm_read_trace_record    (tm_trace_reader_t* p_reader, tm_trace_record_t* p_record);
+tm_api bool               tm_trace_reader_failed  (const tm_trace_reader_t* p_reader);
+tm_api void               tm_destroy_trace_reader (tm_trace_reader_t* p_reader);
@@ -1,15 +1,69 @@
 /// @file tm.cpu.c
 
 #include <tm.cpu.h>
+#include <stdatomic.h>
+#include <stddef.h>
+
+// The JIT compiler emits x86-64 machine code, following the System V calling
+// convention, into memory mapped with `mmap`.
+#if defined(TM_LINUX) && defined(__x86_64__)
+    #define TM_JIT
+    #include <sys/mman.h>
+#endif
+
+// Functions taking an operand width are expanded into each of the handlers
+// specialised for one width, so that the width is a constant in their code.
+#if defined(__GNUC__)
+    #define TM_SPECIALISED          static inline __attribute__((always_inline))
+#else
+    #define TM_SPECIALISED          static inline
+#endif
+
+/* Private Constants **********************************************************/
+
+#define TM_DECODE_CACHE_SIZE        4096    // Must be a power of two.
+#define TM_MAX_INSTRUCTION_SIZE     6       // Two-byte opcode plus a long operand.
+#define TM_BLOCK_CACHE_SIZE         1024    // Must be a power of two.
+#define TM_MAX_BLOCK_LENGTH         32      // Instructions translated into a single block.
+#define TM_MAX_RETIRED_BLOCKS       256     // Invalidated blocks kept before they are freed.
+#define TM_XRAM_FILTER_SIZE         4096    // Bits in the XRAM code page filter.
+#define TM_JIT_THRESHOLD            16      // Executions before a block is compiled.
+#define TM_JIT_BUFFER_SIZE          0x100000
+#define TM_JIT_MAX_CODE_SIZE        256     // Upper bound on machine code emitted per instruction.
+#define TM_ADDRESS_SPACE_SIZE       0x100000000ull
+#define TM_PAGE_TABLE_SHIFT         22      // Address bits below this select a page within a table.
+#define TM_PAGE_TABLE_COUNT         (1u << (32 - TM_PAGE_TABLE_SHIFT))
+#define TM_PAGES_PER_TABLE          (1u << (TM_PAGE_TABLE_SHIFT - TM_PAGE_SHIFT))
+#define TM_PAGE_BUILT_IN            0x01    // Backed by memory the CPU allocates on first access.
+#define TM_PAGE_READ_ONLY           0x02    // Writes go through the callbacks, not to host memory.
+#define TM_PAGE_REGION              0x04    // Accessed through a region's handlers.
+#define TM_PAGE_SHARED              0x08    // Built-in memory shared with a forked CPU until written.
+#define TM_PAGE_BREAKPOINT          0x10    // Holds the address of at least one breakpoint.
+#define TM_PAGE_WATCHED             0x20    // Overlaps at least one watchpoint.
+#define TM_PAGE_DEBUG               (TM_PAGE_BREAKPOINT | TM_PAGE_WATCHED)
+#define TM_STATE_VERSION            1       // Bumped whenever the saved state's layout changes.
+#define TM_PROFILE_TABLE_SIZE       1024    // Initial size of the profiler's hash tables.
+#define TM_MAX_CHECKPOINTS          64      // Checkpoints kept before every other one is dropped.
+#define TM_CHECKPOINT_INTERVAL      1000000 // Default cycles between checkpoints.
+#define TM_MAX_IDLE_SKIP            0x100000 // Idle cycles skipped before checking for interrupts.
 
 /* TM Registers Structure *****************************************************/
 
 typedef struct tm_registers
 {
-    long_t          m_a;
-    long_t          m_b;
-    long_t          m_c;
-    long_t          m_d;
+    union
+    {
+        struct
+        {
+            long_t  m_a;
+            long_t  m_b;
+            long_t  m_c;
+            long_t  m_d;
+        };
+
+        long_t      m_gp[4];    // The general-purpose registers above, by index.
+    };
+
     long_t          m_pc;
     long_t          m_ea;
     long_t          m_ia;
@@ -42,22 +96,299 @@ typedef union tm_flags
     byte_t          m_state;
 } tm_flags_t;
 
+/* TM Decoded Instruction Structure *******************************************/
+
+typedef bool (*tm_instruction_handler) (tm_cpu_t*);
+
+struct tm_block;
+struct tm_decoded_instruction;
+typedef bool (*tm_superoperator) (tm_cpu_t*, struct tm_block*, struct tm_decoded_instruction*,
+    size_t*);
+
+typedef struct tm_decoded_instruction
+{
+    tm_instruction_handler  m_handler;      // Fetches operands and executes the instruction.
+    tm_superoperator        m_fused;        // In a block, executes this instruction and the next.
+    addr_t                  m_address;      // Address of the instruction's opcode.
+    long_t                  m_operand;      // Immediate operand read from the program counter, if any.
+    word_t                  m_ci;           // The instruction's opcode.
+    byte_t                  m_inst;
+    byte_t                  m_param1;
+    byte_t                  m_param2;
+    byte_t                  m_size;         // Size of the instruction, in bytes.
+    bool                    m_valid;
+} tm_decoded_instruction_t;
+
+/* TM Translated Block Structure **********************************************/
+
+typedef size_t (*tm_jit_function) (tm_cpu_t*);
+
+typedef struct tm_block
+{
+    addr_t                      m_address;          // Address of the block's first instruction.
+    addr_t                      m_end;              // Address just past the block's last instruction.
+    struct tm_block*            m_successors[2];    // Blocks this block has been seen to exit into.
+    struct tm_block*            m_hash_next;        // Next block in the same bucket, or retired block.
+    struct tm_block*            m_xram_next;        // Next block translated from XRAM.
+    size_t                      m_count;            // Number of instructions in the block.
+    size_t                      m_executions;       // Times executed while the JIT is enabled.
+    tm_jit_function             m_native[2];        // Compiled code, without and with interrupts enabled.
+    bool                        m_native_unsupported;
+    bool                        m_valid;
+    tm_decoded_instruction_t    m_instructions[];
+} tm_block_t;
+
+/* TM Page Structures *********************************************************/
+
+typedef struct tm_mapped_region
+{
+    tm_region_t                 m_region;
+    struct tm_mapped_region*    m_next;
+} tm_mapped_region_t;
+
+typedef struct tm_page
+{
+    union
+    {
+        byte_t*             m_host;         // Host memory backing the page, if any.
+        const tm_region_t*  m_region;       // With `TM_PAGE_REGION`, the region the page belongs to.
+    };
+
+    word_t                  m_limit;        // Bytes at the start of the page which are backed.
+    byte_t                  m_access;       // `TM_ACCESS_*` flags granted to the guest's instructions.
+    byte_t                  m_flags;        // `TM_PAGE_*` flags.
+} tm_page_t;
+
+typedef struct tm_page_memory
+{
+    _Atomic(size_t)         m_references;   // Pages, on any CPU, backed by this memory.
+    byte_t                  m_bytes[TM_PAGE_SIZE];
+} tm_page_memory_t;
+
+enum tm_page_template
+{
+    TM_PAGES_LOW,           // The first table, with the reserved space before the program.
+    TM_PAGES_ROM,
+    TM_PAGES_RAM,
+    TM_PAGES_XRAM,
+    TM_PAGES_TOP,           // The last table, with the end of XRAM, the stacks and QRAM.
+    TM_PAGE_TEMPLATE_COUNT
+};
+
+/* TM Scheduled Event Structure ***********************************************/
+
+typedef struct tm_event
+{
+    uint64_t            m_cycle;        // Cycle count at which the event is due.
+    size_t              m_id;           // Also orders events due on the same cycle.
+    tm_event_handler    m_handler;
+    void*               m_user_data;
+} tm_event_t;
+
+/* TM Profiler Structures *****************************************************/
+
+typedef struct tm_profile_slot
+{
+    bool                    m_used;
+    tm_profile_entry_t      m_entry;
+} tm_profile_slot_t;
+
+// Calling contexts form a tree, with a frame for each routine called from
+// each context. Frames are referred to by their index, starting from the root.
+typedef struct tm_profile_frame
+{
+    addr_t                  m_address;      // Address of the routine called.
+    size_t                  m_parent;
+    uint64_t                m_cycles;       // Cycles spent in the routine itself.
+} tm_profile_frame_t;
+
+typedef struct tm_profile
+{
+    tm_profile_slot_t*      m_slots;        // Entries, hashed by address.
+    size_t                  m_slot_count;   // Must be a power of two.
+    size_t                  m_used_count;
+    tm_profile_frame_t*     m_frames;
+    size_t                  m_frame_count;
+    size_t                  m_frame_capacity;
+    size_t*                 m_children;     // Frame indices plus one, hashed by parent and address.
+    size_t                  m_child_count;  // Must be a power of two.
+    size_t*                 m_stack;        // Frames of the routines currently called.
+    size_t                  m_depth;
+    size_t                  m_stack_capacity;
+    long_t                  m_base_rp;      // `RP` in the root frame.
+    long_t                  m_rp;           // `RP` in the current frame.
+} tm_profile_t;
+
+/* TM Statistics Structure ****************************************************/
+
+typedef struct tm_statistics
+{
+    tm_opcode_statistics_t  m_opcodes[0x100];   // Indexed by the opcode's high byte.
+    size_t                  m_sample_period;    // Instructions per timed instruction, or zero.
+    size_t                  m_countdown;        // Instructions until the next one is timed.
+} tm_statistics_t;
+
+/* TM Trace Structure *********************************************************/
+
+typedef struct tm_trace
+{
+    tm_trace_writer_t*      m_writer;
+    tm_trace_record_t       m_record;           // Record of the instruction being executed.
+    bool                    m_failed;           // Set once writing the trace has failed.
+} tm_trace_t;
+
+/* TM Record and Replay Structures ********************************************/
+
+enum tm_replay_input_type
+{
+    TM_INPUT_READ,                  // Value read through a callback.
+    TM_INPUT_FAILED_READ,           // Read through a callback which failed.
+    TM_INPUT_WRITE,                 // Value written through a callback.
+    TM_INPUT_FAILED_WRITE,          // Write through a callback which failed.
+    TM_INPUT_INTERRUPTS_BEFORE,     // Interrupts requested before the step began.
+    TM_INPUT_INTERRUPTS_DURING,     // Interrupts requested while the step was executing.
+};
+
+typedef struct tm_replay_input
+{
+    uint64_t                m_step;         // Step during, or before, which the input arrived.
+    long_t                  m_value;        // Value read, or mask of interrupts requested.
+    byte_t                  m_type;
+} tm_replay_input_t;
+
+typedef struct tm_checkpoint
+{
+    uint64_t                m_step;
+    uint64_t                m_cycle;
+    size_t                  m_input;        // Inputs logged before the checkpoint was taken.
+    byte_t*                 m_state;        // Saved with `tm_save_state`.
+    size_t                  m_size;
+} tm_checkpoint_t;
+
+typedef struct tm_replay
+{
+    tm_checkpoint_t*        m_checkpoints;  // Oldest first.
+    size_t                  m_checkpoint_count;
+    uint64_t                m_interval;     // Cycles between checkpoints.
+    uint64_t                m_next_checkpoint;
+    tm_replay_input_t*      m_inputs;       // Inputs logged since recording started, in order.
+    size_t                  m_input_count;
+    size_t                  m_input_capacity;
+    uint64_t                m_step;         // Steps since recording started.
+    bool                    m_in_step;
+    bool                    m_replaying;    // Inputs come from the log, rather than the host.
+    bool                    m_diverged;     // Set if the CPU strayed from the log while replaying.
+    size_t                  m_position;     // Next input to replay.
+    uint64_t                m_end_step;     // Steps recorded, while replaying.
+    uint64_t                m_end_cycle;
+} tm_replay_t;
+
+/* TM Debugger Structures *****************************************************/
+
+typedef struct tm_breakpoint
+{
+    size_t                  m_id;
+    addr_t                  m_address;
+    bool                    m_conditional;
+    tm_break_condition_t    m_condition;
+} tm_breakpoint_t;
+
+typedef struct tm_watchpoint
+{
+    size_t                  m_id;
+    addr_t                  m_start;
+    uint64_t                m_end;          // One past the last address watched.
+    byte_t                  m_access;       // `TM_ACCESS_READ` and/or `TM_ACCESS_WRITE`.
+} tm_watchpoint_t;
+
+typedef struct tm_debugger
+{
+    tm_breakpoint_t*        m_breakpoints;
+    size_t                  m_breakpoint_count;
+    size_t                  m_breakpoint_capacity;
+    tm_watchpoint_t*        m_watchpoints;
+    size_t                  m_watchpoint_count;
+    size_t                  m_watchpoint_capacity;
+    size_t                  m_last_id;
+    tm_break_t              m_break;        // Why the last step stopped, if it did.
+    bool                    m_in_step;
+    bool                    m_resuming;     // Step over the breakpoint at `m_resume_address` once.
+    addr_t                  m_resume_address;
+} tm_debugger_t;
+
+/* TM Lazy Flags Enumeration *************************************************/
+
+enum tm_lazy_flags_type
+{
+    TM_LAZY_NONE,           // The flags register is up to date.
+    TM_LAZY_ADD,            // Pending flags of an `ADD` or `ADC` instruction.
+    TM_LAZY_SUB,            // Pending flags of a `SUB`, `SBC` or `CMP` instruction.
+};
+
 /* TM CPU Structure ***********************************************************/
 
 typedef struct tm_cpu
 {
-    char            m_error_string[TM_ERROR_STRLEN];
-    tm_bus_read     m_read;
-    tm_bus_write    m_write;
-    tm_cycle        m_cycle;
-    tm_registers_t  m_registers;
-    tm_flags_t      m_flags;
-    byte_t          m_inst;
-    byte_t          m_param1;
-    byte_t          m_param2;
-    bool            m_da;
-    bool            m_ime;
-    bool            m_enable_ime;
+    char                        m_error_string[TM_ERROR_STRLEN];
+    tm_bus_read_ctx             m_read;
+    tm_bus_write_ctx            m_write;
+    tm_cycle_ctx                m_cycle;
+    void*                       m_user_data;        // Passed to each of the callbacks above.
+    tm_bus_read                 m_legacy_read;      // Callbacks given to `tm_create_cpu`.
+    tm_bus_write                m_legacy_write;
+    tm_cycle                    m_legacy_cycle;
+    tm_bus_read_ctx             m_read_word;        // Optional callbacks for whole words and longs,
+    tm_bus_write_ctx            m_write_word;       // given to `tm_set_wide_bus`.
+    tm_bus_read_ctx             m_read_long;
+    tm_bus_write_ctx            m_write_long;
+    tm_cycles_ctx               m_cycles;           // Receives batched cycles, if batching is enabled.
+    size_t                      m_cycle_deadline;   // Pending cycles which trigger a call to `m_cycles`.
+    size_t                      m_pending_cycles;   // Cycles spent, but not yet passed to `m_cycles`.
+    uint64_t                    m_cycle_count;      // Cycles spent since the CPU was created.
+    uint64_t                    m_halted_cycles;    // Cycles of those spent halted.
+    uint64_t                    m_next_event;       // Cycle count at which the earliest event is due.
+    tm_event_t*                 m_events;           // Scheduled events, as a binary min-heap.
+    size_t                      m_event_count;
+    size_t                      m_event_capacity;
+    size_t                      m_last_event_id;
+    tm_page_t*                  m_pages[TM_PAGE_TABLE_COUNT];
+    tm_page_t*                  m_page_templates;   // Tables shared until one of their pages changes.
+    tm_program_t*               m_program;          // Program mapped into the built-in memory, if any.
+    tm_mapped_region_t*         m_regions;          // Regions mapped by the host, oldest first.
+    tm_registers_t              m_registers;
+    tm_flags_t                  m_flags;
+    word_t                      m_interrupts;       // Requested interrupts which are enabled: `IF & IE`.
+    _Atomic(word_t)             m_async_interrupts; // Requested from other threads, not yet in `IF`.
+    byte_t                      m_lazy_op;          // Instruction whose flags are pending, if any.
+    byte_t                      m_lazy_width;
+    bool                        m_lazy_carry;       // Its carry-in.
+    long_t                      m_lazy_left;        // Its accumulator and operand values.
+    long_t                      m_lazy_right;
+    byte_t                      m_inst;
+    byte_t                      m_param1;
+    byte_t                      m_param2;
+    bool                        m_da;
+    bool                        m_ime;
+    bool                        m_enable_ime;
+    tm_decoded_instruction_t*   m_decode_cache;
+    tm_decoded_instruction_t*   m_decoding;
+    bool                        m_decode_cache_enabled;
+    tm_block_t**                m_block_cache;
+    tm_block_t*                 m_recording;
+    tm_block_t*                 m_xram_blocks;
+    tm_block_t*                 m_retired_blocks;
+    size_t                      m_retired_count;
+    uint64_t                    m_xram_filter[TM_XRAM_FILTER_SIZE / 64];
+    bool                        m_block_cache_enabled;
+    bool                        m_superoperators_enabled;
+    byte_t*                     m_jit_code;
+    size_t                      m_jit_used;
+    bool                        m_jit_enabled;
+    tm_profile_t*               m_profile;          // Counts executed instructions, if profiling.
+    tm_statistics_t*            m_statistics;       // Counts executed opcodes, if enabled.
+    tm_trace_t*                 m_trace;            // Records executed instructions, if tracing.
+    tm_replay_t*                m_replay;           // Checkpoints and logged inputs, if recording.
+    tm_debugger_t*              m_debugger;         // Breakpoints and watchpoints, once any are added.
 } tm_cpu_t;
 
 /* Static Functions - Error Checking ******************************************/
@@ -72,18 +403,235 @@ static bool tm_set_error (tm_cpu_t* p_cpu, byte_t p_ec)
     return (p_ec == TM_ERROR_OK);
 }
 
+/* Static Functions - Register File *******************************************/
+
+// Each of the sixteen register codes selects a view of one of the four
+// general-purpose registers: the whole register, its low word, or the high or
+// low byte of that word. Views are described by a table indexed by the code,
+// so that accessing any of them is a lookup, a shift and a mask.
+
+typedef struct tm_register_view
+{
+    byte_t      m_base;     // Index of the register in `m_gp`.
+    byte_t      m_shift;
+    long_t      m_mask;
+} tm_register_view_t;
+
+#define tm_define_register_views(p_base) \
+    { p_base, 0, 0xFFFFFFFF }, { p_base, 0, 0xFFFF }, { p_base, 8, 0xFF }, { p_base, 0, 0xFF }
+
+static const tm_register_view_t s_register_views[16] =
+{
+    tm_define_register_views(0),
+    tm_define_register_views(1),
+    tm_define_register_views(2),
+    tm_define_register_views(3),
+};
+
+#undef tm_define_register_views
+
+static inline bool tm_load_register (const tm_cpu_t* p_cpu, byte_t p_type, long_t* p_value)
+{
+    const tm_register_view_t* l_view = &s_register_views[p_type & 0xF];
+    *p_value = (p_cpu->m_registers.m_gp[l_view->m_base] >> l_view->m_shift) & l_view->m_mask;
+    return true;
+}
+
+static inline bool tm_store_register (tm_cpu_t* p_cpu, byte_t p_type, long_t p_value)
+{
+    const tm_register_view_t* l_view = &s_register_views[p_type & 0xF];
+    long_t* l_register = &p_cpu->m_registers.m_gp[l_view->m_base];
+    *l_register =
+        (*l_register & ~(l_view->m_mask << l_view->m_shift)) |
+        ((p_value & l_view->m_mask) << l_view->m_shift);
+    return true;
+}
+
+/* Static Functions - Lazy Flags **********************************************/
+
+// The `ADD`, `ADC`, `SUB`, `SBC` and `CMP` instructions overwrite every one of
+// the zero, negative, half-carry, carry, overflow and underflow flags, which
+// are then, more often than not, overwritten again before anything reads
+// them. Rather than computing the flags right away, these instructions record
+// their operands, and the flags are only computed from those once they are
+// needed.
+//
+// Any other access to those six flags goes through `tm_get_flags`, which
+// brings the flags register up to date first. Conditions and carry-ins are
+// worked out from the recorded operands directly, without updating the rest of
+// the flags register.
+
+static const uint64_t s_lazy_masks[4]       = { 0xFFFFFFFF, 0xFFFF, 0xFF, 0xFF };
+static const uint32_t s_lazy_half_masks[4]  = { 0xFFFFFFF, 0xFFF, 0xF, 0xF };
+
+static inline void tm_defer_flags (tm_cpu_t* p_cpu, enum_t p_op, enum_t p_width, long_t p_left,
+    long_t p_right, bool p_carry)
+{
+    p_cpu->m_lazy_op    = p_op;
+    p_cpu->m_lazy_width = p_width;
+    p_cpu->m_lazy_left  = p_left;
+    p_cpu->m_lazy_right = p_right;
+    p_cpu->m_lazy_carry = p_carry;
+}
+
+static inline bool tm_lazy_zero (const tm_cpu_t* p_cpu)
+{
+    // As the instructions themselves do, the accumulator and operand are added
+    // or subtracted at 32 bits before the carry-in is applied, at 64 bits.
+    uint64_t l_result = (p_cpu->m_lazy_op == TM_LAZY_ADD) ?
+        (uint64_t) (long_t) (p_cpu->m_lazy_left + p_cpu->m_lazy_right) + p_cpu->m_lazy_carry :
+        (uint64_t) ((int64_t) (long_t) (p_cpu->m_lazy_left - p_cpu->m_lazy_right) -
+            p_cpu->m_lazy_carry);
+    return (l_result & s_lazy_masks[p_cpu->m_lazy_width]) == 0;
+}
+
+static inline bool tm_lazy_carry (const tm_cpu_t* p_cpu)
+{
+    if (p_cpu->m_lazy_op == TM_LAZY_ADD)
+    {
+        uint64_t l_result = (uint64_t) (long_t) (p_cpu->m_lazy_left + p_cpu->m_lazy_right) +
+            p_cpu->m_lazy_carry;
+        return l_result > s_lazy_masks[p_cpu->m_lazy_width];
+    }
+
+    // The difference has wrapped around by the time it is widened, so only
+    // the carry-in can take it below zero.
+    return p_cpu->m_lazy_left == p_cpu->m_lazy_right && p_cpu->m_lazy_carry == true;
+}
+
+static inline bool tm_lazy_half_carry (const tm_cpu_t* p_cpu)
+{
+    uint32_t l_mask = s_lazy_half_masks[p_cpu->m_lazy_width];
+    return (p_cpu->m_lazy_op == TM_LAZY_ADD) ?
+        (p_cpu->m_lazy_left & l_mask) + (p_cpu->m_lazy_right & l_mask) > l_mask :
+        (p_cpu->m_lazy_left & l_mask) < (p_cpu->m_lazy_right & l_mask);
+}
+
+static void tm_resolve_flags (tm_cpu_t* p_cpu)
+{
+    bool l_add = (p_cpu->m_lazy_op == TM_LAZY_ADD);
+    bool l_carry = tm_lazy_carry(p_cpu);
+
+    p_cpu->m_flags.m_zero       = tm_lazy_zero(p_cpu);
+    p_cpu->m_flags.m_negative   = !l_add;
+    p_cpu->m_flags.m_half_carry = tm_lazy_half_carry(p_cpu);
+    p_cpu->m_flags.m_carry      = l_carry;
+    p_cpu->m_flags.m_overflow   = l_add && l_carry;
+    p_cpu->m_flags.m_underflow  = !l_add && l_carry;
+    p_cpu->m_lazy_op            = TM_LAZY_NONE;
+}
+
+static inline tm_flags_t* tm_get_flags (tm_cpu_t* p_cpu)
+{
+    if (p_cpu->m_lazy_op != TM_LAZY_NONE)
+    {
+        tm_resolve_flags(p_cpu);
+    }
+
+    return &p_cpu->m_flags;
+}
+
+static inline bool tm_get_carry (tm_cpu_t* p_cpu)
+{
+    return (p_cpu->m_lazy_op != TM_LAZY_NONE) ? tm_lazy_carry(p_cpu) : p_cpu->m_flags.m_carry;
+}
+
+static inline void tm_discard_flags (tm_cpu_t* p_cpu)
+{
+    // For instructions which are about to overwrite all six flags themselves.
+    p_cpu->m_lazy_op = TM_LAZY_NONE;
+}
+
+/* Static Functions - Cycle Accounting ***************************************/
+
+// By default, the host's cycle callback is called once for every cycle spent.
+// With batching enabled, cycles are counted instead, and passed on to the
+// host's batch callback all at once - when the count reaches the deadline,
+// before every access to the IO port registers or to a region mapped with
+// handlers, and whenever `tm_run_cpu` returns. If the batch callback fails
+// before an access, the CPU stops with a hardware error instead of making it.
+
+static bool tm_deliver_cycles (tm_cpu_t* p_cpu)
+{
+    size_t l_cycles = p_cpu->m_pending_cycles;
+    p_cpu->m_pending_cycles = 0;
+    if (l_cycles != 0 && p_cpu->m_cycles(tm_get_user_data(p_cpu), l_cycles) == false)
+    {
+        return tm_set_error(p_cpu, TM_ERROR_HARDWARE);
+    }
+
+    return true;
+}
+
+static bool tm_fire_events (tm_cpu_t* p_cpu);
+static void tm_record_interrupts (tm_cpu_t* p_cpu, word_t p_interrupts);
+static bool tm_record_read (tm_cpu_t* p_cpu, tm_bus_read_ctx p_read, void* p_user_data,
+    addr_t p_address, long_t* p_value);
+static bool tm_record_write (tm_cpu_t* p_cpu, tm_bus_write_ctx p_write, void* p_user_data,
+    addr_t p_address, long_t p_value);
+
+static inline bool tm_spend_cycles (tm_cpu_t* p_cpu, size_t p_cycle_count)
+{
+    p_cpu->m_cycle_count += p_cycle_count;
+    if (p_cpu->m_cycles != nullptr)
+    {
+        p_cpu->m_pending_cycles += p_cycle_count;
+        if (p_cpu->m_pending_cycles >= p_cpu->m_cycle_deadline && tm_deliver_cycles(p_cpu) == false)
+        {
+            return false;
+        }
+    }
+    else
+    {
+        for (size_t i = 0; i < p_cycle_count; ++i)
+        {
+            if (p_cpu->m_cycle(p_cpu->m_user_data) == false)
+            {
+                return tm_set_error(p_cpu, TM_ERROR_HARDWARE);
+            }
+        }
+    }
+
+    // Checking for due events costs a single comparison while none are.
+    return p_cpu->m_cycle_count < p_cpu->m_next_event || tm_fire_events(p_cpu);
+}
+
+static inline bool tm_advance_pc (tm_cpu_t* p_cpu, size_t p_cycle_count)
+{
+    bool l_good = tm_spend_cycles(p_cpu, p_cycle_count);
+    if (l_good == true) { p_cpu->m_registers.m_pc += p_cycle_count; }
+    return l_good;
+}
+
 /* Static Functions - Bounds Checking *****************************************/
 
+static inline tm_page_t* tm_find_page (tm_cpu_t* p_cpu, addr_t p_address)
+{
+    return &p_cpu->m_pages[p_address >> TM_PAGE_TABLE_SHIFT]
+        [(p_address >> TM_PAGE_SHIFT) & (TM_PAGES_PER_TABLE - 1)];
+}
+
+static inline bool tm_check_access (tm_cpu_t* p_cpu, addr_t p_address, size_t p_size,
+    byte_t p_access)
+{
+    // The IO port registers share the last page with QRAM, and are only ever
+    // accessed through their own instructions, so no access may reach them.
+    uint64_t l_end = (uint64_t) p_address + p_size;
+    if (l_end > TM_IO_START || (tm_find_page(p_cpu, p_address)->m_access & p_access) == 0)
+    {
+        return false;
+    }
+
+    // No access is longer than a page, so it spans two pages at most.
+    addr_t l_last = (addr_t) (l_end - 1);
+    return
+        (l_last >> TM_PAGE_SHIFT) == (p_address >> TM_PAGE_SHIFT) ||
+        (tm_find_page(p_cpu, l_last)->m_access & p_access) != 0;
+}
+
 static bool tm_check_readable (tm_cpu_t* p_cpu, addr_t p_address, size_t p_size)
 {
-    if (
-        p_address < TM_PROGRAM_START ||
-        (
-            p_address + p_size > TM_STACK_START &&
-            p_address < TM_QRAM_START
-        ) ||
-        p_address + p_size > TM_IO_START
-    )
+    if (tm_check_access(p_cpu, p_address, p_size, TM_ACCESS_READ) == false)
     {
         p_cpu->m_registers.m_ea = p_address;
         return tm_set_error(p_cpu, TM_ERROR_READ_ACCESS_VIOLATION);
@@ -94,14 +642,7 @@ static bool tm_check_readable (tm_cpu_t* p_cpu, addr_t p_address, size_t p_size)
 
 static bool tm_check_writable (tm_cpu_t* p_cpu, addr_t p_address, size_t p_size)
 {
-    if (
-        p_address < TM_RAM_START ||
-        (
-            p_address + p_size > TM_STACK_START &&
-            p_address < TM_QRAM_START
-        ) ||
-        p_address + p_size > TM_IO_START
-    )
+    if (tm_check_access(p_cpu, p_address, p_size, TM_ACCESS_WRITE) == false)
     {
         p_cpu->m_registers.m_ea = p_address;
         return tm_set_error(p_cpu, TM_ERROR_WRITE_ACCESS_VIOLATION);
@@ -112,14 +653,7 @@ static bool tm_check_writable (tm_cpu_t* p_cpu, addr_t p_address, size_t p_size)
 
 static bool tm_check_executable (tm_cpu_t* p_cpu, addr_t p_address)
 {
-    if (
-        p_address < TM_PROGRAM_START ||
-        (
-            p_address + 2 > TM_RAM_START &&
-            p_address < TM_XRAM_START
-        ) ||
-        p_address + 2 > TM_STACK_START
-    )
+    if (tm_check_access(p_cpu, p_address, 2, TM_ACCESS_EXECUTE) == false)
     {
         p_cpu->m_registers.m_ea = p_address;
         return tm_set_error(p_cpu, TM_ERROR_EXECUTE_ACCESS_VIOLATION);
@@ -194,8 +728,26 @@ static bool tm_push_address (tm_cpu_t* p_cpu, addr_t p_address)
 
 /* Static Functions - Interrupts and Program Counter Functions ****************/
 
-static bool tm_check_condition (tm_cpu_t* p_cpu, enum_t p_condition)
+TM_SPECIALISED bool tm_check_condition (tm_cpu_t* p_cpu, enum_t p_condition)
 {
+    // Flags pending from an arithmetic instruction are worked out one at a
+    // time, leaving the rest pending.
+    if (p_cpu->m_lazy_op != TM_LAZY_NONE)
+    {
+        bool l_add = (p_cpu->m_lazy_op == TM_LAZY_ADD);
+        switch (p_condition)
+        {
+            case TM_CONDITION_N:    return true;
+            case TM_CONDITION_CS:   return tm_lazy_carry(p_cpu) == true;
+            case TM_CONDITION_CC:   return tm_lazy_carry(p_cpu) == false;
+            case TM_CONDITION_ZS:   return tm_lazy_zero(p_cpu) == true;
+            case TM_CONDITION_ZC:   return tm_lazy_zero(p_cpu) == false;
+            case TM_CONDITION_OS:   return l_add == true && tm_lazy_carry(p_cpu) == true;
+            case TM_CONDITION_US:   return l_add == false && tm_lazy_carry(p_cpu) == true;
+            default:                return false;
+        }
+    }
+
     switch (p_condition)
     {
         case TM_CONDITION_N:    return true;
@@ -209,56 +761,119 @@ static bool tm_check_condition (tm_cpu_t* p_cpu, enum_t p_condition)
     }
 }
 
-static void tm_handle_interrupts (tm_cpu_t* p_cpu)
+static inline void tm_update_interrupts (tm_cpu_t* p_cpu)
+{
+    p_cpu->m_interrupts = p_cpu->m_registers.m_if & p_cpu->m_registers.m_ie;
+}
+
+static inline word_t tm_collect_interrupts (tm_cpu_t* p_cpu)
 {
-    for (uint8_t i = 0; i < 16; ++i)
+    // Interrupts requested by other threads are posted to their own mask, so
+    // that only the CPU's thread ever writes to `IF`. They are moved into `IF`
+    // here, at the end of a step, and the current value of `IF` is returned.
+    if (atomic_load_explicit(&p_cpu->m_async_interrupts, memory_order_relaxed) != 0)
     {
-        if (
-            tm_check_bit(p_cpu->m_registers.m_if, i) == true &&
-            tm_check_bit(p_cpu->m_registers.m_ie, i) == true
-        )
+        word_t l_interrupts =
+            atomic_exchange_explicit(&p_cpu->m_async_interrupts, 0, memory_order_acquire);
+        if (p_cpu->m_replay != nullptr)
+        {
+            tm_record_interrupts(p_cpu, l_interrupts);
+        }
+        else
         {
-            tm_push_address(p_cpu, p_cpu->m_registers.m_pc);
-            p_cpu->m_registers.m_pc = TM_INT_START + (0x100 * i);
+            p_cpu->m_registers.m_if |= l_interrupts;
+            tm_update_interrupts(p_cpu);
+        }
+    }
 
-            tm_set_bit(p_cpu->m_registers.m_if, i, false);
-            p_cpu->m_flags.m_halt = false;
-            p_cpu->m_ime = false;
+    return p_cpu->m_registers.m_if;
+}
 
-            return;
-        }
+static void tm_handle_interrupts (tm_cpu_t* p_cpu)
+{
+    // The lowest interrupt requested and enabled has the highest priority.
+    if (p_cpu->m_interrupts == 0)
+    {
+        return;
     }
+
+    uint8_t l_id = __builtin_ctz(p_cpu->m_interrupts);
+    tm_push_address(p_cpu, p_cpu->m_registers.m_pc);
+    p_cpu->m_registers.m_pc = TM_INT_START + (0x100 * l_id);
+
+    tm_set_bit(p_cpu->m_registers.m_if, l_id, false);
+    tm_update_interrupts(p_cpu);
+    p_cpu->m_flags.m_halt = false;
+    p_cpu->m_ime = false;
 }
 
 /* Static Functions - Fetching Operands ***************************************/
 
+static bool tm_read_operand (tm_cpu_t* p_cpu, size_t p_size, long_t* p_value)
+{
+    // Read an instruction's immediate operand from the bus. If the instruction
+    // is being decoded into the cache, record the operand so later executions
+    // can skip the bus read.
+    tm_decoded_instruction_t* l_entry = p_cpu->m_decoding;
+    bool l_good = false;
+    switch (p_size)
+    {
+        case 1:     l_good = tm_read_byte(p_cpu, p_cpu->m_registers.m_pc, p_value); break;
+        case 2:     l_good = tm_read_word(p_cpu, p_cpu->m_registers.m_pc, p_value); break;
+        default:    l_good = tm_read_long(p_cpu, p_cpu->m_registers.m_pc, p_value); break;
+    }
+
+    if (l_good == true && l_entry != nullptr)
+    {
+        l_entry->m_operand = *p_value;
+        l_entry->m_size += p_size;
+    }
+
+    return l_good && tm_advance_pc(p_cpu, p_size);
+}
+
+TM_SPECIALISED bool tm_fetch_operand (tm_cpu_t* p_cpu, size_t p_size, long_t* p_value)
+{
+    // Every instruction reads at most one immediate operand from the program
+    // counter, and that operand never changes for as long as the instruction
+    // remains in the decode cache. If the current instruction was replayed
+    // from the cache, hand back the operand recorded when it was first
+    // decoded instead of reading it from the bus again. The CPU is still
+    // cycled as though the operand's bytes had been read.
+    tm_decoded_instruction_t* l_entry = p_cpu->m_decoding;
+    if (l_entry != nullptr && l_entry->m_valid == true)
+    {
+        *p_value = l_entry->m_operand;
+        return tm_advance_pc(p_cpu, p_size);
+    }
+
+    return tm_read_operand(p_cpu, p_size, p_value);
+}
+
 static bool tm_fetch_imm8 (tm_cpu_t* p_cpu)
 {
     return
         tm_check_readable(p_cpu, p_cpu->m_registers.m_pc, 1) &&
-        tm_read_byte(p_cpu, p_cpu->m_registers.m_pc, &p_cpu->m_registers.m_md) &&
-        tm_advance_cpu(p_cpu, 1);
+        tm_fetch_operand(p_cpu, 1, &p_cpu->m_registers.m_md);
 }
 
-static bool tm_fetch_imm16 (tm_cpu_t* p_cpu)
+TM_SPECIALISED bool tm_fetch_imm16 (tm_cpu_t* p_cpu)
 {
     return
         tm_check_readable(p_cpu, p_cpu->m_registers.m_pc, 2) &&
-        tm_read_word(p_cpu, p_cpu->m_registers.m_pc, &p_cpu->m_registers.m_md) &&
-        tm_advance_cpu(p_cpu, 2);
+        tm_fetch_operand(p_cpu, 2, &p_cpu->m_registers.m_md);
 }
 
 static bool tm_fetch_imm32 (tm_cpu_t* p_cpu)
 {
     return
         tm_check_readable(p_cpu, p_cpu->m_registers.m_pc, 4) &&
-        tm_read_long(p_cpu, p_cpu->m_registers.m_pc, &p_cpu->m_registers.m_md) &&
-        tm_advance_cpu(p_cpu, 4);
+        tm_fetch_operand(p_cpu, 4, &p_cpu->m_registers.m_md);
 }
 
 static bool tm_fetch_reg (tm_cpu_t* p_cpu, bool p_second)
 {
-    return tm_read_cpu_register(
+    return tm_load_register(
         p_cpu, 
         (p_second == true) ?
             p_cpu->m_param2 :
@@ -267,11 +882,9 @@ static bool tm_fetch_reg (tm_cpu_t* p_cpu, bool p_second)
     );
 }
 
-static bool tm_fetch_addr32 (tm_cpu_t* p_cpu, bool p_dest)
+TM_SPECIALISED bool tm_fetch_addr32 (tm_cpu_t* p_cpu, bool p_dest)
 {
-    bool l_good =
-        tm_read_long(p_cpu, p_cpu->m_registers.m_pc, &p_cpu->m_registers.m_ma) &&
-        tm_advance_cpu(p_cpu, 4);
+    bool l_good = tm_fetch_operand(p_cpu, 4, &p_cpu->m_registers.m_ma);
 
     p_cpu->m_da = p_dest;
     return l_good;
@@ -281,7 +894,7 @@ static bool tm_fetch_regptr32 (tm_cpu_t* p_cpu, bool p_dest)
 {
     bool l_good = 
         (p_cpu->m_param2 & 0b11) == 0 &&
-        tm_read_cpu_register(p_cpu, p_cpu->m_param2, &p_cpu->m_registers.m_ma) &&
+        tm_load_register(p_cpu, p_cpu->m_param2, &p_cpu->m_registers.m_ma) &&
         tm_check_readable(p_cpu, p_cpu->m_registers.m_ma, 4);
 
     p_cpu->m_da = p_dest;
@@ -289,63 +902,46 @@ static bool tm_fetch_regptr32 (tm_cpu_t* p_cpu, bool p_dest)
 }
 
 
-static bool tm_fetch_reg_imm (tm_cpu_t* p_cpu)
+TM_SPECIALISED bool tm_fetch_reg_imm (tm_cpu_t* p_cpu, enum_t p_width)
 {
     bool l_good = false;
-    switch (p_cpu->m_param1 & 0b11)
+    switch (p_width)
     {
-        case 0:
-        {
-            l_good =
-                tm_read_long(p_cpu, p_cpu->m_registers.m_pc, &p_cpu->m_registers.m_md) &&
-                tm_advance_cpu(p_cpu, 4);
-        } break;
-        case 1:
-        {
-            l_good =
-                tm_read_word(p_cpu, p_cpu->m_registers.m_pc, &p_cpu->m_registers.m_md) &&
-                tm_advance_cpu(p_cpu, 2);
-        } break;
-        default:
-        {
-            l_good =
-                tm_read_byte(p_cpu, p_cpu->m_registers.m_pc, &p_cpu->m_registers.m_md) &&
-                tm_advance_cpu(p_cpu, 1);
-        } break;
+        case 0:     l_good = tm_fetch_operand(p_cpu, 4, &p_cpu->m_registers.m_md); break;
+        case 1:     l_good = tm_fetch_operand(p_cpu, 2, &p_cpu->m_registers.m_md); break;
+        default:    l_good = tm_fetch_operand(p_cpu, 1, &p_cpu->m_registers.m_md); break;
     }
 
     return l_good;
 }
 
-static bool tm_fetch_reg_addr8 (tm_cpu_t* p_cpu)
+TM_SPECIALISED bool tm_fetch_reg_addr8 (tm_cpu_t* p_cpu, enum_t p_width)
 {
-    bool l_good =
-        tm_read_byte(p_cpu, p_cpu->m_registers.m_pc, &p_cpu->m_registers.m_ma) &&
-        tm_advance_cpu(p_cpu, 1);
+    bool l_good = tm_fetch_operand(p_cpu, 1, &p_cpu->m_registers.m_ma);
 
     if (l_good == true)
     {
         p_cpu->m_registers.m_ma += TM_IO_START;
 
-        switch (p_cpu->m_param1 & 0b11)
+        switch (p_width)
         {
             case 0:
             {
                 l_good =
                     tm_read_long(p_cpu, p_cpu->m_registers.m_ma, &p_cpu->m_registers.m_md) &&
-                    tm_cycle_cpu(p_cpu, 4);
+                    tm_spend_cycles(p_cpu, 4);
             } break;
             case 1:
             {
                 l_good =
                     tm_read_word(p_cpu, p_cpu->m_registers.m_ma, &p_cpu->m_registers.m_md) &&
-                    tm_cycle_cpu(p_cpu, 2);
+                    tm_spend_cycles(p_cpu, 2);
             } break;
             default:
             {
                 l_good =
                     tm_read_byte(p_cpu, p_cpu->m_registers.m_ma, &p_cpu->m_registers.m_md) &&
-                    tm_cycle_cpu(p_cpu, 1);
+                    tm_spend_cycles(p_cpu, 1);
             } break;
         }
     }
@@ -353,35 +949,33 @@ static bool tm_fetch_reg_addr8 (tm_cpu_t* p_cpu)
     return l_good;
 }
 
-static bool tm_fetch_reg_addr16 (tm_cpu_t* p_cpu)
+TM_SPECIALISED bool tm_fetch_reg_addr16 (tm_cpu_t* p_cpu, enum_t p_width)
 {
-    bool l_good =
-        tm_read_word(p_cpu, p_cpu->m_registers.m_pc, &p_cpu->m_registers.m_ma) &&
-        tm_advance_cpu(p_cpu, 2);
+    bool l_good = tm_fetch_operand(p_cpu, 2, &p_cpu->m_registers.m_ma);
 
     if (l_good == true)
     {
         p_cpu->m_registers.m_ma += TM_QRAM_START;
 
-        switch (p_cpu->m_param1 & 0b11)
+        switch (p_width)
         {
             case 0:
             {
                 l_good =
                     tm_read_long(p_cpu, p_cpu->m_registers.m_ma, &p_cpu->m_registers.m_md) &&
-                    tm_cycle_cpu(p_cpu, 4);
+                    tm_spend_cycles(p_cpu, 4);
             } break;
             case 1:
             {
                 l_good =
                     tm_read_word(p_cpu, p_cpu->m_registers.m_ma, &p_cpu->m_registers.m_md) &&
-                    tm_cycle_cpu(p_cpu, 2);
+                    tm_spend_cycles(p_cpu, 2);
             } break;
             default:
             {
                 l_good =
                     tm_read_byte(p_cpu, p_cpu->m_registers.m_ma, &p_cpu->m_registers.m_md) &&
-                    tm_cycle_cpu(p_cpu, 1);
+                    tm_spend_cycles(p_cpu, 1);
             } break;
         }
     }
@@ -389,36 +983,34 @@ static bool tm_fetch_reg_addr16 (tm_cpu_t* p_cpu)
     return l_good;
 }
 
-static bool tm_fetch_reg_addr32 (tm_cpu_t* p_cpu)
+TM_SPECIALISED bool tm_fetch_reg_addr32 (tm_cpu_t* p_cpu, enum_t p_width)
 {
-    bool l_good =
-        tm_read_long(p_cpu, p_cpu->m_registers.m_pc, &p_cpu->m_registers.m_ma) &&
-        tm_advance_cpu(p_cpu, 4);
+    bool l_good = tm_fetch_operand(p_cpu, 4, &p_cpu->m_registers.m_ma);
 
     if (l_good == true)
     {
-        switch (p_cpu->m_param1 & 0b11)
+        switch (p_width)
         {
             case 0:
             {
                 l_good =
                     tm_check_readable(p_cpu, p_cpu->m_registers.m_ma, 4) &&
                     tm_read_long(p_cpu, p_cpu->m_registers.m_ma, &p_cpu->m_registers.m_md) &&
-                    tm_cycle_cpu(p_cpu, 4);
+                    tm_spend_cycles(p_cpu, 4);
             } break;
             case 1:
             {
                 l_good =
                     tm_check_readable(p_cpu, p_cpu->m_registers.m_ma, 2) &&
                     tm_read_word(p_cpu, p_cpu->m_registers.m_ma, &p_cpu->m_registers.m_md) &&
-                    tm_cycle_cpu(p_cpu, 2);
+                    tm_spend_cycles(p_cpu, 2);
             } break;
             default:
             {
                 l_good =
                     tm_check_readable(p_cpu, p_cpu->m_registers.m_ma, 1) &&
                     tm_read_byte(p_cpu, p_cpu->m_registers.m_ma, &p_cpu->m_registers.m_md) &&
-                    tm_cycle_cpu(p_cpu, 1);
+                    tm_spend_cycles(p_cpu, 1);
             } break;
         }
     }
@@ -426,37 +1018,37 @@ static bool tm_fetch_reg_addr32 (tm_cpu_t* p_cpu)
     return l_good;
 }
 
-static bool tm_fetch_reg_regptr32 (tm_cpu_t* p_cpu)
+TM_SPECIALISED bool tm_fetch_reg_regptr32 (tm_cpu_t* p_cpu, enum_t p_width)
 {
     bool l_good = 
         (p_cpu->m_param2 & 0b11) == 0 &&
-        tm_read_cpu_register(p_cpu, p_cpu->m_param2, &p_cpu->m_registers.m_ma) &&
+        tm_load_register(p_cpu, p_cpu->m_param2, &p_cpu->m_registers.m_ma) &&
         tm_check_readable(p_cpu, p_cpu->m_registers.m_ma, 4);
 
     if (l_good == true)
     {
-        switch (p_cpu->m_param1 & 0b11)
+        switch (p_width)
         {
             case 0:
             {
                 l_good =
                     tm_check_readable(p_cpu, p_cpu->m_registers.m_ma, 4) &&
                     tm_read_long(p_cpu, p_cpu->m_registers.m_ma, &p_cpu->m_registers.m_md) &&
-                    tm_cycle_cpu(p_cpu, 4);
+                    tm_spend_cycles(p_cpu, 4);
             } break;
             case 1:
             {
                 l_good =
                     tm_check_readable(p_cpu, p_cpu->m_registers.m_ma, 2) &&
                     tm_read_word(p_cpu, p_cpu->m_registers.m_ma, &p_cpu->m_registers.m_md) &&
-                    tm_cycle_cpu(p_cpu, 2);
+                    tm_spend_cycles(p_cpu, 2);
             } break;
             default:
             {
                 l_good =
                     tm_check_readable(p_cpu, p_cpu->m_registers.m_ma, 1) &&
                     tm_read_byte(p_cpu, p_cpu->m_registers.m_ma, &p_cpu->m_registers.m_md) &&
-                    tm_cycle_cpu(p_cpu, 1);
+                    tm_spend_cycles(p_cpu, 1);
             } break;
         }
     }
@@ -467,9 +1059,8 @@ static bool tm_fetch_reg_regptr32 (tm_cpu_t* p_cpu)
 static bool tm_fetch_addr8_reg (tm_cpu_t* p_cpu)
 {
     bool l_good =
-        tm_read_cpu_register(p_cpu, p_cpu->m_param2, &p_cpu->m_registers.m_md) &&
-        tm_read_byte(p_cpu, p_cpu->m_registers.m_pc, &p_cpu->m_registers.m_ma) &&
-        tm_advance_cpu(p_cpu, 1);
+        tm_load_register(p_cpu, p_cpu->m_param2, &p_cpu->m_registers.m_md) &&
+        tm_fetch_operand(p_cpu, 1, &p_cpu->m_registers.m_ma);
 
     if (l_good == true)
     {
@@ -483,9 +1074,8 @@ static bool tm_fetch_addr8_reg (tm_cpu_t* p_cpu)
 static bool tm_fetch_addr16_reg (tm_cpu_t* p_cpu)
 {
     bool l_good =
-        tm_read_cpu_register(p_cpu, p_cpu->m_param2, &p_cpu->m_registers.m_md) &&
-        tm_read_word(p_cpu, p_cpu->m_registers.m_pc, &p_cpu->m_registers.m_ma) &&
-        tm_advance_cpu(p_cpu, 2);
+        tm_load_register(p_cpu, p_cpu->m_param2, &p_cpu->m_registers.m_md) &&
+        tm_fetch_operand(p_cpu, 2, &p_cpu->m_registers.m_ma);
 
     if (l_good == true)
     {
@@ -496,14 +1086,13 @@ static bool tm_fetch_addr16_reg (tm_cpu_t* p_cpu)
     return l_good;
 }
 
-static bool tm_fetch_addr32_reg (tm_cpu_t* p_cpu)
+TM_SPECIALISED bool tm_fetch_addr32_reg (tm_cpu_t* p_cpu, enum_t p_width)
 {
     bool l_good =
-        tm_read_cpu_register(p_cpu, p_cpu->m_param2, &p_cpu->m_registers.m_md) &&
-        tm_read_long(p_cpu, p_cpu->m_registers.m_pc, &p_cpu->m_registers.m_ma) &&
-        tm_advance_cpu(p_cpu, 4);
+        tm_load_register(p_cpu, p_cpu->m_param2, &p_cpu->m_registers.m_md) &&
+        tm_fetch_operand(p_cpu, 4, &p_cpu->m_registers.m_ma);
 
-    switch (p_cpu->m_param2 & 0b11)
+    switch (p_width)
     {
         case 0:     l_good = tm_check_writable(p_cpu, p_cpu->m_registers.m_ma, 4); break;
         case 1:     l_good = tm_check_writable(p_cpu, p_cpu->m_registers.m_ma, 2); break;
@@ -514,14 +1103,14 @@ static bool tm_fetch_addr32_reg (tm_cpu_t* p_cpu)
     return l_good;
 }
 
-static bool tm_fetch_regptr32_reg (tm_cpu_t* p_cpu)
+TM_SPECIALISED bool tm_fetch_regptr32_reg (tm_cpu_t* p_cpu, enum_t p_width)
 {
     bool l_good =
         (p_cpu->m_param1 & 0b11) == 0 &&
-        tm_read_cpu_register(p_cpu, p_cpu->m_param2, &p_cpu->m_registers.m_md) &&
-        tm_read_cpu_register(p_cpu, p_cpu->m_param1, &p_cpu->m_registers.m_ma);
+        tm_load_register(p_cpu, p_cpu->m_param2, &p_cpu->m_registers.m_md) &&
+        tm_load_register(p_cpu, p_cpu->m_param1, &p_cpu->m_registers.m_ma);
 
-    switch (p_cpu->m_param2 & 0b11)
+    switch (p_width)
     {
         case 0:     l_good = tm_check_writable(p_cpu, p_cpu->m_registers.m_ma, 4); break;
         case 1:     l_good = tm_check_writable(p_cpu, p_cpu->m_registers.m_ma, 2); break;
@@ -602,7 +1191,7 @@ static bool tm_execute_daa (tm_cpu_t* p_cpu)
 
     // Fetch the value of `AL`.
     long_t l_al = 0;
-    tm_read_cpu_register(p_cpu, TM_REGISTER_AL, &l_al);
+    tm_load_register(p_cpu, TM_REGISTER_AL, &l_al);
 
     // Keep track of the amount by which `AL` needs to be adjusted, and the
     // result of the adjustment.
@@ -612,7 +1201,7 @@ static bool tm_execute_daa (tm_cpu_t* p_cpu)
     // The decimal adjustment is performed on a per-nibble basis. Start with the
     // lower nibble of `AL`. If the nibble's value is a letter (between A and F),
     // or if the half-carry flag is set, then that nibble needs to be adjusted.
-    if (p_cpu->m_flags.m_half_carry == true || ((l_al & 0x0F) > 0x09))
+    if (tm_get_flags(p_cpu)->m_half_carry == true || ((l_al & 0x0F) > 0x09))
     {
         l_al_adjust += 0x06;
     }
@@ -620,29 +1209,29 @@ static bool tm_execute_daa (tm_cpu_t* p_cpu)
     // Next, check to see if the upper nibble needs to be decimal adjusted. It
     // will need to be if that nibble is between A and F, or if the carry flag
     // is set. Also, set the carry flag accordingly.
-    if (p_cpu->m_flags.m_carry == true || ((l_al & 0xF0) > 0x90))
+    if (tm_get_flags(p_cpu)->m_carry == true || ((l_al & 0xF0) > 0x90))
     {
-        p_cpu->m_flags.m_carry = true;
+        tm_get_flags(p_cpu)->m_carry = true;
         l_al_adjust += 0x60;
     }
     else
     {
-        p_cpu->m_flags.m_carry = false;
+        tm_get_flags(p_cpu)->m_carry = false;
     }
 
     // Depending on the state of the subtraction flag, the adjust value will be
     // either added to or subtracted from `AL`.
-    l_al_result = (p_cpu->m_flags.m_negative == true) ?
+    l_al_result = (tm_get_flags(p_cpu)->m_negative == true) ?
         (l_al - l_al_adjust) : (l_al + l_al_adjust);
 
     // Write the result to `AL`, then set flags.
-    tm_write_cpu_register(p_cpu, TM_REGISTER_AL, l_al_result);
-    p_cpu->m_flags.m_zero = (tm_check_byte(l_al_result, 0) == 0);
-    p_cpu->m_flags.m_half_carry = false;
-    p_cpu->m_flags.m_overflow =
-        (p_cpu->m_flags.m_carry == true && p_cpu->m_flags.m_negative == false);
-    p_cpu->m_flags.m_underflow =
-        (p_cpu->m_flags.m_carry == true && p_cpu->m_flags.m_negative == true);
+    tm_store_register(p_cpu, TM_REGISTER_AL, l_al_result);
+    tm_get_flags(p_cpu)->m_zero = (tm_check_byte(l_al_result, 0) == 0);
+    tm_get_flags(p_cpu)->m_half_carry = false;
+    tm_get_flags(p_cpu)->m_overflow =
+        (tm_get_flags(p_cpu)->m_carry == true && tm_get_flags(p_cpu)->m_negative == false);
+    tm_get_flags(p_cpu)->m_underflow =
+        (tm_get_flags(p_cpu)->m_carry == true && tm_get_flags(p_cpu)->m_negative == true);
 
     return true;
 }
@@ -653,11 +1242,11 @@ static bool tm_execute_cpl (tm_cpu_t* p_cpu)
     // register `A` - that is, it clears the set bits and sets the clear bits.
 
     long_t l_a = 0;
-    tm_read_cpu_register(p_cpu, TM_REGISTER_A, &l_a);
-    tm_write_cpu_register(p_cpu, TM_REGISTER_A, ~l_a);
+    tm_load_register(p_cpu, TM_REGISTER_A, &l_a);
+    tm_store_register(p_cpu, TM_REGISTER_A, ~l_a);
 
-    p_cpu->m_flags.m_negative = true;
-    p_cpu->m_flags.m_half_carry = true;
+    tm_get_flags(p_cpu)->m_negative = true;
+    tm_get_flags(p_cpu)->m_half_carry = true;
     return true;
 }
 
@@ -667,11 +1256,11 @@ static bool tm_execute_cpw (tm_cpu_t* p_cpu)
     // register `AW`.
 
     long_t l_aw = 0;
-    tm_read_cpu_register(p_cpu, TM_REGISTER_AW, &l_aw);
-    tm_write_cpu_register(p_cpu, TM_REGISTER_AW, ~l_aw);
+    tm_load_register(p_cpu, TM_REGISTER_AW, &l_aw);
+    tm_store_register(p_cpu, TM_REGISTER_AW, ~l_aw);
 
-    p_cpu->m_flags.m_negative = true;
-    p_cpu->m_flags.m_half_carry = true;
+    tm_get_flags(p_cpu)->m_negative = true;
+    tm_get_flags(p_cpu)->m_half_carry = true;
     return true;
 }
 
@@ -681,11 +1270,11 @@ static bool tm_execute_cpb (tm_cpu_t* p_cpu)
     // register `AL`.
 
     long_t l_al = 0;
-    tm_read_cpu_register(p_cpu, TM_REGISTER_AL, &l_al);
-    tm_write_cpu_register(p_cpu, TM_REGISTER_AL, ~l_al);
+    tm_load_register(p_cpu, TM_REGISTER_AL, &l_al);
+    tm_store_register(p_cpu, TM_REGISTER_AL, ~l_al);
 
-    p_cpu->m_flags.m_negative = true;
-    p_cpu->m_flags.m_half_carry = true;
+    tm_get_flags(p_cpu)->m_negative = true;
+    tm_get_flags(p_cpu)->m_half_carry = true;
     return true;
 }
 
@@ -693,11 +1282,11 @@ static bool tm_execute_scf (tm_cpu_t* p_cpu)
 {
     // The `SCF` instruction sets the carry flag. It also clears the subtraction,
     // half-carry, overflow and underflow flags.
-    p_cpu->m_flags.m_negative   = false;
-    p_cpu->m_flags.m_half_carry = false;
-    p_cpu->m_flags.m_carry      = true;
-    p_cpu->m_flags.m_overflow   = false;
-    p_cpu->m_flags.m_underflow  = false;
+    tm_get_flags(p_cpu)->m_negative   = false;
+    tm_get_flags(p_cpu)->m_half_carry = false;
+    tm_get_flags(p_cpu)->m_carry      = true;
+    tm_get_flags(p_cpu)->m_overflow   = false;
+    tm_get_flags(p_cpu)->m_underflow  = false;
     return true;
 }
 
@@ -706,11 +1295,11 @@ static bool tm_execute_ccf (tm_cpu_t* p_cpu)
     // The `CCF` instruction compliments the carry flag, clearing the flag it it's
     // set and setting the flag if it's clear. It also clears the subtraction,
     // half-carry, overflow and underflow flags.
-    p_cpu->m_flags.m_negative   = false;
-    p_cpu->m_flags.m_half_carry = false;
-    p_cpu->m_flags.m_carry      = !p_cpu->m_flags.m_carry;
-    p_cpu->m_flags.m_overflow   = false;
-    p_cpu->m_flags.m_underflow  = false;
+    tm_get_flags(p_cpu)->m_negative   = false;
+    tm_get_flags(p_cpu)->m_half_carry = false;
+    tm_get_flags(p_cpu)->m_carry      = !tm_get_flags(p_cpu)->m_carry;
+    tm_get_flags(p_cpu)->m_overflow   = false;
+    tm_get_flags(p_cpu)->m_underflow  = false;
     return true;
 }
 
@@ -724,14 +1313,14 @@ static bool tm_execute_ld (tm_cpu_t* p_cpu)
     // used for quickly loading data from quick RAM (QRAM) and from the IO
     // port registers.
 
-    return tm_write_cpu_register(
+    return tm_store_register(
         p_cpu, 
         p_cpu->m_param1, 
         p_cpu->m_registers.m_md
     );
 }
 
-static bool tm_execute_st (tm_cpu_t* p_cpu)
+TM_SPECIALISED bool tm_execute_st (tm_cpu_t* p_cpu, enum_t p_width)
 {
     // The `ST` instruction copies the value stored in the memory data register
     // (MDR) into memory at an address specified by the memory address register
@@ -742,22 +1331,22 @@ static bool tm_execute_st (tm_cpu_t* p_cpu)
     // registers.
 
     bool l_good = true;
-    switch (p_cpu->m_param2 & 0b11)
+    switch (p_width)
     {
         case 0:
             l_good =
                 tm_write_long(p_cpu, p_cpu->m_registers.m_ma, p_cpu->m_registers.m_md) &&
-                tm_cycle_cpu(p_cpu, 4);
+                tm_spend_cycles(p_cpu, 4);
             break;
         case 1:
             l_good =
                 tm_write_word(p_cpu, p_cpu->m_registers.m_ma, p_cpu->m_registers.m_md) &&
-                tm_cycle_cpu(p_cpu, 2);
+                tm_spend_cycles(p_cpu, 2);
             break;
         default:
             l_good =
                 tm_write_word(p_cpu, p_cpu->m_registers.m_ma, p_cpu->m_registers.m_md) &&
-                tm_cycle_cpu(p_cpu, 1);
+                tm_spend_cycles(p_cpu, 1);
             break;
     }
 
@@ -769,7 +1358,7 @@ static bool tm_execute_mv (tm_cpu_t* p_cpu)
     // The `MV` instruction copies the value stored in the memory data register
     // (MDR) into a destination register specified by parameter #1.
 
-    return tm_write_cpu_register(
+    return tm_store_register(
         p_cpu, 
         p_cpu->m_param1, 
         p_cpu->m_registers.m_md
@@ -781,7 +1370,7 @@ static bool tm_execute_push (tm_cpu_t* p_cpu)
     // The `PUSH` instruction pushes the value stored in the memory data register
     // into the data stack.
 
-    return tm_push_data(p_cpu, p_cpu->m_registers.m_md) && tm_cycle_cpu(p_cpu, 5);
+    return tm_push_data(p_cpu, p_cpu->m_registers.m_md) && tm_spend_cycles(p_cpu, 5);
 }
 
 static bool tm_execute_pop (tm_cpu_t* p_cpu)
@@ -792,11 +1381,11 @@ static bool tm_execute_pop (tm_cpu_t* p_cpu)
 
     return
         tm_pop_data(p_cpu, &p_cpu->m_registers.m_md) &&
-        tm_cycle_cpu(p_cpu, 5) &&
-        tm_write_cpu_register(p_cpu, p_cpu->m_param1, p_cpu->m_registers.m_md);
+        tm_spend_cycles(p_cpu, 5) &&
+        tm_store_register(p_cpu, p_cpu->m_param1, p_cpu->m_registers.m_md);
 }
 
-static bool tm_execute_jmp (tm_cpu_t* p_cpu)
+TM_SPECIALISED bool tm_execute_jmp (tm_cpu_t* p_cpu)
 {
     // The `JMP` instruction moves the program counter to a memory location
     // specified by the memory data register, provided the condition specified
@@ -805,13 +1394,13 @@ static bool tm_execute_jmp (tm_cpu_t* p_cpu)
     if (tm_check_condition(p_cpu, p_cpu->m_param1) == true)
     {
         p_cpu->m_registers.m_pc = p_cpu->m_registers.m_ma;
-        return tm_cycle_cpu(p_cpu, 1);
+        return tm_spend_cycles(p_cpu, 1);
     }
 
     return true;
 }
 
-static bool tm_execute_jpb (tm_cpu_t* p_cpu)
+TM_SPECIALISED bool tm_execute_jpb (tm_cpu_t* p_cpu)
 {
     // The `JPB` instruction moves the program counter by a signed offset
     // specified by the memory data register, provided the condition specified
@@ -820,7 +1409,7 @@ static bool tm_execute_jpb (tm_cpu_t* p_cpu)
     if (tm_check_condition(p_cpu, p_cpu->m_param1) == true)
     {
         p_cpu->m_registers.m_pc += (int16_t) p_cpu->m_registers.m_md;
-        return tm_cycle_cpu(p_cpu, 1);
+        return tm_spend_cycles(p_cpu, 1);
     }
 
     return true;
@@ -836,14 +1425,14 @@ static bool tm_execute_call (tm_cpu_t* p_cpu)
     {
         if (
             tm_push_address(p_cpu, p_cpu->m_registers.m_pc) == false ||
-            tm_cycle_cpu(p_cpu, 5) == false
+            tm_spend_cycles(p_cpu, 5) == false
         )
         {
             return false;
         }
 
         p_cpu->m_registers.m_pc = p_cpu->m_registers.m_ma;
-        return tm_cycle_cpu(p_cpu, 1);
+        return tm_spend_cycles(p_cpu, 1);
     }
 
     return true;
@@ -857,14 +1446,14 @@ static bool tm_execute_rst (tm_cpu_t* p_cpu)
 
     if (
         tm_push_address(p_cpu, p_cpu->m_registers.m_pc) == false ||
-        tm_cycle_cpu(p_cpu, 5) == false
+        tm_spend_cycles(p_cpu, 5) == false
     )
     {
         return false;
     }
 
     p_cpu->m_registers.m_pc = TM_RST_START + (0x100 * p_cpu->m_param1);
-    return tm_cycle_cpu(p_cpu, 1);
+    return tm_spend_cycles(p_cpu, 1);
 }
 
 static bool tm_execute_ret (tm_cpu_t* p_cpu)
@@ -877,7 +1466,7 @@ static bool tm_execute_ret (tm_cpu_t* p_cpu)
     {
         return
             tm_pop_address(p_cpu, &p_cpu->m_registers.m_pc) &&
-            tm_cycle_cpu(p_cpu, 6);
+            tm_spend_cycles(p_cpu, 6);
     }
 
     return true;
@@ -898,10 +1487,10 @@ static bool tm_execute_jps (tm_cpu_t* p_cpu)
     // program's address space, `$00003000`.
 
     p_cpu->m_registers.m_pc = TM_PROGRAM_START;
-    return tm_cycle_cpu(p_cpu, 1);
+    return tm_spend_cycles(p_cpu, 1);
 }
 
-static bool tm_execute_inc (tm_cpu_t* p_cpu)
+TM_SPECIALISED bool tm_execute_inc (tm_cpu_t* p_cpu, enum_t p_width)
 {
     // The `INC` instruction increments the value of the memory data register
     // (MDR) by 1.
@@ -916,36 +1505,36 @@ static bool tm_execute_inc (tm_cpu_t* p_cpu)
     uint64_t l_result = p_cpu->m_registers.m_md + 1;
 
     // An increment does not involve subtraction, so clear the negative flag.  
-    p_cpu->m_flags.m_negative = false;
+    tm_get_flags(p_cpu)->m_negative = false;
 
     if (p_cpu->m_da == true)
     {
-        p_cpu->m_flags.m_zero = (l_result & 0xFF) == 0;
-        p_cpu->m_flags.m_half_carry = (l_result & 0xF) == 0;
+        tm_get_flags(p_cpu)->m_zero = (l_result & 0xFF) == 0;
+        tm_get_flags(p_cpu)->m_half_carry = (l_result & 0xF) == 0;
 
         return
             tm_write_byte(p_cpu, p_cpu->m_registers.m_ma, l_result & 0xFF) &&
-            tm_cycle_cpu(p_cpu, 1);
+            tm_spend_cycles(p_cpu, 1);
     }
 
-    switch (p_cpu->m_param1 & 0b11)
+    switch (p_width)
     {
         case 0:
-            p_cpu->m_flags.m_zero = (l_result & 0xFFFFFFFF) == 0;
+            tm_get_flags(p_cpu)->m_zero = (l_result & 0xFFFFFFFF) == 0;
             break;
         case 1:
-            p_cpu->m_flags.m_zero = (l_result & 0xFFFF) == 0;
+            tm_get_flags(p_cpu)->m_zero = (l_result & 0xFFFF) == 0;
             break;
         default:
-            p_cpu->m_flags.m_zero = (l_result & 0xFF) == 0;
-            p_cpu->m_flags.m_half_carry = (l_result & 0xF) == 0;
+            tm_get_flags(p_cpu)->m_zero = (l_result & 0xFF) == 0;
+            tm_get_flags(p_cpu)->m_half_carry = (l_result & 0xF) == 0;
             break;
     }
 
-    return tm_write_cpu_register(p_cpu, p_cpu->m_param1, l_result & 0xFFFFFFFF);
+    return tm_store_register(p_cpu, p_cpu->m_param1, l_result & 0xFFFFFFFF);
 }
 
-static bool tm_execute_dec (tm_cpu_t* p_cpu)
+TM_SPECIALISED bool tm_execute_dec (tm_cpu_t* p_cpu, enum_t p_width)
 {
     // The `DEC` instruction decrements the value of the memory data register
     // (MDR) by 1.
@@ -960,36 +1549,36 @@ static bool tm_execute_dec (tm_cpu_t* p_cpu)
     uint64_t l_result = p_cpu->m_registers.m_md - 1;
 
     // A decrement involves subtraction, so set the negative flag.  
-    p_cpu->m_flags.m_negative = true;
+    tm_get_flags(p_cpu)->m_negative = true;
 
     if (p_cpu->m_da == true)
     {
-        p_cpu->m_flags.m_zero = (l_result & 0xFF) == 0;
-        p_cpu->m_flags.m_half_carry = (l_result & 0xF) == 0xF;
+        tm_get_flags(p_cpu)->m_zero = (l_result & 0xFF) == 0;
+        tm_get_flags(p_cpu)->m_half_carry = (l_result & 0xF) == 0xF;
 
         return
             tm_write_byte(p_cpu, p_cpu->m_registers.m_ma, l_result & 0xFF) &&
-            tm_cycle_cpu(p_cpu, 1);
+            tm_spend_cycles(p_cpu, 1);
     }
 
-    switch (p_cpu->m_param1 & 0b11)
+    switch (p_width)
     {
         case 0:
-            p_cpu->m_flags.m_zero = (l_result & 0xFFFFFFFF) == 0;
+            tm_get_flags(p_cpu)->m_zero = (l_result & 0xFFFFFFFF) == 0;
             break;
         case 1:
-            p_cpu->m_flags.m_zero = (l_result & 0xFFFF) == 0;
+            tm_get_flags(p_cpu)->m_zero = (l_result & 0xFFFF) == 0;
             break;
         default:
-            p_cpu->m_flags.m_zero = (l_result & 0xFF) == 0;
-            p_cpu->m_flags.m_half_carry = (l_result & 0xF) == 0;
+            tm_get_flags(p_cpu)->m_zero = (l_result & 0xFF) == 0;
+            tm_get_flags(p_cpu)->m_half_carry = (l_result & 0xF) == 0;
             break;
     }
 
-    return tm_write_cpu_register(p_cpu, p_cpu->m_param1, l_result & 0xFFFFFFFF);
+    return tm_store_register(p_cpu, p_cpu->m_param1, l_result & 0xFFFFFFFF);
 }
 
-static bool tm_execute_add (tm_cpu_t* p_cpu, bool p_with_carry)
+TM_SPECIALISED bool tm_execute_add (tm_cpu_t* p_cpu, enum_t p_width, bool p_with_carry)
 {
     // The `ADD` and `ADC` instructions add the value stored in the memory data
     // register (MDR) to the value of a destination accumulator register
@@ -1008,61 +1597,25 @@ static bool tm_execute_add (tm_cpu_t* p_cpu, bool p_with_carry)
 
     // Fetch the value of the target accumulator register.
     long_t l_acc_value = 0;
-    tm_read_cpu_register(p_cpu, p_cpu->m_param1, &l_acc_value);
+    tm_load_register(p_cpu, p_cpu->m_param1, &l_acc_value);
 
     // Add the value of the MDR to the accumulator's value. Add the carry flag
     // if desired. Store the result.
+    bool l_carry = (p_with_carry == true) && tm_get_carry(p_cpu);
     uint64_t l_result = l_acc_value + p_cpu->m_registers.m_md;
-    if (p_with_carry == true) { l_result += p_cpu->m_flags.m_carry; }
-
-    // A second addition operation is needed to calculate a "half-result". This
-    // will be used to properly set the half-carry flag.
-    uint32_t l_half_result = 0;
-
-    // This is an addition, so clear the negative and underflow flags.
-    p_cpu->m_flags.m_negative = false;
-    p_cpu->m_flags.m_underflow = false;
+    l_result += l_carry;
 
     // Write the result back into the accumulator register.
-    tm_write_cpu_register(p_cpu, p_cpu->m_param1, l_result & 0xFFFFFFFF);
-
-    // Set flags as appropriate.
-    switch (p_cpu->m_param1 & 0b11)
-    {
-        case 0:
-            l_half_result =
-                (l_acc_value & 0xFFFFFFF) +
-                (p_cpu->m_registers.m_md & 0xFFFFFFF);
-            p_cpu->m_flags.m_zero = (l_result & 0xFFFFFFFF) == 0;
-            p_cpu->m_flags.m_half_carry = (l_half_result > 0xFFFFFFF);
-            p_cpu->m_flags.m_carry = (l_result > 0xFFFFFFFF);
-            break;
-        case 1:
-            l_half_result =
-                (l_acc_value & 0xFFF) +
-                (p_cpu->m_registers.m_md & 0xFFF);
-            p_cpu->m_flags.m_zero = (l_result & 0xFFFF) == 0;
-            p_cpu->m_flags.m_half_carry = (l_half_result > 0xFFF);
-            p_cpu->m_flags.m_carry = (l_result > 0xFFFF);
-            break;
-        default:
-            l_half_result =
-                (l_acc_value & 0xF) +
-                (p_cpu->m_registers.m_md & 0xF);
-            p_cpu->m_flags.m_zero = (l_result & 0xFF) == 0;
-            p_cpu->m_flags.m_half_carry = (l_half_result > 0xF);
-            p_cpu->m_flags.m_carry = (l_result > 0xFF);
-            break;
-    }
+    tm_store_register(p_cpu, p_cpu->m_param1, l_result & 0xFFFFFFFF);
 
     // Any addition operations which set the carry flag will also set the
-    // overflow flag.
-    p_cpu->m_flags.m_overflow = p_cpu->m_flags.m_carry;
-
+    // overflow flag, and all of them clear the negative and underflow flags.
+    // The flags are worked out when they are next needed.
+    tm_defer_flags(p_cpu, TM_LAZY_ADD, p_width, l_acc_value, p_cpu->m_registers.m_md, l_carry);
     return true;
 }
 
-static bool tm_execute_sub (tm_cpu_t* p_cpu, bool p_with_carry)
+TM_SPECIALISED bool tm_execute_sub (tm_cpu_t* p_cpu, enum_t p_width, bool p_with_carry)
 {
     // The `SUB` and `SBC` instructions subtract the value stored in the memory 
     // data register (MDR) from the value of a destination accumulator register
@@ -1081,63 +1634,26 @@ static bool tm_execute_sub (tm_cpu_t* p_cpu, bool p_with_carry)
 
     // Fetch the value of the target accumulator register.
     long_t l_acc_value = 0;
-    tm_read_cpu_register(p_cpu, p_cpu->m_param1, &l_acc_value);
+    tm_load_register(p_cpu, p_cpu->m_param1, &l_acc_value);
 
     // Subtract the value of the MDR to the accumulator's value. Subtract the 
     // carry flag if desired. Store the result.
+    bool l_carry = (p_with_carry == true) && tm_get_carry(p_cpu);
     int64_t l_result = l_acc_value - p_cpu->m_registers.m_md;
-    if (p_with_carry == true) { l_result -= p_cpu->m_flags.m_carry; }
-
-    // A second subtraction operation is needed to calculate a "half-result". 
-    // This will be used to properly set the half-carry flag.
-    int32_t l_half_result = 0;
-
-    // This is a subtraction, so set the negative flag and clear the overflow
-    // flag.
-    p_cpu->m_flags.m_negative = true;
-    p_cpu->m_flags.m_overflow = false;
+    l_result -= l_carry;
 
     // Write the result back into the accumulator register.
-    tm_write_cpu_register(p_cpu, p_cpu->m_param1, 
+    tm_store_register(p_cpu, p_cpu->m_param1, 
         (uint64_t) l_result & 0xFFFFFFFF);
 
-    // Set flags as appropriate.
-    switch (p_cpu->m_param1 & 0b11)
-    {
-        case 0:
-            l_half_result =
-                (l_acc_value & 0xFFFFFFF) -
-                (p_cpu->m_registers.m_md & 0xFFFFFFF);
-            p_cpu->m_flags.m_zero = (l_result & 0xFFFFFFFF) == 0;
-            p_cpu->m_flags.m_half_carry = (l_half_result < 0);
-            p_cpu->m_flags.m_carry = (l_result < 0);
-            break;
-        case 1:
-            l_half_result =
-                (l_acc_value & 0xFFF) -
-                (p_cpu->m_registers.m_md & 0xFFF);
-            p_cpu->m_flags.m_zero = (l_result & 0xFFFF) == 0;
-            p_cpu->m_flags.m_half_carry = (l_half_result < 0);
-            p_cpu->m_flags.m_carry = (l_result < 0);
-            break;
-        default:
-            l_half_result =
-                (l_acc_value & 0xF) -
-                (p_cpu->m_registers.m_md & 0xF);
-            p_cpu->m_flags.m_zero = (l_result & 0xFF) == 0;
-            p_cpu->m_flags.m_half_carry = (l_half_result < 0);
-            p_cpu->m_flags.m_carry = (l_result < 0);
-            break;
-    }
-
     // Any subtraction operations which set the carry flag will also set the
-    // underflow flag.
-    p_cpu->m_flags.m_underflow = p_cpu->m_flags.m_carry;
-
+    // underflow flag, and all of them set the negative flag and clear the
+    // overflow flag. The flags are worked out when they are next needed.
+    tm_defer_flags(p_cpu, TM_LAZY_SUB, p_width, l_acc_value, p_cpu->m_registers.m_md, l_carry);
     return true;
 }
 
-static bool tm_execute_and (tm_cpu_t* p_cpu)
+TM_SPECIALISED bool tm_execute_and (tm_cpu_t* p_cpu, enum_t p_width)
 {
     // The `AND` instruction performs a bitwise AND between the destination
     // accumulator register specified by parameter #1 and the value of the
@@ -1152,41 +1668,44 @@ static bool tm_execute_and (tm_cpu_t* p_cpu)
         return tm_set_error(p_cpu, TM_ERROR_INVALID_ARGUMENT);
     }
 
+    // Every flag is overwritten below, so nothing pending needs working out.
+    tm_discard_flags(p_cpu);
+
     // Fetch the value of the target accumulator register.
     long_t l_acc_value = 0;
-    tm_read_cpu_register(p_cpu, p_cpu->m_param1, &l_acc_value);
+    tm_load_register(p_cpu, p_cpu->m_param1, &l_acc_value);
 
     // Bitwise AND the accumulator and memory data registers' values. Store
     // the result and write it back to the accumulator.
     long_t l_result = (l_acc_value & p_cpu->m_registers.m_md);
-    tm_write_cpu_register(p_cpu, p_cpu->m_param1, l_result);
+    tm_store_register(p_cpu, p_cpu->m_param1, l_result);
 
     // Set the zero flag based on the result.
-    switch (p_cpu->m_param1 & 0b11)
+    switch (p_width)
     {
         case 0:
-            p_cpu->m_flags.m_zero = (l_result == 0);
+            tm_get_flags(p_cpu)->m_zero = (l_result == 0);
             break;
         case 1:
-            p_cpu->m_flags.m_zero = ((l_result & 0xFFFF) == 0);
+            tm_get_flags(p_cpu)->m_zero = ((l_result & 0xFFFF) == 0);
             break;
         default:
-            p_cpu->m_flags.m_zero = ((l_result & 0xFF) == 0);
+            tm_get_flags(p_cpu)->m_zero = ((l_result & 0xFF) == 0);
             break;
     }
 
     // Set the half-carry flag and clear the negative, carry, overflow and
     // underflow flags.
-    p_cpu->m_flags.m_negative = false;
-    p_cpu->m_flags.m_half_carry = true;
-    p_cpu->m_flags.m_carry = false;
-    p_cpu->m_flags.m_overflow = false;
-    p_cpu->m_flags.m_underflow = false;
+    tm_get_flags(p_cpu)->m_negative = false;
+    tm_get_flags(p_cpu)->m_half_carry = true;
+    tm_get_flags(p_cpu)->m_carry = false;
+    tm_get_flags(p_cpu)->m_overflow = false;
+    tm_get_flags(p_cpu)->m_underflow = false;
 
     return true;
 }
 
-static bool tm_execute_or (tm_cpu_t* p_cpu)
+TM_SPECIALISED bool tm_execute_or (tm_cpu_t* p_cpu, enum_t p_width)
 {
     // The `OR` instruction performs a bitwise OR between the destination
     // accumulator register specified by parameter #1 and the value of the
@@ -1201,40 +1720,43 @@ static bool tm_execute_or (tm_cpu_t* p_cpu)
         return tm_set_error(p_cpu, TM_ERROR_INVALID_ARGUMENT);
     }
 
+    // Every flag is overwritten below, so nothing pending needs working out.
+    tm_discard_flags(p_cpu);
+
     // Fetch the value of the target accumulator register.
     long_t l_acc_value = 0;
-    tm_read_cpu_register(p_cpu, p_cpu->m_param1, &l_acc_value);
+    tm_load_register(p_cpu, p_cpu->m_param1, &l_acc_value);
 
     // Bitwise OR the accumulator and memory data registers' values. Store
     // the result and write it back to the accumulator.
     long_t l_result = (l_acc_value | p_cpu->m_registers.m_md);
-    tm_write_cpu_register(p_cpu, p_cpu->m_param1, l_result);
+    tm_store_register(p_cpu, p_cpu->m_param1, l_result);
 
     // Set the zero flag based on the result.
-    switch (p_cpu->m_param1 & 0b11)
+    switch (p_width)
     {
         case 0:
-            p_cpu->m_flags.m_zero = (l_result == 0);
+            tm_get_flags(p_cpu)->m_zero = (l_result == 0);
             break;
         case 1:
-            p_cpu->m_flags.m_zero = ((l_result & 0xFFFF) == 0);
+            tm_get_flags(p_cpu)->m_zero = ((l_result & 0xFFFF) == 0);
             break;
         default:
-            p_cpu->m_flags.m_zero = ((l_result & 0xFF) == 0);
+            tm_get_flags(p_cpu)->m_zero = ((l_result & 0xFF) == 0);
             break;
     }
 
     // Clear the negative, half-carry, carry, overflow and underflow flags.
-    p_cpu->m_flags.m_negative = false;
-    p_cpu->m_flags.m_half_carry = false;
-    p_cpu->m_flags.m_carry = false;
-    p_cpu->m_flags.m_overflow = false;
-    p_cpu->m_flags.m_underflow = false;
+    tm_get_flags(p_cpu)->m_negative = false;
+    tm_get_flags(p_cpu)->m_half_carry = false;
+    tm_get_flags(p_cpu)->m_carry = false;
+    tm_get_flags(p_cpu)->m_overflow = false;
+    tm_get_flags(p_cpu)->m_underflow = false;
 
     return true;
 }
 
-static bool tm_execute_xor (tm_cpu_t* p_cpu)
+TM_SPECIALISED bool tm_execute_xor (tm_cpu_t* p_cpu, enum_t p_width)
 {
     // The `XOR` instruction performs a bitwise XOR between the destination
     // accumulator register specified by parameter #1 and the value of the
@@ -1249,40 +1771,43 @@ static bool tm_execute_xor (tm_cpu_t* p_cpu)
         return tm_set_error(p_cpu, TM_ERROR_INVALID_ARGUMENT);
     }
 
+    // Every flag is overwritten below, so nothing pending needs working out.
+    tm_discard_flags(p_cpu);
+
     // Fetch the value of the target accumulator register.
     long_t l_acc_value = 0;
-    tm_read_cpu_register(p_cpu, p_cpu->m_param1, &l_acc_value);
+    tm_load_register(p_cpu, p_cpu->m_param1, &l_acc_value);
 
     // Bitwise XOR the accumulator and memory data registers' values. Store
     // the result and write it back to the accumulator.
     long_t l_result = (l_acc_value ^ p_cpu->m_registers.m_md);
-    tm_write_cpu_register(p_cpu, p_cpu->m_param1, l_result);
+    tm_store_register(p_cpu, p_cpu->m_param1, l_result);
 
     // Set the zero flag based on the result.
-    switch (p_cpu->m_param1 & 0b11)
+    switch (p_width)
     {
         case 0:
-            p_cpu->m_flags.m_zero = (l_result == 0);
+            tm_get_flags(p_cpu)->m_zero = (l_result == 0);
             break;
         case 1:
-            p_cpu->m_flags.m_zero = ((l_result & 0xFFFF) == 0);
+            tm_get_flags(p_cpu)->m_zero = ((l_result & 0xFFFF) == 0);
             break;
         default:
-            p_cpu->m_flags.m_zero = ((l_result & 0xFF) == 0);
+            tm_get_flags(p_cpu)->m_zero = ((l_result & 0xFF) == 0);
             break;
     }
 
     // Clear the negative, half-carry, carry, overflow and underflow flags.
-    p_cpu->m_flags.m_negative = false;
-    p_cpu->m_flags.m_half_carry = false;
-    p_cpu->m_flags.m_carry = false;
-    p_cpu->m_flags.m_overflow = false;
-    p_cpu->m_flags.m_underflow = false;
+    tm_get_flags(p_cpu)->m_negative = false;
+    tm_get_flags(p_cpu)->m_half_carry = false;
+    tm_get_flags(p_cpu)->m_carry = false;
+    tm_get_flags(p_cpu)->m_overflow = false;
+    tm_get_flags(p_cpu)->m_underflow = false;
 
     return true;
 }
 
-static bool tm_execute_cmp (tm_cpu_t* p_cpu)
+TM_SPECIALISED bool tm_execute_cmp (tm_cpu_t* p_cpu, enum_t p_width)
 {
     // The `CMP` instruction compares the values of the accumulator register
     // specified by parameter #1 and the memory data register (MDR). This is the
@@ -1299,57 +1824,15 @@ static bool tm_execute_cmp (tm_cpu_t* p_cpu)
 
     // Fetch the value of the target accumulator register.
     long_t l_acc_value = 0;
-    tm_read_cpu_register(p_cpu, p_cpu->m_param1, &l_acc_value);
-
-    // Subtract the value of the MDR to the accumulator's value.
-    int64_t l_result = l_acc_value - p_cpu->m_registers.m_md;
-
-    // A second subtraction operation is needed to calculate a "half-result". 
-    // This will be used to properly set the half-carry flag.
-    int32_t l_half_result = 0;
-
-    // The comparison operation involves a subtraction, so set the negative flag 
-    // and clear the overflow flag.
-    p_cpu->m_flags.m_negative = true;
-    p_cpu->m_flags.m_overflow = false;
-
-    // Set flags as appropriate.
-    switch (p_cpu->m_param1 & 0b11)
-    {
-        case 0:
-            l_half_result =
-                (l_acc_value & 0xFFFFFFF) -
-                (p_cpu->m_registers.m_md & 0xFFFFFFF);
-            p_cpu->m_flags.m_zero = (l_result & 0xFFFFFFFF) == 0;
-            p_cpu->m_flags.m_half_carry = (l_half_result < 0);
-            p_cpu->m_flags.m_carry = (l_result < 0);
-            break;
-        case 1:
-            l_half_result =
-                (l_acc_value & 0xFFF) -
-                (p_cpu->m_registers.m_md & 0xFFF);
-            p_cpu->m_flags.m_zero = (l_result & 0xFFFF) == 0;
-            p_cpu->m_flags.m_half_carry = (l_half_result < 0);
-            p_cpu->m_flags.m_carry = (l_result < 0);
-            break;
-        default:
-            l_half_result =
-                (l_acc_value & 0xF) -
-                (p_cpu->m_registers.m_md & 0xF);
-            p_cpu->m_flags.m_zero = (l_result & 0xFF) == 0;
-            p_cpu->m_flags.m_half_carry = (l_half_result < 0);
-            p_cpu->m_flags.m_carry = (l_result < 0);
-            break;
-    }
-
-    // Any subtraction operations which set the carry flag will also set the
-    // underflow flag.
-    p_cpu->m_flags.m_underflow = p_cpu->m_flags.m_carry;
+    tm_load_register(p_cpu, p_cpu->m_param1, &l_acc_value);
 
+    // The comparison is a subtraction, so its flags are those of the `SUB`
+    // instruction, worked out when they are next needed.
+    tm_defer_flags(p_cpu, TM_LAZY_SUB, p_width, l_acc_value, p_cpu->m_registers.m_md, false);
     return true;
 }
 
-static bool tm_execute_sla (tm_cpu_t* p_cpu)
+TM_SPECIALISED bool tm_execute_sla (tm_cpu_t* p_cpu, enum_t p_width)
 {
     // The `SLA` instruction shifts the value stored in the memory data register
     // (MDR) left by one bit. The uppermost bit of the old value is stored in
@@ -1366,40 +1849,40 @@ static bool tm_execute_sla (tm_cpu_t* p_cpu)
     tm_set_bit(l_result, 0, false);
 
     // Clear the negative, half-carry, overflow and underflow flags.
-    p_cpu->m_flags.m_negative = false;
-    p_cpu->m_flags.m_half_carry = false;
-    p_cpu->m_flags.m_overflow = false;
-    p_cpu->m_flags.m_underflow = false;
+    tm_get_flags(p_cpu)->m_negative = false;
+    tm_get_flags(p_cpu)->m_half_carry = false;
+    tm_get_flags(p_cpu)->m_overflow = false;
+    tm_get_flags(p_cpu)->m_underflow = false;
 
     if (p_cpu->m_da == true)
     {
-        p_cpu->m_flags.m_zero = (l_result & 0xFF) == 0;
-        p_cpu->m_flags.m_carry = tm_check_bit(l_result, 8);
+        tm_get_flags(p_cpu)->m_zero = (l_result & 0xFF) == 0;
+        tm_get_flags(p_cpu)->m_carry = tm_check_bit(l_result, 8);
         return
             tm_write_byte(p_cpu, p_cpu->m_registers.m_ma, l_result & 0xFF) &&
-            tm_cycle_cpu(p_cpu, 1);
+            tm_spend_cycles(p_cpu, 1);
     }
 
-    switch (p_cpu->m_param1 & 0b11)
+    switch (p_width)
     {
         case 0:
-            p_cpu->m_flags.m_zero = (l_result & 0xFFFFFFFF) == 0;
-            p_cpu->m_flags.m_carry = tm_check_bit(l_result, 32);
+            tm_get_flags(p_cpu)->m_zero = (l_result & 0xFFFFFFFF) == 0;
+            tm_get_flags(p_cpu)->m_carry = tm_check_bit(l_result, 32);
             break;
         case 1:
-            p_cpu->m_flags.m_zero = (l_result & 0xFFFF) == 0;
-            p_cpu->m_flags.m_carry = tm_check_bit(l_result, 16);
+            tm_get_flags(p_cpu)->m_zero = (l_result & 0xFFFF) == 0;
+            tm_get_flags(p_cpu)->m_carry = tm_check_bit(l_result, 16);
             break;
         default:
-            p_cpu->m_flags.m_zero = (l_result & 0xFF) == 0;
-            p_cpu->m_flags.m_carry = tm_check_bit(l_result, 8);
+            tm_get_flags(p_cpu)->m_zero = (l_result & 0xFF) == 0;
+            tm_get_flags(p_cpu)->m_carry = tm_check_bit(l_result, 8);
             break;
     }
 
-    return tm_write_cpu_register(p_cpu, p_cpu->m_param1, l_result & 0xFFFFFFFF);
+    return tm_store_register(p_cpu, p_cpu->m_param1, l_result & 0xFFFFFFFF);
 }
 
-static bool tm_execute_sra (tm_cpu_t* p_cpu)
+TM_SPECIALISED bool tm_execute_sra (tm_cpu_t* p_cpu, enum_t p_width)
 {
     // The `SRA` instruction shifts the value stored in the memory data register
     // (MDR) right by one bit. The lowermost bit of the old value is stored in
@@ -1416,13 +1899,13 @@ static bool tm_execute_sra (tm_cpu_t* p_cpu)
     long_t l_result = (p_cpu->m_registers.m_md >> 1);
 
     // Set the carry flag to bit 0 of the old value.
-    p_cpu->m_flags.m_carry = tm_check_bit(l_old_mdr, 0);
+    tm_get_flags(p_cpu)->m_carry = tm_check_bit(l_old_mdr, 0);
 
     // Clear the negative, half-carry, overflow and underflow flags.
-    p_cpu->m_flags.m_negative = false;
-    p_cpu->m_flags.m_half_carry = false;
-    p_cpu->m_flags.m_overflow = false;
-    p_cpu->m_flags.m_underflow = false;
+    tm_get_flags(p_cpu)->m_negative = false;
+    tm_get_flags(p_cpu)->m_half_carry = false;
+    tm_get_flags(p_cpu)->m_overflow = false;
+    tm_get_flags(p_cpu)->m_underflow = false;
 
     // If the destination address flag (DA) is set, write the result to memory
     // at the address specified by the memory address register (MAR) and set the
@@ -1430,36 +1913,36 @@ static bool tm_execute_sra (tm_cpu_t* p_cpu)
     if (p_cpu->m_da == true)
     {
         tm_set_bit(l_result, 7, tm_check_bit(l_old_mdr, 7));
-        p_cpu->m_flags.m_zero = (l_result & 0xFF) == 0;
+        tm_get_flags(p_cpu)->m_zero = (l_result & 0xFF) == 0;
         return
             tm_write_byte(p_cpu, p_cpu->m_registers.m_ma, l_result & 0xFF) &&
-            tm_cycle_cpu(p_cpu, 1);
+            tm_spend_cycles(p_cpu, 1);
     }
 
     // Based on the size of the destination register, set the proper bit of the
     // newly-shifted value to the bit's old value. Also, set the zero flag
     // according to the result.
-    switch (p_cpu->m_param1 & 0b11)
+    switch (p_width)
     {
         case 0:
             tm_set_bit(l_result, 31, tm_check_bit(l_old_mdr, 31));
-            p_cpu->m_flags.m_zero = (l_result & 0xFFFFFFFF) == 0;
+            tm_get_flags(p_cpu)->m_zero = (l_result & 0xFFFFFFFF) == 0;
             break;
         case 1:
             tm_set_bit(l_result, 15, tm_check_bit(l_old_mdr, 15));
-            p_cpu->m_flags.m_zero = (l_result & 0xFFFF) == 0;
+            tm_get_flags(p_cpu)->m_zero = (l_result & 0xFFFF) == 0;
             break;
         default:
             tm_set_bit(l_result, 7, tm_check_bit(l_old_mdr, 7));
-            p_cpu->m_flags.m_zero = (l_result & 0xFF) == 0;
+            tm_get_flags(p_cpu)->m_zero = (l_result & 0xFF) == 0;
             break;
     }
     
     // Write the result back to the destination register.
-    return tm_write_cpu_register(p_cpu, p_cpu->m_param1, l_result);
+    return tm_store_register(p_cpu, p_cpu->m_param1, l_result);
 }
 
-static bool tm_execute_srl (tm_cpu_t* p_cpu)
+TM_SPECIALISED bool tm_execute_srl (tm_cpu_t* p_cpu, enum_t p_width)
 {
     // The `SRL` instruction shifts the value stored in the memory data register
     // (MDR) right by one bit. The lowermost bit of the old value is stored in
@@ -1476,13 +1959,13 @@ static bool tm_execute_srl (tm_cpu_t* p_cpu)
     long_t l_result = (p_cpu->m_registers.m_md >> 1);
 
     // Set the carry flag to bit 0 of the old value.
-    p_cpu->m_flags.m_carry = tm_check_bit(l_old_mdr, 0);
+    tm_get_flags(p_cpu)->m_carry = tm_check_bit(l_old_mdr, 0);
 
     // Clear the negative, half-carry, overflow and underflow flags.
-    p_cpu->m_flags.m_negative = false;
-    p_cpu->m_flags.m_half_carry = false;
-    p_cpu->m_flags.m_overflow = false;
-    p_cpu->m_flags.m_underflow = false;
+    tm_get_flags(p_cpu)->m_negative = false;
+    tm_get_flags(p_cpu)->m_half_carry = false;
+    tm_get_flags(p_cpu)->m_overflow = false;
+    tm_get_flags(p_cpu)->m_underflow = false;
 
     // If the destination address flag (DA) is set, write the result to memory
     // at the address specified by the memory address register (MAR) and set the
@@ -1490,36 +1973,36 @@ static bool tm_execute_srl (tm_cpu_t* p_cpu)
     if (p_cpu->m_da == true)
     {
         tm_set_bit(l_result, 7, 0);
-        p_cpu->m_flags.m_zero = (l_result & 0xFF) == 0;
+        tm_get_flags(p_cpu)->m_zero = (l_result & 0xFF) == 0;
         return
             tm_write_byte(p_cpu, p_cpu->m_registers.m_ma, l_result & 0xFF) &&
-            tm_cycle_cpu(p_cpu, 1);
+            tm_spend_cycles(p_cpu, 1);
     }
 
     // Based on the size of the destination register, set the proper bit of the
     // newly-shifted value to the bit's old value. Also, set the zero flag
     // according to the result.
-    switch (p_cpu->m_param1 & 0b11)
+    switch (p_width)
     {
         case 0:
             tm_set_bit(l_result, 31, 0);
-            p_cpu->m_flags.m_zero = (l_result & 0xFFFFFFFF) == 0;
+            tm_get_flags(p_cpu)->m_zero = (l_result & 0xFFFFFFFF) == 0;
             break;
         case 1:
             tm_set_bit(l_result, 15, 0);
-            p_cpu->m_flags.m_zero = (l_result & 0xFFFF) == 0;
+            tm_get_flags(p_cpu)->m_zero = (l_result & 0xFFFF) == 0;
             break;
         default:
             tm_set_bit(l_result, 7, 0);
-            p_cpu->m_flags.m_zero = (l_result & 0xFF) == 0;
+            tm_get_flags(p_cpu)->m_zero = (l_result & 0xFF) == 0;
             break;
     }
     
     // Write the result back to the destination register.
-    return tm_write_cpu_register(p_cpu, p_cpu->m_param1, l_result);
+    return tm_store_register(p_cpu, p_cpu->m_param1, l_result);
 }
 
-static bool tm_execute_rl (tm_cpu_t* p_cpu)
+TM_SPECIALISED bool tm_execute_rl (tm_cpu_t* p_cpu, enum_t p_width)
 {
     // The `RL` instruction shifts the value stored in the memory data register
     // (MDR) left by one bit. The uppermost bit of the old value is stored in
@@ -1534,44 +2017,44 @@ static bool tm_execute_rl (tm_cpu_t* p_cpu)
     // Shift the MDR's value left one bit. Store the result, with the lowermost
     // bit set to the current state of the carry flag.
     uint64_t l_result = (p_cpu->m_registers.m_md << 1);
-    tm_set_bit(l_result, 0, p_cpu->m_flags.m_carry);
+    tm_set_bit(l_result, 0, tm_get_flags(p_cpu)->m_carry);
 
     // Clear the negative, half-carry, overflow and underflow flags.
-    p_cpu->m_flags.m_negative = false;
-    p_cpu->m_flags.m_half_carry = false;
-    p_cpu->m_flags.m_overflow = false;
-    p_cpu->m_flags.m_underflow = false;
+    tm_get_flags(p_cpu)->m_negative = false;
+    tm_get_flags(p_cpu)->m_half_carry = false;
+    tm_get_flags(p_cpu)->m_overflow = false;
+    tm_get_flags(p_cpu)->m_underflow = false;
 
     if (p_cpu->m_da == true)
     {
-        p_cpu->m_flags.m_zero = (l_result & 0xFF) == 0;
-        p_cpu->m_flags.m_carry = tm_check_bit(l_result, 8);
+        tm_get_flags(p_cpu)->m_zero = (l_result & 0xFF) == 0;
+        tm_get_flags(p_cpu)->m_carry = tm_check_bit(l_result, 8);
         return
             tm_write_byte(p_cpu, p_cpu->m_registers.m_ma, l_result & 0xFF) &&
-            tm_cycle_cpu(p_cpu, 1);
+            tm_spend_cycles(p_cpu, 1);
     }
 
-    switch (p_cpu->m_param1 & 0b11)
+    switch (p_width)
     {
         case 0:
-            p_cpu->m_flags.m_zero = (l_result & 0xFFFFFFFF) == 0;
-            p_cpu->m_flags.m_carry = tm_check_bit(l_result, 32);
+            tm_get_flags(p_cpu)->m_zero = (l_result & 0xFFFFFFFF) == 0;
+            tm_get_flags(p_cpu)->m_carry = tm_check_bit(l_result, 32);
             break;
         case 1:
-            p_cpu->m_flags.m_zero = (l_result & 0xFFFF) == 0;
-            p_cpu->m_flags.m_carry = tm_check_bit(l_result, 16);
+            tm_get_flags(p_cpu)->m_zero = (l_result & 0xFFFF) == 0;
+            tm_get_flags(p_cpu)->m_carry = tm_check_bit(l_result, 16);
             break;
         default:
-            p_cpu->m_flags.m_zero = (l_result & 0xFF) == 0;
-            p_cpu->m_flags.m_carry = tm_check_bit(l_result, 8);
+            tm_get_flags(p_cpu)->m_zero = (l_result & 0xFF) == 0;
+            tm_get_flags(p_cpu)->m_carry = tm_check_bit(l_result, 8);
             break;
     }
 
-    return tm_write_cpu_register(p_cpu, p_cpu->m_param1, l_result & 0xFFFFFFFF);
+    return tm_store_register(p_cpu, p_cpu->m_param1, l_result & 0xFFFFFFFF);
 }
 
 
-static bool tm_execute_rlc (tm_cpu_t* p_cpu)
+TM_SPECIALISED bool tm_execute_rlc (tm_cpu_t* p_cpu, enum_t p_width)
 {
     // The `RLC` instruction shifts the value stored in the memory data register
     // (MDR) left by one bit. The uppermost bit of the old value is stored in
@@ -1586,45 +2069,45 @@ static bool tm_execute_rlc (tm_cpu_t* p_cpu)
     uint64_t l_result = (p_cpu->m_registers.m_md << 1);
 
     // Clear the negative, half-carry, overflow and underflow flags.
-    p_cpu->m_flags.m_negative = false;
-    p_cpu->m_flags.m_half_carry = false;
-    p_cpu->m_flags.m_overflow = false;
-    p_cpu->m_flags.m_underflow = false;
+    tm_get_flags(p_cpu)->m_negative = false;
+    tm_get_flags(p_cpu)->m_half_carry = false;
+    tm_get_flags(p_cpu)->m_overflow = false;
+    tm_get_flags(p_cpu)->m_underflow = false;
 
     if (p_cpu->m_da == true)
     {
         tm_set_bit(l_result, 0, tm_check_bit(l_result, 8));
-        p_cpu->m_flags.m_zero = (l_result & 0xFF) == 0;
-        p_cpu->m_flags.m_carry = tm_check_bit(l_result, 8);
+        tm_get_flags(p_cpu)->m_zero = (l_result & 0xFF) == 0;
+        tm_get_flags(p_cpu)->m_carry = tm_check_bit(l_result, 8);
         return
             tm_write_byte(p_cpu, p_cpu->m_registers.m_ma, l_result & 0xFF) &&
-            tm_cycle_cpu(p_cpu, 1);
+            tm_spend_cycles(p_cpu, 1);
     }
 
-    switch (p_cpu->m_param1 & 0b11)
+    switch (p_width)
     {
         case 0:
             tm_set_bit(l_result, 0, tm_check_bit(l_result, 32));
-            p_cpu->m_flags.m_zero = (l_result & 0xFFFFFFFF) == 0;
-            p_cpu->m_flags.m_carry = tm_check_bit(l_result, 32);
+            tm_get_flags(p_cpu)->m_zero = (l_result & 0xFFFFFFFF) == 0;
+            tm_get_flags(p_cpu)->m_carry = tm_check_bit(l_result, 32);
             break;
         case 1:
             tm_set_bit(l_result, 0, tm_check_bit(l_result, 16));
-            p_cpu->m_flags.m_zero = (l_result & 0xFFFF) == 0;
-            p_cpu->m_flags.m_carry = tm_check_bit(l_result, 16);
+            tm_get_flags(p_cpu)->m_zero = (l_result & 0xFFFF) == 0;
+            tm_get_flags(p_cpu)->m_carry = tm_check_bit(l_result, 16);
             break;
         default:
             tm_set_bit(l_result, 0, tm_check_bit(l_result, 8));
-            p_cpu->m_flags.m_zero = (l_result & 0xFF) == 0;
-            p_cpu->m_flags.m_carry = tm_check_bit(l_result, 8);
+            tm_get_flags(p_cpu)->m_zero = (l_result & 0xFF) == 0;
+            tm_get_flags(p_cpu)->m_carry = tm_check_bit(l_result, 8);
             break;
     }
 
-    return tm_write_cpu_register(p_cpu, p_cpu->m_param1, l_result & 0xFFFFFFFF);
+    return tm_store_register(p_cpu, p_cpu->m_param1, l_result & 0xFFFFFFFF);
 
 }
 
-static bool tm_execute_rr (tm_cpu_t* p_cpu)
+TM_SPECIALISED bool tm_execute_rr (tm_cpu_t* p_cpu, enum_t p_width)
 {
     // The `RR` instruction shifts the value stored in the memory data register
     // (MDR) right by one bit. The lowermost bit of the old value is stored in
@@ -1642,16 +2125,16 @@ static bool tm_execute_rr (tm_cpu_t* p_cpu)
     long_t l_result = (p_cpu->m_registers.m_md >> 1);
 
     // Keep track of the old state of the carry flag.
-    byte_t l_old_carry = p_cpu->m_flags.m_carry;
+    byte_t l_old_carry = tm_get_flags(p_cpu)->m_carry;
 
     // Set the carry flag to bit 0 of the old value.
-    p_cpu->m_flags.m_carry = tm_check_bit(l_old_mdr, 0);
+    tm_get_flags(p_cpu)->m_carry = tm_check_bit(l_old_mdr, 0);
 
     // Clear the negative, half-carry, overflow and underflow flags.
-    p_cpu->m_flags.m_negative = false;
-    p_cpu->m_flags.m_half_carry = false;
-    p_cpu->m_flags.m_overflow = false;
-    p_cpu->m_flags.m_underflow = false;
+    tm_get_flags(p_cpu)->m_negative = false;
+    tm_get_flags(p_cpu)->m_half_carry = false;
+    tm_get_flags(p_cpu)->m_overflow = false;
+    tm_get_flags(p_cpu)->m_underflow = false;
 
     // If the destination address flag (DA) is set, write the result to memory
     // at the address specified by the memory address register (MAR) and set the
@@ -1659,36 +2142,36 @@ static bool tm_execute_rr (tm_cpu_t* p_cpu)
     if (p_cpu->m_da == true)
     {
         tm_set_bit(l_result, 7, l_old_carry);
-        p_cpu->m_flags.m_zero = (l_result & 0xFF) == 0;
+        tm_get_flags(p_cpu)->m_zero = (l_result & 0xFF) == 0;
         return
             tm_write_byte(p_cpu, p_cpu->m_registers.m_ma, l_result & 0xFF) &&
-            tm_cycle_cpu(p_cpu, 1);
+            tm_spend_cycles(p_cpu, 1);
     }
 
     // Based on the size of the destination register, set the proper bit of the
     // newly-shifted value to the bit's old value. Also, set the zero flag
     // according to the result.
-    switch (p_cpu->m_param1 & 0b11)
+    switch (p_width)
     {
         case 0:
             tm_set_bit(l_result, 31, l_old_carry);
-            p_cpu->m_flags.m_zero = (l_result & 0xFFFFFFFF) == 0;
+            tm_get_flags(p_cpu)->m_zero = (l_result & 0xFFFFFFFF) == 0;
             break;
         case 1:
             tm_set_bit(l_result, 15, l_old_carry);
-            p_cpu->m_flags.m_zero = (l_result & 0xFFFF) == 0;
+            tm_get_flags(p_cpu)->m_zero = (l_result & 0xFFFF) == 0;
             break;
         default:
             tm_set_bit(l_result, 7, l_old_carry);
-            p_cpu->m_flags.m_zero = (l_result & 0xFF) == 0;
+            tm_get_flags(p_cpu)->m_zero = (l_result & 0xFF) == 0;
             break;
     }
 
     // Write the result back to the destination register.
-    return tm_write_cpu_register(p_cpu, p_cpu->m_param1, l_result);
+    return tm_store_register(p_cpu, p_cpu->m_param1, l_result);
 }
 
-static bool tm_execute_rrc (tm_cpu_t* p_cpu)
+TM_SPECIALISED bool tm_execute_rrc (tm_cpu_t* p_cpu, enum_t p_width)
 {
     // The `RRC` instruction shifts the value stored in the memory data register
     // (MDR) right by one bit. The lowermost bit of the old value is stored in
@@ -1705,47 +2188,47 @@ static bool tm_execute_rrc (tm_cpu_t* p_cpu)
     long_t l_result = (p_cpu->m_registers.m_md >> 1);
 
     // Set the carry flag to bit 0 of the old value.
-    p_cpu->m_flags.m_carry = tm_check_bit(l_old_mdr, 0);
+    tm_get_flags(p_cpu)->m_carry = tm_check_bit(l_old_mdr, 0);
 
     // Clear the negative, half-carry, overflow and underflow flags.
-    p_cpu->m_flags.m_negative = false;
-    p_cpu->m_flags.m_half_carry = false;
-    p_cpu->m_flags.m_overflow = false;
-    p_cpu->m_flags.m_underflow = false;
+    tm_get_flags(p_cpu)->m_negative = false;
+    tm_get_flags(p_cpu)->m_half_carry = false;
+    tm_get_flags(p_cpu)->m_overflow = false;
+    tm_get_flags(p_cpu)->m_underflow = false;
 
     // If the destination address flag (DA) is set, write the result to memory
     // at the address specified by the memory address register (MAR) and set the
     // appropriate flags.
     if (p_cpu->m_da == true)
     {
-        tm_set_bit(l_result, 7, p_cpu->m_flags.m_carry);
-        p_cpu->m_flags.m_zero = (l_result & 0xFF) == 0;
+        tm_set_bit(l_result, 7, tm_get_flags(p_cpu)->m_carry);
+        tm_get_flags(p_cpu)->m_zero = (l_result & 0xFF) == 0;
         return
             tm_write_byte(p_cpu, p_cpu->m_registers.m_ma, l_result & 0xFF) &&
-            tm_cycle_cpu(p_cpu, 1);
+            tm_spend_cycles(p_cpu, 1);
     }
 
     // Based on the size of the destination register, set the proper bit of the
     // newly-shifted value to the bit's old value. Also, set the zero flag
     // according to the result.
-    switch (p_cpu->m_param1 & 0b11)
+    switch (p_width)
     {
         case 0:
-            tm_set_bit(l_result, 31, p_cpu->m_flags.m_carry);
-            p_cpu->m_flags.m_zero = (l_result & 0xFFFFFFFF) == 0;
+            tm_set_bit(l_result, 31, tm_get_flags(p_cpu)->m_carry);
+            tm_get_flags(p_cpu)->m_zero = (l_result & 0xFFFFFFFF) == 0;
             break;
         case 1:
-            tm_set_bit(l_result, 15, p_cpu->m_flags.m_carry);
-            p_cpu->m_flags.m_zero = (l_result & 0xFFFF) == 0;
+            tm_set_bit(l_result, 15, tm_get_flags(p_cpu)->m_carry);
+            tm_get_flags(p_cpu)->m_zero = (l_result & 0xFFFF) == 0;
             break;
         default:
-            tm_set_bit(l_result, 7, p_cpu->m_flags.m_carry);
-            p_cpu->m_flags.m_zero = (l_result & 0xFF) == 0;
+            tm_set_bit(l_result, 7, tm_get_flags(p_cpu)->m_carry);
+            tm_get_flags(p_cpu)->m_zero = (l_result & 0xFF) == 0;
             break;
     }
 
     // Write the result back to the destination register.
-    return tm_write_cpu_register(p_cpu, p_cpu->m_param1, l_result);
+    return tm_store_register(p_cpu, p_cpu->m_param1, l_result);
 }
 
 static bool tm_execute_bit (tm_cpu_t* p_cpu)
@@ -1756,15 +2239,14 @@ static bool tm_execute_bit (tm_cpu_t* p_cpu)
     // the opcode.
 
     // Clear the negative flag and set the half-carry flag.
-    p_cpu->m_flags.m_negative = false;
-    p_cpu->m_flags.m_half_carry = true;
+    tm_get_flags(p_cpu)->m_negative = false;
+    tm_get_flags(p_cpu)->m_half_carry = true;
 
     // Fetch the bit to test from the instruction's immediate byte.
     long_t l_bit = 0;
     if (
         tm_check_readable(p_cpu, p_cpu->m_registers.m_pc, 1) == false ||
-        tm_read_byte(p_cpu, p_cpu->m_registers.m_pc, &l_bit) == false ||
-        tm_advance_cpu(p_cpu, 1) == false
+        tm_fetch_operand(p_cpu, 1, &l_bit) == false
     )
     {
         return false;
@@ -1778,13 +2260,13 @@ static bool tm_execute_bit (tm_cpu_t* p_cpu)
         long_t l_value = 0;
         if (
             tm_read_byte(p_cpu, p_cpu->m_registers.m_ma, &l_value) == false ||
-            tm_cycle_cpu(p_cpu, 1) == false
+            tm_spend_cycles(p_cpu, 1) == false
         )
         {
             return false;
         }
 
-        p_cpu->m_flags.m_zero = !tm_check_bit(l_value, (l_bit % 8));
+        tm_get_flags(p_cpu)->m_zero = !tm_check_bit(l_value, (l_bit % 8));
         return true;
     }
 
@@ -1792,13 +2274,13 @@ static bool tm_execute_bit (tm_cpu_t* p_cpu)
     switch (p_cpu->m_param2)
     {
         case 0:
-            p_cpu->m_flags.m_zero = !tm_check_bit(p_cpu->m_registers.m_md, (l_bit % 32));
+            tm_get_flags(p_cpu)->m_zero = !tm_check_bit(p_cpu->m_registers.m_md, (l_bit % 32));
             break;
         case 1:
-            p_cpu->m_flags.m_zero = !tm_check_bit(p_cpu->m_registers.m_md, (l_bit % 16));
+            tm_get_flags(p_cpu)->m_zero = !tm_check_bit(p_cpu->m_registers.m_md, (l_bit % 16));
             break;
         default:
-            p_cpu->m_flags.m_zero = !tm_check_bit(p_cpu->m_registers.m_md, (l_bit % 8));
+            tm_get_flags(p_cpu)->m_zero = !tm_check_bit(p_cpu->m_registers.m_md, (l_bit % 8));
             break;
     }
 
@@ -1812,16 +2294,15 @@ static bool tm_execute_set (tm_cpu_t* p_cpu)
     // byte after the opcode.
 
     // Clear the negative and half-carry flags, and set the carry flag.
-    p_cpu->m_flags.m_negative = false;
-    p_cpu->m_flags.m_half_carry = false;
-    p_cpu->m_flags.m_carry = true;
+    tm_get_flags(p_cpu)->m_negative = false;
+    tm_get_flags(p_cpu)->m_half_carry = false;
+    tm_get_flags(p_cpu)->m_carry = true;
 
     // Fetch the bit to set from the instruction's immediate byte.
     long_t l_bit = 0;
     if (
         tm_check_readable(p_cpu, p_cpu->m_registers.m_pc, 1) == false ||
-        tm_read_byte(p_cpu, p_cpu->m_registers.m_pc, &l_bit) == false ||
-        tm_advance_cpu(p_cpu, 1) == false
+        tm_fetch_operand(p_cpu, 1, &l_bit) == false
     )
     {
         return false;
@@ -1834,7 +2315,7 @@ static bool tm_execute_set (tm_cpu_t* p_cpu)
         tm_set_bit(p_cpu->m_registers.m_md, (l_bit % 8), true);
         return
             tm_write_byte(p_cpu, p_cpu->m_registers.m_ma, p_cpu->m_registers.m_md) &&
-            tm_cycle_cpu(p_cpu, 1);
+            tm_spend_cycles(p_cpu, 1);
     }
 
     // Set the specified bit of the MDR's value.
@@ -1852,7 +2333,7 @@ static bool tm_execute_set (tm_cpu_t* p_cpu)
     }
 
     // Write the result back to the destination register.
-    return tm_write_cpu_register(p_cpu, p_cpu->m_param1, p_cpu->m_registers.m_md);
+    return tm_store_register(p_cpu, p_cpu->m_param1, p_cpu->m_registers.m_md);
 }
 
 static bool tm_execute_res (tm_cpu_t* p_cpu)
@@ -1865,8 +2346,7 @@ static bool tm_execute_res (tm_cpu_t* p_cpu)
     long_t l_bit = 0;
     if (
         tm_check_readable(p_cpu, p_cpu->m_registers.m_pc, 1) == false ||
-        tm_read_byte(p_cpu, p_cpu->m_registers.m_pc, &l_bit) == false ||
-        tm_advance_cpu(p_cpu, 1) == false
+        tm_fetch_operand(p_cpu, 1, &l_bit) == false
     )
     {
         return false;
@@ -1879,7 +2359,7 @@ static bool tm_execute_res (tm_cpu_t* p_cpu)
         tm_set_bit(p_cpu->m_registers.m_md, (l_bit % 8), false);
         return
             tm_write_byte(p_cpu, p_cpu->m_registers.m_ma, p_cpu->m_registers.m_md) &&
-            tm_cycle_cpu(p_cpu, 1);
+            tm_spend_cycles(p_cpu, 1);
     }
 
     // Clear the specified bit of the MDR's value.
@@ -1897,10 +2377,10 @@ static bool tm_execute_res (tm_cpu_t* p_cpu)
     }
 
     // Write the result back to the destination register.
-    return tm_write_cpu_register(p_cpu, p_cpu->m_param1, p_cpu->m_registers.m_md);
+    return tm_store_register(p_cpu, p_cpu->m_param1, p_cpu->m_registers.m_md);
 }
 
-static bool tm_execute_swap (tm_cpu_t* p_cpu)
+TM_SPECIALISED bool tm_execute_swap (tm_cpu_t* p_cpu, enum_t p_width)
 {
     // The `SWAP` instruction swaps the upper and lower halves of the value
     // stored in the memory data register (MDR).
@@ -1910,11 +2390,11 @@ static bool tm_execute_swap (tm_cpu_t* p_cpu)
     //      destination register specified by parameter #1.
 
     // Clear the negative, half-carry, carry, overflow and underflow flags.
-    p_cpu->m_flags.m_negative = false;
-    p_cpu->m_flags.m_half_carry = false;
-    p_cpu->m_flags.m_carry = false;
-    p_cpu->m_flags.m_overflow = false;
-    p_cpu->m_flags.m_underflow = false;
+    tm_get_flags(p_cpu)->m_negative = false;
+    tm_get_flags(p_cpu)->m_half_carry = false;
+    tm_get_flags(p_cpu)->m_carry = false;
+    tm_get_flags(p_cpu)->m_overflow = false;
+    tm_get_flags(p_cpu)->m_underflow = false;
 
     if (p_cpu->m_da == true)
     {
@@ -1924,538 +2404,5311 @@ static bool tm_execute_swap (tm_cpu_t* p_cpu)
                           ((p_cpu->m_registers.m_md & 0xF0) >> 4);
 
         // Set the zero flag based on the result.
-        p_cpu->m_flags.m_zero = (l_result & 0xFF) == 0;
+        tm_get_flags(p_cpu)->m_zero = (l_result & 0xFF) == 0;
 
         // Write the result back to memory at the address specified by the memory
         // address register (MAR).
         return
             tm_write_byte(p_cpu, p_cpu->m_registers.m_ma, l_result & 0xFF) &&
-            tm_cycle_cpu(p_cpu, 1);
+            tm_spend_cycles(p_cpu, 1);
     }
 
     // Based on the size of the destination register, swap the upper and lower
     // halves of the MDR's value.
     long_t l_result = 0;
-    switch (p_cpu->m_param1 & 0b11)
+    switch (p_width)
     {
         case 0:
             l_result = ((p_cpu->m_registers.m_md & 0xFFFF) << 16) |
                        ((p_cpu->m_registers.m_md & 0xFFFF0000) >> 16);
-            p_cpu->m_flags.m_zero = (l_result & 0xFFFFFFFF) == 0;
+            tm_get_flags(p_cpu)->m_zero = (l_result & 0xFFFFFFFF) == 0;
             break;
         case 1:
             l_result = ((p_cpu->m_registers.m_md & 0xFF) << 8) |
                        ((p_cpu->m_registers.m_md & 0xFF00) >> 8);
-            p_cpu->m_flags.m_zero = (l_result & 0xFFFF) == 0;
+            tm_get_flags(p_cpu)->m_zero = (l_result & 0xFFFF) == 0;
             break;
         default:
             l_result = ((p_cpu->m_registers.m_md & 0xF) << 4) |
                        ((p_cpu->m_registers.m_md & 0xF0) >> 4);
-            p_cpu->m_flags.m_zero = (l_result & 0xFF) == 0;
+            tm_get_flags(p_cpu)->m_zero = (l_result & 0xFF) == 0;
             break;
     }
 
     // Write the result back to the destination register.
-    return tm_write_cpu_register(p_cpu, p_cpu->m_param1, l_result);
+    return tm_store_register(p_cpu, p_cpu->m_param1, l_result);
 }
 
-/* Public Functions ***********************************************************/
+/* Static Functions - Instruction Handlers ***********************************/
+
+// Each opcode's high byte maps to a clause which fetches the instruction's
+// operands, then executes the instruction. The list below is expanded into
+// one handler function per opcode, and into the table used to look those
+// handlers up when an instruction is decoded.
+//
+// Most instructions operate on a long, word or byte, as given by the lower two
+// bits of one of their parameters. The second column names that parameter, if
+// any. Such instructions are expanded into one handler per operand width
+// instead, each evaluating the clause with a constant `l_width`, so that the
+// width-dependent code of the functions it calls folds away. The width is
+// worked out once, when the instruction is decoded, by picking the handler.
+#define tm_for_each_instruction(X) \
+    X(0x00, nop,                none,   tm_execute_nop(p_cpu)) \
+    X(0x01, stop,               none,   tm_execute_stop(p_cpu)) \
+    X(0x02, halt,               none,   tm_execute_halt(p_cpu)) \
+    X(0x03, sec,                none,   tm_execute_sec(p_cpu)) \
+    X(0x04, cec,                none,   tm_execute_cec(p_cpu)) \
+    X(0x05, di,                 none,   tm_execute_di(p_cpu)) \
+    X(0x06, ei,                 none,   tm_execute_ei(p_cpu)) \
+    X(0x07, daa,                none,   tm_execute_daa(p_cpu)) \
+    X(0x08, cpl,                none,   tm_execute_cpl(p_cpu)) \
+    X(0x09, cpw,                none,   tm_execute_cpw(p_cpu)) \
+    X(0x0A, cpb,                none,   tm_execute_cpb(p_cpu)) \
+    X(0x0B, scf,                none,   tm_execute_scf(p_cpu)) \
+    X(0x0C, ccf,                none,   tm_execute_ccf(p_cpu)) \
+    X(0x10, ld_reg_imm,         param1, tm_fetch_reg_imm(p_cpu, l_width)        && tm_execute_ld(p_cpu)) \
+    X(0x11, ld_reg_addr32,      param1, tm_fetch_reg_addr32(p_cpu, l_width)     && tm_execute_ld(p_cpu)) \
+    X(0x12, ld_reg_regptr32,    param1, tm_fetch_reg_regptr32(p_cpu, l_width)   && tm_execute_ld(p_cpu)) \
+    X(0x13, ldq_reg_addr16,     param1, tm_fetch_reg_addr16(p_cpu, l_width)     && tm_execute_ld(p_cpu)) \
+    X(0x15, ldh_reg_addr8,      param1, tm_fetch_reg_addr8(p_cpu, l_width)      && tm_execute_ld(p_cpu)) \
+    X(0x17, st_addr32_reg,      param2, tm_fetch_addr32_reg(p_cpu, l_width)     && tm_execute_st(p_cpu, l_width)) \
+    X(0x18, st_regptr32_reg,    param2, tm_fetch_regptr32_reg(p_cpu, l_width)   && tm_execute_st(p_cpu, l_width)) \
+    X(0x19, stq_addr16_reg,     param2, tm_fetch_addr16_reg(p_cpu)              && tm_execute_st(p_cpu, l_width)) \
+    X(0x1B, sth_addr8_reg,      param2, tm_fetch_addr8_reg(p_cpu)               && tm_execute_st(p_cpu, l_width)) \
+    X(0x1D, mv_reg_reg,         none,   tm_fetch_reg(p_cpu, true)               && tm_execute_mv(p_cpu)) \
+    X(0x1E, push_reg,           none,   tm_fetch_reg(p_cpu, true)               && tm_execute_push(p_cpu)) \
+    X(0x1F, pop_reg,            none,   tm_execute_pop(p_cpu)) \
+    X(0x20, jmp_addr32,         none,   tm_fetch_addr32(p_cpu, false)           && tm_execute_jmp(p_cpu)) \
+    X(0x21, jmp_regptr32,       none,   tm_fetch_regptr32(p_cpu, false)         && tm_execute_jmp(p_cpu)) \
+    X(0x22, jpb_imm16,          none,   tm_fetch_imm16(p_cpu)                   && tm_execute_jpb(p_cpu)) \
+    X(0x23, call_addr32,        none,   tm_fetch_addr32(p_cpu, false)           && tm_execute_call(p_cpu)) \
+    X(0x24, rst,                none,   tm_execute_rst(p_cpu)) \
+    X(0x25, ret,                none,   tm_execute_ret(p_cpu)) \
+    X(0x26, reti,               none,   tm_execute_reti(p_cpu)) \
+    X(0x27, jps,                none,   tm_execute_jps(p_cpu)) \
+    X(0x30, inc_reg,            param1, tm_fetch_reg(p_cpu, false)              && tm_execute_inc(p_cpu, l_width)) \
+    X(0x31, inc_regptr32,       param1, tm_fetch_regptr32(p_cpu, true)          && tm_execute_inc(p_cpu, l_width)) \
+    X(0x32, dec_reg,            param1, tm_fetch_reg(p_cpu, false)              && tm_execute_dec(p_cpu, l_width)) \
+    X(0x33, dec_regptr32,       param1, tm_fetch_regptr32(p_cpu, true)          && tm_execute_dec(p_cpu, l_width)) \
+    X(0x34, add_reg_imm,        param1, tm_fetch_reg_imm(p_cpu, l_width)        && tm_execute_add(p_cpu, l_width, false)) \
+    X(0x35, add_reg_reg,        param1, tm_fetch_reg(p_cpu, true)               && tm_execute_add(p_cpu, l_width, false)) \
+    X(0x36, add_reg_regptr32,   param1, tm_fetch_reg_regptr32(p_cpu, l_width)   && tm_execute_add(p_cpu, l_width, false)) \
+    X(0x37, adc_reg_imm,        param1, tm_fetch_reg_imm(p_cpu, l_width)        && tm_execute_add(p_cpu, l_width, true)) \
+    X(0x38, adc_reg_reg,        param1, tm_fetch_reg(p_cpu, true)               && tm_execute_add(p_cpu, l_width, true)) \
+    X(0x39, adc_reg_regptr32,   param1, tm_fetch_reg_regptr32(p_cpu, l_width)   && tm_execute_add(p_cpu, l_width, true)) \
+    X(0x3A, sub_reg_imm,        param1, tm_fetch_reg_imm(p_cpu, l_width)        && tm_execute_sub(p_cpu, l_width, false)) \
+    X(0x3B, sub_reg_reg,        param1, tm_fetch_reg(p_cpu, true)               && tm_execute_sub(p_cpu, l_width, false)) \
+    X(0x3C, sub_reg_regptr32,   param1, tm_fetch_reg_regptr32(p_cpu, l_width)   && tm_execute_sub(p_cpu, l_width, false)) \
+    X(0x3D, sbc_reg_imm,        param1, tm_fetch_reg_imm(p_cpu, l_width)        && tm_execute_sub(p_cpu, l_width, true)) \
+    X(0x3E, sbc_reg_reg,        param1, tm_fetch_reg(p_cpu, true)               && tm_execute_sub(p_cpu, l_width, true)) \
+    X(0x3F, sbc_reg_regptr32,   param1, tm_fetch_reg_regptr32(p_cpu, l_width)   && tm_execute_sub(p_cpu, l_width, true)) \
+    X(0x40, and_reg_imm,        param1, tm_fetch_reg_imm(p_cpu, l_width)        && tm_execute_and(p_cpu, l_width)) \
+    X(0x41, and_reg_reg,        param1, tm_fetch_reg(p_cpu, true)               && tm_execute_and(p_cpu, l_width)) \
+    X(0x42, and_reg_regptr32,   param1, tm_fetch_reg_regptr32(p_cpu, l_width)   && tm_execute_and(p_cpu, l_width)) \
+    X(0x43, or_reg_imm,         param1, tm_fetch_reg_imm(p_cpu, l_width)        && tm_execute_or(p_cpu, l_width)) \
+    X(0x44, or_reg_reg,         param1, tm_fetch_reg(p_cpu, true)               && tm_execute_or(p_cpu, l_width)) \
+    X(0x45, or_reg_regptr32,    param1, tm_fetch_reg_regptr32(p_cpu, l_width)   && tm_execute_or(p_cpu, l_width)) \
+    X(0x46, xor_reg_imm,        param1, tm_fetch_reg_imm(p_cpu, l_width)        && tm_execute_xor(p_cpu, l_width)) \
+    X(0x47, xor_reg_reg,        param1, tm_fetch_reg(p_cpu, true)               && tm_execute_xor(p_cpu, l_width)) \
+    X(0x48, xor_reg_regptr32,   param1, tm_fetch_reg_regptr32(p_cpu, l_width)   && tm_execute_xor(p_cpu, l_width)) \
+    X(0x49, cmp_reg_imm,        param1, tm_fetch_reg_imm(p_cpu, l_width)        && tm_execute_cmp(p_cpu, l_width)) \
+    X(0x4A, cmp_reg_reg,        param1, tm_fetch_reg(p_cpu, true)               && tm_execute_cmp(p_cpu, l_width)) \
+    X(0x4B, cmp_reg_regptr32,   param1, tm_fetch_reg_regptr32(p_cpu, l_width)   && tm_execute_cmp(p_cpu, l_width)) \
+    X(0x50, sla_reg,            param1, tm_fetch_reg(p_cpu, false)              && tm_execute_sla(p_cpu, l_width)) \
+    X(0x51, sla_regptr32,       param1, tm_fetch_regptr32(p_cpu, true)          && tm_execute_sla(p_cpu, l_width)) \
+    X(0x52, sra_reg,            param1, tm_fetch_reg(p_cpu, false)              && tm_execute_sra(p_cpu, l_width)) \
+    X(0x53, sra_regptr32,       param1, tm_fetch_regptr32(p_cpu, true)          && tm_execute_sra(p_cpu, l_width)) \
+    X(0x54, srl_reg,            param1, tm_fetch_reg(p_cpu, false)              && tm_execute_srl(p_cpu, l_width)) \
+    X(0x55, srl_regptr32,       param1, tm_fetch_regptr32(p_cpu, true)          && tm_execute_srl(p_cpu, l_width)) \
+    X(0x56, rl_reg,             param1, tm_fetch_reg(p_cpu, false)              && tm_execute_rl(p_cpu, l_width)) \
+    X(0x57, rl_regptr32,        param1, tm_fetch_regptr32(p_cpu, true)          && tm_execute_rl(p_cpu, l_width)) \
+    X(0x58, rlc_reg,            param1, tm_fetch_reg(p_cpu, false)              && tm_execute_rlc(p_cpu, l_width)) \
+    X(0x59, rlc_regptr32,       param1, tm_fetch_regptr32(p_cpu, true)          && tm_execute_rlc(p_cpu, l_width)) \
+    X(0x5A, rr_reg,             param1, tm_fetch_reg(p_cpu, false)              && tm_execute_rr(p_cpu, l_width)) \
+    X(0x5B, rr_regptr32,        param1, tm_fetch_regptr32(p_cpu, true)          && tm_execute_rr(p_cpu, l_width)) \
+    X(0x5C, rrc_reg,            param1, tm_fetch_reg(p_cpu, false)              && tm_execute_rrc(p_cpu, l_width)) \
+    X(0x5D, rrc_regptr32,       param1, tm_fetch_regptr32(p_cpu, true)          && tm_execute_rrc(p_cpu, l_width)) \
+    X(0x60, bit_reg,            none,   tm_fetch_reg(p_cpu, true)               && tm_execute_bit(p_cpu)) \
+    X(0x61, bit_regptr32,       none,   tm_fetch_regptr32(p_cpu, true)          && tm_execute_bit(p_cpu)) \
+    X(0x62, set_reg,            none,   tm_fetch_reg(p_cpu, true)               && tm_execute_set(p_cpu)) \
+    X(0x63, set_regptr32,       none,   tm_fetch_regptr32(p_cpu, true)          && tm_execute_set(p_cpu)) \
+    X(0x64, res_reg,            none,   tm_fetch_reg(p_cpu, true)               && tm_execute_res(p_cpu)) \
+    X(0x65, res_regptr32,       none,   tm_fetch_regptr32(p_cpu, true)          && tm_execute_res(p_cpu)) \
+    X(0x66, swap_reg,           param1, tm_fetch_reg(p_cpu, false)              && tm_execute_swap(p_cpu, l_width)) \
+    X(0x67, swap_regptr32,      param1, tm_fetch_regptr32(p_cpu, true)          && tm_execute_swap(p_cpu, l_width)) \
+    X(0xFF, jps_ff,             none,   tm_execute_jps(p_cpu))
+
+#define tm_width_none(p_cpu)        0
+#define tm_width_param1(p_cpu)      ((p_cpu)->m_param1 & 0b11)
+#define tm_width_param2(p_cpu)      ((p_cpu)->m_param2 & 0b11)
+
+// Each clause is also given an inlined function of its own, taking the width,
+// so that superoperators can evaluate the clauses of their instructions
+// without going through the handlers.
+#define tm_define_clause(p_inst, p_name, p_width_kind, p_clause) \
+    TM_SPECIALISED bool tm_clause_##p_name (tm_cpu_t* p_cpu, enum_t p_width) \
+        { const enum_t l_width = p_width; (void) l_width; return p_clause; }
+tm_for_each_instruction(tm_define_clause)
+#undef tm_define_clause
+
+#define tm_define_handler_none(p_name) \
+    static bool tm_handle_##p_name (tm_cpu_t* p_cpu) \
+        { return tm_clause_##p_name(p_cpu, 0); }
+#define tm_define_handler_param1(p_name) \
+    static bool tm_handle_##p_name##_long (tm_cpu_t* p_cpu) \
+        { return tm_clause_##p_name(p_cpu, 0); } \
+    static bool tm_handle_##p_name##_word (tm_cpu_t* p_cpu) \
+        { return tm_clause_##p_name(p_cpu, 1); } \
+    static bool tm_handle_##p_name##_byte (tm_cpu_t* p_cpu) \
+        { return tm_clause_##p_name(p_cpu, 2); }
+#define tm_define_handler_param2    tm_define_handler_param1
+#define tm_define_handler(p_inst, p_name, p_width, p_clause) \
+    tm_define_handler_##p_width(p_name)
+tm_for_each_instruction(tm_define_handler)
+#undef tm_define_handler
+#undef tm_define_handler_param2
+#undef tm_define_handler_param1
+#undef tm_define_handler_none
+
+typedef struct tm_instruction_variants
+{
+    bool                    m_param2_width;     // The operand width is given by parameter #2.
+    tm_instruction_handler  m_handlers[4];      // Indexed by the operand width.
+} tm_instruction_variants_t;
 
-tm_cpu_t* tm_create_cpu (tm_bus_read p_read, tm_bus_write p_write, tm_cycle p_cycle)
+static const tm_instruction_variants_t s_instruction_handlers[0x100] =
 {
-    tm_expect(p_read, "tm: expected a bus read function!\n");
-    tm_expect(p_write, "tm: expected a bus write function!\n");
-    tm_expect(p_cycle, "tm: expected a bus cycle function!\n");
+    #define tm_define_handler_entry_none(p_name) \
+        { false, { tm_handle_##p_name, tm_handle_##p_name, tm_handle_##p_name, \
+            tm_handle_##p_name } }
+    #define tm_define_handler_entry_param1(p_name) \
+        { false, { tm_handle_##p_name##_long, tm_handle_##p_name##_word, \
+            tm_handle_##p_name##_byte, tm_handle_##p_name##_byte } }
+    #define tm_define_handler_entry_param2(p_name) \
+        { true, { tm_handle_##p_name##_long, tm_handle_##p_name##_word, \
+            tm_handle_##p_name##_byte, tm_handle_##p_name##_byte } }
+    #define tm_define_handler_entry(p_inst, p_name, p_width, p_clause) \
+        [p_inst] = tm_define_handler_entry_##p_width(p_name),
+    tm_for_each_instruction(tm_define_handler_entry)
+    #undef tm_define_handler_entry
+    #undef tm_define_handler_entry_param2
+    #undef tm_define_handler_entry_param1
+    #undef tm_define_handler_entry_none
+};
+
+// The name of each instruction's handler, for the statistics. Opcodes which
+// are not defined have none.
+static const char* const s_instruction_names[0x100] =
+{
+    #define tm_define_name_entry(p_inst, p_name, p_width, p_clause) \
+        [p_inst] = #p_name,
 
-    tm_cpu_t* l_cpu = tm_calloc(1, tm_cpu_t);
-    tm_expect_p(l_cpu, "tm: could not allocate cpu context");
+    tm_for_each_instruction(tm_define_name_entry)
 
-    l_cpu->m_read   = p_read;
-    l_cpu->m_write  = p_write;
-    l_cpu->m_cycle  = p_cycle;
-    tm_init_cpu(l_cpu);
+    #undef tm_define_name_entry
+};
 
-    return l_cpu;
-}
+/* Static Functions - Decode Cache ********************************************/
 
-void tm_init_cpu (tm_cpu_t* p_cpu)
+static inline tm_decoded_instruction_t* tm_lookup_decoded (tm_cpu_t* p_cpu, addr_t p_address)
 {
-    tm_hard_assert(p_cpu);
+    // Instructions are at least two bytes long, so the lowest bit of an
+    // instruction's address carries little information. Drop it when hashing
+    // the address into the direct-mapped cache.
+    return &p_cpu->m_decode_cache[(p_address >> 1) & (TM_DECODE_CACHE_SIZE - 1)];
+}
+
+static void tm_invalidate_decoded (tm_cpu_t* p_cpu, addr_t p_address, size_t p_size)
+{
+    // Any cached instruction whose bytes overlap the written range is stale.
+    // An instruction can start up to `TM_MAX_INSTRUCTION_SIZE - 1` bytes before
+    // the first byte written, so check every address in that window.
+    if (p_cpu->m_decode_cache == nullptr)
+    {
+        return;
+    }
+
+    addr_t l_first = p_address - (TM_MAX_INSTRUCTION_SIZE - 1);
+    for (size_t i = 0; i < p_size + TM_MAX_INSTRUCTION_SIZE - 1; ++i)
+    {
+        addr_t l_address = l_first + i;
+        tm_decoded_instruction_t* l_entry = tm_lookup_decoded(p_cpu, l_address);
+        if (l_entry->m_address == l_address)
+        {
+            l_entry->m_valid = false;
+
+            // If the instruction currently executing just overwrote itself,
+            // make sure it is not committed to the cache once it finishes.
+            if (p_cpu->m_decoding == l_entry)
+            {
+                p_cpu->m_decoding = nullptr;
+            }
+        }
+    }
+}
+
+/* Static Functions - Block Cache *********************************************/
+
+static inline size_t tm_hash_block (addr_t p_address)
+{
+    return (p_address >> 1) & (TM_BLOCK_CACHE_SIZE - 1);
+}
+
+static tm_block_t* tm_lookup_block (tm_cpu_t* p_cpu, addr_t p_address)
+{
+    tm_block_t* l_block = p_cpu->m_block_cache[tm_hash_block(p_address)];
+    while (l_block != nullptr && l_block->m_address != p_address)
+    {
+        l_block = l_block->m_hash_next;
+    }
+
+    return l_block;
+}
+
+static void tm_retire_block (tm_cpu_t* p_cpu, tm_block_t* p_block)
+{
+    // A retired block is removed from the block cache, but it is not freed
+    // straight away: the block may be executing right now, and other blocks
+    // may still be chained to it. Retired blocks are marked invalid, so they
+    // are never entered again, and are freed by `tm_collect_blocks` once the
+    // CPU is between blocks.
+    tm_block_t** l_link = &p_cpu->m_block_cache[tm_hash_block(p_block->m_address)];
+    while (*l_link != nullptr && *l_link != p_block)
+    {
+        l_link = &(*l_link)->m_hash_next;
+    }
+
+    if (*l_link != nullptr)
+    {
+        *l_link = p_block->m_hash_next;
+    }
+
+    p_block->m_valid            = false;
+    p_block->m_hash_next        = p_cpu->m_retired_blocks;
+    p_cpu->m_retired_blocks     = p_block;
+    p_cpu->m_retired_count++;
+}
+
+static void tm_flush_blocks (tm_cpu_t* p_cpu)
+{
+    if (p_cpu->m_block_cache == nullptr)
+    {
+        return;
+    }
+
+    for (size_t i = 0; i < TM_BLOCK_CACHE_SIZE; ++i)
+    {
+        while (p_cpu->m_block_cache[i] != nullptr)
+        {
+            tm_retire_block(p_cpu, p_cpu->m_block_cache[i]);
+        }
+    }
+
+    p_cpu->m_xram_blocks = nullptr;
+    memset(p_cpu->m_xram_filter, 0x00, sizeof(p_cpu->m_xram_filter));
+}
+
+static void tm_collect_blocks (tm_cpu_t* p_cpu)
+{
+    // Use this function to free the retired blocks. It must only be called
+    // while no block is executing. Live blocks may still be chained to retired
+    // ones, so every chain is cut first; they are re-established the next time
+    // each block exits.
+    if (p_cpu->m_retired_blocks == nullptr)
+    {
+        return;
+    }
+
+    for (size_t i = 0; i < TM_BLOCK_CACHE_SIZE; ++i)
+    {
+        for (tm_block_t* l_block = p_cpu->m_block_cache[i]; l_block != nullptr;
+            l_block = l_block->m_hash_next)
+        {
+            l_block->m_successors[0] = nullptr;
+            l_block->m_successors[1] = nullptr;
+        }
+    }
+
+    while (p_cpu->m_retired_blocks != nullptr)
+    {
+        tm_block_t* l_block = p_cpu->m_retired_blocks;
+        p_cpu->m_retired_blocks = l_block->m_hash_next;
+        tm_free(l_block);
+    }
+
+    p_cpu->m_retired_count = 0;
+}
+
+static inline bool tm_check_xram_filter (tm_cpu_t* p_cpu, addr_t p_page)
+{
+    size_t l_bit = p_page & (TM_XRAM_FILTER_SIZE - 1);
+    return (p_cpu->m_xram_filter[l_bit / 64] >> (l_bit % 64)) & 1;
+}
+
+static void tm_invalidate_blocks (tm_cpu_t* p_cpu, addr_t p_address, size_t p_size)
+{
+    // Any translated block whose instructions overlap the written range is
+    // stale. This includes the block being translated right now, which is
+    // then abandoned once its current instruction finishes.
+    addr_t l_last = p_address + p_size - 1;
+    tm_block_t* l_recording = p_cpu->m_recording;
+    if (
+        l_recording != nullptr &&
+        l_recording->m_valid == true &&
+        p_address < l_recording->m_end &&
+        l_last >= l_recording->m_address
+    )
+    {
+        l_recording->m_valid = false;
+    }
+
+    // Most writes to XRAM are plain data, far away from any code. Each 256-byte
+    // page of XRAM holding translated code sets a bit in the XRAM filter, so
+    // the list of XRAM blocks only needs to be searched if a page written to
+    // might hold some.
+    if (
+        tm_check_xram_filter(p_cpu, p_address >> 8) == false &&
+        tm_check_xram_filter(p_cpu, l_last >> 8) == false
+    )
+    {
+        return;
+    }
+
+    tm_block_t** l_link = &p_cpu->m_xram_blocks;
+    while (*l_link != nullptr)
+    {
+        tm_block_t* l_block = *l_link;
+        if (p_address < l_block->m_end && l_last >= l_block->m_address)
+        {
+            *l_link = l_block->m_xram_next;
+            tm_retire_block(p_cpu, l_block);
+        }
+        else
+        {
+            l_link = &l_block->m_xram_next;
+        }
+    }
+}
+
+/* Static Functions - Self-Modifying Code *************************************/
+
+static inline void tm_check_self_modification (tm_cpu_t* p_cpu, addr_t p_address, size_t p_size)
+{
+    // Executable RAM (XRAM) is the only memory which can be both written to
+    // and executed, so only writes there can change cached instructions.
+    if (p_address + p_size > TM_XRAM_START && p_address <= TM_XRAM_END)
+    {
+        tm_invalidate_decoded(p_cpu, p_address, p_size);
+        if (p_cpu->m_block_cache != nullptr)
+        {
+            tm_invalidate_blocks(p_cpu, p_address, p_size);
+        }
+    }
+}
+
+/* Static Functions - Instruction Cycle **************************************/
+
+static tm_instruction_handler tm_decode_instruction (tm_cpu_t* p_cpu, tm_decoded_instruction_t* p_entry)
+{
+    // The `tm_decode_instruction` function performs the fetch and decode
+    // stages of the instruction cycle for an instruction which could not be
+    // replayed from the decode cache. It returns the handler which executes
+    // the decoded instruction, or `nullptr` if an error occurred.
+
+    // 1c.  Ensure that the memory address retrieved is within executable
+    //      bounds. Copy the contents of the MAR into the instruction
+    //      address register (IAR) if it is. Throw an execute access 
+    //      violation error if it isn't.
+    if (tm_check_executable(p_cpu, p_cpu->m_registers.m_ma) == false)
+    {
+        return nullptr;
+    }
+    else
+    {
+        p_cpu->m_registers.m_ia = p_cpu->m_registers.m_ma;
+    }
+
+    // 1d.  Read a two-byte opcode from the data bus at the address 
+    //      specified in the MAR. Place the word into the memory data 
+    //      register (MDR), then advance the program counter by two places, 
+    //      as two bytes were read.
+    //
+    //      For each byte read from or written to the data bus, the CPU is
+    //      cycled one time.
+    if (tm_read_word(p_cpu, p_cpu->m_registers.m_ma, &p_cpu->m_registers.m_md) == false)
+    {
+        return nullptr;
+    }
+    else if (tm_spend_cycles(p_cpu, 2) == false)
+    {
+        return nullptr;
+    }
+    else
+    {
+        p_cpu->m_registers.m_pc += 2;
+    }
+
+    // 1e.  Copy the contents of the MDR into the current instruction
+    //      register (CIR).
+    p_cpu->m_registers.m_ci = p_cpu->m_registers.m_md;
+
+    // 2a. Reset the instruction and parameter registers to zero.
+    p_cpu->m_inst   = 0;
+    p_cpu->m_param1 = 0;
+    p_cpu->m_param2 = 0;
+
+    // 2b.  An instruction's operation code (opcode) contains important
+    //      information on the instruction to be executed and its
+    //      parameters:
+    //          -   The upper byte (0xXX00) identifies the instruction to be
+    //              executed.
+    //          -   The lower byte (0x00XX) contains information on the
+    //              instruction's parameters.
+    //          -   In many cases, the upper nibble of this byte (0x00X0)
+    //              indicates a destination register, and the lower nibble
+    //              (0x000X) indicates a source register.
+    //
+    //      Decode the encoded instruction from the CIR, and record the
+    //      decoded information.
+    p_cpu->m_inst   = tm_check_byte(p_cpu->m_registers.m_ci, 1);
+    p_cpu->m_param1 = tm_check_nibble(p_cpu->m_registers.m_ci, 1);
+    p_cpu->m_param2 = tm_check_nibble(p_cpu->m_registers.m_ci, 0);
+
+    // 2c.  Look up the handler for the decoded instruction, specialised for
+    //      the width of its operands. Throw an invalid opcode error if there
+    //      isn't one.
+    const tm_instruction_variants_t* l_variants = &s_instruction_handlers[p_cpu->m_inst];
+    tm_instruction_handler l_handler = l_variants->m_handlers[
+        (l_variants->m_param2_width == true) ? tm_width_param2(p_cpu) : tm_width_param1(p_cpu)
+    ];
+    if (l_handler == nullptr)
+    {
+        tm_set_error(p_cpu, TM_ERROR_INVALID_OPCODE);
+        return nullptr;
+    }
+
+    // 2d.  If the decode cache is enabled, start recording the decoded
+    //      instruction into its cache entry. The entry only becomes valid
+    //      once the instruction has executed successfully, at which point
+    //      its immediate operand (if any) has been recorded, too.
+    if (p_entry != nullptr)
+    {
+        p_entry->m_valid    = false;
+        p_entry->m_handler  = l_handler;
+        p_entry->m_fused    = nullptr;
+        p_entry->m_address  = p_cpu->m_registers.m_ia;
+        p_entry->m_ci       = p_cpu->m_registers.m_ci;
+        p_entry->m_inst     = p_cpu->m_inst;
+        p_entry->m_param1   = p_cpu->m_param1;
+        p_entry->m_param2   = p_cpu->m_param2;
+        p_entry->m_size     = 2;
+        p_cpu->m_decoding   = p_entry;
+    }
+
+    return l_handler;
+}
+
+TM_SPECIALISED bool tm_refetch_instruction (tm_cpu_t* p_cpu, tm_decoded_instruction_t* p_entry)
+{
+    // The `tm_refetch_instruction` function performs the fetch and decode
+    // stages for an instruction which was decoded earlier, found at the
+    // address in the MAR. The instruction's address already passed the
+    // execute check and its opcode is already known, so only the cycles spent
+    // reading the opcode need to be accounted for.
+    p_cpu->m_registers.m_ia = p_cpu->m_registers.m_ma;
+    if (tm_spend_cycles(p_cpu, 2) == false)
+    {
+        return false;
+    }
+
+    p_cpu->m_registers.m_pc += 2;
+    p_cpu->m_registers.m_md = p_entry->m_ci;
+    p_cpu->m_registers.m_ci = p_entry->m_ci;
+    p_cpu->m_inst           = p_entry->m_inst;
+    p_cpu->m_param1         = p_entry->m_param1;
+    p_cpu->m_param2         = p_entry->m_param2;
+    p_cpu->m_decoding       = p_entry;
+    return true;
+}
+
+static bool tm_replay_instruction (tm_cpu_t* p_cpu, tm_decoded_instruction_t* p_entry)
+{
+    // The `tm_replay_instruction` function executes an instruction which was
+    // decoded earlier, found at the address in the MAR.
+    if (tm_refetch_instruction(p_cpu, p_entry) == false)
+    {
+        return false;
+    }
+
+    bool l_good = p_entry->m_handler(p_cpu);
+    p_cpu->m_decoding = nullptr;
+    return l_good;
+}
+
+TM_SPECIALISED void tm_finish_step (tm_cpu_t* p_cpu)
+{
+    // If the CPU's interrupt master enable flag is set, handle any pending
+    // interrupts if their respective interrupt enable bit is set.
+    if (p_cpu->m_ime == true)
+    {
+        tm_collect_interrupts(p_cpu);
+        tm_handle_interrupts(p_cpu);
+        p_cpu->m_enable_ime = false;
+    }
+
+    // If the `EI` instruction set the `enable_ime` flag, enable the interrupt
+    // master flag.
+    if (p_cpu->m_enable_ime == true)
+    {
+        p_cpu->m_ime = true;
+    }
+}
+
+/* Static Functions - Interpreter Loop ****************************************/
+
+// Outside of translated blocks, `tm_run_cpu` executes instructions through the
+// loop in `tm_interpret`, which dispatches on each instruction's opcode itself
+// rather than calling `tm_step_cpu`, and through it the instruction's handler,
+// once per step.
+//
+// By default, the loop is threaded: every instruction's handler is expanded
+// in place behind a label, and the address of each label is kept in a table
+// indexed by opcode (a GCC extension). Each handler ends by jumping straight
+// to the handler of the next instruction, so every handler gets an indirect
+// branch of its own for the host to predict. A `switch` statement is used
+// instead if the extension is not available, or if premake is run with
+// `--dispatch=switch`.
+
+#if defined(TM_COMPUTED_GOTO) && defined(__GNUC__)
+    #define TM_THREADED_DISPATCH
+#endif
+
+static inline bool tm_fetch_instruction (tm_cpu_t* p_cpu)
+{
+    // Performs the fetch and decode stages for the instruction at the program
+    // counter, replaying it from the decode cache if possible, as
+    // `tm_step_cpu` does.
+    p_cpu->m_registers.m_ma = p_cpu->m_registers.m_pc;
+
+    tm_decoded_instruction_t* l_entry = nullptr;
+    if (p_cpu->m_decode_cache_enabled == true)
+    {
+        l_entry = tm_lookup_decoded(p_cpu, p_cpu->m_registers.m_ma);
+        if (l_entry->m_valid == true && l_entry->m_address == p_cpu->m_registers.m_ma)
+        {
+            return tm_refetch_instruction(p_cpu, l_entry);
+        }
+    }
+
+    return tm_decode_instruction(p_cpu, l_entry) != nullptr;
+}
+
+static inline bool tm_retire_instruction (tm_cpu_t* p_cpu, bool p_good)
+{
+    // Commits the instruction just executed to the decode cache if it was
+    // being recorded, then finishes the step if the instruction succeeded.
+    tm_decoded_instruction_t* l_entry = p_cpu->m_decoding;
+    if (l_entry != nullptr)
+    {
+        if (l_entry->m_valid == false) { l_entry->m_valid = p_good; }
+        p_cpu->m_decoding = nullptr;
+    }
+
+    if (p_good == true)
+    {
+        tm_finish_step(p_cpu);
+    }
+
+    return p_good;
+}
+
+static bool tm_interpret (tm_cpu_t* p_cpu, size_t p_budget, size_t* p_steps)
+{
+    // The `tm_interpret` function executes up to `p_budget` instructions, with
+    // the same outcome as calling `tm_step_cpu` as many times. It returns early
+    // once the CPU halts or stops. The number of steps executed is added to
+    // `p_steps`. Returns false if an instruction failed.
+
+    size_t l_steps = 0;
+    bool l_good = tm_fetch_instruction(p_cpu);
+
+    // After each instruction, count the step, then fetch the next instruction
+    // unless it is time to return.
+    #define tm_next_instruction() \
+        if ( \
+            tm_retire_instruction(p_cpu, l_good) == false || \
+            ++l_steps == p_budget || \
+            p_cpu->m_flags.m_halt == true || \
+            p_cpu->m_flags.m_stop == true || \
+            (l_good = tm_fetch_instruction(p_cpu)) == false \
+        ) \
+        { \
+            goto tm_done; \
+        }
+
+    if (l_good == false)
+    {
+        goto tm_done;
+    }
+
+    #if defined(TM_THREADED_DISPATCH)
+
+        static void* const s_labels[0x100] =
+        {
+            #define tm_define_label_entry(p_inst, p_name, p_width, p_clause) \
+                [p_inst] = &&tm_label_##p_name,
+            tm_for_each_instruction(tm_define_label_entry)
+            #undef tm_define_label_entry
+        };
+
+        // Opcodes without a handler never get here; `tm_decode_instruction`
+        // rejects them.
+        goto *s_labels[p_cpu->m_inst];
+
+        #define tm_define_label(p_inst, p_name, p_width, p_clause) \
+            tm_label_##p_name: \
+            { \
+                const enum_t l_width = tm_width_##p_width(p_cpu); \
+                (void) l_width; \
+                l_good = p_clause; \
+                tm_next_instruction(); \
+                goto *s_labels[p_cpu->m_inst]; \
+            }
+        tm_for_each_instruction(tm_define_label)
+        #undef tm_define_label
+
+    #else
+
+        for (;;)
+        {
+            switch (p_cpu->m_inst)
+            {
+                #define tm_define_case(p_inst, p_name, p_width, p_clause) \
+                    case p_inst: \
+                    { \
+                        const enum_t l_width = tm_width_##p_width(p_cpu); \
+                        (void) l_width; \
+                        l_good = p_clause; \
+                    } break;
+                tm_for_each_instruction(tm_define_case)
+                #undef tm_define_case
+            }
+
+            tm_next_instruction();
+        }
+
+    #endif
+
+    #undef tm_next_instruction
+
+tm_done:
+    *p_steps += l_steps;
+    return l_good;
+}
+
+/* Static Functions - Superoperators *****************************************/
+
+// A counter's increment or decrement, or a comparison, is followed by the
+// conditional branch testing its result often enough that blocks execute such
+// pairs through a single superoperator, fused when the block is committed.
+// Each pair listed below is expanded into one superoperator per operand width
+// of its first instruction, which evaluates the clauses of both instructions
+// in one function: there is no dispatch between them, and the flags set by
+// the first are still at hand when the branch tests its condition. Between
+// the two, a superoperator does exactly what the block's loop does: finishing
+// the step, and leaving the block if an interrupt was handled or the block was
+// overwritten. Only blocks fuse: `tm_step_cpu` executes a single instruction,
+// and the interpreter loop already expands every handler in place.
+#define tm_for_each_superoperator(X) \
+    X(0x30, 0x20, inc_reg,          jmp_addr32) \
+    X(0x30, 0x22, inc_reg,          jpb_imm16) \
+    X(0x31, 0x20, inc_regptr32,     jmp_addr32) \
+    X(0x31, 0x22, inc_regptr32,     jpb_imm16) \
+    X(0x32, 0x20, dec_reg,          jmp_addr32) \
+    X(0x32, 0x22, dec_reg,          jpb_imm16) \
+    X(0x33, 0x20, dec_regptr32,     jmp_addr32) \
+    X(0x33, 0x22, dec_regptr32,     jpb_imm16) \
+    X(0x49, 0x20, cmp_reg_imm,      jmp_addr32) \
+    X(0x49, 0x22, cmp_reg_imm,      jpb_imm16) \
+    X(0x4A, 0x20, cmp_reg_reg,      jmp_addr32) \
+    X(0x4A, 0x22, cmp_reg_reg,      jpb_imm16)
+
+TM_SPECIALISED bool tm_begin_fused (tm_cpu_t* p_cpu, tm_decoded_instruction_t* p_entry)
+{
+    p_cpu->m_registers.m_ma = p_cpu->m_registers.m_pc;
+    return tm_refetch_instruction(p_cpu, p_entry);
+}
+
+TM_SPECIALISED bool tm_end_fused (tm_cpu_t* p_cpu, bool p_good)
+{
+    p_cpu->m_decoding = nullptr;
+    if (p_good == true)
+    {
+        tm_finish_step(p_cpu);
+    }
+
+    return p_good;
+}
+
+// Sets `p_executed` to the number of the pair's instructions executed, which
+// is less than two if one of them failed, or if the block has to be left after
+// the first. Returns false if one of them failed. The branch ending each pair
+// takes no width.
+#define tm_define_superoperator_width(p_first, p_second, p_suffix, p_width) \
+    static bool tm_fuse_##p_first##_##p_second##p_suffix (tm_cpu_t* p_cpu, \
+        tm_block_t* p_block, tm_decoded_instruction_t* p_entry, size_t* p_executed) \
+    { \
+        *p_executed = 0; \
+        if (tm_end_fused(p_cpu, tm_begin_fused(p_cpu, &p_entry[0]) && \
+            tm_clause_##p_first(p_cpu, p_width)) == false) \
+        { \
+            return false; \
+        } \
+        *p_executed = 1; \
+        if (p_cpu->m_registers.m_pc != p_entry[1].m_address || p_block->m_valid == false) \
+        { \
+            return true; \
+        } \
+        if (tm_end_fused(p_cpu, tm_begin_fused(p_cpu, &p_entry[1]) && \
+            tm_clause_##p_second(p_cpu, 0)) == false) \
+        { \
+            return false; \
+        } \
+        *p_executed = 2; \
+        return true; \
+    }
+#define tm_define_superoperator(p_first_inst, p_second_inst, p_first, p_second) \
+    tm_define_superoperator_width(p_first, p_second, _long, 0) \
+    tm_define_superoperator_width(p_first, p_second, _word, 1) \
+    tm_define_superoperator_width(p_first, p_second, _byte, 2)
+tm_for_each_superoperator(tm_define_superoperator)
+#undef tm_define_superoperator
+#undef tm_define_superoperator_width
+
+static tm_superoperator tm_find_superoperator (const tm_decoded_instruction_t* p_entry)
+{
+    // The first instruction of every pair takes its operand width from its
+    // parameter #1, as its handler does.
+    enum_t l_width = p_entry[0].m_param1 & 0b11;
+    switch ((p_entry[0].m_inst << 8) | p_entry[1].m_inst)
+    {
+        #define tm_define_superoperator_case(p_first_inst, p_second_inst, p_first, p_second) \
+            case (p_first_inst << 8) | p_second_inst: \
+            { \
+                static const tm_superoperator s_variants[4] = \
+                { \
+                    tm_fuse_##p_first##_##p_second##_long, \
+                    tm_fuse_##p_first##_##p_second##_word, \
+                    tm_fuse_##p_first##_##p_second##_byte, \
+                    tm_fuse_##p_first##_##p_second##_byte \
+                }; \
+                return s_variants[l_width]; \
+            }
+        tm_for_each_superoperator(tm_define_superoperator_case)
+        #undef tm_define_superoperator_case
+        default: return nullptr;
+    }
+}
+
+static void tm_fuse_block (tm_block_t* p_block)
+{
+    // Pairs are fused from the start of the block, so an instruction belongs
+    // to one superoperator at most.
+    for (size_t i = 0; i + 1 < p_block->m_count; ++i)
+    {
+        tm_decoded_instruction_t* l_entry = &p_block->m_instructions[i];
+        l_entry->m_fused = tm_find_superoperator(l_entry);
+        if (l_entry->m_fused != nullptr)
+        {
+            ++i;
+        }
+    }
+}
+
+/* Static Functions - Block Translation ***************************************/
+
+static inline bool tm_ends_block (byte_t p_inst)
+{
+    // Blocks end at the first instruction which may move the program counter
+    // anywhere other than the next instruction, or which stops the CPU from
+    // executing instructions.
+    switch (p_inst)
+    {
+        case 0x01:  // STOP
+        case 0x02:  // HALT
+        case 0x20:  // JMP
+        case 0x21:
+        case 0x22:  // JPB
+        case 0x23:  // CALL
+        case 0x24:  // RST
+        case 0x25:  // RET
+        case 0x26:  // RETI
+        case 0x27:  // JPS
+        case 0xFF:
+            return true;
+        default:
+            return false;
+    }
+}
+
+static void tm_commit_block (tm_cpu_t* p_cpu, tm_block_t** p_block)
+{
+    // Copy the block just translated out of the recording buffer, then add it
+    // to the block cache.
+    tm_block_t* l_recording = p_cpu->m_recording;
+    size_t l_size = sizeof(tm_block_t) + l_recording->m_count * sizeof(tm_decoded_instruction_t);
+
+    tm_block_t* l_block = malloc(l_size);
+    tm_expect_p(l_block, "tm: could not allocate translated block");
+    memcpy(l_block, l_recording, l_size);
+    if (p_cpu->m_superoperators_enabled == true)
+    {
+        tm_fuse_block(l_block);
+    }
+
+    size_t l_hash = tm_hash_block(l_block->m_address);
+    l_block->m_hash_next = p_cpu->m_block_cache[l_hash];
+    p_cpu->m_block_cache[l_hash] = l_block;
+
+    // Blocks translated from XRAM must be found again when the memory they
+    // were translated from is written to.
+    if (l_block->m_end > TM_XRAM_START && l_block->m_address <= TM_XRAM_END)
+    {
+        l_block->m_xram_next = p_cpu->m_xram_blocks;
+        p_cpu->m_xram_blocks = l_block;
+
+        for (addr_t l_page = l_block->m_address >> 8; l_page <= (l_block->m_end - 1) >> 8; ++l_page)
+        {
+            size_t l_bit = l_page & (TM_XRAM_FILTER_SIZE - 1);
+            p_cpu->m_xram_filter[l_bit / 64] |= (1ull << (l_bit % 64));
+        }
+    }
+
+    *p_block = l_block;
+}
+
+static bool tm_translate_block (tm_cpu_t* p_cpu, tm_block_t** p_block, size_t* p_steps)
+{
+    // The `tm_translate_block` function translates the block of instructions
+    // starting at the program counter. Instructions are translated by
+    // executing them in the same way as `tm_step_cpu` does, while recording
+    // each decoded instruction and its immediate operand. This guarantees that
+    // the translated block behaves exactly like the instructions it was built
+    // from. The number of steps executed is added to `p_steps`, and the new
+    // block, if one could be translated, is returned through `p_block`.
+    // Returns false if an instruction failed.
+
+    tm_block_t* l_recording     = p_cpu->m_recording;
+    l_recording->m_address      = p_cpu->m_registers.m_pc;
+    l_recording->m_end          = p_cpu->m_registers.m_pc;
+    l_recording->m_successors[0] = nullptr;
+    l_recording->m_successors[1] = nullptr;
+    l_recording->m_hash_next    = nullptr;
+    l_recording->m_xram_next    = nullptr;
+    l_recording->m_count        = 0;
+    l_recording->m_executions   = 0;
+    l_recording->m_native[0]    = nullptr;
+    l_recording->m_native[1]    = nullptr;
+    l_recording->m_native_unsupported = false;
+    l_recording->m_valid        = true;
+    *p_block = nullptr;
+
+    bool l_good = false;
+    while (l_recording->m_count < TM_MAX_BLOCK_LENGTH)
+    {
+        tm_decoded_instruction_t* l_entry = &l_recording->m_instructions[l_recording->m_count];
+
+        // Until the instruction's size is known, assume it is as long as an
+        // instruction can be, so that it is checked for self-modification.
+        p_cpu->m_registers.m_ma = p_cpu->m_registers.m_pc;
+        l_recording->m_end = p_cpu->m_registers.m_ma + TM_MAX_INSTRUCTION_SIZE;
+
+        tm_instruction_handler l_handler = tm_decode_instruction(p_cpu, l_entry);
+        l_good = (l_handler != nullptr) && l_handler(p_cpu);
+        l_entry->m_valid = l_good;
+        p_cpu->m_decoding = nullptr;
+        if (l_good == false)
+        {
+            break;
+        }
+
+        l_recording->m_end = l_entry->m_address + l_entry->m_size;
+        l_recording->m_count++;
+
+        // The block ends at a control flow instruction, or early if an
+        // interrupt was handled after this instruction, or if the block wrote
+        // over its own instructions.
+        addr_t l_next = p_cpu->m_registers.m_pc;
+        tm_finish_step(p_cpu);
+        if (
+            tm_ends_block(l_entry->m_inst) == true ||
+            p_cpu->m_registers.m_pc != l_next ||
+            l_recording->m_valid == false
+        )
+        {
+            break;
+        }
+    }
+
+    *p_steps += l_recording->m_count;
+    if (l_good == true && l_recording->m_valid == true)
+    {
+        tm_commit_block(p_cpu, p_block);
+    }
+
+    l_recording->m_valid = false;
+    return l_good;
+}
+
+static bool tm_execute_block (tm_cpu_t* p_cpu, tm_block_t* p_block, size_t* p_steps)
+{
+    // The `tm_execute_block` function executes a translated block, and adds
+    // the number of steps executed to `p_steps`. If all went well, that is the
+    // number of instructions in the block. Returns false if an instruction
+    // failed.
+    tm_decoded_instruction_t* l_entry = p_block->m_instructions;
+    tm_decoded_instruction_t* l_last = l_entry + p_block->m_count - 1;
+    for (;; ++l_entry)
+    {
+        if (l_entry->m_fused != nullptr)
+        {
+            size_t l_executed = 0;
+            bool l_good = l_entry->m_fused(p_cpu, p_block, l_entry, &l_executed);
+            if (l_executed < 2)
+            {
+                *p_steps += l_entry - p_block->m_instructions + l_executed;
+                return l_good;
+            }
+
+            // Carry on from the second instruction of the pair.
+            ++l_entry;
+        }
+        else
+        {
+            p_cpu->m_registers.m_ma = p_cpu->m_registers.m_pc;
+            if (tm_replay_instruction(p_cpu, l_entry) == false)
+            {
+                *p_steps += l_entry - p_block->m_instructions;
+                return false;
+            }
+
+            tm_finish_step(p_cpu);
+        }
+
+        if (l_entry == l_last)
+        {
+            *p_steps += p_block->m_count;
+            return true;
+        }
+
+        // Leave the block early if an interrupt was handled, or if the block
+        // has just written over its own instructions.
+        if (p_cpu->m_registers.m_pc != l_entry[1].m_address || p_block->m_valid == false)
+        {
+            *p_steps += l_entry - p_block->m_instructions + 1;
+            return true;
+        }
+    }
+}
+
+static void tm_chain_block (tm_block_t* p_previous, tm_block_t* p_block)
+{
+    // Each block remembers up to two blocks it exits into - enough for both
+    // outcomes of a conditional branch. Fill the first slot unless it is
+    // already in use, otherwise replace the second.
+    if (p_previous != nullptr && p_block != nullptr)
+    {
+        tm_block_t* l_first = p_previous->m_successors[0];
+        p_previous->m_successors[(l_first == nullptr || l_first->m_valid == false) ? 0 : 1] = p_block;
+    }
+}
+
+static tm_block_t* tm_find_block (tm_cpu_t* p_cpu, tm_block_t* p_previous)
+{
+    // Find the block starting at the program counter. If the previous block
+    // has already been chained to it, follow the chain; otherwise, look it up
+    // in the block cache and chain the previous block to it.
+    addr_t l_address = p_cpu->m_registers.m_pc;
+    if (p_previous == nullptr)
+    {
+        return tm_lookup_block(p_cpu, l_address);
+    }
+
+    for (size_t i = 0; i < 2; ++i)
+    {
+        tm_block_t* l_successor = p_previous->m_successors[i];
+        if (l_successor != nullptr && l_successor->m_address == l_address &&
+            l_successor->m_valid == true)
+        {
+            return l_successor;
+        }
+    }
+
+    tm_block_t* l_block = tm_lookup_block(p_cpu, l_address);
+    tm_chain_block(p_previous, l_block);
+    return l_block;
+}
+
+/* Static Functions - JIT Compiler ********************************************/
+
+#if defined(TM_JIT)
+
+// Compiled blocks keep the CPU context in `RBX`, the general-purpose registers
+// `A` through `D` in `R12D` through `R15D`, and the flags register in `EBP`,
+// all of which are preserved across calls. The remaining registers are
+// scratch. Each compiled block returns the number of steps it executed, as
+// many as `tm_execute_block` would count.
+//
+// Only blocks made up entirely of instructions which operate on registers and
+// immediate values are compiled. Blocks which access memory - including the
+// IO port registers at `TM_IO_START` - or the stacks, or which change the
+// interrupt state, keep running in the interpreter.
+//
+// Guest registers and flags are written back to the CPU context when a block
+// exits, so they are not up to date while the host's cycle callback runs from
+// within a compiled block. Flags which a block overwrites before reading them
+// are never computed, so after a hardware error raised from within a compiled
+// block, those flags may hold stale values.
+
+enum tm_jit_register
+{
+    TM_JIT_RAX, TM_JIT_RCX, TM_JIT_RDX, TM_JIT_RBX,
+    TM_JIT_RSP, TM_JIT_RBP, TM_JIT_RSI, TM_JIT_RDI,
+    TM_JIT_R8,  TM_JIT_R9,  TM_JIT_R10, TM_JIT_R11,
+    TM_JIT_R12, TM_JIT_R13, TM_JIT_R14, TM_JIT_R15,
+};
+
+enum tm_jit_condition
+{
+    TM_JIT_CC_B     = 0x2,
+    TM_JIT_CC_E     = 0x4,
+    TM_JIT_CC_NE    = 0x5,
+    TM_JIT_CC_A     = 0x7,
+    TM_JIT_CC_S     = 0x8,
+};
+
+#define TM_JIT_WIDE         0x01    // 64-bit operand size (REX.W prefix).
+#define TM_JIT_WORD         0x02    // 16-bit operand size (0x66 prefix).
+#define TM_JIT_MAX_EXITS    (4 * TM_MAX_BLOCK_LENGTH)
+
+#define TM_JIT_FLAGS_ALL    0x3F
+#define tm_jit_flag(p_flag) (1 << (p_flag))
+
+typedef bool (*tm_jit_helper) (tm_cpu_t*, const void*);
+
+typedef struct tm_jit_emitter
+{
+    byte_t*     m_code;
+    size_t      m_used;
+    size_t      m_exits[TM_JIT_MAX_EXITS];      // Jumps to the common exit, to be patched.
+    size_t      m_exit_count;
+} tm_jit_emitter_t;
+
+static inline void tm_jit_byte (tm_jit_emitter_t* p_jit, byte_t p_byte)
+{
+    p_jit->m_code[p_jit->m_used++] = p_byte;
+}
+
+static inline void tm_jit_long (tm_jit_emitter_t* p_jit, uint32_t p_value)
+{
+    memcpy(p_jit->m_code + p_jit->m_used, &p_value, sizeof(p_value));
+    p_jit->m_used += sizeof(p_value);
+}
+
+static inline void tm_jit_quad (tm_jit_emitter_t* p_jit, uint64_t p_value)
+{
+    memcpy(p_jit->m_code + p_jit->m_used, &p_value, sizeof(p_value));
+    p_jit->m_used += sizeof(p_value);
+}
+
+static void tm_jit_modrm (tm_jit_emitter_t* p_jit, int p_flags, uint32_t p_opcode,
+    int p_reg, int p_rm, bool p_memory, int32_t p_disp)
+{
+    // Emits an instruction with a ModR/M operand. The operand is either the
+    // register `p_rm`, or the memory at `[RBX + p_disp]` if `p_memory` is set.
+    // Two-byte opcodes are passed as `0x0Fxx`.
+    if (p_flags & TM_JIT_WORD) { tm_jit_byte(p_jit, 0x66); }
+
+    byte_t l_rex = 0x40 |
+        ((p_flags & TM_JIT_WIDE) ? 0x08 : 0) |
+        ((p_reg & 0x08) ? 0x04 : 0) |
+        ((p_rm & 0x08) ? 0x01 : 0);
+    if (l_rex != 0x40) { tm_jit_byte(p_jit, l_rex); }
+
+    if (p_opcode > 0xFF) { tm_jit_byte(p_jit, p_opcode >> 8); }
+    tm_jit_byte(p_jit, p_opcode & 0xFF);
+
+    if (p_memory == true)
+    {
+        tm_jit_byte(p_jit, 0x80 | ((p_reg & 7) << 3) | (p_rm & 7));
+        tm_jit_long(p_jit, p_disp);
+    }
+    else
+    {
+        tm_jit_byte(p_jit, 0xC0 | ((p_reg & 7) << 3) | (p_rm & 7));
+    }
+}
+
+static inline void tm_jit_rr (tm_jit_emitter_t* p_jit, int p_flags, uint32_t p_opcode, int p_reg, int p_rm)
+{
+    tm_jit_modrm(p_jit, p_flags, p_opcode, p_reg, p_rm, false, 0);
+}
+
+static inline void tm_jit_mem (tm_jit_emitter_t* p_jit, int p_flags, uint32_t p_opcode, int p_reg, size_t p_offset)
+{
+    tm_jit_modrm(p_jit, p_flags, p_opcode, p_reg, TM_JIT_RBX, true, (int32_t) p_offset);
+}
+
+static inline void tm_jit_imm (tm_jit_emitter_t* p_jit, int p_flags, int p_extension, int p_rm, uint32_t p_value)
+{
+    // Group 1 arithmetic with a 32-bit immediate: `ADD`, `OR`, `AND`, `SUB`,
+    // `XOR` and `CMP` are extensions 0, 1, 4, 5, 6 and 7.
+    tm_jit_rr(p_jit, p_flags, 0x81, p_extension, p_rm);
+    tm_jit_long(p_jit, p_value);
+}
+
+static inline void tm_jit_shift (tm_jit_emitter_t* p_jit, int p_flags, int p_extension, int p_rm, byte_t p_count)
+{
+    // `SHL` and `SHR` are extensions 4 and 5.
+    tm_jit_rr(p_jit, p_flags, 0xC1, p_extension, p_rm);
+    tm_jit_byte(p_jit, p_count);
+}
+
+static inline void tm_jit_mov_imm (tm_jit_emitter_t* p_jit, int p_reg, uint32_t p_value)
+{
+    if (p_reg & 0x08) { tm_jit_byte(p_jit, 0x41); }
+    tm_jit_byte(p_jit, 0xB8 + (p_reg & 7));
+    tm_jit_long(p_jit, p_value);
+}
+
+static inline void tm_jit_mov_imm64 (tm_jit_emitter_t* p_jit, int p_reg, uint64_t p_value)
+{
+    tm_jit_byte(p_jit, (p_reg & 0x08) ? 0x49 : 0x48);
+    tm_jit_byte(p_jit, 0xB8 + (p_reg & 7));
+    tm_jit_quad(p_jit, p_value);
+}
+
+static inline void tm_jit_push (tm_jit_emitter_t* p_jit, int p_reg)
+{
+    if (p_reg & 0x08) { tm_jit_byte(p_jit, 0x41); }
+    tm_jit_byte(p_jit, 0x50 + (p_reg & 7));
+}
+
+static inline void tm_jit_pop (tm_jit_emitter_t* p_jit, int p_reg)
+{
+    if (p_reg & 0x08) { tm_jit_byte(p_jit, 0x41); }
+    tm_jit_byte(p_jit, 0x58 + (p_reg & 7));
+}
+
+static size_t tm_jit_jump (tm_jit_emitter_t* p_jit, int p_condition)
+{
+    // Emits a jump with a 32-bit displacement, conditional unless
+    // `p_condition` is negative. Returns the offset of the displacement, so it
+    // can be patched once the target is known.
+    if (p_condition < 0)
+    {
+        tm_jit_byte(p_jit, 0xE9);
+    }
+    else
+    {
+        tm_jit_byte(p_jit, 0x0F);
+        tm_jit_byte(p_jit, 0x80 | p_condition);
+    }
+
+    size_t l_offset = p_jit->m_used;
+    tm_jit_long(p_jit, 0);
+    return l_offset;
+}
+
+static inline void tm_jit_patch (tm_jit_emitter_t* p_jit, size_t p_offset, size_t p_target)
+{
+    int32_t l_displacement = (int32_t) (p_target - (p_offset + 4));
+    memcpy(p_jit->m_code + p_offset, &l_displacement, sizeof(l_displacement));
+}
+
+static void tm_jit_exit_if (tm_jit_emitter_t* p_jit, int p_condition, size_t p_steps)
+{
+    // Leaves the block, reporting `p_steps` steps executed, if the host
+    // condition `p_condition` holds. The exit path is laid out inline and
+    // skipped with a short jump on the inverse condition.
+    tm_jit_byte(p_jit, 0x70 | (p_condition ^ 1));
+    tm_jit_byte(p_jit, 10);
+    tm_jit_mov_imm(p_jit, TM_JIT_RAX, p_steps);
+    p_jit->m_exits[p_jit->m_exit_count++] = tm_jit_jump(p_jit, -1);
+}
+
+static void tm_jit_call (tm_jit_emitter_t* p_jit, tm_jit_helper p_function, const void* p_argument)
+{
+    // Calls `p_function (p_cpu, p_argument)`, which returns false if the CPU
+    // has been stopped by an error.
+    tm_jit_rr(p_jit, TM_JIT_WIDE, 0x89, TM_JIT_RBX, TM_JIT_RDI);
+    tm_jit_mov_imm64(p_jit, TM_JIT_RSI, (uintptr_t) p_argument);
+    tm_jit_mov_imm64(p_jit, TM_JIT_RAX, (uintptr_t) p_function);
+    tm_jit_byte(p_jit, 0xFF);
+    tm_jit_byte(p_jit, 0xD0);
+    tm_jit_rr(p_jit, 0, 0x84, TM_JIT_RAX, TM_JIT_RAX);
+}
+
+/* Static Functions - JIT Compiler - Guest State ******************************/
+
+static inline int tm_jit_guest_register (byte_t p_register)
+{
+    return TM_JIT_R12 + (p_register >> 2);
+}
+
+static void tm_jit_read_register (tm_jit_emitter_t* p_jit, byte_t p_register, int p_host)
+{
+    // Loads the value of a guest register into a host register, as
+    // `tm_load_register` would.
+    int l_guest = tm_jit_guest_register(p_register);
+    switch (p_register & 0b11)
+    {
+        case 0:
+            tm_jit_rr(p_jit, 0, 0x89, l_guest, p_host);
+            break;
+        case 1:
+            tm_jit_rr(p_jit, 0, 0x0FB7, p_host, l_guest);
+            break;
+        case 2:
+            tm_jit_rr(p_jit, 0, 0x89, l_guest, p_host);
+            tm_jit_shift(p_jit, 0, 5, p_host, 8);
+            tm_jit_rr(p_jit, 0, 0x0FB6, p_host, p_host);
+            break;
+        default:
+            tm_jit_rr(p_jit, 0, 0x0FB6, p_host, l_guest);
+            break;
+    }
+}
+
+static void tm_jit_write_register (tm_jit_emitter_t* p_jit, byte_t p_register, int p_host)
+{
+    // Stores a host register into a guest register, as `tm_store_register`
+    // would. Writing one of the high byte registers clobbers `p_host`.
+    int l_guest = tm_jit_guest_register(p_register);
+    switch (p_register & 0b11)
+    {
+        case 0:
+            tm_jit_rr(p_jit, 0, 0x89, p_host, l_guest);
+            break;
+        case 1:
+            tm_jit_rr(p_jit, TM_JIT_WORD, 0x89, p_host, l_guest);
+            break;
+        case 2:
+            tm_jit_imm(p_jit, 0, 4, l_guest, 0xFFFF00FF);
+            tm_jit_rr(p_jit, 0, 0x0FB6, p_host, p_host);
+            tm_jit_shift(p_jit, 0, 4, p_host, 8);
+            tm_jit_rr(p_jit, 0, 0x09, p_host, l_guest);
+            break;
+        default:
+            tm_jit_rr(p_jit, 0, 0x88, p_host, l_guest);
+            break;
+    }
+}
+
+static void tm_jit_test_width (tm_jit_emitter_t* p_jit, byte_t p_register, int p_host)
+{
+    // Tests the bits of `p_host` which fit in the given guest register.
+    switch (p_register & 0b11)
+    {
+        case 0:     tm_jit_rr(p_jit, 0, 0x85, p_host, p_host); break;
+        case 1:     tm_jit_rr(p_jit, TM_JIT_WORD, 0x85, p_host, p_host); break;
+        default:    tm_jit_rr(p_jit, 0, 0x84, p_host, p_host); break;
+    }
+}
+
+static void tm_jit_set_flag (tm_jit_emitter_t* p_jit, int p_condition, enum_t p_flag)
+{
+    // Copies a host condition into one of the guest flags. The flag must have
+    // been cleared beforehand.
+    tm_jit_rr(p_jit, 0, 0x0F90 | p_condition, 0, TM_JIT_R8);
+    tm_jit_rr(p_jit, 0, 0x0FB6, TM_JIT_R8, TM_JIT_R8);
+    if (p_flag != 0) { tm_jit_shift(p_jit, 0, 4, TM_JIT_R8, p_flag); }
+    tm_jit_rr(p_jit, 0, 0x09, TM_JIT_R8, TM_JIT_RBP);
+}
+
+static void tm_jit_reset_flags (tm_jit_emitter_t* p_jit, byte_t p_written, byte_t p_set)
+{
+    // Clears the flags about to be written, then sets those whose new value
+    // is always one.
+    if (p_written != 0) { tm_jit_imm(p_jit, 0, 4, TM_JIT_RBP, ~((uint32_t) p_written)); }
+    if (p_set != 0)     { tm_jit_imm(p_jit, 0, 1, TM_JIT_RBP, p_set); }
+}
+
+/* Static Functions - JIT Compiler - Instructions *****************************/
+
+static bool tm_jit_supports (const tm_decoded_instruction_t* p_entry)
+{
+    switch (p_entry->m_inst)
+    {
+        case 0x00:  // NOP
+        case 0x10:  // LD reg, imm
+        case 0x1D:  // MV reg, reg
+        case 0x20:  // JMP cond, addr32
+        case 0x22:  // JPB cond, imm16
+        case 0x27:  // JPS
+        case 0xFF:
+        case 0x30:  // INC reg
+        case 0x32:  // DEC reg
+        case 0x34: case 0x35:   // ADD
+        case 0x37: case 0x38:   // ADC
+        case 0x3A: case 0x3B:   // SUB
+        case 0x3D: case 0x3E:   // SBC
+        case 0x40: case 0x41:   // AND
+        case 0x43: case 0x44:   // OR
+        case 0x46: case 0x47:   // XOR
+        case 0x49: case 0x4A:   // CMP
+            return true;
+        default:
+            return false;
+    }
+}
+
+static byte_t tm_jit_flags_read (const tm_decoded_instruction_t* p_entry)
+{
+    switch (p_entry->m_inst)
+    {
+        case 0x37: case 0x38:
+        case 0x3D: case 0x3E:
+            return tm_jit_flag(TM_FLAG_C);
+        case 0x20:
+        case 0x22:
+            switch (p_entry->m_param1)
+            {
+                case TM_CONDITION_CS:
+                case TM_CONDITION_CC:   return tm_jit_flag(TM_FLAG_C);
+                case TM_CONDITION_ZS:
+                case TM_CONDITION_ZC:   return tm_jit_flag(TM_FLAG_Z);
+                case TM_CONDITION_OS:   return tm_jit_flag(TM_FLAG_O);
+                case TM_CONDITION_US:   return tm_jit_flag(TM_FLAG_U);
+                default:                return 0;
+            }
+        default:
+            return 0;
+    }
+}
+
+static byte_t tm_jit_flags_written (const tm_decoded_instruction_t* p_entry)
+{
+    switch (p_entry->m_inst)
+    {
+        case 0x30:
+        case 0x32:
+            // `INC` and `DEC` only update the half-carry flag for byte
+            // registers.
+            return tm_jit_flag(TM_FLAG_Z) | tm_jit_flag(TM_FLAG_N) |
+                (((p_entry->m_param1 & 0b11) >= 2) ? tm_jit_flag(TM_FLAG_H) : 0);
+        case 0x34: case 0x35: case 0x37: case 0x38:
+        case 0x3A: case 0x3B: case 0x3D: case 0x3E:
+        case 0x40: case 0x41: case 0x43: case 0x44:
+        case 0x46: case 0x47: case 0x49: case 0x4A:
+            return TM_JIT_FLAGS_ALL;
+        default:
+            return 0;
+    }
+}
+
+static void tm_jit_emit_inc_dec (tm_jit_emitter_t* p_jit, const tm_decoded_instruction_t* p_entry,
+    byte_t p_live)
+{
+    // Mirrors `tm_execute_inc` and `tm_execute_dec`, with the destination
+    // address flag clear.
+    bool l_dec = (p_entry->m_inst == 0x32);
+    byte_t l_written = tm_jit_flags_written(p_entry) & p_live;
+
+    tm_jit_read_register(p_jit, p_entry->m_param1, TM_JIT_RAX);
+    tm_jit_rr(p_jit, 0, 0x83, l_dec ? 5 : 0, TM_JIT_RAX);
+    tm_jit_byte(p_jit, 1);
+
+    tm_jit_reset_flags(p_jit, l_written, l_dec ? (l_written & tm_jit_flag(TM_FLAG_N)) : 0);
+    if (l_written & tm_jit_flag(TM_FLAG_Z))
+    {
+        tm_jit_test_width(p_jit, p_entry->m_param1, TM_JIT_RAX);
+        tm_jit_set_flag(p_jit, TM_JIT_CC_E, TM_FLAG_Z);
+    }
+    if (l_written & tm_jit_flag(TM_FLAG_H))
+    {
+        tm_jit_byte(p_jit, 0xA8);   // TEST AL, 0x0F
+        tm_jit_byte(p_jit, 0x0F);
+        tm_jit_set_flag(p_jit, TM_JIT_CC_E, TM_FLAG_H);
+    }
+
+    tm_jit_write_register(p_jit, p_entry->m_param1, TM_JIT_RAX);
+}
+
+static void tm_jit_emit_arithmetic (tm_jit_emitter_t* p_jit, const tm_decoded_instruction_t* p_entry,
+    byte_t p_live)
+{
+    // Mirrors `tm_execute_add`, `tm_execute_sub`, `tm_execute_and`,
+    // `tm_execute_or`, `tm_execute_xor` and `tm_execute_cmp`. The accumulator
+    // is loaded into `EAX` and the operand into `ECX`. The result is computed
+    // in `RDX`, which is 64 bits wide so that the carry out of a 32-bit
+    // addition with carry, and the sign of a 32-bit subtraction with carry,
+    // come out the same as in the interpreter.
+    byte_t l_inst = p_entry->m_inst;
+    byte_t l_param1 = p_entry->m_param1;
+    byte_t l_written = TM_JIT_FLAGS_ALL & p_live;
+
+    // Instructions come in pairs of an immediate form followed by a register
+    // form, starting with `ADD`.
+    bool l_immediate = ((l_inst - 0x34) % 3) == 0;
+    byte_t l_base = l_inst - (l_immediate ? 0 : 1);
+
+    tm_jit_read_register(p_jit, l_param1, TM_JIT_RAX);
+    if (l_immediate == true)
+    {
+        tm_jit_mov_imm(p_jit, TM_JIT_RCX, p_entry->m_operand);
+    }
+    else
+    {
+        tm_jit_read_register(p_jit, p_entry->m_param2, TM_JIT_RCX);
+    }
+
+    tm_jit_rr(p_jit, 0, 0x89, TM_JIT_RAX, TM_JIT_RDX);
+    switch (l_base)
+    {
+        case 0x34: case 0x37:   tm_jit_rr(p_jit, 0, 0x01, TM_JIT_RCX, TM_JIT_RDX); break;
+        case 0x3A: case 0x3D:
+        case 0x49:              tm_jit_rr(p_jit, 0, 0x29, TM_JIT_RCX, TM_JIT_RDX); break;
+        case 0x40:              tm_jit_rr(p_jit, 0, 0x21, TM_JIT_RCX, TM_JIT_RDX); break;
+        case 0x43:              tm_jit_rr(p_jit, 0, 0x09, TM_JIT_RCX, TM_JIT_RDX); break;
+        case 0x46:              tm_jit_rr(p_jit, 0, 0x31, TM_JIT_RCX, TM_JIT_RDX); break;
+    }
+
+    // Add or subtract the carry flag in 64 bits, for `ADC` and `SBC`.
+    if (l_base == 0x37 || l_base == 0x3D)
+    {
+        tm_jit_rr(p_jit, 0, 0x89, TM_JIT_RBP, TM_JIT_RSI);
+        tm_jit_shift(p_jit, 0, 5, TM_JIT_RSI, TM_FLAG_C);
+        tm_jit_imm(p_jit, 0, 4, TM_JIT_RSI, 1);
+        tm_jit_rr(p_jit, TM_JIT_WIDE, (l_base == 0x37) ? 0x01 : 0x29, TM_JIT_RSI, TM_JIT_RDX);
+    }
+
+    bool l_add = (l_base == 0x34 || l_base == 0x37);
+    bool l_sub = (l_base == 0x3A || l_base == 0x3D || l_base == 0x49);
+    uint32_t l_half_mask = 0xF;
+    byte_t l_bits = 8;
+    switch (l_param1 & 0b11)
+    {
+        case 0:     l_half_mask = 0xFFFFFFF; l_bits = 32; break;
+        case 1:     l_half_mask = 0xFFF; l_bits = 16; break;
+        default:    break;
+    }
+
+    // Constant flags: additions clear the negative and underflow flags,
+    // subtractions set the negative flag and clear the overflow flag, and
+    // bitwise operations clear everything except the zero flag, setting the
+    // half-carry flag for `AND` only.
+    byte_t l_set = 0;
+    if (l_sub == true)
+    {
+        l_set = tm_jit_flag(TM_FLAG_N);
+    }
+    else if (l_base == 0x40)
+    {
+        l_set = tm_jit_flag(TM_FLAG_H);
+    }
+    tm_jit_reset_flags(p_jit, l_written, l_set & l_written);
+
+    if (l_written & tm_jit_flag(TM_FLAG_Z))
+    {
+        tm_jit_test_width(p_jit, l_param1, TM_JIT_RDX);
+        tm_jit_set_flag(p_jit, TM_JIT_CC_E, TM_FLAG_Z);
+    }
+
+    if (l_add == true)
+    {
+        // The carry and overflow flags are set if the result does not fit in
+        // the accumulator.
+        if (l_written & (tm_jit_flag(TM_FLAG_C) | tm_jit_flag(TM_FLAG_O)))
+        {
+            tm_jit_rr(p_jit, TM_JIT_WIDE, 0x89, TM_JIT_RDX, TM_JIT_RSI);
+            tm_jit_shift(p_jit, TM_JIT_WIDE, 5, TM_JIT_RSI, l_bits);
+            tm_jit_rr(p_jit, TM_JIT_WIDE, 0x85, TM_JIT_RSI, TM_JIT_RSI);
+            if (l_written & tm_jit_flag(TM_FLAG_C)) { tm_jit_set_flag(p_jit, TM_JIT_CC_NE, TM_FLAG_C); }
+            if (l_written & tm_jit_flag(TM_FLAG_O)) { tm_jit_set_flag(p_jit, TM_JIT_CC_NE, TM_FLAG_O); }
+        }
+    }
+    else if (l_sub == true)
+    {
+        // The carry and underflow flags are set if the result is negative.
+        if (l_written & (tm_jit_flag(TM_FLAG_C) | tm_jit_flag(TM_FLAG_U)))
+        {
+            tm_jit_rr(p_jit, TM_JIT_WIDE, 0x85, TM_JIT_RDX, TM_JIT_RDX);
+            if (l_written & tm_jit_flag(TM_FLAG_C)) { tm_jit_set_flag(p_jit, TM_JIT_CC_S, TM_FLAG_C); }
+            if (l_written & tm_jit_flag(TM_FLAG_U)) { tm_jit_set_flag(p_jit, TM_JIT_CC_S, TM_FLAG_U); }
+        }
+    }
+
+    // The half-carry flag is computed from the low bits of both values,
+    // without the carry flag.
+    if ((l_add == true || l_sub == true) && (l_written & tm_jit_flag(TM_FLAG_H)))
+    {
+        tm_jit_rr(p_jit, 0, 0x89, TM_JIT_RAX, TM_JIT_RSI);
+        tm_jit_imm(p_jit, 0, 4, TM_JIT_RSI, l_half_mask);
+        tm_jit_rr(p_jit, 0, 0x89, TM_JIT_RCX, TM_JIT_RDI);
+        tm_jit_imm(p_jit, 0, 4, TM_JIT_RDI, l_half_mask);
+        if (l_add == true)
+        {
+            tm_jit_rr(p_jit, 0, 0x01, TM_JIT_RDI, TM_JIT_RSI);
+            tm_jit_imm(p_jit, 0, 7, TM_JIT_RSI, l_half_mask);
+            tm_jit_set_flag(p_jit, TM_JIT_CC_A, TM_FLAG_H);
+        }
+        else
+        {
+            tm_jit_rr(p_jit, 0, 0x39, TM_JIT_RDI, TM_JIT_RSI);
+            tm_jit_set_flag(p_jit, TM_JIT_CC_B, TM_FLAG_H);
+        }
+    }
+
+    if (l_base != 0x49)
+    {
+        tm_jit_write_register(p_jit, l_param1, TM_JIT_RDX);
+    }
+}
+
+static bool tm_jit_cycle (tm_cpu_t* p_cpu, const void* p_unused)
+{
+    // Called by compiled code for the cycle spent taking a branch.
+    (void) p_unused;
+    return tm_spend_cycles(p_cpu, 1);
+}
+
+static bool tm_jit_fetch (tm_cpu_t* p_cpu, const void* p_instruction)
+{
+    // Called by compiled code at the start of each instruction. Performs the
+    // fetch stage as `tm_replay_instruction` would, including the cycles
+    // spent reading the instruction's opcode and immediate operand.
+    const tm_decoded_instruction_t* l_entry = p_instruction;
+    p_cpu->m_registers.m_ma = l_entry->m_address;
+    p_cpu->m_registers.m_ia = l_entry->m_address;
+    p_cpu->m_registers.m_pc = l_entry->m_address;
+    if (tm_spend_cycles(p_cpu, 2) == false)
+    {
+        return false;
+    }
+
+    p_cpu->m_registers.m_pc += 2;
+    p_cpu->m_registers.m_md = l_entry->m_ci;
+    p_cpu->m_registers.m_ci = l_entry->m_ci;
+    p_cpu->m_inst           = l_entry->m_inst;
+    p_cpu->m_param1         = l_entry->m_param1;
+    p_cpu->m_param2         = l_entry->m_param2;
+    return l_entry->m_size == 2 || tm_advance_pc(p_cpu, l_entry->m_size - 2);
+}
+
+static void tm_jit_emit_branch (tm_jit_emitter_t* p_jit, const tm_decoded_instruction_t* p_entry,
+    size_t p_index)
+{
+    // Mirrors `tm_execute_jmp`, `tm_execute_jpb` and `tm_execute_jps`. The
+    // fetch stage has already pointed the program counter at the next
+    // instruction, so only a taken branch has anything left to do.
+    addr_t l_target = TM_PROGRAM_START;
+    byte_t l_condition = TM_CONDITION_N;
+    switch (p_entry->m_inst)
+    {
+        case 0x20:
+            l_target = p_entry->m_operand;
+            l_condition = p_entry->m_param1;
+            break;
+        case 0x22:
+            l_target = p_entry->m_address + p_entry->m_size + (int16_t) p_entry->m_operand;
+            l_condition = p_entry->m_param1;
+            break;
+        default:
+            break;
+    }
+
+    size_t l_skip = 0;
+    bool l_conditional = true;
+    switch (l_condition)
+    {
+        case TM_CONDITION_N:
+            l_conditional = false;
+            break;
+        case TM_CONDITION_CS:
+        case TM_CONDITION_CC:
+        case TM_CONDITION_ZS:
+        case TM_CONDITION_ZC:
+        case TM_CONDITION_OS:
+        case TM_CONDITION_US:
+            tm_jit_rr(p_jit, 0, 0xF7, 0, TM_JIT_RBP);
+            tm_jit_long(p_jit, tm_jit_flags_read(p_entry));
+            l_skip = tm_jit_jump(p_jit,
+                (l_condition == TM_CONDITION_CC || l_condition == TM_CONDITION_ZC) ?
+                    TM_JIT_CC_NE : TM_JIT_CC_E);
+            break;
+        default:
+            // Unknown conditions are never fulfilled.
+            return;
+    }
+
+    tm_jit_modrm(p_jit, 0, 0xC7, 0, TM_JIT_RBX, true, offsetof(tm_cpu_t, m_registers.m_pc));
+    tm_jit_long(p_jit, l_target);
+    tm_jit_call(p_jit, tm_jit_cycle, nullptr);
+    tm_jit_exit_if(p_jit, TM_JIT_CC_E, p_index);
+
+    if (l_conditional == true)
+    {
+        tm_jit_patch(p_jit, l_skip, p_jit->m_used);
+    }
+}
+
+/* Static Functions - JIT Compiler - Blocks ***********************************/
+
+static void tm_jit_reset (tm_cpu_t* p_cpu)
+{
+    // Discards all compiled code, once the code buffer is full.
+    for (size_t i = 0; i < TM_BLOCK_CACHE_SIZE; ++i)
+    {
+        for (tm_block_t* l_block = p_cpu->m_block_cache[i]; l_block != nullptr;
+            l_block = l_block->m_hash_next)
+        {
+            l_block->m_native[0] = nullptr;
+            l_block->m_native[1] = nullptr;
+        }
+    }
+
+    p_cpu->m_jit_used = 0;
+}
+
+static tm_jit_function tm_jit_compile (tm_cpu_t* p_cpu, tm_block_t* p_block, bool p_interruptible)
+{
+    // The `tm_jit_compile` function compiles a translated block into native
+    // code. Two variants can be compiled for each block: one for when the
+    // interrupt master flag is clear, and one for when it is set, which checks
+    // for requested interrupts after each instruction.
+
+    for (size_t i = 0; i < p_block->m_count; ++i)
+    {
+        if (tm_jit_supports(&p_block->m_instructions[i]) == false)
+        {
+            p_block->m_native_unsupported = true;
+            return nullptr;
+        }
+    }
+
+    // Work out which flags are live after each instruction - that is, read by
+    // a later instruction before being overwritten. All flags are live once
+    // the block exits, and after every instruction if interrupts can be
+    // handled in between.
+    byte_t l_live[TM_MAX_BLOCK_LENGTH];
+    byte_t l_live_after = TM_JIT_FLAGS_ALL;
+    for (size_t i = p_block->m_count; i-- > 0; )
+    {
+        const tm_decoded_instruction_t* l_entry = &p_block->m_instructions[i];
+        l_live[i] = (p_interruptible == true) ? TM_JIT_FLAGS_ALL : l_live_after;
+        l_live_after = (l_live[i] & ~tm_jit_flags_written(l_entry)) | tm_jit_flags_read(l_entry);
+    }
+
+    // Make sure the code will fit, then make the code buffer writable.
+    size_t l_size = (p_block->m_count + 2) * TM_JIT_MAX_CODE_SIZE;
+    if (p_cpu->m_jit_used + l_size > TM_JIT_BUFFER_SIZE)
+    {
+        tm_jit_reset(p_cpu);
+    }
+
+    if (mprotect(p_cpu->m_jit_code, TM_JIT_BUFFER_SIZE, PROT_READ | PROT_WRITE) != 0)
+    {
+        p_cpu->m_jit_enabled = false;
+        return nullptr;
+    }
+
+    tm_jit_emitter_t l_jit = { .m_code = p_cpu->m_jit_code + p_cpu->m_jit_used };
+
+    // Prologue: save the registers used by the block, keeping the stack
+    // aligned for calls, then load the guest registers and flags.
+    tm_jit_push(&l_jit, TM_JIT_RBX);
+    tm_jit_push(&l_jit, TM_JIT_RBP);
+    tm_jit_push(&l_jit, TM_JIT_R12);
+    tm_jit_push(&l_jit, TM_JIT_R13);
+    tm_jit_push(&l_jit, TM_JIT_R14);
+    tm_jit_push(&l_jit, TM_JIT_R15);
+    tm_jit_rr(&l_jit, TM_JIT_WIDE, 0x83, 5, TM_JIT_RSP);
+    tm_jit_byte(&l_jit, 8);
+    tm_jit_rr(&l_jit, TM_JIT_WIDE, 0x89, TM_JIT_RDI, TM_JIT_RBX);
+    tm_jit_mem(&l_jit, 0, 0x8B, TM_JIT_R12, offsetof(tm_cpu_t, m_registers.m_a));
+    tm_jit_mem(&l_jit, 0, 0x8B, TM_JIT_R13, offsetof(tm_cpu_t, m_registers.m_b));
+    tm_jit_mem(&l_jit, 0, 0x8B, TM_JIT_R14, offsetof(tm_cpu_t, m_registers.m_c));
+    tm_jit_mem(&l_jit, 0, 0x8B, TM_JIT_R15, offsetof(tm_cpu_t, m_registers.m_d));
+    tm_jit_mem(&l_jit, 0, 0x0FB6, TM_JIT_RBP, offsetof(tm_cpu_t, m_flags));
+
+    for (size_t i = 0; i < p_block->m_count; ++i)
+    {
+        const tm_decoded_instruction_t* l_entry = &p_block->m_instructions[i];
+
+        tm_jit_call(&l_jit, tm_jit_fetch, l_entry);
+        tm_jit_exit_if(&l_jit, TM_JIT_CC_E, i);
+
+        switch (l_entry->m_inst)
+        {
+            case 0x00:
+                break;
+            case 0x10:
+                tm_jit_mov_imm(&l_jit, TM_JIT_RAX, l_entry->m_operand);
+                tm_jit_write_register(&l_jit, l_entry->m_param1, TM_JIT_RAX);
+                break;
+            case 0x1D:
+                tm_jit_read_register(&l_jit, l_entry->m_param2, TM_JIT_RAX);
+                tm_jit_write_register(&l_jit, l_entry->m_param1, TM_JIT_RAX);
+                break;
+            case 0x20:
+            case 0x22:
+            case 0x27:
+            case 0xFF:
+                tm_jit_emit_branch(&l_jit, l_entry, i);
+                break;
+            case 0x30:
+            case 0x32:
+                tm_jit_emit_inc_dec(&l_jit, l_entry, l_live[i]);
+                break;
+            default:
+                tm_jit_emit_arithmetic(&l_jit, l_entry, l_live[i]);
+                break;
+        }
+
+        // Leave the block after any instruction which left an enabled
+        // interrupt requested, so it can be handled before the next one.
+        if (p_interruptible == true && i + 1 < p_block->m_count)
+        {
+            tm_jit_mem(&l_jit, 0, 0x0FB7, TM_JIT_RAX, offsetof(tm_cpu_t, m_interrupts));
+            tm_jit_mem(&l_jit, TM_JIT_WORD, 0x85, TM_JIT_RAX, offsetof(tm_cpu_t, m_interrupts));
+            tm_jit_exit_if(&l_jit, TM_JIT_CC_NE, i + 1);
+        }
+    }
+
+    // Epilogue: report the whole block as executed, then write the guest
+    // registers back. Only the low six bits of the flags register belong to
+    // the block; the halt and stop flags may have been changed by the calls
+    // made from within it.
+    tm_jit_mov_imm(&l_jit, TM_JIT_RAX, p_block->m_count);
+    for (size_t i = 0; i < l_jit.m_exit_count; ++i)
+    {
+        tm_jit_patch(&l_jit, l_jit.m_exits[i], l_jit.m_used);
+    }
+
+    tm_jit_mem(&l_jit, 0, 0x89, TM_JIT_R12, offsetof(tm_cpu_t, m_registers.m_a));
+    tm_jit_mem(&l_jit, 0, 0x89, TM_JIT_R13, offsetof(tm_cpu_t, m_registers.m_b));
+    tm_jit_mem(&l_jit, 0, 0x89, TM_JIT_R14, offsetof(tm_cpu_t, m_registers.m_c));
+    tm_jit_mem(&l_jit, 0, 0x89, TM_JIT_R15, offsetof(tm_cpu_t, m_registers.m_d));
+    tm_jit_mem(&l_jit, 0, 0x0FB6, TM_JIT_RCX, offsetof(tm_cpu_t, m_flags));
+    tm_jit_imm(&l_jit, 0, 4, TM_JIT_RCX, 0xC0);
+    tm_jit_imm(&l_jit, 0, 4, TM_JIT_RBP, TM_JIT_FLAGS_ALL);
+    tm_jit_rr(&l_jit, 0, 0x09, TM_JIT_RBP, TM_JIT_RCX);
+    tm_jit_mem(&l_jit, 0, 0x88, TM_JIT_RCX, offsetof(tm_cpu_t, m_flags));
+    tm_jit_rr(&l_jit, TM_JIT_WIDE, 0x83, 0, TM_JIT_RSP);
+    tm_jit_byte(&l_jit, 8);
+    tm_jit_pop(&l_jit, TM_JIT_R15);
+    tm_jit_pop(&l_jit, TM_JIT_R14);
+    tm_jit_pop(&l_jit, TM_JIT_R13);
+    tm_jit_pop(&l_jit, TM_JIT_R12);
+    tm_jit_pop(&l_jit, TM_JIT_RBP);
+    tm_jit_pop(&l_jit, TM_JIT_RBX);
+    tm_jit_byte(&l_jit, 0xC3);
+    tm_assert(l_jit.m_used <= l_size);
+
+    if (mprotect(p_cpu->m_jit_code, TM_JIT_BUFFER_SIZE, PROT_READ | PROT_EXEC) != 0)
+    {
+        p_cpu->m_jit_enabled = false;
+        return nullptr;
+    }
+
+    tm_jit_function l_function = (tm_jit_function) l_jit.m_code;
+    p_cpu->m_jit_used += l_jit.m_used;
+    p_block->m_native[p_interruptible] = l_function;
+    return l_function;
+}
+
+#endif
+
+static bool tm_run_block (tm_cpu_t* p_cpu, tm_block_t* p_block, size_t* p_steps)
+{
+    // Runs a translated block through the JIT compiler if it is enabled and
+    // the block is hot enough, and through the interpreter otherwise. The
+    // number of steps executed is added to `p_steps`. Returns false if an
+    // instruction failed.
+    //
+    // Compiled code does not implement the destination address flag or the
+    // delayed effect of `EI`, so blocks entered with either pending are always
+    // interpreted.
+    #if defined(TM_JIT)
+        if (
+            p_cpu->m_jit_enabled == true &&
+            p_block->m_native_unsupported == false &&
+            p_cpu->m_da == false &&
+            p_cpu->m_enable_ime == false
+        )
+        {
+            tm_jit_function l_native = p_block->m_native[p_cpu->m_ime];
+            if (l_native == nullptr && ++p_block->m_executions >= TM_JIT_THRESHOLD)
+            {
+                l_native = tm_jit_compile(p_cpu, p_block, p_cpu->m_ime);
+            }
+
+            if (l_native != nullptr)
+            {
+                // Compiled blocks keep the flags in a host register, so they
+                // start from an up-to-date flags register. They also leave it
+                // to the caller to handle interrupts requested during their
+                // last instruction. Compiled code only fails by stopping the
+                // CPU with an error.
+                tm_get_flags(p_cpu);
+                *p_steps += l_native(p_cpu);
+                if (p_cpu->m_flags.m_stop == true)
+                {
+                    return false;
+                }
+
+                tm_finish_step(p_cpu);
+                return true;
+            }
+        }
+    #endif
+
+    return tm_execute_block(p_cpu, p_block, p_steps);
+}
+
+/* Static Functions - Page Table **********************************************/
+
+// The address space is split into pages of `TM_PAGE_SIZE` bytes, found through
+// a two-level page table: the top ten bits of an address select one of the
+// CPU's page tables, and the next ten a page within it. Each page records the
+// accesses the guest's instructions may make to it, which is all the bounds
+// checks have to look at, and what backs it on the bus - host memory, the
+// handlers of a region mapped by the host, or the callbacks.
+//
+// Without a program mapped, every page is left to the callbacks. With one
+// mapped, ROM is borrowed from the program, while RAM, the stacks and QRAM are
+// backed by memory the CPU allocates, one page at a time as they are first
+// accessed. Only the IO port registers, in the last 256 bytes of the last
+// page, always go through the callbacks.
+//
+// Most tables look the same on every CPU with the same memory map, so they
+// start out pointing to one of a few templates, and are only copied once one
+// of their pages has to change.
+//
+// A CPU forked from another starts out sharing the memory the other allocated,
+// with both CPUs' pages marked as shared. Whichever writes to such a page
+// first copies it, unless the other has already let go of it.
+
+static tm_page_t tm_default_page (const tm_cpu_t* p_cpu, addr_t p_address, bool p_rom)
+{
+    // Returns the page at `p_address` as laid out by the memory map. Pages in
+    // ROM are only backed by the program's ROM if `p_rom` is set, so that the
+    // templates can be shared by the tables the program does not reach.
+    tm_page_t l_page = { .m_limit = TM_PAGE_SIZE };
+    if (p_address >= TM_QRAM_START)
+    {
+        l_page.m_access = TM_ACCESS_READ | TM_ACCESS_WRITE;
+    }
+    else if (p_address >= TM_STACK_START)
+    {
+        l_page.m_access = 0;
+    }
+    else if (p_address >= TM_XRAM_START)
+    {
+        l_page.m_access = TM_ACCESS_READ | TM_ACCESS_WRITE | TM_ACCESS_EXECUTE;
+    }
+    else if (p_address >= TM_RAM_START)
+    {
+        l_page.m_access = TM_ACCESS_READ | TM_ACCESS_WRITE;
+    }
+    else if (p_address >= TM_RST_START)
+    {
+        // Program code, and the restart and interrupt vector subroutines
+        // before it, are readable and executable, but not writable. Code has
+        // to be readable, as immediate operands are fetched with read checks.
+        // The metadata before the vectors cannot be accessed at all.
+        l_page.m_access = TM_ACCESS_READ | TM_ACCESS_EXECUTE;
+    }
+
+    if (p_cpu->m_program == nullptr)
+    {
+        return l_page;
+    }
+
+    if (p_address >= TM_RAM_START)
+    {
+        l_page.m_flags = TM_PAGE_BUILT_IN;
+        if ((p_address >> TM_PAGE_SHIFT) == (TM_IO_START >> TM_PAGE_SHIFT))
+        {
+            l_page.m_limit = TM_IO_START & (TM_PAGE_SIZE - 1);
+        }
+    }
+    else if (p_rom == true && p_address < p_cpu->m_program->m_rom_size)
+    {
+        size_t l_remaining = p_cpu->m_program->m_rom_size - p_address;
+        l_page.m_host   = p_cpu->m_program->m_rom + p_address;
+        l_page.m_limit  = (l_remaining < TM_PAGE_SIZE) ? l_remaining : TM_PAGE_SIZE;
+        l_page.m_flags  = TM_PAGE_READ_ONLY;
+    }
+
+    return l_page;
+}
+
+static enum_t tm_get_page_template (size_t p_table)
+{
+    addr_t l_address = (addr_t) p_table << TM_PAGE_TABLE_SHIFT;
+    if (p_table == TM_PAGE_TABLE_COUNT - 1)     { return TM_PAGES_TOP; }
+    else if (l_address >= TM_XRAM_START)        { return TM_PAGES_XRAM; }
+    else if (l_address >= TM_RAM_START)         { return TM_PAGES_RAM; }
+    else if (p_table == 0)                      { return TM_PAGES_LOW; }
+    else                                        { return TM_PAGES_ROM; }
+}
+
+static inline bool tm_is_page_template (const tm_cpu_t* p_cpu, const tm_page_t* p_table)
+{
+    return
+        p_table >= p_cpu->m_page_templates &&
+        p_table < p_cpu->m_page_templates + TM_PAGE_TEMPLATE_COUNT * TM_PAGES_PER_TABLE;
+}
+
+static byte_t* tm_allocate_page_memory ()
+{
+    // The memory the CPU allocates for a page is reference counted, so that
+    // forked CPUs can share it until one of them writes to it. The pages
+    // themselves only point to its bytes.
+    tm_page_memory_t* l_memory = tm_calloc(1, tm_page_memory_t);
+    tm_expect_p(l_memory, "tm: could not allocate cpu memory");
+
+    atomic_init(&l_memory->m_references, 1);
+    return l_memory->m_bytes;
+}
+
+static inline tm_page_memory_t* tm_get_page_memory (byte_t* p_host)
+{
+    return (tm_page_memory_t*) (p_host - offsetof(tm_page_memory_t, m_bytes));
+}
+
+static void tm_release_page_memory (byte_t* p_host)
+{
+    // Forked CPUs may run on other threads, so the last one to let go of the
+    // memory frees it.
+    if (
+        p_host != nullptr &&
+        atomic_fetch_sub_explicit(&tm_get_page_memory(p_host)->m_references, 1,
+            memory_order_acq_rel) == 1
+    )
+    {
+        free(tm_get_page_memory(p_host));
+    }
+}
+
+static void tm_free_page_tables (tm_cpu_t* p_cpu)
+{
+    // Frees every table which no longer points to its template, along with
+    // the memory the CPU allocated for its pages.
+    for (size_t i = 0; i < TM_PAGE_TABLE_COUNT; ++i)
+    {
+        tm_page_t* l_table = p_cpu->m_pages[i];
+        if (l_table == nullptr || tm_is_page_template(p_cpu, l_table) == true)
+        {
+            continue;
+        }
+
+        for (size_t j = 0; j < TM_PAGES_PER_TABLE; ++j)
+        {
+            if ((l_table[j].m_flags & TM_PAGE_BUILT_IN) != 0)
+            {
+                tm_release_page_memory(l_table[j].m_host);
+            }
+        }
+
+        tm_free(p_cpu->m_pages[i]);
+    }
+}
+
+static tm_page_t* tm_own_page (tm_cpu_t* p_cpu, addr_t p_address)
+{
+    // Returns the page at `p_address`, first copying its table if it still
+    // points to its template.
+    size_t l_index = p_address >> TM_PAGE_TABLE_SHIFT;
+    if (tm_is_page_template(p_cpu, p_cpu->m_pages[l_index]) == true)
+    {
+        tm_page_t* l_table = tm_calloc(TM_PAGES_PER_TABLE, tm_page_t);
+        tm_expect_p(l_table, "tm: could not allocate cpu page table");
+
+        memcpy(l_table, p_cpu->m_pages[l_index], TM_PAGES_PER_TABLE * sizeof(tm_page_t));
+        p_cpu->m_pages[l_index] = l_table;
+    }
+
+    return &p_cpu->m_pages[l_index][(p_address >> TM_PAGE_SHIFT) & (TM_PAGES_PER_TABLE - 1)];
+}
+
+static void tm_set_page (tm_cpu_t* p_cpu, addr_t p_address, tm_page_t p_page)
+{
+    // Whatever the CPU allocated for the page before is lost.
+    tm_page_t* l_page = tm_own_page(p_cpu, p_address);
+    if ((l_page->m_flags & TM_PAGE_BUILT_IN) != 0)
+    {
+        tm_release_page_memory(l_page->m_host);
+    }
+
+    *l_page = p_page;
+}
+
+static tm_page_t* tm_unshare_page (tm_cpu_t* p_cpu, addr_t p_address)
+{
+    // Gives the page at `p_address` memory of its own before it is written
+    // to, unless every other CPU sharing its memory has done so already.
+    tm_page_t* l_page = tm_own_page(p_cpu, p_address);
+    if (atomic_load_explicit(&tm_get_page_memory(l_page->m_host)->m_references,
+        memory_order_acquire) > 1)
+    {
+        byte_t* l_host = tm_allocate_page_memory();
+        memcpy(l_host, l_page->m_host, TM_PAGE_SIZE);
+        tm_release_page_memory(l_page->m_host);
+        l_page->m_host = l_host;
+    }
+
+    l_page->m_flags &= ~TM_PAGE_SHARED;
+    return l_page;
+}
+
+static void tm_reset_pages (tm_cpu_t* p_cpu)
+{
+    // Lays the pages out as the memory map and the mapped program have them,
+    // dropping every region the host has mapped.
+    tm_free_page_tables(p_cpu);
+
+    static const size_t s_template_tables[TM_PAGE_TEMPLATE_COUNT] =
+    {
+        [TM_PAGES_LOW]  = 0,
+        [TM_PAGES_ROM]  = 1,
+        [TM_PAGES_RAM]  = TM_RAM_START >> TM_PAGE_TABLE_SHIFT,
+        [TM_PAGES_XRAM] = TM_XRAM_START >> TM_PAGE_TABLE_SHIFT,
+        [TM_PAGES_TOP]  = TM_PAGE_TABLE_COUNT - 1,
+    };
+
+    for (size_t i = 0; i < TM_PAGE_TEMPLATE_COUNT; ++i)
+    {
+        tm_page_t* l_template = p_cpu->m_page_templates + i * TM_PAGES_PER_TABLE;
+        for (size_t j = 0; j < TM_PAGES_PER_TABLE; ++j)
+        {
+            l_template[j] = tm_default_page(p_cpu,
+                (s_template_tables[i] << TM_PAGE_TABLE_SHIFT) | (j << TM_PAGE_SHIFT), false);
+        }
+    }
+
+    for (size_t i = 0; i < TM_PAGE_TABLE_COUNT; ++i)
+    {
+        p_cpu->m_pages[i] = p_cpu->m_page_templates +
+            tm_get_page_template(i) * TM_PAGES_PER_TABLE;
+    }
+
+    if (p_cpu->m_program != nullptr)
+    {
+        size_t l_rom_size = p_cpu->m_program->m_rom_size;
+        if (l_rom_size > TM_ROM_SIZE)
+        {
+            l_rom_size = TM_ROM_SIZE;
+        }
+
+        for (size_t l_address = 0; l_address < l_rom_size; l_address += TM_PAGE_SIZE)
+        {
+            tm_set_page(p_cpu, l_address, tm_default_page(p_cpu, l_address, true));
+        }
+    }
+}
+
+static void tm_apply_region (tm_cpu_t* p_cpu, const tm_region_t* p_region, uint64_t p_start,
+    uint64_t p_end)
+{
+    // Maps the pages of `p_region` which fall between `p_start` and `p_end`.
+    uint64_t l_start = (p_region->m_start > p_start) ? p_region->m_start : p_start;
+    uint64_t l_end = (uint64_t) p_region->m_start + p_region->m_size;
+    if (l_end > p_end)
+    {
+        l_end = p_end;
+    }
+
+    for (uint64_t l_address = l_start; l_address < l_end; l_address += TM_PAGE_SIZE)
+    {
+        size_t l_offset = l_address - p_region->m_start;
+        tm_page_t l_page = { .m_limit = TM_PAGE_SIZE, .m_access = p_region->m_access };
+        if (p_region->m_host != nullptr)
+        {
+            l_page.m_host = p_region->m_host + l_offset;
+        }
+        else
+        {
+            l_page.m_region = p_region;
+            l_page.m_flags  = TM_PAGE_REGION;
+        }
+
+        tm_set_page(p_cpu, l_address, l_page);
+    }
+}
+
+static inline byte_t* tm_map_host (tm_cpu_t* p_cpu, addr_t p_address, size_t p_size, bool p_write,
+    byte_t p_unmapped)
+{
+    // Returns a pointer to the host memory backing `p_size` bytes starting at
+    // `p_address`, or `nullptr` if the access has to go through a region's
+    // handlers or the host's callbacks instead, or if the page has any of the
+    // flags in `p_unmapped`.
+    tm_page_t* l_page = tm_find_page(p_cpu, p_address);
+    long_t l_offset = p_address & (TM_PAGE_SIZE - 1);
+    byte_t l_unmapped = p_unmapped | TM_PAGE_REGION | ((p_write == true) ? TM_PAGE_READ_ONLY : 0);
+    if (l_offset + p_size > l_page->m_limit || (l_page->m_flags & l_unmapped) != 0)
+    {
+        return nullptr;
+    }
+
+    if (l_page->m_host == nullptr)
+    {
+        if ((l_page->m_flags & TM_PAGE_BUILT_IN) == 0)
+        {
+            return nullptr;
+        }
+
+        l_page = tm_own_page(p_cpu, p_address);
+        l_page->m_host = tm_allocate_page_memory();
+    }
+    else if (p_write == true && (l_page->m_flags & TM_PAGE_SHARED) != 0)
+    {
+        l_page = tm_unshare_page(p_cpu, p_address);
+    }
+
+    return l_page->m_host + l_offset;
+}
+
+static inline byte_t* tm_map_address (tm_cpu_t* p_cpu, addr_t p_address, size_t p_size, bool p_write)
+{
+    // Watched pages are left to the slower accesses below, which check the
+    // watchpoints, so the accesses to the rest of memory never have to.
+    return tm_map_host(p_cpu, p_address, p_size, p_write, TM_PAGE_WATCHED);
+}
+
+static inline bool tm_read_bus (tm_cpu_t* p_cpu, tm_bus_read_ctx p_read, void* p_user_data,
+    addr_t p_address, long_t* p_value)
+{
+    // Values read through the callbacks during a step come from outside the
+    // CPU's state, so they are logged while recording, and taken from the log
+    // while replaying.
+    if (p_cpu->m_replay != nullptr && p_cpu->m_replay->m_in_step == true)
+    {
+        return tm_record_read(p_cpu, p_read, p_user_data, p_address, p_value);
+    }
+
+    return p_read(p_user_data, p_address, p_value);
+}
+
+static inline bool tm_write_bus (tm_cpu_t* p_cpu, tm_bus_write_ctx p_write, void* p_user_data,
+    addr_t p_address, long_t p_value)
+{
+    // Whether a write through the callbacks succeeded is up to the host, so
+    // it is logged while recording. Steps being replayed have had their
+    // effects on the host already, so their writes are dropped, and succeed
+    // or fail as they did while recording.
+    if (p_cpu->m_replay != nullptr && p_cpu->m_replay->m_in_step == true)
+    {
+        return tm_record_write(p_cpu, p_write, p_user_data, p_address, p_value);
+    }
+
+    return p_write(p_user_data, p_address, p_value);
+}
+
+static inline bool tm_load_byte (tm_cpu_t* p_cpu, addr_t p_address, long_t* p_value)
+{
+    // Watched pages are backed by host memory all the same.
+    const byte_t* l_host = tm_map_host(p_cpu, p_address, 1, false, 0);
+    if (l_host != nullptr)
+    {
+        *p_value = *l_host;
+        return true;
+    }
+
+    const tm_page_t* l_page = tm_find_page(p_cpu, p_address);
+    if ((l_page->m_flags & TM_PAGE_REGION) != 0)
+    {
+        return tm_read_bus(p_cpu, l_page->m_region->m_read, l_page->m_region->m_user_data,
+            p_address, p_value);
+    }
+
+    return tm_read_bus(p_cpu, p_cpu->m_read, p_cpu->m_user_data, p_address, p_value);
+}
+
+static inline bool tm_store_byte (tm_cpu_t* p_cpu, addr_t p_address, long_t p_value)
+{
+    byte_t* l_host = tm_map_host(p_cpu, p_address, 1, true, 0);
+    if (l_host != nullptr)
+    {
+        *l_host = p_value & 0xFF;
+        return true;
+    }
+
+    const tm_page_t* l_page = tm_find_page(p_cpu, p_address);
+    if ((l_page->m_flags & TM_PAGE_REGION) != 0)
+    {
+        return tm_write_bus(p_cpu, l_page->m_region->m_write, l_page->m_region->m_user_data,
+            p_address, p_value);
+    }
+
+    return tm_write_bus(p_cpu, p_cpu->m_write, p_cpu->m_user_data, p_address, p_value);
+}
+
+static inline bool tm_is_bus_access (tm_cpu_t* p_cpu, addr_t p_address, size_t p_size, bool p_write)
+{
+    // Returns true if every byte of the `p_size`-byte access at `p_address`
+    // would be passed to the host's callbacks, in which case the access may be
+    // made with a single call to one of the wide callbacks instead.
+    const tm_page_t* l_page = tm_find_page(p_cpu, p_address);
+    long_t l_offset = p_address & (TM_PAGE_SIZE - 1);
+    if (l_offset + p_size > TM_PAGE_SIZE || (l_page->m_flags & TM_PAGE_REGION) != 0)
+    {
+        return false;
+    }
+
+    if (p_write == true && (l_page->m_flags & TM_PAGE_READ_ONLY) != 0)
+    {
+        return true;
+    }
+
+    return
+        l_offset >= l_page->m_limit ||
+        (l_page->m_host == nullptr && (l_page->m_flags & TM_PAGE_BUILT_IN) == 0);
+}
+
+static inline bool tm_prepare_bus_access (tm_cpu_t* p_cpu, addr_t p_address, size_t p_size)
+{
+    // Devices may depend on the time, so bring the host up to date before it
+    // sees an access to the IO port registers or to a region mapped with
+    // handlers. Returns false if the host's batch callback failed, in which
+    // case the access must not be made.
+    if (p_cpu->m_pending_cycles == 0)
+    {
+        return true;
+    }
+
+    if (
+        (size_t) p_address + p_size > TM_IO_START ||
+        (tm_find_page(p_cpu, p_address)->m_flags & TM_PAGE_REGION) != 0 ||
+        (tm_find_page(p_cpu, p_address + p_size - 1)->m_flags & TM_PAGE_REGION) != 0
+    )
+    {
+        return tm_deliver_cycles(p_cpu);
+    }
+
+    return true;
+}
+
+/* Static Functions - Event Scheduler *****************************************/
+
+// Scheduled events are kept in a binary min-heap, ordered by the cycle count at
+// which they are due, then by the order they were scheduled in. The cycle count
+// of the earliest is cached in `m_next_event`, for `tm_spend_cycles` to compare
+// against, so that nothing else has to be done until an event is due.
+
+static inline bool tm_event_precedes (const tm_event_t* p_left, const tm_event_t* p_right)
+{
+    return
+        p_left->m_cycle < p_right->m_cycle ||
+        (p_left->m_cycle == p_right->m_cycle && p_left->m_id < p_right->m_id);
+}
+
+static void tm_sift_event (tm_cpu_t* p_cpu, size_t p_index)
+{
+    // Moves the event at `p_index` up or down the heap, to where it belongs.
+    tm_event_t* l_events = p_cpu->m_events;
+    tm_event_t l_event = l_events[p_index];
+
+    while (p_index > 0 && tm_event_precedes(&l_event, &l_events[(p_index - 1) / 2]) == true)
+    {
+        l_events[p_index] = l_events[(p_index - 1) / 2];
+        p_index = (p_index - 1) / 2;
+    }
+
+    while (true)
+    {
+        size_t l_child = p_index * 2 + 1;
+        if (l_child >= p_cpu->m_event_count)
+        {
+            break;
+        }
+
+        if (
+            l_child + 1 < p_cpu->m_event_count &&
+            tm_event_precedes(&l_events[l_child + 1], &l_events[l_child]) == true
+        )
+        {
+            l_child++;
+        }
+
+        if (tm_event_precedes(&l_events[l_child], &l_event) == false)
+        {
+            break;
+        }
+
+        l_events[p_index] = l_events[l_child];
+        p_index = l_child;
+    }
+
+    l_events[p_index] = l_event;
+}
+
+static void tm_remove_event (tm_cpu_t* p_cpu, size_t p_index)
+{
+    p_cpu->m_event_count--;
+    if (p_index < p_cpu->m_event_count)
+    {
+        p_cpu->m_events[p_index] = p_cpu->m_events[p_cpu->m_event_count];
+        tm_sift_event(p_cpu, p_index);
+    }
+
+    p_cpu->m_next_event = (p_cpu->m_event_count > 0) ? p_cpu->m_events[0].m_cycle : UINT64_MAX;
+}
+
+static bool tm_fire_events (tm_cpu_t* p_cpu)
+{
+    // The host is brought up to date before any of its events are handled.
+    if (p_cpu->m_cycles != nullptr && tm_deliver_cycles(p_cpu) == false)
+    {
+        return false;
+    }
+
+    // Events are removed before they are handled, so that their handlers may
+    // schedule them again.
+    while (p_cpu->m_event_count > 0 && p_cpu->m_events[0].m_cycle <= p_cpu->m_cycle_count)
+    {
+        tm_event_t l_event = p_cpu->m_events[0];
+        tm_remove_event(p_cpu, 0);
+        if (l_event.m_handler(p_cpu, l_event.m_user_data, l_event.m_cycle) == false)
+        {
+            return tm_set_error(p_cpu, TM_ERROR_HARDWARE);
+        }
+    }
+
+    return true;
+}
+
+static bool tm_raise_interrupt (tm_cpu_t* p_cpu, void* p_user_data, uint64_t p_cycle)
+{
+    (void) p_cycle;
+    tm_request_interrupt(p_cpu, (byte_t) (uintptr_t) p_user_data);
+    return true;
+}
+
+/* Static Functions - Saved State *********************************************/
+
+// A saved state is a flat run of values, each stored most significant byte
+// first, like the values the CPU reads and writes:
+//
+// -    The bytes `TMST`, then `TM_STATE_VERSION`, as a byte.
+// -    The registers `A`, `B`, `C`, `D`, `PC`, `EA`, `IA`, `MA`, `MD`, `SP` and
+//      `RP`, as longs, then `CI`, `IE` and `IF`, as words, then `EC`.
+// -    The flags register, the `IME` flag, whether `IME` is about to be set,
+//      and the destination address flag, as a byte each.
+// -    The cycle count, in eight bytes.
+// -    The number of pages of built-in memory which follow, as a long. Each of
+//      them is stored as its address, as a long, followed by its bytes. Pages
+//      the guest has not written anything but zeroes to are left out.
+
+#define TM_STATE_FIXED_SIZE         (5 + 11 * 4 + 3 * 2 + 1 + 4 + 8 + 4)
+#define TM_STATE_PAGE_SIZE          (4 + TM_PAGE_SIZE)
+
+static const byte_t s_zero_page[TM_PAGE_SIZE];
+
+static inline byte_t* tm_put_state (byte_t* p_cursor, uint64_t p_value, size_t p_bytes)
+{
+    for (size_t i = 0; i < p_bytes; ++i)
+    {
+        p_cursor[i] = (p_value >> ((p_bytes - i - 1) * 8)) & 0xFF;
+    }
+
+    return p_cursor + p_bytes;
+}
+
+static inline uint64_t tm_get_state (const byte_t** p_cursor, size_t p_bytes)
+{
+    uint64_t l_value = 0;
+    for (size_t i = 0; i < p_bytes; ++i)
+    {
+        l_value = (l_value << 8) | (*p_cursor)[i];
+    }
+
+    *p_cursor += p_bytes;
+    return l_value;
+}
+
+static tm_page_t* tm_find_saved_page (tm_cpu_t* p_cpu, size_t p_table, size_t p_page)
+{
+    // Returns the page of built-in memory at the given position in the page
+    // tables if it has been allocated, or `nullptr` if it hasn't, or is not
+    // built-in memory at all. Tables still pointing to their templates have
+    // no memory allocated.
+    tm_page_t* l_table = p_cpu->m_pages[p_table];
+    if (tm_is_page_template(p_cpu, l_table) == true)
+    {
+        return nullptr;
+    }
+
+    tm_page_t* l_page = &l_table[p_page];
+    return ((l_page->m_flags & TM_PAGE_BUILT_IN) != 0 && l_page->m_host != nullptr) ?
+        l_page : nullptr;
+}
+
+static inline addr_t tm_get_page_address (size_t p_table, size_t p_page)
+{
+    return ((addr_t) p_table << TM_PAGE_TABLE_SHIFT) | ((addr_t) p_page << TM_PAGE_SHIFT);
+}
+
+/* Static Functions - Profiler ************************************************/
+
+// While the profiler is enabled, every instruction is executed by
+// `tm_step_cpu`, which counts it, and the cycles it took, against its address.
+// The calling context is followed by watching the depth of the call stack: a
+// deeper stack means that the instruction just executed called the routine at
+// the program counter, or that an interrupt did, and a shallower one that it
+// returned. Any instructions in between are counted against that routine in
+// that context, too.
+
+static inline size_t tm_hash_profile (uint64_t p_key, size_t p_count)
+{
+    return (size_t) ((p_key * 0x9E3779B97F4A7C15ull) >> 32) & (p_count - 1);
+}
+
+static tm_profile_t* tm_create_profile (tm_cpu_t* p_cpu)
+{
+    tm_profile_t* l_profile = tm_calloc(1, tm_profile_t);
+    tm_expect_p(l_profile != nullptr, "tm: could not allocate cpu profile");
+
+    l_profile->m_slot_count = TM_PROFILE_TABLE_SIZE;
+    l_profile->m_slots = tm_calloc(l_profile->m_slot_count, tm_profile_slot_t);
+    tm_expect_p(l_profile->m_slots != nullptr, "tm: could not allocate cpu profile entries");
+
+    l_profile->m_child_count = TM_PROFILE_TABLE_SIZE;
+    l_profile->m_children = tm_calloc(l_profile->m_child_count, size_t);
+    tm_expect_p(l_profile->m_children != nullptr, "tm: could not allocate cpu profile frames");
+
+    l_profile->m_frame_capacity = TM_PROFILE_TABLE_SIZE / 2;
+    l_profile->m_frames = tm_calloc(l_profile->m_frame_capacity, tm_profile_frame_t);
+    tm_expect_p(l_profile->m_frames != nullptr, "tm: could not allocate cpu profile frames");
+
+    l_profile->m_stack_capacity = 64;
+    l_profile->m_stack = tm_calloc(l_profile->m_stack_capacity, size_t);
+    tm_expect_p(l_profile->m_stack != nullptr, "tm: could not allocate cpu profile call stack");
+
+    // The root frame stands for wherever the CPU was when profiling started.
+    l_profile->m_frames[0].m_address = p_cpu->m_registers.m_pc;
+    l_profile->m_frame_count = 1;
+    l_profile->m_base_rp = p_cpu->m_registers.m_rp;
+    l_profile->m_rp = p_cpu->m_registers.m_rp;
+    return l_profile;
+}
+
+static void tm_destroy_profile (tm_profile_t* p_profile)
+{
+    if (p_profile != nullptr)
+    {
+        tm_free(p_profile->m_slots);
+        tm_free(p_profile->m_children);
+        tm_free(p_profile->m_frames);
+        tm_free(p_profile->m_stack);
+        tm_free(p_profile);
+    }
+}
+
+static tm_profile_entry_t* tm_add_profile_entry (tm_profile_t* p_profile, addr_t p_address)
+{
+    // Adds an entry for an address which has none yet. The table is kept at
+    // most half full, so that probe sequences stay short.
+    if ((p_profile->m_used_count + 1) * 2 > p_profile->m_slot_count)
+    {
+        tm_profile_slot_t* l_old = p_profile->m_slots;
+        size_t l_old_count = p_profile->m_slot_count;
+        p_profile->m_slot_count *= 2;
+        p_profile->m_slots = tm_calloc(p_profile->m_slot_count, tm_profile_slot_t);
+        tm_expect_p(p_profile->m_slots != nullptr, "tm: could not allocate cpu profile entries");
+
+        for (size_t i = 0; i < l_old_count; ++i)
+        {
+            if (l_old[i].m_used == true)
+            {
+                size_t j = tm_hash_profile(l_old[i].m_entry.m_address, p_profile->m_slot_count);
+                while (p_profile->m_slots[j].m_used == true)
+                {
+                    j = (j + 1) & (p_profile->m_slot_count - 1);
+                }
+
+                p_profile->m_slots[j] = l_old[i];
+            }
+        }
+
+        tm_free(l_old);
+    }
+
+    size_t i = tm_hash_profile(p_address, p_profile->m_slot_count);
+    while (p_profile->m_slots[i].m_used == true)
+    {
+        i = (i + 1) & (p_profile->m_slot_count - 1);
+    }
+
+    tm_profile_slot_t* l_slot = &p_profile->m_slots[i];
+    l_slot->m_used = true;
+    l_slot->m_entry.m_address = p_address;
+    p_profile->m_used_count++;
+    return &l_slot->m_entry;
+}
+
+static inline tm_profile_entry_t* tm_find_profile_entry (tm_profile_t* p_profile, addr_t p_address)
+{
+    // Finds the entry for an address, adding one if there is none yet.
+    size_t l_mask = p_profile->m_slot_count - 1;
+    for (size_t i = tm_hash_profile(p_address, p_profile->m_slot_count);; i = (i + 1) & l_mask)
+    {
+        tm_profile_slot_t* l_slot = &p_profile->m_slots[i];
+        if (l_slot->m_used == false)
+        {
+            return tm_add_profile_entry(p_profile, p_address);
+        }
+        else if (l_slot->m_entry.m_address == p_address)
+        {
+            return &l_slot->m_entry;
+        }
+    }
+}
+
+static size_t tm_find_profile_frame (tm_profile_t* p_profile, size_t p_parent, addr_t p_address)
+{
+    // Finds the frame of the routine at `p_address` called from the context of
+    // `p_parent`, adding one if it was never called from there before.
+    uint64_t l_key = ((uint64_t) p_parent << 32) | p_address;
+    size_t l_mask = p_profile->m_child_count - 1;
+    size_t i = tm_hash_profile(l_key, p_profile->m_child_count);
+    for (; p_profile->m_children[i] != 0; i = (i + 1) & l_mask)
+    {
+        const tm_profile_frame_t* l_frame = &p_profile->m_frames[p_profile->m_children[i] - 1];
+        if (l_frame->m_parent == p_parent && l_frame->m_address == p_address)
+        {
+            return p_profile->m_children[i] - 1;
+        }
+    }
+
+    if (p_profile->m_frame_count == p_profile->m_frame_capacity)
+    {
+        p_profile->m_frame_capacity *= 2;
+        p_profile->m_frames = tm_realloc(p_profile->m_frames, p_profile->m_frame_capacity,
+            tm_profile_frame_t);
+        tm_expect_p(p_profile->m_frames != nullptr, "tm: could not allocate cpu profile frames");
+    }
+
+    size_t l_index = p_profile->m_frame_count++;
+    p_profile->m_frames[l_index] = (tm_profile_frame_t) { .m_address = p_address,
+        .m_parent = p_parent };
+
+    // Keep the table at most half full. Every frame but the root is in it.
+    if (p_profile->m_frame_count * 2 > p_profile->m_child_count)
+    {
+        tm_free(p_profile->m_children);
+        p_profile->m_child_count *= 2;
+        p_profile->m_children = tm_calloc(p_profile->m_child_count, size_t);
+        tm_expect_p(p_profile->m_children != nullptr, "tm: could not allocate cpu profile frames");
+
+        l_mask = p_profile->m_child_count - 1;
+        for (size_t j = 1; j < p_profile->m_frame_count; ++j)
+        {
+            const tm_profile_frame_t* l_frame = &p_profile->m_frames[j];
+            size_t k = tm_hash_profile(((uint64_t) l_frame->m_parent << 32) | l_frame->m_address,
+                p_profile->m_child_count);
+            while (p_profile->m_children[k] != 0) { k = (k + 1) & l_mask; }
+            p_profile->m_children[k] = j + 1;
+        }
+    }
+    else
+    {
+        p_profile->m_children[i] = l_index + 1;
+    }
+
+    return l_index;
+}
+
+static void tm_follow_call_stack (tm_cpu_t* p_cpu, tm_profile_t* p_profile)
+{
+    // Each call pushes one long onto the call stack, which grows downwards
+    // from where `RP` was when profiling started. Returning past that point
+    // makes the root frame stand for the caller.
+    long_t l_rp = p_cpu->m_registers.m_rp;
+    if (l_rp > p_profile->m_base_rp)
+    {
+        p_profile->m_base_rp = l_rp;
+    }
+
+    size_t l_depth = (p_profile->m_base_rp - l_rp) / 4;
+    if (l_depth < p_profile->m_depth)
+    {
+        p_profile->m_depth = l_depth;
+    }
+
+    while (p_profile->m_depth < l_depth)
+    {
+        if (p_profile->m_depth + 1 == p_profile->m_stack_capacity)
+        {
+            p_profile->m_stack_capacity *= 2;
+            p_profile->m_stack = tm_realloc(p_profile->m_stack, p_profile->m_stack_capacity, size_t);
+            tm_expect_p(p_profile->m_stack != nullptr, "tm: could not allocate cpu profile call stack");
+        }
+
+        addr_t l_target = p_cpu->m_registers.m_pc;
+        size_t l_caller = p_profile->m_stack[p_profile->m_depth];
+        p_profile->m_stack[++p_profile->m_depth] = tm_find_profile_frame(p_profile, l_caller, l_target);
+        tm_find_profile_entry(p_profile, l_target)->m_calls++;
+    }
+
+    p_profile->m_rp = l_rp;
+}
+
+static inline void tm_record_profile (tm_cpu_t* p_cpu, addr_t p_address, uint64_t p_cycles)
+{
+    tm_profile_t* l_profile = p_cpu->m_profile;
+
+    tm_profile_entry_t* l_entry = tm_find_profile_entry(l_profile, p_address);
+    l_entry->m_instructions++;
+    l_entry->m_cycles += p_cycles;
+    l_profile->m_frames[l_profile->m_stack[l_profile->m_depth]].m_cycles += p_cycles;
+
+    // Most instructions neither call nor return.
+    if (p_cpu->m_registers.m_rp != l_profile->m_rp)
+    {
+        tm_follow_call_stack(p_cpu, l_profile);
+    }
+}
+
+static int tm_compare_profile_entries (const void* p_left, const void* p_right)
+{
+    // Sorts entries by cycles spent, most first, then by address.
+    const tm_profile_entry_t* l_left = p_left;
+    const tm_profile_entry_t* l_right = p_right;
+    if (l_left->m_cycles != l_right->m_cycles)
+    {
+        return (l_left->m_cycles > l_right->m_cycles) ? -1 : 1;
+    }
+
+    return (l_left->m_address > l_right->m_address) - (l_left->m_address < l_right->m_address);
+}
+
+static void tm_write_profile_frame (const tm_profile_t* p_profile, size_t p_frame, FILE* p_file)
+{
+    // Writes the names of the frames from the root down to `p_frame`.
+    const tm_profile_frame_t* l_frame = &p_profile->m_frames[p_frame];
+    if (p_frame != 0)
+    {
+        tm_write_profile_frame(p_profile, l_frame->m_parent, p_file);
+        fputc(';', p_file);
+    }
+
+    fprintf(p_file, "$%08X", l_frame->m_address);
+}
+
+/* Static Functions - Statistics **********************************************/
+
+static inline uint64_t tm_get_host_time ()
+{
+    // Returns a timestamp, in nanoseconds, from the host's monotonic clock.
+    struct timespec l_time;
+    #if defined(TM_LINUX)
+        clock_gettime(CLOCK_MONOTONIC, &l_time);
+    #else
+        timespec_get(&l_time, TIME_UTC);
+    #endif
+
+    return (uint64_t) l_time.tv_sec * 1000000000ull + (uint64_t) l_time.tv_nsec;
+}
+
+static inline uint64_t tm_start_sample (tm_statistics_t* p_statistics)
+{
+    // Returns the time at which a timed instruction started, or zero if the
+    // instruction is not to be timed.
+    if (p_statistics->m_sample_period == 0 || --p_statistics->m_countdown > 0)
+    {
+        return 0;
+    }
+
+    p_statistics->m_countdown = p_statistics->m_sample_period;
+    return tm_get_host_time();
+}
+
+static inline void tm_record_statistics (tm_cpu_t* p_cpu, uint64_t p_cycles, uint64_t p_start)
+{
+    tm_opcode_statistics_t* l_opcode = &p_cpu->m_statistics->m_opcodes[p_cpu->m_inst];
+    l_opcode->m_executions++;
+    l_opcode->m_cycles += p_cycles;
+
+    if (p_start != 0)
+    {
+        l_opcode->m_samples++;
+        l_opcode->m_nanoseconds += tm_get_host_time() - p_start;
+    }
+}
+
+/* Static Functions - Trace ***************************************************/
+
+static inline void tm_trace_write (tm_cpu_t* p_cpu, addr_t p_address, byte_t p_size, long_t p_value)
+{
+    // Adds a write to the record of the instruction being executed. Writes
+    // past the last one a record has room for are not recorded.
+    tm_trace_record_t* l_record = &p_cpu->m_trace->m_record;
+    if (l_record->m_write_count < TM_TRACE_MAX_WRITES)
+    {
+        l_record->m_writes[l_record->m_write_count++] = (tm_trace_write_t) {
+            .m_address  = p_address,
+            .m_size     = p_size,
+            .m_value    = p_value
+        };
+    }
+}
+
+static void tm_record_trace (tm_cpu_t* p_cpu, addr_t p_address, uint64_t p_cycles)
+{
+    tm_trace_t* l_trace = p_cpu->m_trace;
+    tm_trace_record_t* l_record = &l_trace->m_record;
+
+    l_record->m_address = p_address;
+    l_record->m_instruction = p_cpu->m_registers.m_ci;
+    l_record->m_cycles = (uint32_t) p_cycles;
+    l_record->m_registers[TM_TRACE_A] = p_cpu->m_registers.m_a;
+    l_record->m_registers[TM_TRACE_B] = p_cpu->m_registers.m_b;
+    l_record->m_registers[TM_TRACE_C] = p_cpu->m_registers.m_c;
+    l_record->m_registers[TM_TRACE_D] = p_cpu->m_registers.m_d;
+    l_record->m_registers[TM_TRACE_SP] = p_cpu->m_registers.m_sp;
+    l_record->m_registers[TM_TRACE_RP] = p_cpu->m_registers.m_rp;
+    l_record->m_registers[TM_TRACE_FLAGS] = tm_get_flags(p_cpu)->m_state;
+    l_record->m_registers[TM_TRACE_EC] = p_cpu->m_registers.m_ec;
+    l_record->m_registers[TM_TRACE_IE] = p_cpu->m_registers.m_ie;
+    l_record->m_registers[TM_TRACE_IF] = p_cpu->m_registers.m_if;
+
+    if (tm_write_trace_record(l_trace->m_writer, l_record) == false)
+    {
+        l_trace->m_failed = true;
+    }
+}
+
+/* Static Functions - Record and Replay ***************************************/
+
+// While recording, the CPU is checkpointed with `tm_save_state` every so many
+// cycles, and everything else it takes in from outside its state is logged:
+// values read through the callbacks during a step, and interrupts requested
+// by the host, by events, or from other threads. Each input is logged against
+// the step it arrived during, or before. Restoring a checkpoint, then stepping
+// with the inputs taken from the log, repeats what the CPU did exactly.
+
+static void tm_log_input (tm_cpu_t* p_cpu, byte_t p_type, long_t p_value)
+{
+    tm_replay_t* l_replay = p_cpu->m_replay;
+    if (l_replay->m_input_count == l_replay->m_input_capacity)
+    {
+        size_t l_capacity = (l_replay->m_input_capacity > 0) ? l_replay->m_input_capacity * 2 : 256;
+        tm_replay_input_t* l_inputs = tm_realloc(l_replay->m_inputs, l_capacity, tm_replay_input_t);
+        tm_expect_p(l_inputs, "tm: could not allocate replay input log");
+
+        l_replay->m_inputs = l_inputs;
+        l_replay->m_input_capacity = l_capacity;
+    }
+
+    l_replay->m_inputs[l_replay->m_input_count++] = (tm_replay_input_t) {
+        .m_step     = l_replay->m_step,
+        .m_value    = p_value,
+        .m_type     = p_type
+    };
+}
+
+static void tm_replay_interrupts (tm_cpu_t* p_cpu, byte_t p_type)
+{
+    // Requests the interrupts logged as `p_type` for the current step, up to
+    // the next input of another kind.
+    tm_replay_t* l_replay = p_cpu->m_replay;
+    while (l_replay->m_position < l_replay->m_input_count)
+    {
+        const tm_replay_input_t* l_input = &l_replay->m_inputs[l_replay->m_position];
+        if (l_input->m_step != l_replay->m_step || l_input->m_type != p_type)
+        {
+            break;
+        }
+
+        p_cpu->m_registers.m_if |= l_input->m_value;
+        l_replay->m_position++;
+    }
+
+    tm_update_interrupts(p_cpu);
+}
+
+static void tm_record_interrupts (tm_cpu_t* p_cpu, word_t p_interrupts)
+{
+    // Requests and logs interrupts while recording. While replaying, the ones
+    // from the log are requested instead, so these are ignored.
+    tm_replay_t* l_replay = p_cpu->m_replay;
+    if (l_replay->m_replaying == true)
+    {
+        return;
+    }
+
+    tm_log_input(p_cpu, (l_replay->m_in_step == true) ?
+        TM_INPUT_INTERRUPTS_DURING : TM_INPUT_INTERRUPTS_BEFORE, p_interrupts);
+    p_cpu->m_registers.m_if |= p_interrupts;
+    tm_update_interrupts(p_cpu);
+}
+
+static bool tm_replay_access (tm_cpu_t* p_cpu, byte_t p_type, byte_t p_failed_type,
+    long_t* p_value)
+{
+    // Takes the value read, or written, through the callbacks from the log,
+    // and whether the access succeeded.
+    tm_replay_t* l_replay = p_cpu->m_replay;
+
+    // Interrupts requested earlier in the step than the access come first.
+    tm_replay_interrupts(p_cpu, TM_INPUT_INTERRUPTS_DURING);
+    if (l_replay->m_position < l_replay->m_input_count)
+    {
+        const tm_replay_input_t* l_input = &l_replay->m_inputs[l_replay->m_position];
+        if (
+            l_input->m_step == l_replay->m_step &&
+            (l_input->m_type == p_type || l_input->m_type == p_failed_type)
+        )
+        {
+            *p_value = l_input->m_value;
+            l_replay->m_position++;
+            return l_input->m_type == p_type;
+        }
+    }
+
+    // Only a host which changed the CPU's state behind the recording's back
+    // can get the CPU to access something it did not access before.
+    l_replay->m_diverged = true;
+    return false;
+}
+
+static bool tm_record_read (tm_cpu_t* p_cpu, tm_bus_read_ctx p_read, void* p_user_data,
+    addr_t p_address, long_t* p_value)
+{
+    tm_replay_t* l_replay = p_cpu->m_replay;
+    if (l_replay->m_replaying == false)
+    {
+        bool l_good = p_read(p_user_data, p_address, p_value);
+        tm_log_input(p_cpu, (l_good == true) ? TM_INPUT_READ : TM_INPUT_FAILED_READ,
+            (l_good == true) ? *p_value : 0);
+        return l_good;
+    }
+
+    return tm_replay_access(p_cpu, TM_INPUT_READ, TM_INPUT_FAILED_READ, p_value);
+}
+
+static bool tm_record_write (tm_cpu_t* p_cpu, tm_bus_write_ctx p_write, void* p_user_data,
+    addr_t p_address, long_t p_value)
+{
+    tm_replay_t* l_replay = p_cpu->m_replay;
+    if (l_replay->m_replaying == false)
+    {
+        bool l_good = p_write(p_user_data, p_address, p_value);
+        tm_log_input(p_cpu, (l_good == true) ? TM_INPUT_WRITE : TM_INPUT_FAILED_WRITE, p_value);
+        return l_good;
+    }
+
+    long_t l_value = 0;
+    bool l_good = tm_replay_access(p_cpu, TM_INPUT_WRITE, TM_INPUT_FAILED_WRITE, &l_value);
+    if (l_value != p_value)
+    {
+        l_replay->m_diverged = true;
+        return false;
+    }
+
+    return l_good;
+}
+
+static void tm_take_checkpoint (tm_cpu_t* p_cpu)
+{
+    tm_replay_t* l_replay = p_cpu->m_replay;
+
+    // Keep memory bounded over long recordings by dropping every other
+    // checkpoint once there are too many, and taking them half as often.
+    if (l_replay->m_checkpoint_count == TM_MAX_CHECKPOINTS)
+    {
+        size_t l_kept = 0;
+        for (size_t i = 0; i < l_replay->m_checkpoint_count; ++i)
+        {
+            if (i % 2 == 0)
+            {
+                l_replay->m_checkpoints[l_kept++] = l_replay->m_checkpoints[i];
+            }
+            else
+            {
+                tm_free(l_replay->m_checkpoints[i].m_state);
+            }
+        }
+
+        l_replay->m_checkpoint_count = l_kept;
+        l_replay->m_interval *= 2;
+    }
+
+    // Restoring a checkpoint leaves the decode cache empty. Instructions found
+    // in the cache skip the reads which fetch them, so start from an empty
+    // cache here too, or the steps replayed would read more than the steps
+    // recorded.
+    tm_flush_decode_cache(p_cpu);
+
+    size_t l_size = tm_save_state(p_cpu, nullptr, 0);
+    byte_t* l_state = tm_malloc(l_size, byte_t);
+    tm_expect_p(l_state, "tm: could not allocate checkpoint");
+    tm_save_state(p_cpu, l_state, l_size);
+
+    // Saving the state collects interrupts requested from other threads, so
+    // the inputs are only counted afterwards.
+    l_replay->m_checkpoints[l_replay->m_checkpoint_count++] = (tm_checkpoint_t) {
+        .m_step     = l_replay->m_step,
+        .m_cycle    = p_cpu->m_cycle_count,
+        .m_input    = l_replay->m_input_count,
+        .m_state    = l_state,
+        .m_size     = l_size
+    };
+
+    l_replay->m_next_checkpoint = p_cpu->m_cycle_count + l_replay->m_interval;
+}
+
+static void tm_finish_replay (tm_cpu_t* p_cpu)
+{
+    // Once the last step recorded has been replayed, the CPU is back where it
+    // was when it was rewound, and the host takes over again.
+    tm_replay_t* l_replay = p_cpu->m_replay;
+    if (l_replay->m_replaying == true && l_replay->m_step == l_replay->m_end_step)
+    {
+        tm_replay_interrupts(p_cpu, TM_INPUT_INTERRUPTS_BEFORE);
+        l_replay->m_replaying = false;
+        l_replay->m_input_count = l_replay->m_position;
+    }
+}
+
+static void tm_begin_replay_step (tm_cpu_t* p_cpu)
+{
+    tm_replay_t* l_replay = p_cpu->m_replay;
+    if (l_replay->m_replaying == true)
+    {
+        tm_replay_interrupts(p_cpu, TM_INPUT_INTERRUPTS_BEFORE);
+    }
+    else if (p_cpu->m_cycle_count >= l_replay->m_next_checkpoint)
+    {
+        tm_take_checkpoint(p_cpu);
+    }
+
+    l_replay->m_in_step = true;
+}
+
+static inline void tm_replay_step_interrupts (tm_cpu_t* p_cpu)
+{
+    // Requests the interrupts logged during the current step which have not
+    // been requested yet, before the step checks for them.
+    if (p_cpu->m_replay != nullptr && p_cpu->m_replay->m_replaying == true)
+    {
+        tm_replay_interrupts(p_cpu, TM_INPUT_INTERRUPTS_DURING);
+    }
+}
+
+static inline bool tm_end_replay_step (tm_cpu_t* p_cpu, bool p_result)
+{
+    if (p_cpu->m_replay != nullptr)
+    {
+        tm_replay_step_interrupts(p_cpu);
+        p_cpu->m_replay->m_in_step = false;
+        p_cpu->m_replay->m_step++;
+        tm_finish_replay(p_cpu);
+    }
+
+    return p_result;
+}
+
+/* Static Functions - Debugger ************************************************/
+
+// Breakpoints and watchpoints cost nothing until one is added. From then on,
+// `tm_run_cpu` steps every instruction through `tm_step_cpu`, as it does for
+// the profiler, and the pages holding a breakpoint, or overlapping a
+// watchpoint, are marked in the page tables. Only instructions on a marked
+// page look through the breakpoints, and only accesses to a marked page look
+// through the watchpoints: watched pages are never handed out by
+// `tm_map_address`, so their accesses take the slower paths, which check.
+
+static void tm_mark_debug_pages (tm_cpu_t* p_cpu, uint64_t p_start, uint64_t p_end, byte_t p_flag,
+    bool p_set)
+{
+    // Sets, or clears, `p_flag` on every page between `p_start` and `p_end`.
+    for (uint64_t l_address = p_start & ~(uint64_t) (TM_PAGE_SIZE - 1); l_address < p_end;
+        l_address += TM_PAGE_SIZE)
+    {
+        if (p_set == true)
+        {
+            tm_own_page(p_cpu, l_address)->m_flags |= p_flag;
+        }
+        else if ((tm_find_page(p_cpu, l_address)->m_flags & p_flag) != 0)
+        {
+            tm_own_page(p_cpu, l_address)->m_flags &= ~p_flag;
+        }
+    }
+}
+
+static void tm_apply_debug_pages (tm_cpu_t* p_cpu)
+{
+    // Marks the pages of every breakpoint and watchpoint, once their pages
+    // have been laid out again, or some of their marks cleared.
+    const tm_debugger_t* l_debugger = p_cpu->m_debugger;
+    for (size_t i = 0; i < l_debugger->m_breakpoint_count; ++i)
+    {
+        addr_t l_address = l_debugger->m_breakpoints[i].m_address;
+        tm_mark_debug_pages(p_cpu, l_address, (uint64_t) l_address + 1, TM_PAGE_BREAKPOINT, true);
+    }
+
+    for (size_t i = 0; i < l_debugger->m_watchpoint_count; ++i)
+    {
+        const tm_watchpoint_t* l_watch = &l_debugger->m_watchpoints[i];
+        tm_mark_debug_pages(p_cpu, l_watch->m_start, l_watch->m_end, TM_PAGE_WATCHED, true);
+    }
+}
+
+static bool tm_test_break_condition (tm_cpu_t* p_cpu, const tm_break_condition_t* p_condition)
+{
+    long_t l_value = 0;
+    tm_load_register(p_cpu, p_condition->m_register, &l_value);
+    switch (p_condition->m_compare)
+    {
+        case TM_COMPARE_EQ: return l_value == p_condition->m_value;
+        case TM_COMPARE_NE: return l_value != p_condition->m_value;
+        case TM_COMPARE_LT: return l_value <  p_condition->m_value;
+        case TM_COMPARE_LE: return l_value <= p_condition->m_value;
+        case TM_COMPARE_GT: return l_value >  p_condition->m_value;
+        default:            return l_value >= p_condition->m_value;
+    }
+}
+
+static bool tm_begin_debug_step (tm_cpu_t* p_cpu)
+{
+    // Returns false, with the CPU left before the instruction, if it is about
+    // to execute an instruction at a breakpoint whose condition holds. The
+    // next step carries on from there, stepping over the breakpoint once.
+    tm_debugger_t* l_debugger = p_cpu->m_debugger;
+    addr_t l_address = p_cpu->m_registers.m_pc;
+    bool l_resuming = l_debugger->m_resuming == true && l_debugger->m_resume_address == l_address;
+    l_debugger->m_break.m_reason = TM_BREAK_NONE;
+    l_debugger->m_resuming = false;
+
+    if (
+        p_cpu->m_flags.m_halt == false && l_resuming == false &&
+        (tm_find_page(p_cpu, l_address)->m_flags & TM_PAGE_BREAKPOINT) != 0
+    )
+    {
+        for (size_t i = 0; i < l_debugger->m_breakpoint_count; ++i)
+        {
+            const tm_breakpoint_t* l_breakpoint = &l_debugger->m_breakpoints[i];
+            if (
+                l_breakpoint->m_address == l_address &&
+                (
+                    l_breakpoint->m_conditional == false ||
+                    tm_test_break_condition(p_cpu, &l_breakpoint->m_condition) == true
+                )
+            )
+            {
+                l_debugger->m_break = (tm_break_t) {
+                    .m_reason   = TM_BREAK_BREAKPOINT,
+                    .m_id       = l_breakpoint->m_id,
+                    .m_address  = l_address
+                };
+
+                l_debugger->m_resuming = true;
+                l_debugger->m_resume_address = l_address;
+                return false;
+            }
+        }
+    }
+
+    l_debugger->m_in_step = true;
+    return true;
+}
+
+static void tm_check_watchpoints (tm_cpu_t* p_cpu, addr_t p_address, byte_t p_size, byte_t p_access,
+    long_t p_value)
+{
+    // Only the first access to hit a watchpoint during a step is reported.
+    // Reads from the program counter fetch the instruction and its operand,
+    // rather than data, so they are not watched.
+    tm_debugger_t* l_debugger = p_cpu->m_debugger;
+    if (
+        l_debugger->m_in_step == false || l_debugger->m_break.m_reason != TM_BREAK_NONE ||
+        (p_access == TM_ACCESS_READ && p_address == p_cpu->m_registers.m_pc)
+    )
+    {
+        return;
+    }
+
+    uint64_t l_end = (uint64_t) p_address + p_size;
+    for (size_t i = 0; i < l_debugger->m_watchpoint_count; ++i)
+    {
+        const tm_watchpoint_t* l_watch = &l_debugger->m_watchpoints[i];
+        if ((l_watch->m_access & p_access) != 0 && p_address < l_watch->m_end &&
+            l_end > l_watch->m_start)
+        {
+            l_debugger->m_break = (tm_break_t) {
+                .m_reason   = TM_BREAK_WATCHPOINT,
+                .m_id       = l_watch->m_id,
+                .m_address  = p_address,
+                .m_access   = p_access,
+                .m_size     = p_size,
+                .m_value    = p_value
+            };
+
+            return;
+        }
+    }
+}
+
+static inline void tm_watch_access (tm_cpu_t* p_cpu, addr_t p_address, byte_t p_size,
+    byte_t p_access, long_t p_value)
+{
+    if (p_cpu->m_debugger != nullptr)
+    {
+        tm_check_watchpoints(p_cpu, p_address, p_size, p_access, p_value);
+    }
+}
+
+static inline bool tm_end_step (tm_cpu_t* p_cpu, bool p_result)
+{
+    // Ends the step for the recorder and the debugger. A step which hit a
+    // watchpoint is finished, but still returns false, so the host can look.
+    p_result = tm_end_replay_step(p_cpu, p_result);
+    if (p_cpu->m_debugger != nullptr)
+    {
+        p_cpu->m_debugger->m_in_step = false;
+        if (p_cpu->m_debugger->m_break.m_reason == TM_BREAK_WATCHPOINT)
+        {
+            return false;
+        }
+    }
+
+    return p_result;
+}
+
+static inline bool tm_is_debugging (const tm_cpu_t* p_cpu)
+{
+    return
+        p_cpu->m_debugger != nullptr &&
+        (p_cpu->m_debugger->m_breakpoint_count > 0 || p_cpu->m_debugger->m_watchpoint_count > 0);
+}
+
+/* Static Functions - Legacy Callbacks ***************************************/
+
+static bool tm_legacy_read (void* p_user_data, addr_t p_address, long_t* p_value)
+{
+    return ((tm_cpu_t*) p_user_data)->m_legacy_read(p_address, p_value);
+}
+
+static bool tm_legacy_write (void* p_user_data, addr_t p_address, long_t p_value)
+{
+    return ((tm_cpu_t*) p_user_data)->m_legacy_write(p_address, p_value);
+}
+
+static bool tm_legacy_cycle (void* p_user_data)
+{
+    return ((tm_cpu_t*) p_user_data)->m_legacy_cycle();
+}
+
+/* Public Functions ***********************************************************/
+
+tm_cpu_t* tm_create_cpu (tm_bus_read p_read, tm_bus_write p_write, tm_cycle p_cycle)
+{
+    // Hosts which keep a single machine's state in globals can use callbacks
+    // which take no context. These are called through adapters which are
+    // given the CPU itself as their context.
+    tm_expect(p_read, "tm: expected a bus read function!\n");
+    tm_expect(p_write, "tm: expected a bus write function!\n");
+    tm_expect(p_cycle, "tm: expected a bus cycle function!\n");
+
+    tm_cpu_t* l_cpu = tm_create_cpu_ctx(tm_legacy_read, tm_legacy_write, tm_legacy_cycle, nullptr);
+    l_cpu->m_user_data      = l_cpu;
+    l_cpu->m_legacy_read    = p_read;
+    l_cpu->m_legacy_write   = p_write;
+    l_cpu->m_legacy_cycle   = p_cycle;
+
+    return l_cpu;
+}
+
+tm_cpu_t* tm_create_cpu_ctx (tm_bus_read_ctx p_read, tm_bus_write_ctx p_write, tm_cycle_ctx p_cycle,
+    void* p_user_data)
+{
+    tm_expect(p_read, "tm: expected a bus read function!\n");
+    tm_expect(p_write, "tm: expected a bus write function!\n");
+    tm_expect(p_cycle, "tm: expected a bus cycle function!\n");
+
+    tm_cpu_t* l_cpu = tm_calloc(1, tm_cpu_t);
+    tm_expect_p(l_cpu, "tm: could not allocate cpu context");
+
+    l_cpu->m_decode_cache = tm_calloc(TM_DECODE_CACHE_SIZE, tm_decoded_instruction_t);
+    tm_expect_p(l_cpu->m_decode_cache, "tm: could not allocate cpu decode cache");
+
+    l_cpu->m_block_cache = tm_calloc(TM_BLOCK_CACHE_SIZE, tm_block_t*);
+    tm_expect_p(l_cpu->m_block_cache, "tm: could not allocate cpu block cache");
+
+    l_cpu->m_recording = malloc(sizeof(tm_block_t) +
+        TM_MAX_BLOCK_LENGTH * sizeof(tm_decoded_instruction_t));
+    tm_expect_p(l_cpu->m_recording, "tm: could not allocate cpu block translation buffer");
+    l_cpu->m_recording->m_valid = false;
+
+    l_cpu->m_page_templates = tm_calloc(TM_PAGE_TEMPLATE_COUNT * TM_PAGES_PER_TABLE, tm_page_t);
+    tm_expect_p(l_cpu->m_page_templates, "tm: could not allocate cpu page tables");
+    tm_reset_pages(l_cpu);
+
+    l_cpu->m_read       = p_read;
+    l_cpu->m_write      = p_write;
+    l_cpu->m_cycle      = p_cycle;
+    l_cpu->m_user_data  = p_user_data;
+    l_cpu->m_next_event = UINT64_MAX;
+    l_cpu->m_decode_cache_enabled = true;
+    l_cpu->m_block_cache_enabled = true;
+    l_cpu->m_superoperators_enabled = true;
+    tm_init_cpu(l_cpu);
+
+    return l_cpu;
+}
+
+void tm_init_cpu (tm_cpu_t* p_cpu)
+{
+    tm_hard_assert(p_cpu);
 
     // 1. Reset all CPU registers and the flags register to zero.
     memset(&p_cpu->m_registers, 0x00, sizeof(tm_registers_t));
     memset(&p_cpu->m_flags, 0x00, sizeof(tm_flags_t));
+    p_cpu->m_lazy_op = TM_LAZY_NONE;
+    p_cpu->m_interrupts = 0;
+    atomic_store_explicit(&p_cpu->m_async_interrupts, 0, memory_order_relaxed);
+
+    // 2. Set the program counter, stack pointer and current instruction
+    //    registers to their initial values.
+    p_cpu->m_registers.m_pc = TM_PROGRAM_START;
+    p_cpu->m_registers.m_sp = 0x10000;
+    p_cpu->m_registers.m_rp = 0x10000;
+    p_cpu->m_registers.m_ci = 0xFFFF;
+
+    // 3. Discard any instructions decoded before the reset.
+    tm_flush_decode_cache(p_cpu);
+}
+
+void tm_destroy_cpu (tm_cpu_t* p_cpu)
+{
+    tm_hard_assert(p_cpu);
+    tm_flush_blocks(p_cpu);
+    tm_collect_blocks(p_cpu);
+    tm_free(p_cpu->m_block_cache);
+    tm_free(p_cpu->m_recording);
+    tm_free(p_cpu->m_decode_cache);
+    tm_free_page_tables(p_cpu);
+    tm_free(p_cpu->m_page_templates);
+    tm_free(p_cpu->m_events);
+    tm_destroy_profile(p_cpu->m_profile);
+    tm_free(p_cpu->m_statistics);
+    tm_stop_trace(p_cpu);
+    tm_stop_recording(p_cpu);
+    if (p_cpu->m_debugger != nullptr)
+    {
+        tm_free(p_cpu->m_debugger->m_breakpoints);
+        tm_free(p_cpu->m_debugger->m_watchpoints);
+        tm_free(p_cpu->m_debugger);
+    }
+
+    while (p_cpu->m_regions != nullptr)
+    {
+        tm_mapped_region_t* l_next = p_cpu->m_regions->m_next;
+        tm_free(p_cpu->m_regions);
+        p_cpu->m_regions = l_next;
+    }
+
+    #if defined(TM_JIT)
+        if (p_cpu->m_jit_code != nullptr)
+        {
+            munmap(p_cpu->m_jit_code, TM_JIT_BUFFER_SIZE);
+        }
+    #endif
+
+    tm_free(p_cpu);
+}
+
+void* tm_get_user_data (tm_cpu_t* p_cpu)
+{
+    tm_assert(p_cpu != nullptr);
+
+    // CPUs created with `tm_create_cpu` pass themselves to the legacy
+    // callback adapters, but have no user data of their own.
+    return (p_cpu->m_legacy_read != nullptr) ? nullptr : p_cpu->m_user_data;
+}
+
+void tm_set_wide_bus (tm_cpu_t* p_cpu, tm_bus_read_ctx p_read_word, tm_bus_write_ctx p_write_word,
+    tm_bus_read_ctx p_read_long, tm_bus_write_ctx p_write_long)
+{
+    // Use this function to give the CPU callbacks which read or write a whole
+    // word or long in one call, rather than one call to the byte-wide
+    // callbacks per byte. Values are passed as the CPU sees them, with the
+    // byte at `p_address` being the most significant. Any of the callbacks may
+    // be `nullptr`, in which case accesses of that width and direction are
+    // split into bytes as before.
+    //
+    // Only accesses which would otherwise reach the byte-wide callbacks with
+    // every one of their bytes are passed to the wide callbacks. Accesses
+    // crossing a page boundary, or touching host memory or a mapped region,
+    // are still split into bytes.
+
+    tm_assert(p_cpu != nullptr);
+
+    p_cpu->m_read_word  = p_read_word;
+    p_cpu->m_write_word = p_write_word;
+    p_cpu->m_read_long  = p_read_long;
+    p_cpu->m_write_long = p_write_long;
+}
+
+/* Public Functions - Decode Cache ********************************************/
+
+void tm_enable_decode_cache (tm_cpu_t* p_cpu, bool p_enable)
+{
+    tm_assert(p_cpu != nullptr);
+
+    // Entries recorded while the cache was enabled may have gone stale while
+    // it was disabled, so start over with an empty cache either way.
+    p_cpu->m_decode_cache_enabled = p_enable;
+    tm_flush_decode_cache(p_cpu);
+}
+
+void tm_enable_block_cache (tm_cpu_t* p_cpu, bool p_enable)
+{
+    tm_assert(p_cpu != nullptr);
+
+    // As with the decode cache, blocks may have gone stale while the block
+    // cache was disabled.
+    p_cpu->m_block_cache_enabled = p_enable;
+    tm_flush_blocks(p_cpu);
+}
+
+void tm_enable_superoperators (tm_cpu_t* p_cpu, bool p_enable)
+{
+    tm_assert(p_cpu != nullptr);
+
+    // Pairs of instructions are fused as blocks are translated. Disabling
+    // superoperators, for instance to debug one of the instructions within
+    // one, executes every instruction of a block through its own handler.
+    // Blocks translated before are discarded, so the change applies at once.
+    p_cpu->m_superoperators_enabled = p_enable;
+    tm_flush_blocks(p_cpu);
+}
+
+void tm_flush_decode_cache (tm_cpu_t* p_cpu)
+{
+    // Use this function to discard every decoded instruction and translated
+    // block. Hosts must call this after changing executable memory behind the
+    // CPU's back - such as patching the program ROM, or writing to XRAM other
+    // than through the `tm_write_*` functions.
+
+    tm_assert(p_cpu != nullptr);
+    memset(p_cpu->m_decode_cache, 0x00,
+        TM_DECODE_CACHE_SIZE * sizeof(tm_decoded_instruction_t));
+    p_cpu->m_decoding = nullptr;
+    tm_flush_blocks(p_cpu);
+}
+
+/* Public Functions - JIT Compiler *******************************************/
+
+bool tm_enable_jit (tm_cpu_t* p_cpu, bool p_enable)
+{
+    // Use this function to have `tm_run_cpu` compile frequently executed
+    // blocks into native code. The JIT compiler is disabled by default, and
+    // needs the block cache to be enabled.
+    //
+    // Returns false if the JIT compiler is not available on the host, in which
+    // case the CPU keeps running in the interpreter.
+
+    tm_assert(p_cpu != nullptr);
+
+    #if defined(TM_JIT)
+        if (p_enable == true && p_cpu->m_jit_code == nullptr)
+        {
+            void* l_code = mmap(nullptr, TM_JIT_BUFFER_SIZE, PROT_READ | PROT_EXEC,
+                MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+            if (l_code == MAP_FAILED)
+            {
+                return false;
+            }
+
+            p_cpu->m_jit_code = l_code;
+        }
+
+        p_cpu->m_jit_enabled = p_enable;
+        return true;
+    #else
+        (void) p_enable;
+        return false;
+    #endif
+}
+
+/* Public Functions - Built-In Memory *****************************************/
+
+void tm_map_program (tm_cpu_t* p_cpu, tm_program_t* p_program)
+{
+    // Use this function to have the CPU provide its own memory, instead of
+    // going through the bus callbacks for every byte. The program's ROM is
+    // mapped from address `$00000000`, so that its code starts at
+    // `TM_PROGRAM_START`; RAM, the stacks and QRAM are backed by memory the
+    // CPU allocates. Only accesses to the IO port registers, and to addresses
+    // outside of the ROM, still go through the bus callbacks. Writes to ROM go
+    // through the callbacks as well, so the host decides whether to allow
+    // them. Regions mapped with `tm_map_region` stay mapped on top.
+    //
+    // The program's ROM is not copied, so the program must outlive the CPU,
+    // or be unmapped first. Passing `nullptr` unmaps the program, and frees
+    // the memory the CPU allocated.
+
+    tm_assert(p_cpu != nullptr);
+    tm_assert(p_program == nullptr || p_program->m_rom != nullptr);
+
+    p_cpu->m_program = p_program;
+    tm_reset_pages(p_cpu);
+    for (tm_mapped_region_t* l_mapped = p_cpu->m_regions; l_mapped != nullptr;
+        l_mapped = l_mapped->m_next)
+    {
+        tm_apply_region(p_cpu, &l_mapped->m_region, 0, TM_ADDRESS_SPACE_SIZE);
+    }
+
+    if (p_cpu->m_debugger != nullptr)
+    {
+        tm_apply_debug_pages(p_cpu);
+    }
+
+    // Whatever was executed before was read from somewhere else.
+    tm_flush_decode_cache(p_cpu);
+}
+
+bool tm_map_region (tm_cpu_t* p_cpu, const tm_region_t* p_region)
+{
+    // Use this function to map part of the address space to memory or devices
+    // of the host's own - a framebuffer in XRAM, say. Accesses to the region
+    // read and write its host memory directly or, without host memory, call
+    // its handlers one byte at a time. Its access flags replace the memory
+    // map's for the guest's instructions, though the IO port registers stay
+    // out of their reach either way.
+    //
+    // The region replaces whatever was mapped to its pages before, including
+    // any memory the CPU allocated there, until it is unmapped. Regions mapped
+    // later take precedence over the ones mapped before them.
+    //
+    // Returns false, without mapping anything, if the region is not aligned to
+    // `TM_PAGE_SIZE`, or has neither host memory nor both handlers.
+
+    tm_assert(p_cpu != nullptr);
+    tm_assert(p_region != nullptr);
+
+    if (
+        p_region->m_size == 0 ||
+        ((p_region->m_start | p_region->m_size) & (TM_PAGE_SIZE - 1)) != 0 ||
+        (uint64_t) p_region->m_start + p_region->m_size > TM_ADDRESS_SPACE_SIZE ||
+        (
+            p_region->m_host == nullptr &&
+            (p_region->m_read == nullptr || p_region->m_write == nullptr)
+        )
+    )
+    {
+        return false;
+    }
+
+    tm_mapped_region_t* l_mapped = tm_calloc(1, tm_mapped_region_t);
+    tm_expect_p(l_mapped, "tm: could not allocate cpu memory region");
+    l_mapped->m_region = *p_region;
+
+    tm_mapped_region_t** l_tail = &p_cpu->m_regions;
+    while (*l_tail != nullptr)
+    {
+        l_tail = &(*l_tail)->m_next;
+    }
+
+    *l_tail = l_mapped;
+    tm_apply_region(p_cpu, &l_mapped->m_region, 0, TM_ADDRESS_SPACE_SIZE);
+    if (p_cpu->m_debugger != nullptr)
+    {
+        tm_apply_debug_pages(p_cpu);
+    }
+
+    tm_flush_decode_cache(p_cpu);
+    return true;
+}
+
+bool tm_unmap_region (tm_cpu_t* p_cpu, addr_t p_start)
+{
+    // Use this function to unmap the region most recently mapped at `p_start`.
+    // Its pages go back to what was there before it was mapped, except for
+    // the memory the CPU allocated, which starts out cleared again.
+    //
+    // Returns false if no region is mapped at `p_start`.
+
+    tm_assert(p_cpu != nullptr);
+
+    tm_mapped_region_t** l_found = nullptr;
+    for (tm_mapped_region_t** l_link = &p_cpu->m_regions; *l_link != nullptr;
+        l_link = &(*l_link)->m_next)
+    {
+        if ((*l_link)->m_region.m_start == p_start)
+        {
+            l_found = l_link;
+        }
+    }
+
+    if (l_found == nullptr)
+    {
+        return false;
+    }
+
+    tm_mapped_region_t* l_mapped = *l_found;
+    *l_found = l_mapped->m_next;
+
+    // Put the memory map back, then whatever other regions overlap it, in the
+    // order they were mapped.
+    addr_t l_start = l_mapped->m_region.m_start;
+    uint64_t l_end = (uint64_t) l_start + l_mapped->m_region.m_size;
+    for (uint64_t l_address = l_start; l_address < l_end; l_address += TM_PAGE_SIZE)
+    {
+        tm_set_page(p_cpu, l_address, tm_default_page(p_cpu, l_address, true));
+    }
+
+    for (tm_mapped_region_t* l_other = p_cpu->m_regions; l_other != nullptr;
+        l_other = l_other->m_next)
+    {
+        tm_apply_region(p_cpu, &l_other->m_region, l_start, l_end);
+    }
+
+    tm_free(l_mapped);
+    if (p_cpu->m_debugger != nullptr)
+    {
+        tm_apply_debug_pages(p_cpu);
+    }
+
+    tm_flush_decode_cache(p_cpu);
+    return true;
+}
+
+/* Public Functions - CPU Registers *******************************************/
+
+bool tm_read_cpu_flag (tm_cpu_t* p_cpu, enum_t p_flag)
+{
+    tm_assert(p_cpu != nullptr);
+    tm_assert(p_flag >= TM_FLAG_Z && p_flag <= TM_FLAG_S);
+
+    return tm_check_bit(tm_get_flags(p_cpu)->m_state, p_flag);
+}
+
+bool tm_read_cpu_register (tm_cpu_t* p_cpu, enum_t p_type, long_t* p_value)
+{
+    tm_assert(p_cpu != nullptr);
+    tm_assert(p_value != nullptr);
+
+    if (p_type > TM_REGISTER_DL)
+    {
+        return false;
+    }
+
+    return tm_load_register(p_cpu, p_type, p_value);
+}
+
+bool tm_write_cpu_register (tm_cpu_t* p_cpu, enum_t p_type, long_t p_value)
+{
+    tm_assert(p_cpu != nullptr);
+
+    if (p_type > TM_REGISTER_DL)
+    {
+        return false;
+    }
+
+    return tm_store_register(p_cpu, p_type, p_value);
+}
+
+long_t tm_get_program_counter (tm_cpu_t* p_cpu)
+{
+    tm_assert(p_cpu != nullptr);
+    return p_cpu->m_registers.m_pc;
+}
+
+/* Public Functions - Bus Read ************************************************/
+
+bool tm_read_byte (tm_cpu_t* p_cpu, addr_t p_address, long_t* p_value)
+{
+    tm_assert(p_cpu != nullptr);
+    tm_assert(p_value != nullptr);
+
+    const byte_t* l_host = tm_map_address(p_cpu, p_address, 1, false);
+    if (l_host != nullptr)
+    {
+        *p_value = *l_host;
+        return true;
+    }
+
+    if (tm_prepare_bus_access(p_cpu, p_address, 1) == false)
+    {
+        return false;
+    }
+
+    if (tm_load_byte(p_cpu, p_address, p_value) == false)
+    {
+        p_cpu->m_registers.m_ea = p_address;
+        return tm_set_error(p_cpu, TM_ERROR_BUS_READ);
+    }
+
+    tm_watch_access(p_cpu, p_address, 1, TM_ACCESS_READ, *p_value);
+    return true;
+}
+
+bool tm_read_word (tm_cpu_t* p_cpu, addr_t p_address, long_t* p_value)
+{
+    tm_assert(p_cpu != nullptr);
+    tm_assert(p_value != nullptr);
+
+    const byte_t* l_host = tm_map_address(p_cpu, p_address, 2, false);
+    if (l_host != nullptr)
+    {
+        *p_value = (l_host[0] << 8) | l_host[1];
+        return true;
+    }
+
+    if (p_cpu->m_read_word != nullptr && tm_is_bus_access(p_cpu, p_address, 2, false) == true)
+    {
+        if (tm_prepare_bus_access(p_cpu, p_address, 2) == false)
+        {
+            return false;
+        }
+
+        if (tm_read_bus(p_cpu, p_cpu->m_read_word, tm_get_user_data(p_cpu), p_address,
+            p_value) == false)
+        {
+            p_cpu->m_registers.m_ea = p_address;
+            return tm_set_error(p_cpu, TM_ERROR_BUS_READ);
+        }
+
+        *p_value &= 0xFFFF;
+        tm_watch_access(p_cpu, p_address, 2, TM_ACCESS_READ, *p_value);
+        return true;
+    }
+
+    if (tm_prepare_bus_access(p_cpu, p_address, 2) == false)
+    {
+        return false;
+    }
+
+    long_t l_byte1 = 0, l_byte0 = 0;
+    if (
+        tm_load_byte(p_cpu, p_address, &l_byte1) == false ||
+        tm_load_byte(p_cpu, p_address + 1, &l_byte0) == false
+    )
+    {
+        p_cpu->m_registers.m_ea = p_address;
+        return tm_set_error(p_cpu, TM_ERROR_BUS_READ);
+    }
+
+    *p_value = (l_byte1 << 8) | l_byte0;
+    tm_watch_access(p_cpu, p_address, 2, TM_ACCESS_READ, *p_value);
+    return true;
+}
+
+bool tm_read_long (tm_cpu_t* p_cpu, addr_t p_address, long_t* p_value)
+{
+    tm_assert(p_cpu != nullptr);
+    tm_assert(p_value != nullptr);
+
+    const byte_t* l_host = tm_map_address(p_cpu, p_address, 4, false);
+    if (l_host != nullptr)
+    {
+        *p_value =
+            ((long_t) l_host[0] << 24) | ((long_t) l_host[1] << 16) |
+            ((long_t) l_host[2] << 8) | l_host[3];
+        return true;
+    }
+
+    if (p_cpu->m_read_long != nullptr && tm_is_bus_access(p_cpu, p_address, 4, false) == true)
+    {
+        if (tm_prepare_bus_access(p_cpu, p_address, 4) == false)
+        {
+            return false;
+        }
+
+        if (tm_read_bus(p_cpu, p_cpu->m_read_long, tm_get_user_data(p_cpu), p_address,
+            p_value) == false)
+        {
+            p_cpu->m_registers.m_ea = p_address;
+            return tm_set_error(p_cpu, TM_ERROR_BUS_READ);
+        }
+
+        tm_watch_access(p_cpu, p_address, 4, TM_ACCESS_READ, *p_value);
+        return true;
+    }
+
+    if (tm_prepare_bus_access(p_cpu, p_address, 4) == false)
+    {
+        return false;
+    }
+
+    long_t l_byte3 = 0, l_byte2 = 0, l_byte1 = 0, l_byte0 = 0;
+    if (
+        tm_load_byte(p_cpu, p_address    , &l_byte3) == false ||
+        tm_load_byte(p_cpu, p_address + 1, &l_byte2) == false ||
+        tm_load_byte(p_cpu, p_address + 2, &l_byte1) == false ||
+        tm_load_byte(p_cpu, p_address + 3, &l_byte0) == false
+    )
+    {
+        p_cpu->m_registers.m_ea = p_address;
+        return tm_set_error(p_cpu, TM_ERROR_BUS_READ);
+    }
+
+    *p_value = (l_byte3 << 24) | (l_byte2 << 16) | (l_byte1 << 8) | l_byte0;
+    tm_watch_access(p_cpu, p_address, 4, TM_ACCESS_READ, *p_value);
+    return true;
+}
+
+/* Public Functions - Bus Write ***********************************************/
+
+bool tm_write_byte (tm_cpu_t* p_cpu, addr_t p_address, long_t p_value)
+{
+    tm_assert(p_cpu != nullptr);
+
+    byte_t* l_host = tm_map_address(p_cpu, p_address, 1, true);
+    if (l_host != nullptr)
+    {
+        *l_host = p_value & 0xFF;
+    }
+    else if (tm_prepare_bus_access(p_cpu, p_address, 1) == false)
+    {
+        return false;
+    }
+    else if (tm_store_byte(p_cpu, p_address, p_value) == false)
+    {
+        p_cpu->m_registers.m_ea = p_address;
+        return tm_set_error(p_cpu, TM_ERROR_BUS_WRITE);
+    }
+
+    if (l_host == nullptr)
+    {
+        tm_watch_access(p_cpu, p_address, 1, TM_ACCESS_WRITE, p_value & 0xFF);
+    }
+
+    tm_check_self_modification(p_cpu, p_address, 1);
+    if (p_cpu->m_trace != nullptr)
+    {
+        tm_trace_write(p_cpu, p_address, 1, p_value & 0xFF);
+    }
+
+    return true;
+}
+
+bool tm_write_word (tm_cpu_t* p_cpu, addr_t p_address, long_t p_value)
+{
+    tm_assert(p_cpu != nullptr);
+
+    byte_t* l_host = tm_map_address(p_cpu, p_address, 2, true);
+    if (l_host != nullptr)
+    {
+        l_host[0] = (p_value >> 8) & 0xFF;
+        l_host[1] = p_value & 0xFF;
+    }
+    else if (p_cpu->m_write_word != nullptr && tm_is_bus_access(p_cpu, p_address, 2, true) == true)
+    {
+        if (tm_prepare_bus_access(p_cpu, p_address, 2) == false)
+        {
+            return false;
+        }
+
+        if (tm_write_bus(p_cpu, p_cpu->m_write_word, tm_get_user_data(p_cpu), p_address,
+            p_value & 0xFFFF) == false)
+        {
+            p_cpu->m_registers.m_ea = p_address;
+            return tm_set_error(p_cpu, TM_ERROR_BUS_WRITE);
+        }
+    }
+    else if (tm_prepare_bus_access(p_cpu, p_address, 2) == false)
+    {
+        return false;
+    }
+    else if (
+        tm_store_byte(p_cpu, p_address, (p_value >> 8) & 0xFF) == false ||
+        tm_store_byte(p_cpu, p_address + 1, p_value & 0xFF) == false
+    )
+    {
+        p_cpu->m_registers.m_ea = p_address;
+        return tm_set_error(p_cpu, TM_ERROR_BUS_WRITE);
+    }
+
+    if (l_host == nullptr)
+    {
+        tm_watch_access(p_cpu, p_address, 2, TM_ACCESS_WRITE, p_value & 0xFFFF);
+    }
+
+    tm_check_self_modification(p_cpu, p_address, 2);
+    if (p_cpu->m_trace != nullptr)
+    {
+        tm_trace_write(p_cpu, p_address, 2, p_value & 0xFFFF);
+    }
+
+    return true;
+}
+
+bool tm_write_long (tm_cpu_t* p_cpu, addr_t p_address, long_t p_value)
+{
+    tm_assert(p_cpu != nullptr);
+
+    byte_t* l_host = tm_map_address(p_cpu, p_address, 4, true);
+    if (l_host != nullptr)
+    {
+        l_host[0] = (p_value >> 24) & 0xFF;
+        l_host[1] = (p_value >> 16) & 0xFF;
+        l_host[2] = (p_value >> 8) & 0xFF;
+        l_host[3] = p_value & 0xFF;
+    }
+    else if (p_cpu->m_write_long != nullptr && tm_is_bus_access(p_cpu, p_address, 4, true) == true)
+    {
+        if (tm_prepare_bus_access(p_cpu, p_address, 4) == false)
+        {
+            return false;
+        }
+
+        if (tm_write_bus(p_cpu, p_cpu->m_write_long, tm_get_user_data(p_cpu), p_address,
+            p_value) == false)
+        {
+            p_cpu->m_registers.m_ea = p_address;
+            return tm_set_error(p_cpu, TM_ERROR_BUS_WRITE);
+        }
+    }
+    else if (tm_prepare_bus_access(p_cpu, p_address, 4) == false)
+    {
+        return false;
+    }
+    else if (
+        tm_store_byte(p_cpu, p_address, (p_value >> 24) & 0xFF) == false ||
+        tm_store_byte(p_cpu, p_address + 1, (p_value >> 16) & 0xFF) == false ||
+        tm_store_byte(p_cpu, p_address + 2, (p_value >> 8) & 0xFF) == false ||
+        tm_store_byte(p_cpu, p_address + 3, p_value & 0xFF) == false
+    )
+    {
+        p_cpu->m_registers.m_ea = p_address;
+        return tm_set_error(p_cpu, TM_ERROR_BUS_WRITE);
+    }
+
+    if (l_host == nullptr)
+    {
+        tm_watch_access(p_cpu, p_address, 4, TM_ACCESS_WRITE, p_value);
+    }
+
+    tm_check_self_modification(p_cpu, p_address, 4);
+    if (p_cpu->m_trace != nullptr)
+    {
+        tm_trace_write(p_cpu, p_address, 4, p_value);
+    }
+
+    return true;
+}
+
+/* Public Functions - Interrupts **********************************************/
+
+void tm_request_interrupt (tm_cpu_t* p_cpu, byte_t p_id)
+{
+    tm_assert(p_cpu != nullptr);
+    if (p_cpu->m_replay != nullptr)
+    {
+        tm_record_interrupts(p_cpu, 1 << (p_id & 0xF));
+        return;
+    }
+
+    tm_set_bit(p_cpu->m_registers.m_if, (p_id & 0xF), true);
+    tm_update_interrupts(p_cpu);
+}
+
+void tm_request_interrupt_async (tm_cpu_t* p_cpu, byte_t p_id)
+{
+    // Unlike `tm_request_interrupt`, this function may be called from any
+    // thread, while the CPU is running on another. The request is added to
+    // `IF` by the CPU's own thread, by the end of its current step, or of its
+    // current block if it is running compiled code.
+    tm_assert(p_cpu != nullptr);
+    atomic_fetch_or_explicit(&p_cpu->m_async_interrupts, (word_t) (1 << (p_id & 0xF)),
+        memory_order_release);
+}
+
+void tm_enable_interrupts (tm_cpu_t* p_cpu, word_t p_mask)
+{
+    // Use this function to set the interrupt enable register, `IE`. Requested
+    // interrupts are only handled if their bits are set in `IE`, and the
+    // interrupt master enable flag is set.
+    tm_assert(p_cpu != nullptr);
+    p_cpu->m_registers.m_ie = p_mask;
+    tm_update_interrupts(p_cpu);
+}
+
+/* Public Functions - Event Scheduler *****************************************/
+
+size_t tm_schedule_event (tm_cpu_t* p_cpu, uint64_t p_cycle, tm_event_handler p_handler,
+    void* p_user_data)
+{
+    // Use this function to have `p_handler` called once the CPU's cycle count
+    // reaches `p_cycle`, instead of counting cycles in the cycle callback - for
+    // timers, say, or for DMA transfers to complete. Events are handled as
+    // soon as the instruction spending the cycle they are due on has spent it,
+    // in the order they are due, and are passed the CPU, `p_user_data` and
+    // the cycle count they were due at. Events due already are handled when
+    // the CPU next spends a cycle. Handlers may schedule further events, such
+    // as the next tick of a periodic timer, and may return false to stop the
+    // CPU with a hardware error.
+    //
+    // Returns an identifier for the event, which can be passed to
+    // `tm_cancel_event` until the event has been handled.
+
+    tm_assert(p_cpu != nullptr);
+    tm_assert(p_handler != nullptr);
+
+    if (p_cpu->m_event_count == p_cpu->m_event_capacity)
+    {
+        size_t l_capacity = (p_cpu->m_event_capacity > 0) ? p_cpu->m_event_capacity * 2 : 16;
+        tm_event_t* l_events = tm_realloc(p_cpu->m_events, l_capacity, tm_event_t);
+        tm_expect_p(l_events, "tm: could not allocate cpu event queue");
+
+        p_cpu->m_events = l_events;
+        p_cpu->m_event_capacity = l_capacity;
+    }
+
+    size_t l_index = p_cpu->m_event_count++;
+    p_cpu->m_events[l_index] = (tm_event_t) {
+        .m_cycle        = p_cycle,
+        .m_id           = ++p_cpu->m_last_event_id,
+        .m_handler      = p_handler,
+        .m_user_data    = p_user_data
+    };
+
+    tm_sift_event(p_cpu, l_index);
+    p_cpu->m_next_event = p_cpu->m_events[0].m_cycle;
+    return p_cpu->m_last_event_id;
+}
+
+size_t tm_schedule_interrupt (tm_cpu_t* p_cpu, uint64_t p_cycle, byte_t p_id)
+{
+    // Use this function to have the interrupt `p_id` requested once the CPU's
+    // cycle count reaches `p_cycle`.
+
+    return tm_schedule_event(p_cpu, p_cycle, tm_raise_interrupt, (void*) (uintptr_t) p_id);
+}
+
+bool tm_cancel_event (tm_cpu_t* p_cpu, size_t p_event)
+{
+    // Returns false if the event has been handled or cancelled already.
+
+    tm_assert(p_cpu != nullptr);
+    for (size_t i = 0; i < p_cpu->m_event_count; ++i)
+    {
+        if (p_cpu->m_events[i].m_id == p_event)
+        {
+            tm_remove_event(p_cpu, i);
+            return true;
+        }
+    }
+
+    return false;
+}
+
+/* Public Functions - Cycle and Step ******************************************/
+
+bool tm_cycle_cpu (tm_cpu_t* p_cpu, size_t p_cycle_count)
+{
+    // Use this function to cycle the CPU a specific number of times. This is
+    // useful for stepping through the CPU's execution cycle without advancing
+    // the program counter.
+    //
+    // Call the `m_cycle` function pointer for each cycle, or count the cycles
+    // towards the next batch if batching is enabled. If the host's callback
+    // returns false, then set the CPU's error flag and return false.
+
+    tm_assert(p_cpu != nullptr);
+    return tm_spend_cycles(p_cpu, p_cycle_count);
+}
+
+bool tm_advance_cpu (tm_cpu_t* p_cpu, size_t p_cycle_count)
+{
+    // Use this function instead of the `tm_cycle_cpu` function if you need to
+    // advance the program counter by the same cycle count.
+
+    tm_assert(p_cpu != nullptr);
+    return tm_advance_pc(p_cpu, p_cycle_count);
+}
+
+void tm_batch_cycles (tm_cpu_t* p_cpu, tm_cycles_ctx p_cycles, size_t p_deadline)
+{
+    // Use this function to stop the CPU calling the host's cycle callback for
+    // every cycle, when the host's timing does not need to be that precise.
+    // Cycles are counted instead, and passed to `p_cycles` - along with the
+    // same user data as the other callbacks - once `p_deadline` of them have
+    // been spent, right before the guest accesses the IO port registers or a
+    // region mapped with handlers, and before `tm_run_cpu` returns. Hosts can
+    // also collect them at any time with `tm_sync_cycles`. `tm_step_cpu` does
+    // not pass them on by itself, so hosts which only ever step the CPU have
+    // to call `tm_sync_cycles` whenever they need to be up to date.
+    //
+    // Passing `nullptr` goes back to calling the cycle callback for every
+    // cycle. Either way, the cycles counted so far are passed on first.
+
+    tm_assert(p_cpu != nullptr);
+    tm_sync_cycles(p_cpu);
+    p_cpu->m_cycles = p_cycles;
+    p_cpu->m_cycle_deadline = (p_deadline > 0) ? p_deadline : 1;
+}
+
+bool tm_sync_cycles (tm_cpu_t* p_cpu)
+{
+    // Use this function to pass the cycles counted since the last batch on to
+    // the host. Does nothing if batching is disabled.
+
+    tm_assert(p_cpu != nullptr);
+    return p_cpu->m_cycles == nullptr || tm_deliver_cycles(p_cpu);
+}
+
+uint64_t tm_get_cycle_count (tm_cpu_t* p_cpu)
+{
+    // Returns the number of cycles spent since the CPU was created. Resetting
+    // the CPU with `tm_init_cpu` does not reset the count, so that scheduled
+    // events stay due when they were.
+
+    tm_assert(p_cpu != nullptr);
+    return p_cpu->m_cycle_count;
+}
+
+uint64_t tm_get_idle_cycles (tm_cpu_t* p_cpu)
+{
+    // Returns the number of cycles the CPU will spend doing nothing: while it
+    // is halted with no interrupt requested, until the next scheduled event
+    // is due. If no event is scheduled, only the host can wake the CPU, and
+    // `UINT64_MAX` is returned. Returns zero if the CPU is not idle. Hosts may
+    // use this to sleep, rather than run a CPU which is waiting.
+
+    tm_assert(p_cpu != nullptr);
+
+    if (
+        p_cpu->m_flags.m_stop == true ||
+        p_cpu->m_flags.m_halt == false ||
+        p_cpu->m_enable_ime == true ||
+        tm_collect_interrupts(p_cpu) != 0
+    )
+    {
+        return 0;
+    }
+
+    return (p_cpu->m_next_event == UINT64_MAX) ?
+        UINT64_MAX : p_cpu->m_next_event - p_cpu->m_cycle_count;
+}
+
+uint64_t tm_get_halted_cycles (tm_cpu_t* p_cpu)
+{
+    // Returns the number of cycles the CPU has spent halted since it was
+    // created. Each of these was also counted as a step, so subtracting them
+    // from the steps executed gives the number of instructions executed.
+
+    tm_assert(p_cpu != nullptr);
+    return p_cpu->m_halted_cycles;
+}
+
+bool tm_step_cpu (tm_cpu_t* p_cpu)
+{
+    tm_assert(p_cpu != nullptr);
+
+    // Remember where the instruction started, and when, for the profiler, the
+    // statistics and the trace.
+    addr_t l_address = p_cpu->m_registers.m_pc;
+    uint64_t l_cycles = p_cpu->m_cycle_count;
+    bool l_halted = p_cpu->m_flags.m_halt;
+    uint64_t l_start = 0;
+    if (p_cpu->m_statistics != nullptr && l_halted == false)
+    {
+        l_start = tm_start_sample(p_cpu->m_statistics);
+    }
+
+    if (p_cpu->m_trace != nullptr)
+    {
+        p_cpu->m_trace->m_record.m_write_count = 0;
+    }
+
+    if (p_cpu->m_flags.m_stop == true)
+    {
+        // The CPU should not run at all if the stop flag is set.
+        return false;
+    }
+
+    // Stop before executing an instruction at a breakpoint.
+    if (p_cpu->m_debugger != nullptr && tm_begin_debug_step(p_cpu) == false)
+    {
+        return false;
+    }
+
+    // Take a checkpoint, or request the interrupts logged before this step,
+    // if recording.
+    if (p_cpu->m_replay != nullptr)
+    {
+        tm_begin_replay_step(p_cpu);
+    }
+
+    if (p_cpu->m_flags.m_halt == false)
+    {
+
+        // The instruction cycle consists of three repeating stages:
+        //
+        // 1. Fetch Stage - Read the next instruction from memory.
+        // 2. Decode Stage - Determine the instruction to be executed and its parameters.
+        // 3. Execute Stage - Fetch necessary operands and execute the instruction.
+        // 4. Repeat until program termination.
+
+        // 1a.  The program counter register contains the opcode of the next
+        //      instruction to be executed. Copy it into the memory address
+        //      register (MAR).
+        p_cpu->m_registers.m_ma = p_cpu->m_registers.m_pc;
+
+        // 1b.  If the instruction at this address was decoded by an earlier
+        //      step and has not been overwritten since, replay it from the
+        //      decode cache, skipping straight to step 3a.
+        //
+        //      Otherwise, fetch and decode the instruction from the bus.
+        tm_decoded_instruction_t* l_entry = nullptr;
+        if (p_cpu->m_decode_cache_enabled == true)
+        {
+            l_entry = tm_lookup_decoded(p_cpu, p_cpu->m_registers.m_ma);
+        }
+
+        bool l_good = false;
+        if (l_entry != nullptr && l_entry->m_valid == true && l_entry->m_address == p_cpu->m_registers.m_ma)
+        {
+            l_good = tm_replay_instruction(p_cpu, l_entry);
+        }
+        else
+        {
+            tm_instruction_handler l_handler = tm_decode_instruction(p_cpu, l_entry);
+            if (l_handler == nullptr)
+            {
+                return tm_end_step(p_cpu, false);
+            }
+
+            // 3a.  Based on the opcode and parameters, fetch any extra
+            //      information needed to execute the instruction, then execute
+            //      the instruction. Commit the instruction to the decode cache
+            //      if it was being recorded and executed successfully.
+            l_good = l_handler(p_cpu);
+            if (p_cpu->m_decoding != nullptr)
+            {
+                p_cpu->m_decoding->m_valid = l_good;
+                p_cpu->m_decoding = nullptr;
+            }
+        }
 
-    // 2. Set the program counter, stack pointer and current instruction
-    //    registers to their initial values.
-    p_cpu->m_registers.m_pc = TM_PROGRAM_START;
-    p_cpu->m_registers.m_sp = 0x10000;
-    p_cpu->m_registers.m_rp = 0x10000;
-    p_cpu->m_registers.m_ci = 0xFFFF;
+        // 3b.  Ensure that the data fetching and instruction execution were
+        //      successful.
+        if (l_good == false)
+        {
+            return tm_end_step(p_cpu, false);
+        }
+
+    }
+    else
+    {
+        // If the CPU is halted, cycle the CPU once and check if an interrupt
+        // has been requested. If an interrupt has been requested, clear the
+        // halt flag.
+        tm_spend_cycles(p_cpu, 1);
+        p_cpu->m_halted_cycles++;
+        tm_replay_step_interrupts(p_cpu);
+        if (tm_collect_interrupts(p_cpu) != 0)
+        {
+            p_cpu->m_flags.m_halt = false;
+        }
+    }
+
+    tm_replay_step_interrupts(p_cpu);
+    tm_finish_step(p_cpu);
+
+    // Count the instruction against its opcode, if statistics are enabled.
+    if (p_cpu->m_statistics != nullptr && l_halted == false)
+    {
+        tm_record_statistics(p_cpu, p_cpu->m_cycle_count - l_cycles, l_start);
+    }
+
+    // Count the instruction against its address, and follow any call made by
+    // it or by an interrupt, if profiling.
+    if (p_cpu->m_profile != nullptr)
+    {
+        if (l_halted == false)
+        {
+            tm_record_profile(p_cpu, l_address, p_cpu->m_cycle_count - l_cycles);
+        }
+        else
+        {
+            tm_follow_call_stack(p_cpu, p_cpu->m_profile);
+        }
+    }
+
+    // Record the instruction, its effects on the registers and the memory
+    // written by it, if tracing.
+    if (p_cpu->m_trace != nullptr && l_halted == false)
+    {
+        tm_record_trace(p_cpu, l_address, p_cpu->m_cycle_count - l_cycles);
+    }
+
+    return tm_end_step(p_cpu, true);
+}
+
+size_t tm_run_cpu (tm_cpu_t* p_cpu, size_t p_budget)
+{
+    // Use this function to execute up to `p_budget` steps in one call. The
+    // outcome is the same as calling `tm_step_cpu` as many times, but with the
+    // block cache enabled, straight-line runs of instructions are translated
+    // into blocks once, then executed from there, following the chains
+    // between blocks without going back through the fetch and decode stages.
+    // With the block cache disabled, instructions are executed by the
+    // interpreter loop, without returning to the caller between steps.
+    //
+    // Returns the number of steps executed, which is less than `p_budget` if
+    // the CPU stopped or an error occurred, or if cycles are batched and the
+    // CPU halted with no event scheduled to wake it.
+
+    tm_assert(p_cpu != nullptr);
+
+    // No block can be executing between calls, so this is a good time to free
+    // the blocks invalidated since the last call.
+    tm_collect_blocks(p_cpu);
+
+    size_t l_steps = 0;
+    tm_block_t* l_previous = nullptr;
+    while (l_steps < p_budget && p_cpu->m_flags.m_stop == false)
+    {
+        size_t l_remaining = p_budget - l_steps;
+        tm_block_t* l_block = nullptr;
+
+        // A halted CPU spends one cycle per step until an interrupt is
+        // requested, so skip ahead to the cycle before the next event is due,
+        // in a single call to the host, if cycles are batched. That last cycle
+        // is stepped, so the event fires and wakes the CPU as it would have.
+        // The host's cycle callback could request an interrupt on any cycle,
+        // so without batching, every cycle is stepped. Recorded CPUs are
+        // stepped through every cycle too, so that the steps replayed match
+        // the steps recorded. Cycles are skipped in bounded chunks, so that
+        // interrupts requested from other threads are still seen. With no
+        // event scheduled, nothing but the host can wake the CPU, so return to
+        // the host rather than spending the rest of the budget.
+        if (p_cpu->m_flags.m_halt == true && p_cpu->m_cycles != nullptr && p_cpu->m_replay == nullptr)
+        {
+            uint64_t l_idle = tm_get_idle_cycles(p_cpu);
+            if (l_idle == UINT64_MAX)
+            {
+                break;
+            }
+            else if (l_idle > 1)
+            {
+                size_t l_skip = (l_idle - 1 < l_remaining) ? l_idle - 1 : l_remaining;
+                if (l_skip > TM_MAX_IDLE_SKIP)
+                {
+                    l_skip = TM_MAX_IDLE_SKIP;
+                }
+
+                if (tm_spend_cycles(p_cpu, l_skip) == false)
+                {
+                    break;
+                }
+
+                p_cpu->m_halted_cycles += l_skip;
+                l_steps += l_skip;
+                continue;
+            }
+        }
+
+        // Without the block cache, stay in the interpreter loop until the
+        // budget runs out, or the CPU halts or stops. The profiler, the
+        // statistics, the trace, the recorder and the debugger need to see
+        // every instruction, so CPUs keeping any of them are always stepped.
+        bool l_stepped = p_cpu->m_profile != nullptr || p_cpu->m_statistics != nullptr ||
+            p_cpu->m_trace != nullptr || p_cpu->m_replay != nullptr || tm_is_debugging(p_cpu);
+        if (p_cpu->m_block_cache_enabled == false && p_cpu->m_flags.m_halt == false &&
+            l_stepped == false)
+        {
+            if (tm_interpret(p_cpu, l_remaining, &l_steps) == false)
+            {
+                break;
+            }
+
+            continue;
+        }
+
+        // Halted CPUs are not executing instructions, so they are stepped.
+        if (p_cpu->m_block_cache_enabled == true && p_cpu->m_flags.m_halt == false &&
+            l_stepped == false)
+        {
+            if (p_cpu->m_retired_count >= TM_MAX_RETIRED_BLOCKS)
+            {
+                tm_collect_blocks(p_cpu);
+                l_previous = nullptr;
+            }
+
+            l_block = tm_find_block(p_cpu, l_previous);
+
+            // Translate a new block if there isn't one here yet, but only if
+            // the budget leaves room for a full block. Leftover budget is
+            // spent stepping instead.
+            if (l_block == nullptr && l_remaining >= TM_MAX_BLOCK_LENGTH)
+            {
+                if (tm_translate_block(p_cpu, &l_block, &l_steps) == false)
+                {
+                    break;
+                }
+
+                tm_chain_block(l_previous, l_block);
+                l_previous = l_block;
+                continue;
+            }
+        }
+
+        if (l_block != nullptr && l_block->m_count <= l_remaining)
+        {
+            size_t l_executed = 0;
+            bool l_good = tm_run_block(p_cpu, l_block, &l_executed);
+            l_steps += l_executed;
+            if (l_good == false)
+            {
+                break;
+            }
+
+            l_previous = (l_executed == l_block->m_count) ? l_block : nullptr;
+        }
+        else if (tm_step_cpu(p_cpu) == true)
+        {
+            l_steps++;
+            l_previous = nullptr;
+        }
+        else
+        {
+            // An instruction which hit a watchpoint was still executed.
+            if (p_cpu->m_debugger != nullptr &&
+                p_cpu->m_debugger->m_break.m_reason == TM_BREAK_WATCHPOINT)
+            {
+                l_steps++;
+            }
+
+            break;
+        }
+    }
+
+    // The host has seen every cycle spent by the time this function returns.
+    tm_sync_cycles(p_cpu);
+    return l_steps;
+}
+
+/* Public Functions - Saved State *********************************************/
+
+size_t tm_save_state (tm_cpu_t* p_cpu, byte_t* p_buffer, size_t p_size)
+{
+    // Use this function to save the CPU's registers, flags and interrupt
+    // state, along with the memory it allocated for a program mapped with
+    // `tm_map_program`, into `p_buffer`. Nothing is written unless the state
+    // fits into the buffer's `p_size` bytes; call this with a size of zero
+    // first to find out how large the buffer has to be.
+    //
+    // The program's ROM, regions mapped by the host, whatever lies behind the
+    // callbacks, and scheduled events are not part of the state. Saving and
+    // restoring those is up to the host.
+    //
+    // Returns the size of the state, in bytes.
+
+    tm_assert(p_cpu != nullptr);
+
+    size_t l_size = TM_STATE_FIXED_SIZE;
+    size_t l_page_count = 0;
+    for (size_t i = 0; i < TM_PAGE_TABLE_COUNT; ++i)
+    {
+        for (size_t j = 0; j < TM_PAGES_PER_TABLE; ++j)
+        {
+            tm_page_t* l_page = tm_find_saved_page(p_cpu, i, j);
+            if (l_page != nullptr && memcmp(l_page->m_host, s_zero_page, TM_PAGE_SIZE) != 0)
+            {
+                l_size += TM_STATE_PAGE_SIZE;
+                l_page_count++;
+            }
+        }
+    }
+
+    if (p_buffer == nullptr || p_size < l_size)
+    {
+        return l_size;
+    }
+
+    // Bring `IF` and the flags register up to date, so that the state holds
+    // everything there is to know about them.
+    tm_collect_interrupts(p_cpu);
+    tm_registers_t* l_registers = &p_cpu->m_registers;
+    const long_t l_longs[] =
+    {
+        l_registers->m_a, l_registers->m_b, l_registers->m_c, l_registers->m_d,
+        l_registers->m_pc, l_registers->m_ea, l_registers->m_ia, l_registers->m_ma,
+        l_registers->m_md, l_registers->m_sp, l_registers->m_rp
+    };
+
+    byte_t* l_cursor = p_buffer;
+    memcpy(l_cursor, "TMST", 4);
+    l_cursor = tm_put_state(l_cursor + 4, TM_STATE_VERSION, 1);
+    for (size_t i = 0; i < sizeof(l_longs) / sizeof(l_longs[0]); ++i)
+    {
+        l_cursor = tm_put_state(l_cursor, l_longs[i], 4);
+    }
+
+    l_cursor = tm_put_state(l_cursor, l_registers->m_ci, 2);
+    l_cursor = tm_put_state(l_cursor, l_registers->m_ie, 2);
+    l_cursor = tm_put_state(l_cursor, l_registers->m_if, 2);
+    l_cursor = tm_put_state(l_cursor, l_registers->m_ec, 1);
+    l_cursor = tm_put_state(l_cursor, tm_get_flags(p_cpu)->m_state, 1);
+    l_cursor = tm_put_state(l_cursor, p_cpu->m_ime, 1);
+    l_cursor = tm_put_state(l_cursor, p_cpu->m_enable_ime, 1);
+    l_cursor = tm_put_state(l_cursor, p_cpu->m_da, 1);
+    l_cursor = tm_put_state(l_cursor, p_cpu->m_cycle_count, 8);
+    l_cursor = tm_put_state(l_cursor, l_page_count, 4);
+
+    for (size_t i = 0; i < TM_PAGE_TABLE_COUNT; ++i)
+    {
+        for (size_t j = 0; j < TM_PAGES_PER_TABLE; ++j)
+        {
+            tm_page_t* l_page = tm_find_saved_page(p_cpu, i, j);
+            if (l_page != nullptr && memcmp(l_page->m_host, s_zero_page, TM_PAGE_SIZE) != 0)
+            {
+                l_cursor = tm_put_state(l_cursor, tm_get_page_address(i, j), 4);
+                memcpy(l_cursor, l_page->m_host, TM_PAGE_SIZE);
+                l_cursor += TM_PAGE_SIZE;
+            }
+        }
+    }
+
+    return l_size;
+}
+
+bool tm_load_state (tm_cpu_t* p_cpu, const byte_t* p_buffer, size_t p_size)
+{
+    // Use this function to restore a state saved with `tm_save_state`, by this
+    // CPU or by another one with the same memory map - that is, with a program
+    // mapped, and the same regions mapped over its memory. Memory the CPU
+    // allocated which is not part of the state is cleared, and instructions
+    // decoded before are discarded. Cycles not yet passed to the host's batch
+    // callback are passed on first.
+    //
+    // Returns false, leaving the CPU as it was, if the state is malformed -
+    // including pages listed twice, or out of order - was saved by a
+    // different version of this library, or covers memory which this CPU
+    // does not allocate.
+
+    tm_assert(p_cpu != nullptr);
+    tm_assert(p_buffer != nullptr || p_size == 0);
+
+    if (
+        p_size < TM_STATE_FIXED_SIZE ||
+        memcmp(p_buffer, "TMST", 4) != 0 ||
+        p_buffer[4] != TM_STATE_VERSION
+    )
+    {
+        return false;
+    }
+
+    // Check every page before changing anything. Pages are saved in order of
+    // their addresses, so a page listed twice, which would be allocated twice,
+    // shows up as an address no higher than the one before it.
+    const byte_t* l_cursor = p_buffer + TM_STATE_FIXED_SIZE - 4;
+    uint64_t l_page_count = tm_get_state(&l_cursor, 4);
+    if (p_size != TM_STATE_FIXED_SIZE + l_page_count * TM_STATE_PAGE_SIZE)
+    {
+        return false;
+    }
+
+    addr_t l_previous = 0;
+    for (uint64_t i = 0; i < l_page_count; ++i)
+    {
+        addr_t l_address = tm_get_state(&l_cursor, 4);
+        if (
+            (l_address & (TM_PAGE_SIZE - 1)) != 0 ||
+            (tm_find_page(p_cpu, l_address)->m_flags & TM_PAGE_BUILT_IN) == 0 ||
+            (i > 0 && l_address <= l_previous)
+        )
+        {
+            return false;
+        }
+
+        l_previous = l_address;
+        l_cursor += TM_PAGE_SIZE;
+    }
+
+    tm_deliver_cycles(p_cpu);
+
+    l_cursor = p_buffer + 5;
+    tm_registers_t* l_registers = &p_cpu->m_registers;
+    long_t* l_longs[] =
+    {
+        &l_registers->m_a, &l_registers->m_b, &l_registers->m_c, &l_registers->m_d,
+        &l_registers->m_pc, &l_registers->m_ea, &l_registers->m_ia, &l_registers->m_ma,
+        &l_registers->m_md, &l_registers->m_sp, &l_registers->m_rp
+    };
+
+    for (size_t i = 0; i < sizeof(l_longs) / sizeof(l_longs[0]); ++i)
+    {
+        *l_longs[i] = tm_get_state(&l_cursor, 4);
+    }
+
+    l_registers->m_ci       = tm_get_state(&l_cursor, 2);
+    l_registers->m_ie       = tm_get_state(&l_cursor, 2);
+    l_registers->m_if       = tm_get_state(&l_cursor, 2);
+    l_registers->m_ec       = tm_get_state(&l_cursor, 1);
+    p_cpu->m_flags.m_state  = tm_get_state(&l_cursor, 1);
+    p_cpu->m_ime            = tm_get_state(&l_cursor, 1) != 0;
+    p_cpu->m_enable_ime     = tm_get_state(&l_cursor, 1) != 0;
+    p_cpu->m_da             = tm_get_state(&l_cursor, 1) != 0;
+    p_cpu->m_cycle_count    = tm_get_state(&l_cursor, 8);
+    p_cpu->m_lazy_op        = TM_LAZY_NONE;
+    tm_update_interrupts(p_cpu);
+    l_cursor += 4;
+
+    // Let go of the memory allocated so far, then allocate the pages which are
+    // part of the state again.
+    for (size_t i = 0; i < TM_PAGE_TABLE_COUNT; ++i)
+    {
+        for (size_t j = 0; j < TM_PAGES_PER_TABLE; ++j)
+        {
+            tm_page_t* l_page = tm_find_saved_page(p_cpu, i, j);
+            if (l_page != nullptr)
+            {
+                tm_release_page_memory(l_page->m_host);
+                l_page->m_host = nullptr;
+                l_page->m_flags &= ~TM_PAGE_SHARED;
+            }
+        }
+    }
+
+    for (uint64_t i = 0; i < l_page_count; ++i)
+    {
+        tm_page_t* l_page = tm_own_page(p_cpu, tm_get_state(&l_cursor, 4));
+        l_page->m_host = tm_allocate_page_memory();
+        memcpy(l_page->m_host, l_cursor, TM_PAGE_SIZE);
+        l_cursor += TM_PAGE_SIZE;
+    }
+
+    tm_flush_decode_cache(p_cpu);
+    return true;
+}
+
+tm_cpu_t* tm_fork_cpu (tm_cpu_t* p_cpu)
+{
+    // Use this function to create a CPU which carries on from this CPU's
+    // current state, independently of it: with the same callbacks and user
+    // data, program, regions, settings, registers and scheduled events. This
+    // makes it cheap to run many jobs from a state which is expensive to set
+    // up - set it up once, then fork a CPU for each job.
+    //
+    // The memory this CPU allocated is not copied. Both CPUs share it, and a
+    // page of it is only copied once either of them writes to it. Forks may
+    // run on other threads than the CPU they were forked from, and either may
+    // be destroyed first, though a CPU must not be running while it is forked.
+    //
+    // Instructions this CPU decoded are not carried over, and neither are its
+    // breakpoints and watchpoints, or the cycles it has yet to pass to its
+    // batch callback.
+
+    tm_assert(p_cpu != nullptr);
+
+    tm_cpu_t* l_fork = (p_cpu->m_legacy_read != nullptr) ?
+        tm_create_cpu(p_cpu->m_legacy_read, p_cpu->m_legacy_write, p_cpu->m_legacy_cycle) :
+        tm_create_cpu_ctx(p_cpu->m_read, p_cpu->m_write, p_cpu->m_cycle, p_cpu->m_user_data);
+
+    // 1. Settings.
+    tm_set_wide_bus(l_fork, p_cpu->m_read_word, p_cpu->m_write_word, p_cpu->m_read_long,
+        p_cpu->m_write_long);
+    l_fork->m_cycles                    = p_cpu->m_cycles;
+    l_fork->m_cycle_deadline            = p_cpu->m_cycle_deadline;
+    l_fork->m_decode_cache_enabled      = p_cpu->m_decode_cache_enabled;
+    l_fork->m_block_cache_enabled       = p_cpu->m_block_cache_enabled;
+    l_fork->m_superoperators_enabled    = p_cpu->m_superoperators_enabled;
+    if (p_cpu->m_jit_enabled == true)
+    {
+        tm_enable_jit(l_fork, true);
+    }
+
+    // 2. The memory map, with the pages of memory this CPU allocated shared
+    //    between both CPUs.
+    l_fork->m_program = p_cpu->m_program;
+    tm_reset_pages(l_fork);
+    for (tm_mapped_region_t* l_mapped = p_cpu->m_regions; l_mapped != nullptr;
+        l_mapped = l_mapped->m_next)
+    {
+        tm_map_region(l_fork, &l_mapped->m_region);
+    }
+
+    for (size_t i = 0; i < TM_PAGE_TABLE_COUNT; ++i)
+    {
+        for (size_t j = 0; j < TM_PAGES_PER_TABLE; ++j)
+        {
+            tm_page_t* l_page = tm_find_saved_page(p_cpu, i, j);
+            if (l_page != nullptr)
+            {
+                atomic_fetch_add_explicit(&tm_get_page_memory(l_page->m_host)->m_references, 1,
+                    memory_order_relaxed);
+                l_page->m_flags |= TM_PAGE_SHARED;
+
+                // Breakpoints and watchpoints are not carried over.
+                tm_page_t* l_copy = tm_own_page(l_fork, tm_get_page_address(i, j));
+                *l_copy = *l_page;
+                l_copy->m_flags &= ~TM_PAGE_DEBUG;
+            }
+        }
+    }
+
+    // 3. The CPU's state, and its scheduled events.
+    tm_collect_interrupts(p_cpu);
+    memcpy(l_fork->m_error_string, p_cpu->m_error_string, TM_ERROR_STRLEN);
+    l_fork->m_registers     = p_cpu->m_registers;
+    l_fork->m_flags         = p_cpu->m_flags;
+    l_fork->m_interrupts    = p_cpu->m_interrupts;
+    l_fork->m_lazy_op       = p_cpu->m_lazy_op;
+    l_fork->m_lazy_width    = p_cpu->m_lazy_width;
+    l_fork->m_lazy_carry    = p_cpu->m_lazy_carry;
+    l_fork->m_lazy_left     = p_cpu->m_lazy_left;
+    l_fork->m_lazy_right    = p_cpu->m_lazy_right;
+    l_fork->m_da            = p_cpu->m_da;
+    l_fork->m_ime           = p_cpu->m_ime;
+    l_fork->m_enable_ime    = p_cpu->m_enable_ime;
+    l_fork->m_cycle_count   = p_cpu->m_cycle_count;
+    l_fork->m_halted_cycles = p_cpu->m_halted_cycles;
+
+    if (p_cpu->m_event_count > 0)
+    {
+        l_fork->m_events = tm_calloc(p_cpu->m_event_capacity, tm_event_t);
+        tm_expect_p(l_fork->m_events, "tm: could not allocate cpu event queue");
+        memcpy(l_fork->m_events, p_cpu->m_events, p_cpu->m_event_count * sizeof(tm_event_t));
+        l_fork->m_event_capacity = p_cpu->m_event_capacity;
+    }
+
+    l_fork->m_event_count       = p_cpu->m_event_count;
+    l_fork->m_last_event_id     = p_cpu->m_last_event_id;
+    l_fork->m_next_event        = p_cpu->m_next_event;
+
+    return l_fork;
+}
+
+/* Public Functions - Profiler ************************************************/
+
+void tm_enable_profiler (tm_cpu_t* p_cpu, bool p_enable)
+{
+    // Use this function to count the instructions executed, and the cycles
+    // spent, at each guest address, along with the calls made to each routine
+    // and the calling contexts they were made from. The profile can then be
+    // retrieved with `tm_get_profile`, or written out by `tm_write_profile`
+    // and `tm_write_profile_stacks`.
+    //
+    // While the profiler is enabled, the CPU is stepped one instruction at a
+    // time, without the block cache or the JIT compiler, so that it sees every
+    // instruction. Disabling the profiler discards the profile. Forked CPUs
+    // start out without a profiler.
+
+    tm_assert(p_cpu != nullptr);
+
+    if (p_enable == true && p_cpu->m_profile == nullptr)
+    {
+        p_cpu->m_profile = tm_create_profile(p_cpu);
+    }
+    else if (p_enable == false && p_cpu->m_profile != nullptr)
+    {
+        tm_destroy_profile(p_cpu->m_profile);
+        p_cpu->m_profile = nullptr;
+    }
+}
+
+void tm_reset_profile (tm_cpu_t* p_cpu)
+{
+    // Use this function to discard everything profiled so far, and start again
+    // from the current instruction. Does nothing if the profiler is disabled.
+
+    tm_assert(p_cpu != nullptr);
+
+    if (p_cpu->m_profile != nullptr)
+    {
+        tm_destroy_profile(p_cpu->m_profile);
+        p_cpu->m_profile = tm_create_profile(p_cpu);
+    }
+}
+
+size_t tm_get_profile (tm_cpu_t* p_cpu, tm_profile_entry_t* p_entries, size_t p_count)
+{
+    // Use this function to retrieve up to `p_count` entries of the profile,
+    // one per address executed or called, sorted by the cycles spent there,
+    // most first. Returns the number of entries in the whole profile, which
+    // may be more than `p_count`, or zero if the profiler is disabled.
+
+    tm_assert(p_cpu != nullptr);
+    tm_assert(p_entries != nullptr || p_count == 0);
+
+    tm_profile_t* l_profile = p_cpu->m_profile;
+    if (l_profile == nullptr || l_profile->m_used_count == 0)
+    {
+        return 0;
+    }
+
+    tm_profile_entry_t* l_sorted = tm_calloc(l_profile->m_used_count, tm_profile_entry_t);
+    tm_expect_p(l_sorted != nullptr, "tm: could not allocate cpu profile entries");
+
+    size_t l_used = 0;
+    for (size_t i = 0; i < l_profile->m_slot_count; ++i)
+    {
+        if (l_profile->m_slots[i].m_used == true)
+        {
+            l_sorted[l_used++] = l_profile->m_slots[i].m_entry;
+        }
+    }
+
+    qsort(l_sorted, l_used, sizeof(tm_profile_entry_t), tm_compare_profile_entries);
+    if (p_count > 0)
+    {
+        memcpy(p_entries, l_sorted, ((p_count < l_used) ? p_count : l_used) * sizeof(tm_profile_entry_t));
+    }
+    tm_free(l_sorted);
+    return l_used;
+}
+
+bool tm_write_profile (tm_cpu_t* p_cpu, FILE* p_file, size_t p_limit)
+{
+    // Use this function to write the profile to `p_file` as a table, one
+    // address per line, sorted by the cycles spent there, most first. Only the
+    // first `p_limit` addresses are written, unless `p_limit` is zero.
+    //
+    // Returns false if the profiler is disabled, or writing failed.
+
+    tm_assert(p_cpu != nullptr);
+    tm_assert(p_file != nullptr);
+
+    if (p_cpu->m_profile == nullptr)
+    {
+        return false;
+    }
+
+    size_t l_count = tm_get_profile(p_cpu, nullptr, 0);
+    tm_profile_entry_t* l_entries = tm_calloc(l_count + 1, tm_profile_entry_t);
+    tm_expect_p(l_entries != nullptr, "tm: could not allocate cpu profile entries");
+    tm_get_profile(p_cpu, l_entries, l_count);
+
+    uint64_t l_total = 0;
+    for (size_t i = 0; i < l_count; ++i)
+    {
+        l_total += l_entries[i].m_cycles;
+    }
+
+    fprintf(p_file, "%-10s %16s %16s %8s %12s\n", "address", "instructions", "cycles", "cycles%",
+        "calls");
+    for (size_t i = 0; i < l_count && (p_limit == 0 || i < p_limit); ++i)
+    {
+        const tm_profile_entry_t* l_entry = &l_entries[i];
+        fprintf(p_file, "$%08X  %16llu %16llu %7.2f%% %12llu\n", l_entry->m_address,
+            (unsigned long long) l_entry->m_instructions, (unsigned long long) l_entry->m_cycles,
+            (l_total > 0) ? 100.0 * (double) l_entry->m_cycles / (double) l_total : 0.0,
+            (unsigned long long) l_entry->m_calls);
+    }
+
+    tm_free(l_entries);
+    return ferror(p_file) == 0;
+}
+
+bool tm_write_profile_stacks (tm_cpu_t* p_cpu, FILE* p_file)
+{
+    // Use this function to write the cycles spent in each calling context to
+    // `p_file`, in the collapsed stack format read by flame graph tools: one
+    // line per context, naming each routine called on the way to it by its
+    // address, outermost first, separated by semicolons, then the cycles
+    // spent in the innermost routine itself.
+    //
+    // Returns false if the profiler is disabled, or writing failed.
+
+    tm_assert(p_cpu != nullptr);
+    tm_assert(p_file != nullptr);
+
+    const tm_profile_t* l_profile = p_cpu->m_profile;
+    if (l_profile == nullptr)
+    {
+        return false;
+    }
+
+    for (size_t i = 0; i < l_profile->m_frame_count; ++i)
+    {
+        if (l_profile->m_frames[i].m_cycles > 0)
+        {
+            tm_write_profile_frame(l_profile, i, p_file);
+            fprintf(p_file, " %llu\n", (unsigned long long) l_profile->m_frames[i].m_cycles);
+        }
+    }
+
+    return ferror(p_file) == 0;
+}
+
+/* Public Functions - Statistics **********************************************/
+
+void tm_enable_statistics (tm_cpu_t* p_cpu, bool p_enable, size_t p_sample_period)
+{
+    // Use this function to count the instructions executed, and the cycles
+    // spent, per opcode. With a non-zero `p_sample_period`, one instruction
+    // in every `p_sample_period` is also timed on the host's clock, which
+    // shows where the host's time goes without timing every instruction.
+    //
+    // Like the profiler, statistics see every instruction by stepping the CPU,
+    // without the block cache or the JIT compiler. Enabling statistics which
+    // are already enabled only changes the sample period. Disabling them
+    // discards the counts.
+
+    tm_assert(p_cpu != nullptr);
+
+    if (p_enable == false)
+    {
+        tm_free(p_cpu->m_statistics);
+        return;
+    }
+
+    if (p_cpu->m_statistics == nullptr)
+    {
+        p_cpu->m_statistics = tm_calloc(1, tm_statistics_t);
+        tm_expect_p(p_cpu->m_statistics != nullptr, "tm: could not allocate cpu statistics");
+    }
+
+    p_cpu->m_statistics->m_sample_period = p_sample_period;
+    p_cpu->m_statistics->m_countdown = p_sample_period;
 }
 
-void tm_destroy_cpu (tm_cpu_t* p_cpu)
+void tm_reset_statistics (tm_cpu_t* p_cpu)
 {
-    tm_hard_assert(p_cpu);
-    tm_free(p_cpu);
-}
+    // Use this function to set every count back to zero. Does nothing if
+    // statistics are disabled.
 
-/* Public Functions - CPU Registers *******************************************/
+    tm_assert(p_cpu != nullptr);
 
-bool tm_read_cpu_register (tm_cpu_t* p_cpu, enum_t p_type, long_t* p_value)
+    if (p_cpu->m_statistics != nullptr)
+    {
+        memset(p_cpu->m_statistics->m_opcodes, 0x00, sizeof(p_cpu->m_statistics->m_opcodes));
+        p_cpu->m_statistics->m_countdown = p_cpu->m_statistics->m_sample_period;
+    }
+}
+
+bool tm_get_opcode_statistics (tm_cpu_t* p_cpu, byte_t p_opcode, tm_opcode_statistics_t* p_stats)
 {
+    // Use this function to retrieve the counts for the opcode whose high byte
+    // is `p_opcode`. Returns false if statistics are disabled.
+
     tm_assert(p_cpu != nullptr);
-    tm_assert(p_value != nullptr);
+    tm_assert(p_stats != nullptr);
 
-    switch (p_type)
-    {
-        case TM_REGISTER_A:     *p_value = p_cpu->m_registers.m_a; break;
-        case TM_REGISTER_AW:    *p_value = p_cpu->m_registers.m_a & 0xFFFF; break;
-        case TM_REGISTER_AH:    *p_value = (p_cpu->m_registers.m_a >> 8) & 0xFF; break;
-        case TM_REGISTER_AL:    *p_value = p_cpu->m_registers.m_a & 0xFF; break;
-        case TM_REGISTER_B:     *p_value = p_cpu->m_registers.m_b; break;
-        case TM_REGISTER_BW:    *p_value = p_cpu->m_registers.m_b & 0xFFFF; break;
-        case TM_REGISTER_BH:    *p_value = (p_cpu->m_registers.m_b >> 8) & 0xFF; break;
-        case TM_REGISTER_BL:    *p_value = p_cpu->m_registers.m_b & 0xFF; break;
-        case TM_REGISTER_C:     *p_value = p_cpu->m_registers.m_c; break;
-        case TM_REGISTER_CW:    *p_value = p_cpu->m_registers.m_c & 0xFFFF; break;
-        case TM_REGISTER_CH:    *p_value = (p_cpu->m_registers.m_c >> 8) & 0xFF; break;
-        case TM_REGISTER_CL:    *p_value = p_cpu->m_registers.m_c & 0xFF; break;
-        case TM_REGISTER_D:     *p_value = p_cpu->m_registers.m_d; break;
-        case TM_REGISTER_DW:    *p_value = p_cpu->m_registers.m_d & 0xFFFF; break;
-        case TM_REGISTER_DH:    *p_value = (p_cpu->m_registers.m_d >> 8) & 0xFF; break;
-        case TM_REGISTER_DL:    *p_value = p_cpu->m_registers.m_d & 0xFF; break;
-        default: return false;
+    if (p_cpu->m_statistics == nullptr)
+    {
+        return false;
     }
 
+    *p_stats = p_cpu->m_statistics->m_opcodes[p_opcode];
     return true;
 }
 
-bool tm_write_cpu_register (tm_cpu_t* p_cpu, enum_t p_type, long_t p_value)
+bool tm_write_statistics (tm_cpu_t* p_cpu, FILE* p_file, bool p_json)
 {
+    // Use this function to write the counts of every opcode executed so far to
+    // `p_file`, either as a table or, if `p_json` is set, as a JSON object
+    // holding an array of opcodes. Host times are given per timed instruction.
+    //
+    // Returns false if statistics are disabled, or writing failed.
+
     tm_assert(p_cpu != nullptr);
+    tm_assert(p_file != nullptr);
 
-    switch (p_type)
+    if (p_cpu->m_statistics == nullptr)
     {
-        case TM_REGISTER_A:     
-            p_cpu->m_registers.m_a = p_value; 
-            break;
-        case TM_REGISTER_AW:    
-            p_cpu->m_registers.m_a = (p_cpu->m_registers.m_a & 0xFFFF0000) | (p_value & 0xFFFF); 
-            break;
-        case TM_REGISTER_AH:    
-            p_cpu->m_registers.m_a = (p_cpu->m_registers.m_a & 0xFFFF00FF) | ((p_value & 0xFF) << 8); 
-            break;
-        case TM_REGISTER_AL:    
-            p_cpu->m_registers.m_a = (p_cpu->m_registers.m_a & 0xFFFFFF00) | (p_value & 0xFF); 
-            break;
-        case TM_REGISTER_B:     
-            p_cpu->m_registers.m_b = p_value; 
-            break;
-        case TM_REGISTER_BW:    
-            p_cpu->m_registers.m_b = (p_cpu->m_registers.m_b & 0xFFFF0000) | (p_value & 0xFFFF); 
-            break;
-        case TM_REGISTER_BH:    
-            p_cpu->m_registers.m_b = (p_cpu->m_registers.m_b & 0xFFFF00FF) | ((p_value & 0xFF) << 8); 
-            break;
-        case TM_REGISTER_BL:    
-            p_cpu->m_registers.m_b = (p_cpu->m_registers.m_b & 0xFFFFFF00) | (p_value & 0xFF); 
-            break;
-        case TM_REGISTER_C:     
-            p_cpu->m_registers.m_c = p_value; 
-            break;
-        case TM_REGISTER_CW:    
-            p_cpu->m_registers.m_c = (p_cpu->m_registers.m_c & 0xFFFF0000) | (p_value & 0xFFFF); 
-            break;
-        case TM_REGISTER_CH:    
-            p_cpu->m_registers.m_c = (p_cpu->m_registers.m_c & 0xFFFF00FF) | ((p_value & 0xFF) << 8); 
-            break;
-        case TM_REGISTER_CL:    
-            p_cpu->m_registers.m_c = (p_cpu->m_registers.m_c & 0xFFFFFF00) | (p_value & 0xFF); 
-            break;
-        case TM_REGISTER_D:     
-            p_cpu->m_registers.m_d = p_value; 
-            break;
-        case TM_REGISTER_DW:    
-            p_cpu->m_registers.m_d = (p_cpu->m_registers.m_d & 0xFFFF0000) | (p_value & 0xFFFF); 
-            break;
-        case TM_REGISTER_DH:    
-            p_cpu->m_registers.m_d = (p_cpu->m_registers.m_d & 0xFFFF00FF) | ((p_value & 0xFF) << 8); 
-            break;
-        case TM_REGISTER_DL:    
-            p_cpu->m_registers.m_d = (p_cpu->m_registers.m_d & 0xFFFFFF00) | (p_value & 0xFF); 
-            break;
-        default: return false;
+        return false;
     }
 
-    return true;
-}
+    if (p_json == true)
+    {
+        fprintf(p_file, "{\n  \"sample_period\": %zu,\n  \"opcodes\": [",
+            p_cpu->m_statistics->m_sample_period);
+    }
+    else
+    {
+        fprintf(p_file, "%-6s %-20s %16s %16s %10s %12s %10s\n", "opcode", "handler",
+            "executions", "cycles", "cycles/op", "samples", "ns/op");
+    }
 
-/* Public Functions - Bus Read ************************************************/
+    bool l_first = true;
+    for (size_t i = 0; i < 0x100; ++i)
+    {
+        const tm_opcode_statistics_t* l_opcode = &p_cpu->m_statistics->m_opcodes[i];
+        if (l_opcode->m_executions == 0)
+        {
+            continue;
+        }
 
-bool tm_read_byte (tm_cpu_t* p_cpu, addr_t p_address, long_t* p_value)
-{
-    tm_assert(p_cpu != nullptr);
-    tm_assert(p_value != nullptr);
+        const char* l_name = (s_instruction_names[i] != nullptr) ? s_instruction_names[i] : "?";
+        double l_cycles = (double) l_opcode->m_cycles / (double) l_opcode->m_executions;
+        double l_nanoseconds = (l_opcode->m_samples > 0) ?
+            (double) l_opcode->m_nanoseconds / (double) l_opcode->m_samples : 0.0;
+
+        if (p_json == true)
+        {
+            fprintf(p_file,
+                "%s\n    { \"opcode\": %zu, \"handler\": \"%s\", \"executions\": %llu, "
+                "\"cycles\": %llu, \"samples\": %llu, \"nanoseconds\": %llu }",
+                (l_first == true) ? "" : ",", i, l_name,
+                (unsigned long long) l_opcode->m_executions, (unsigned long long) l_opcode->m_cycles,
+                (unsigned long long) l_opcode->m_samples,
+                (unsigned long long) l_opcode->m_nanoseconds);
+        }
+        else
+        {
+            fprintf(p_file, "$%02zX    %-20s %16llu %16llu %10.2f %12llu %10.1f\n", i, l_name,
+                (unsigned long long) l_opcode->m_executions, (unsigned long long) l_opcode->m_cycles,
+                l_cycles, (unsigned long long) l_opcode->m_samples, l_nanoseconds);
+        }
 
-    if (p_cpu->m_read(p_address, p_value) == false)
+        l_first = false;
+    }
+
+    if (p_json == true)
     {
-        p_cpu->m_registers.m_ea = p_address;
-        return tm_set_error(p_cpu, TM_ERROR_BUS_READ);
+        fprintf(p_file, "%s]\n}\n", (l_first == true) ? "" : "\n  ");
     }
 
-    return true;
+    return ferror(p_file) == 0;
 }
 
-bool tm_read_word (tm_cpu_t* p_cpu, addr_t p_address, long_t* p_value)
+/* Public Functions - Trace ***************************************************/
+
+bool tm_start_trace (tm_cpu_t* p_cpu, const char* p_filename)
 {
+    // Use this function to record every instruction executed from now on to
+    // the trace file `p_filename`: its address, the instruction itself, the
+    // cycles it took, the registers it changed and the memory it wrote. Any
+    // trace already being recorded is stopped first. The `tmtrace` tool
+    // prints traces, as does a `tm_trace_reader_t`.
+    //
+    // Like the profiler, tracing sees every instruction by stepping the CPU,
+    // without the block cache or the JIT compiler.
+    //
+    // Returns false if the trace file could not be created.
+
     tm_assert(p_cpu != nullptr);
-    tm_assert(p_value != nullptr);
+    tm_assert(p_filename != nullptr);
 
-    long_t l_byte1 = 0, l_byte0 = 0;
-    if (
-        p_cpu->m_read(p_address, &l_byte1) == false ||
-        p_cpu->m_read(p_address + 1, &l_byte0) == false
-    )
+    tm_stop_trace(p_cpu);
+
+    tm_trace_writer_t* l_writer = tm_create_trace_writer(p_filename);
+    if (l_writer == nullptr)
     {
-        p_cpu->m_registers.m_ea = p_address;
-        return tm_set_error(p_cpu, TM_ERROR_BUS_READ);
+        return false;
     }
 
-    *p_value = (l_byte1 << 8) | l_byte0;
+    p_cpu->m_trace = tm_calloc(1, tm_trace_t);
+    tm_expect_p(p_cpu->m_trace != nullptr, "tm: could not allocate cpu trace");
+    p_cpu->m_trace->m_writer = l_writer;
     return true;
 }
 
-bool tm_read_long (tm_cpu_t* p_cpu, addr_t p_address, long_t* p_value)
+bool tm_stop_trace (tm_cpu_t* p_cpu)
 {
+    // Use this function to stop tracing, and write out the rest of the trace.
+    // Returns false if any of the trace could not be written.
+
     tm_assert(p_cpu != nullptr);
-    tm_assert(p_value != nullptr);
 
-    long_t l_byte3 = 0, l_byte2 = 0, l_byte1 = 0, l_byte0 = 0;
-    if (
-        p_cpu->m_read(p_address    , &l_byte3) == false ||
-        p_cpu->m_read(p_address + 1, &l_byte2) == false ||
-        p_cpu->m_read(p_address + 2, &l_byte1) == false ||
-        p_cpu->m_read(p_address + 3, &l_byte0) == false
-    )
+    if (p_cpu->m_trace == nullptr)
     {
-        p_cpu->m_registers.m_ea = p_address;
-        return tm_set_error(p_cpu, TM_ERROR_BUS_READ);
+        return true;
     }
 
-    *p_value = (l_byte3 << 24) | (l_byte2 << 16) | (l_byte1 << 8) | l_byte0;
-    return true;
+    bool l_good = tm_destroy_trace_writer(p_cpu->m_trace->m_writer) &&
+        p_cpu->m_trace->m_failed == false;
+    tm_free(p_cpu->m_trace);
+    return l_good;
 }
 
-/* Public Functions - Bus Write ***********************************************/
+/* Public Functions - Record and Replay ***************************************/
 
-bool tm_write_byte (tm_cpu_t* p_cpu, addr_t p_address, long_t p_value)
+void tm_start_recording (tm_cpu_t* p_cpu, uint64_t p_interval)
 {
+    // Use this function to record the CPU's execution from now on, so that it
+    // can be rewound to any cycle since with `tm_rewind_cpu`. The CPU is
+    // checkpointed every `p_interval` cycles, or every million with zero, and
+    // the values it reads through the callbacks, whether its writes through
+    // them succeed, and the interrupts requested of it are logged in between. Any recording already made is discarded.
+    //
+    // Checkpoints are saved with `tm_save_state`, so memory outside it - the
+    // program's ROM and host memory backing mapped regions - must not change
+    // while recording. Neither must the CPU's state be changed by the host,
+    // other than by requesting interrupts. Like the profiler, recording sees
+    // every step by stepping the CPU, without the block cache or the JIT
+    // compiler, and halted CPUs are stepped through every cycle. Fewer
+    // checkpoints are kept, further apart, as the recording grows.
+
     tm_assert(p_cpu != nullptr);
 
-    if (p_cpu->m_write(p_address, p_value) == false)
-    {
-        p_cpu->m_registers.m_ea = p_address;
-        return tm_set_error(p_cpu, TM_ERROR_BUS_WRITE);
-    }
+    tm_stop_recording(p_cpu);
 
-    return true;
+    tm_replay_t* l_replay = tm_calloc(1, tm_replay_t);
+    tm_expect_p(l_replay, "tm: could not allocate cpu recording");
+    l_replay->m_checkpoints = tm_calloc(TM_MAX_CHECKPOINTS, tm_checkpoint_t);
+    tm_expect_p(l_replay->m_checkpoints, "tm: could not allocate cpu checkpoints");
+    l_replay->m_interval = (p_interval > 0) ? p_interval : TM_CHECKPOINT_INTERVAL;
+
+    p_cpu->m_replay = l_replay;
+    tm_take_checkpoint(p_cpu);
 }
 
-bool tm_write_word (tm_cpu_t* p_cpu, addr_t p_address, long_t p_value)
+void tm_stop_recording (tm_cpu_t* p_cpu)
 {
+    // Use this function to stop recording, and discard the recording. A CPU
+    // which was rewound stays where it is.
+
     tm_assert(p_cpu != nullptr);
 
-    if (
-        p_cpu->m_write(p_address, (p_value >> 8) & 0xFF) == false ||
-        p_cpu->m_write(p_address + 1, p_value & 0xFF) == false
-    )
+    tm_replay_t* l_replay = p_cpu->m_replay;
+    if (l_replay == nullptr)
     {
-        p_cpu->m_registers.m_ea = p_address;
-        return tm_set_error(p_cpu, TM_ERROR_BUS_WRITE);
+        return;
     }
 
-    return true;
+    for (size_t i = 0; i < l_replay->m_checkpoint_count; ++i)
+    {
+        tm_free(l_replay->m_checkpoints[i].m_state);
+    }
+
+    tm_free(l_replay->m_checkpoints);
+    tm_free(l_replay->m_inputs);
+    tm_free(p_cpu->m_replay);
 }
 
-bool tm_write_long (tm_cpu_t* p_cpu, addr_t p_address, long_t p_value)
+bool tm_rewind_cpu (tm_cpu_t* p_cpu, uint64_t p_cycle)
 {
+    // Use this function to bring the CPU back to the state it was in at the
+    // cycle count `p_cycle`, or at the end of the first step to reach it. The
+    // nearest checkpoint before `p_cycle` is restored, and the steps after it
+    // replayed, with their inputs taken from the recording. From there, the
+    // CPU runs on as usual: it replays the rest of the recording, reads from
+    // the callbacks again and resumes recording once it has caught up.
+    //
+    // While replaying, the CPU writes nothing through the callbacks - writes
+    // succeed or fail as they did while recording - and ignores interrupts
+    // requested by the host or by events.
+    //
+    // Returns false if the CPU is not recording, the recording does not cover
+    // `p_cycle`, or the CPU did not behave as it did while recording.
+
     tm_assert(p_cpu != nullptr);
 
-    if (
-        p_cpu->m_write(p_address, (p_value >> 24) & 0xFF) == false ||
-        p_cpu->m_write(p_address + 1, (p_value >> 16) & 0xFF) == false ||
-        p_cpu->m_write(p_address + 2, (p_value >> 8) & 0xFF) == false ||
-        p_cpu->m_write(p_address + 3, p_value & 0xFF) == false
-    )
+    tm_replay_t* l_replay = p_cpu->m_replay;
+    if (l_replay == nullptr)
     {
-        p_cpu->m_registers.m_ea = p_address;
-        return tm_set_error(p_cpu, TM_ERROR_BUS_WRITE);
+        return false;
     }
 
-    return true;
-}
+    if (l_replay->m_replaying == false)
+    {
+        l_replay->m_end_step = l_replay->m_step;
+        l_replay->m_end_cycle = p_cpu->m_cycle_count;
+    }
 
-/* Public Functions - Interrupts **********************************************/
+    if (p_cycle < l_replay->m_checkpoints[0].m_cycle || p_cycle > l_replay->m_end_cycle)
+    {
+        return false;
+    }
 
-void tm_request_interrupt (tm_cpu_t* p_cpu, byte_t p_id)
-{
-    tm_assert(p_cpu != nullptr);
-    tm_set_bit(p_cpu->m_registers.m_if, (p_id & 0xF), true);
-}
+    size_t l_index = l_replay->m_checkpoint_count - 1;
+    while (l_replay->m_checkpoints[l_index].m_cycle > p_cycle)
+    {
+        l_index--;
+    }
 
-/* Public Functions - Cycle and Step ******************************************/
+    const tm_checkpoint_t* l_checkpoint = &l_replay->m_checkpoints[l_index];
+    if (tm_load_state(p_cpu, l_checkpoint->m_state, l_checkpoint->m_size) == false)
+    {
+        return false;
+    }
 
-bool tm_cycle_cpu (tm_cpu_t* p_cpu, size_t p_cycle_count)
-{
-    // Use this function to cycle the CPU a specific number of times. This is
-    // useful for stepping through the CPU's execution cycle without advancing
-    // the program counter.
-    //
-    // Call the `m_cycle` function pointer for each cycle. If the function
-    // returns false, then set the CPU's error flag and return false.
+    l_replay->m_step = l_checkpoint->m_step;
+    l_replay->m_position = l_checkpoint->m_input;
+    l_replay->m_replaying = true;
+    l_replay->m_diverged = false;
+    tm_finish_replay(p_cpu);
 
-    tm_assert(p_cpu != nullptr);
-    for (size_t i = 0; i < p_cycle_count; ++i)
+    while (l_replay->m_replaying == true && p_cpu->m_cycle_count < p_cycle)
     {
-        if (p_cpu->m_cycle() == false)
+        if (tm_step_cpu(p_cpu) == false)
         {
-            return tm_set_error(p_cpu, TM_ERROR_HARDWARE);
+            break;
         }
     }
 
-    return true;
+    return l_replay->m_diverged == false;
 }
 
-bool tm_advance_cpu (tm_cpu_t* p_cpu, size_t p_cycle_count)
+/* Public Functions - Debugger ************************************************/
+
+static tm_debugger_t* tm_get_debugger (tm_cpu_t* p_cpu)
 {
-    // Use this function instead of the `tm_cycle_cpu` function if you need to
-    // advance the program counter by the same cycle count.
+    if (p_cpu->m_debugger == nullptr)
+    {
+        p_cpu->m_debugger = tm_calloc(1, tm_debugger_t);
+        tm_expect_p(p_cpu->m_debugger, "tm: could not allocate cpu debugger");
+    }
 
-    tm_assert(p_cpu != nullptr);
-    bool l_good = tm_cycle_cpu(p_cpu, p_cycle_count);
-    if (l_good == true) { p_cpu->m_registers.m_pc += p_cycle_count; }
-    return l_good;
+    return p_cpu->m_debugger;
 }
 
-bool tm_step_cpu (tm_cpu_t* p_cpu)
+size_t tm_add_breakpoint (tm_cpu_t* p_cpu, addr_t p_address, const tm_break_condition_t* p_condition)
 {
+    // Use this function to stop the CPU before it executes the instruction at
+    // `p_address` - or, if `p_condition` is not `nullptr`, only when the
+    // register it names compares with its value as it says. `tm_step_cpu`
+    // and `tm_run_cpu` return without executing the instruction, and
+    // `tm_get_break` tells the host which breakpoint was hit. Stepping again
+    // executes the instruction, without stopping at the same breakpoint.
+    //
+    // Returns an identifier for the breakpoint, which can be passed to
+    // `tm_remove_breakpoint`, or 0 if the condition is not valid.
+
     tm_assert(p_cpu != nullptr);
 
-    if (p_cpu->m_flags.m_stop == true)
+    if (
+        p_condition != nullptr &&
+        (p_condition->m_register > TM_REGISTER_DL || p_condition->m_compare > TM_COMPARE_GE)
+    )
     {
-        // The CPU should not run at all if the stop flag is set.
-        return false;
+        return 0;
     }
-    else if (p_cpu->m_flags.m_halt == false)
+
+    tm_debugger_t* l_debugger = tm_get_debugger(p_cpu);
+    if (l_debugger->m_breakpoint_count == l_debugger->m_breakpoint_capacity)
     {
+        size_t l_capacity = (l_debugger->m_breakpoint_capacity > 0) ?
+            l_debugger->m_breakpoint_capacity * 2 : 8;
+        tm_breakpoint_t* l_breakpoints = tm_realloc(l_debugger->m_breakpoints, l_capacity,
+            tm_breakpoint_t);
+        tm_expect_p(l_breakpoints, "tm: could not allocate cpu breakpoints");
+
+        l_debugger->m_breakpoints = l_breakpoints;
+        l_debugger->m_breakpoint_capacity = l_capacity;
+    }
 
-        // The instruction cycle consists of three repeating stages:
-        //
-        // 1. Fetch Stage - Read the next instruction from memory.
-        // 2. Decode Stage - Determine the instruction to be executed and its parameters.
-        // 3. Execute Stage - Fetch necessary operands and execute the instruction.
-        // 4. Repeat until program termination.
+    l_debugger->m_breakpoints[l_debugger->m_breakpoint_count++] = (tm_breakpoint_t) {
+        .m_id           = ++l_debugger->m_last_id,
+        .m_address      = p_address,
+        .m_conditional  = (p_condition != nullptr),
+        .m_condition    = (p_condition != nullptr) ? *p_condition : (tm_break_condition_t) { 0 }
+    };
 
-        // 1a.  The program counter register contains the opcode of the next
-        //      instruction to be executed. Copy it into the memory address
-        //      register (MAR).
-        p_cpu->m_registers.m_ma = p_cpu->m_registers.m_pc;
+    tm_mark_debug_pages(p_cpu, p_address, (uint64_t) p_address + 1, TM_PAGE_BREAKPOINT, true);
+    return l_debugger->m_last_id;
+}
 
-        // 1b.  Ensure that the memory address retrieved is within executable
-        //      bounds. Copy the contents of the MAR into the instruction
-        //      address register (IAR) if it is. Throw an execute access 
-        //      violation error if it isn't.
-        if (tm_check_executable(p_cpu, p_cpu->m_registers.m_ma) == false)
-        {
-            return false;
-        }
-        else
-        {
-            p_cpu->m_registers.m_ia = p_cpu->m_registers.m_ma;
-        }
+size_t tm_add_watchpoint (tm_cpu_t* p_cpu, addr_t p_start, size_t p_size, byte_t p_access)
+{
+    // Use this function to stop the CPU after an instruction reads from, or
+    // writes to, any of the `p_size` bytes starting at `p_start`, as
+    // `p_access` (`TM_ACCESS_READ` and/or `TM_ACCESS_WRITE`) says. The
+    // instruction is executed in full, then `tm_step_cpu` and `tm_run_cpu`
+    // return, and `tm_get_break` tells the host which access hit the
+    // watchpoint. Only the guest's own accesses are watched - not the
+    // fetching of its instructions, nor the host's calls to `tm_read_*` and
+    // `tm_write_*` between steps.
+    //
+    // Returns an identifier for the watchpoint, which can be passed to
+    // `tm_remove_watchpoint`, or 0 if the range or access flags are not valid.
 
-        // 1c.  Read a two-byte opcode from the data bus at the address 
-        //      specified in the MAR. Place the word into the memory data 
-        //      register (MDR), then advance the program counter by two places, 
-        //      as two bytes were read.
-        //
-        //      For each byte read from or written to the data bus, the CPU is
-        //      cycled one time.
-        if (tm_read_word(p_cpu, p_cpu->m_registers.m_ma, &p_cpu->m_registers.m_md) == false)
-        {
-            return false;
-        }
-        else if (tm_cycle_cpu(p_cpu, 2) == false)
-        {
-            return false;
-        }
-        else
-        {
-            p_cpu->m_registers.m_pc += 2;
-        }
+    tm_assert(p_cpu != nullptr);
 
-        // 1d.  Copy the contents of the MDR into the current instruction
-        //      register (CIR).
-        p_cpu->m_registers.m_ci = p_cpu->m_registers.m_md;
+    if (
+        p_size == 0 || (uint64_t) p_start + p_size > TM_ADDRESS_SPACE_SIZE ||
+        p_access == 0 || (p_access & ~(TM_ACCESS_READ | TM_ACCESS_WRITE)) != 0
+    )
+    {
+        return 0;
+    }
 
-        // 2a. Reset the instruction and parameter registers to zero.
-        p_cpu->m_inst   = 0;
-        p_cpu->m_param1 = 0;
-        p_cpu->m_param2 = 0;
+    tm_debugger_t* l_debugger = tm_get_debugger(p_cpu);
+    if (l_debugger->m_watchpoint_count == l_debugger->m_watchpoint_capacity)
+    {
+        size_t l_capacity = (l_debugger->m_watchpoint_capacity > 0) ?
+            l_debugger->m_watchpoint_capacity * 2 : 8;
+        tm_watchpoint_t* l_watchpoints = tm_realloc(l_debugger->m_watchpoints, l_capacity,
+            tm_watchpoint_t);
+        tm_expect_p(l_watchpoints, "tm: could not allocate cpu watchpoints");
+
+        l_debugger->m_watchpoints = l_watchpoints;
+        l_debugger->m_watchpoint_capacity = l_capacity;
+    }
 
-        // 2b.  An instruction's operation code (opcode) contains important
-        //      information on the instruction to be executed and its
-        //      parameters:
-        //          -   The upper byte (0xXX00) identifies the instruction to be
-        //              executed.
-        //          -   The lower byte (0x00XX) contains information on the
-        //              instruction's parameters.
-        //          -   In many cases, the upper nibble of this byte (0x00X0)
-        //              indicates a destination register, and the lower nibble
-        //              (0x000X) indicates a source register.
-        //
-        //      Decode the encoded instruction from the CIR, and record the
-        //      decoded information.
-        p_cpu->m_inst   = tm_check_byte(p_cpu->m_registers.m_ci, 1);
-        p_cpu->m_param1 = tm_check_nibble(p_cpu->m_registers.m_ci, 1);
-        p_cpu->m_param2 = tm_check_nibble(p_cpu->m_registers.m_ci, 0);
-
-        // 3a.  Based on the opcode and parameters, fetch any extra information
-        //      needed to execute the instruction, then execute the instruction.
-        bool l_good = false;
-        switch (p_cpu->m_inst)
-        {
-            case 0x00:  l_good = tm_execute_nop(p_cpu);                                         break;
-            case 0x01:  l_good = tm_execute_stop(p_cpu);                                        break;
-            case 0x02:  l_good = tm_execute_halt(p_cpu);                                        break;
-            case 0x03:  l_good = tm_execute_sec(p_cpu);                                         break;
-            case 0x04:  l_good = tm_execute_cec(p_cpu);                                         break;
-            case 0x05:  l_good = tm_execute_di(p_cpu);                                          break;
-            case 0x06:  l_good = tm_execute_ei(p_cpu);                                          break;
-            case 0x07:  l_good = tm_execute_daa(p_cpu);                                         break;
-            case 0x08:  l_good = tm_execute_cpl(p_cpu);                                         break;
-            case 0x09:  l_good = tm_execute_cpw(p_cpu);                                         break;
-            case 0x0A:  l_good = tm_execute_cpb(p_cpu);                                         break;
-            case 0x0B:  l_good = tm_execute_scf(p_cpu);                                         break;
-            case 0x0C:  l_good = tm_execute_ccf(p_cpu);                                         break;
-
-            case 0x10:  l_good = tm_fetch_reg_imm(p_cpu)        && tm_execute_ld(p_cpu);        break;
-            case 0x11:  l_good = tm_fetch_reg_addr32(p_cpu)     && tm_execute_ld(p_cpu);        break;
-            case 0x12:  l_good = tm_fetch_reg_regptr32(p_cpu)   && tm_execute_ld(p_cpu);        break;
-            case 0x13:  l_good = tm_fetch_reg_addr16(p_cpu)     && tm_execute_ld(p_cpu);        break;
-            case 0x15:  l_good = tm_fetch_reg_addr8(p_cpu)      && tm_execute_ld(p_cpu);        break;
-            case 0x17:  l_good = tm_fetch_addr32_reg(p_cpu)     && tm_execute_st(p_cpu);        break;
-            case 0x18:  l_good = tm_fetch_regptr32_reg(p_cpu)   && tm_execute_st(p_cpu);        break;
-            case 0x19:  l_good = tm_fetch_addr16_reg(p_cpu)     && tm_execute_st(p_cpu);        break;
-            case 0x1B:  l_good = tm_fetch_addr8_reg(p_cpu)      && tm_execute_st(p_cpu);        break;
-            case 0x1D:  l_good = tm_fetch_reg(p_cpu, true)      && tm_execute_mv(p_cpu);        break;
-            case 0x1E:  l_good = tm_fetch_reg(p_cpu, true)      && tm_execute_push(p_cpu);      break;
-            case 0x1F:  l_good = tm_execute_pop(p_cpu);                                         break;
-
-            case 0x20:  l_good = tm_fetch_addr32(p_cpu, false)  && tm_execute_jmp(p_cpu);       break;
-            case 0x21:  l_good = tm_fetch_regptr32(p_cpu, false)&& tm_execute_jmp(p_cpu);       break;
-            case 0x22:  l_good = tm_fetch_imm16(p_cpu)          && tm_execute_jpb(p_cpu);       break;
-            case 0x23:  l_good = tm_fetch_addr32(p_cpu, false)  && tm_execute_call(p_cpu);      break;
-            case 0x24:  l_good = tm_execute_rst(p_cpu);                                         break;
-            case 0x25:  l_good = tm_execute_ret(p_cpu);                                         break;
-            case 0x26:  l_good = tm_execute_reti(p_cpu);                                        break;
-            case 0x27:  
-            case 0xFF:  l_good = tm_execute_jps(p_cpu);                                         break;
-
-            case 0x30:  l_good = tm_fetch_reg(p_cpu, false)     && tm_execute_inc(p_cpu);       break;
-            case 0x31:  l_good = tm_fetch_regptr32(p_cpu, true) && tm_execute_inc(p_cpu);       break;
-            case 0x32:  l_good = tm_fetch_reg(p_cpu, false)     && tm_execute_dec(p_cpu);       break;
-            case 0x33:  l_good = tm_fetch_regptr32(p_cpu, true) && tm_execute_dec(p_cpu);       break;
-            case 0x34:  l_good = tm_fetch_reg_imm(p_cpu)        && tm_execute_add(p_cpu, false);break;
-            case 0x35:  l_good = tm_fetch_reg(p_cpu, true)      && tm_execute_add(p_cpu, false);break;
-            case 0x36:  l_good = tm_fetch_reg_regptr32(p_cpu)   && tm_execute_add(p_cpu, false);break;
-            case 0x37:  l_good = tm_fetch_reg_imm(p_cpu)        && tm_execute_add(p_cpu, true); break;
-            case 0x38:  l_good = tm_fetch_reg(p_cpu, true)      && tm_execute_add(p_cpu, true); break;
-            case 0x39:  l_good = tm_fetch_reg_regptr32(p_cpu)   && tm_execute_add(p_cpu, true); break;
-            case 0x3A:  l_good = tm_fetch_reg_imm(p_cpu)        && tm_execute_sub(p_cpu, false);break;
-            case 0x3B:  l_good = tm_fetch_reg(p_cpu, true)      && tm_execute_sub(p_cpu, false);break;
-            case 0x3C:  l_good = tm_fetch_reg_regptr32(p_cpu)   && tm_execute_sub(p_cpu, false);break;
-            case 0x3D:  l_good = tm_fetch_reg_imm(p_cpu)        && tm_execute_sub(p_cpu, true); break;
-            case 0x3E:  l_good = tm_fetch_reg(p_cpu, true)      && tm_execute_sub(p_cpu, true); break;
-            case 0x3F:  l_good = tm_fetch_reg_regptr32(p_cpu)   && tm_execute_sub(p_cpu, true); break;
-
-            case 0x40:  l_good = tm_fetch_reg_imm(p_cpu)        && tm_execute_and(p_cpu);       break;
-            case 0x41:  l_good = tm_fetch_reg(p_cpu, true)      && tm_execute_and(p_cpu);       break;
-            case 0x42:  l_good = tm_fetch_reg_regptr32(p_cpu)   && tm_execute_and(p_cpu);       break;
-            case 0x43:  l_good = tm_fetch_reg_imm(p_cpu)        && tm_execute_or(p_cpu);        break;
-            case 0x44:  l_good = tm_fetch_reg(p_cpu, true)      && tm_execute_or(p_cpu);        break;
-            case 0x45:  l_good = tm_fetch_reg_regptr32(p_cpu)   && tm_execute_or(p_cpu);        break;
-            case 0x46:  l_good = tm_fetch_reg_imm(p_cpu)        && tm_execute_xor(p_cpu);       break;
-            case 0x47:  l_good = tm_fetch_reg(p_cpu, true)      && tm_execute_xor(p_cpu);       break;
-            case 0x48:  l_good = tm_fetch_reg_regptr32(p_cpu)   && tm_execute_xor(p_cpu);       break;
-            case 0x49:  l_good = tm_fetch_reg_imm(p_cpu)        && tm_execute_cmp(p_cpu);       break;
-            case 0x4A:  l_good = tm_fetch_reg(p_cpu, true)      && tm_execute_cmp(p_cpu);       break;
-            case 0x4B:  l_good = tm_fetch_reg_regptr32(p_cpu)   && tm_execute_cmp(p_cpu);       break;
-
-            case 0x50:  l_good = tm_fetch_reg(p_cpu, false)     && tm_execute_sla(p_cpu);       break;
-            case 0x51:  l_good = tm_fetch_regptr32(p_cpu, true) && tm_execute_sla(p_cpu);       break;
-            case 0x52:  l_good = tm_fetch_reg(p_cpu, false)     && tm_execute_sra(p_cpu);       break;
-            case 0x53:  l_good = tm_fetch_regptr32(p_cpu, true) && tm_execute_sra(p_cpu);       break;
-            case 0x54:  l_good = tm_fetch_reg(p_cpu, false)     && tm_execute_srl(p_cpu);       break;
-            case 0x55:  l_good = tm_fetch_regptr32(p_cpu, true) && tm_execute_srl(p_cpu);       break;
-            case 0x56:  l_good = tm_fetch_reg(p_cpu, false)     && tm_execute_rl(p_cpu);        break;
-            case 0x57:  l_good = tm_fetch_regptr32(p_cpu, true) && tm_execute_rl(p_cpu);        break;
-            case 0x58:  l_good = tm_fetch_reg(p_cpu, false)     && tm_execute_rlc(p_cpu);       break;
-            case 0x59:  l_good = tm_fetch_regptr32(p_cpu, true) && tm_execute_rlc(p_cpu);       break;
-            case 0x5A:  l_good = tm_fetch_reg(p_cpu, false)     && tm_execute_rr(p_cpu);        break;
-            case 0x5B:  l_good = tm_fetch_regptr32(p_cpu, true) && tm_execute_rr(p_cpu);        break;
-            case 0x5C:  l_good = tm_fetch_reg(p_cpu, false)     && tm_execute_rrc(p_cpu);       break;
-            case 0x5D:  l_good = tm_fetch_regptr32(p_cpu, true) && tm_execute_rrc(p_cpu);       break;
-
-            case 0x60:  l_good = tm_fetch_reg(p_cpu, true)      && tm_execute_bit(p_cpu);       break;
-            case 0x61:  l_good = tm_fetch_regptr32(p_cpu, true) && tm_execute_bit(p_cpu);       break;
-            case 0x62:  l_good = tm_fetch_reg(p_cpu, true)      && tm_execute_set(p_cpu);       break;
-            case 0x63:  l_good = tm_fetch_regptr32(p_cpu, true) && tm_execute_set(p_cpu);       break;
-            case 0x64:  l_good = tm_fetch_reg(p_cpu, true)      && tm_execute_res(p_cpu);       break;
-            case 0x65:  l_good = tm_fetch_regptr32(p_cpu, true) && tm_execute_res(p_cpu);       break;
-            case 0x66:  l_good = tm_fetch_reg(p_cpu, false)     && tm_execute_swap(p_cpu);      break;
-            case 0x67:  l_good = tm_fetch_regptr32(p_cpu, true) && tm_execute_swap(p_cpu);      break;
+    tm_watchpoint_t* l_watch = &l_debugger->m_watchpoints[l_debugger->m_watchpoint_count++];
+    *l_watch = (tm_watchpoint_t) {
+        .m_id       = ++l_debugger->m_last_id,
+        .m_start    = p_start,
+        .m_end      = (uint64_t) p_start + p_size,
+        .m_access   = p_access
+    };
 
-            default:
-                return tm_set_error(p_cpu, TM_ERROR_INVALID_OPCODE);
-        }
+    tm_mark_debug_pages(p_cpu, l_watch->m_start, l_watch->m_end, TM_PAGE_WATCHED, true);
+    return l_watch->m_id;
+}
 
-        // 3b.  Ensure that the data fetching and instruction execution were
-        //      successful.
-        if (l_good == false)
-        {
-            return false;
-        }
+bool tm_remove_breakpoint (tm_cpu_t* p_cpu, size_t p_id)
+{
+    // Returns false if there is no breakpoint with the identifier `p_id`.
 
-    }
-    else
+    tm_assert(p_cpu != nullptr);
+
+    tm_debugger_t* l_debugger = p_cpu->m_debugger;
+    for (size_t i = 0; l_debugger != nullptr && i < l_debugger->m_breakpoint_count; ++i)
     {
-        // If the CPU is halted, cycle the CPU once and check if an interrupt
-        // has been requested. If an interrupt has been requested, clear the
-        // halt flag.
-        tm_cycle_cpu(p_cpu, 1);
-        if (p_cpu->m_registers.m_if != 0)
+        if (l_debugger->m_breakpoints[i].m_id == p_id)
         {
-            p_cpu->m_flags.m_halt = false;
+            addr_t l_address = l_debugger->m_breakpoints[i].m_address;
+            l_debugger->m_breakpoint_count--;
+            l_debugger->m_breakpoints[i] = l_debugger->m_breakpoints[l_debugger->m_breakpoint_count];
+
+            // Clear the page's mark, then put back the marks of whatever else
+            // shares it.
+            tm_mark_debug_pages(p_cpu, l_address, (uint64_t) l_address + 1, TM_PAGE_BREAKPOINT,
+                false);
+            tm_apply_debug_pages(p_cpu);
+            return true;
         }
     }
 
-    // If the CPU's interrupt master enable flag is set, handle any pending
-    // interrupts if their respective interrupt enable bit is set.
-    if (p_cpu->m_ime == true)
+    return false;
+}
+
+bool tm_remove_watchpoint (tm_cpu_t* p_cpu, size_t p_id)
+{
+    // Returns false if there is no watchpoint with the identifier `p_id`.
+
+    tm_assert(p_cpu != nullptr);
+
+    tm_debugger_t* l_debugger = p_cpu->m_debugger;
+    for (size_t i = 0; l_debugger != nullptr && i < l_debugger->m_watchpoint_count; ++i)
     {
-        tm_handle_interrupts(p_cpu);
-        p_cpu->m_enable_ime = false;
+        if (l_debugger->m_watchpoints[i].m_id == p_id)
+        {
+            tm_watchpoint_t l_watch = l_debugger->m_watchpoints[i];
+            l_debugger->m_watchpoint_count--;
+            l_debugger->m_watchpoints[i] = l_debugger->m_watchpoints[l_debugger->m_watchpoint_count];
+            tm_mark_debug_pages(p_cpu, l_watch.m_start, l_watch.m_end, TM_PAGE_WATCHED, false);
+            tm_apply_debug_pages(p_cpu);
+            return true;
+        }
     }
 
-    // If the `EI` instruction set the `enable_ime` flag, enable the interrupt
-    // master flag.
-    if (p_cpu->m_enable_ime == true)
+    return false;
+}
+
+bool tm_get_break (tm_cpu_t* p_cpu, tm_break_t* p_break)
+{
+    // Use this function, once `tm_step_cpu` or `tm_run_cpu` returns early, to
+    // find out whether the last step stopped at a breakpoint or watchpoint,
+    // rather than on an error or the stop flag.
+    //
+    // Returns false, with `p_break` left alone, if it did not.
+
+    tm_assert(p_cpu != nullptr);
+    tm_assert(p_break != nullptr);
+
+    if (p_cpu->m_debugger == nullptr || p_cpu->m_debugger->m_break.m_reason == TM_BREAK_NONE)
     {
-        p_cpu->m_ime = true;
+        return false;
     }
 
+    *p_break = p_cpu->m_debugger->m_break;
     return true;
 }
 
@@ -2469,6 +7722,12 @@ bool tm_has_error (tm_cpu_t* p_cpu)
         p_cpu->m_flags.m_stop == true;
 }
 
+byte_t tm_get_error_code (tm_cpu_t* p_cpu)
+{
+    tm_assert(p_cpu != nullptr);
+    return p_cpu->m_registers.m_ec;
+}
+
 const char* tm_get_error (tm_cpu_t* p_cpu)
 {
     tm_assert(p_cpu != nullptr);
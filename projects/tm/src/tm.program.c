@@ -2,29 +2,85 @@
 
 #include <tm.program.h>
 
-/* Public Functions ***********************************************************/
+// Program files are mapped into memory, rather than read, on systems with
+// `mmap`. Pages of the ROM are then only read from the file once they are
+// accessed, and processes running the same program share their copies.
+#if defined(TM_LINUX)
+    #define TM_MAPPED_ROM
+    #include <fcntl.h>
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+    #include <unistd.h>
+#endif
 
-tm_program_t* tm_create_program (const char* p_filename)
-{
-    tm_program_t* l_program = tm_calloc(1, tm_program_t);
-    tm_expect_p(l_program != nullptr, "tm: failed to allocate memory for program structure!\n");
+/* Static Functions ***********************************************************/
 
-    if (tm_init_program(l_program, p_filename) == false)
+static bool tm_check_rom_size (const char* p_filename, long long p_rom_size)
+{
+    if (p_rom_size < TM_ROM_MINIMUM_SIZE)
     {
-        tm_destroy_program(l_program);
-        return nullptr;
+        tm_errorf("tm: program file '%s' is too small!\n", p_filename);
+        tm_errorf("tm:   minimum size is %u bytes, but file is %lld bytes.\n", TM_ROM_MINIMUM_SIZE, p_rom_size);
+        return false;
+    }
+    else if (p_rom_size > TM_ROM_SIZE)
+    {
+        tm_errorf("tm: program file '%s' is too large!\n", p_filename);
+        tm_errorf("tm:   maximum size is %u bytes, but file is %lld bytes.\n", TM_ROM_SIZE, p_rom_size);
+        return false;
     }
 
-    return l_program;
+    return true;
 }
 
-bool tm_init_program (tm_program_t* p_program, const char* p_filename)
+#if defined(TM_MAPPED_ROM)
+
+static bool tm_load_rom (tm_program_t* p_program, const char* p_filename)
 {
-    // Validate input parameters.
-    tm_expect(p_program != nullptr, "tm: program structure is null!\n");
-    tm_expect(p_filename != nullptr, "tm: program filename is null!\n");
-    tm_expect(p_filename[0] != '\0', "tm: program filename is empty!\n");
+    // Attempt to open the program file.
+    int l_file = open(p_filename, O_RDONLY);
+    if (l_file < 0)
+    {
+        tm_perrorf("tm: failed to open program file '%s'", p_filename);
+        return false;
+    }
 
+    // Attempt to determine and validate the size of the program file.
+    struct stat l_stat;
+    if (fstat(l_file, &l_stat) != 0)
+    {
+        tm_perrorf("tm: failed to determine size of program file '%s'", p_filename);
+        close(l_file);
+        return false;
+    }
+    else if (tm_check_rom_size(p_filename, (long long) l_stat.st_size) == false)
+    {
+        close(l_file);
+        return false;
+    }
+
+    // Attempt to map the program ROM. The mapping is private, so writes to the
+    // ROM copy the pages written to, and never reach the file. The mapping
+    // stays valid once the file is closed.
+    void* l_rom = mmap(nullptr, (size_t) l_stat.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE,
+        l_file, 0);
+    close(l_file);
+    if (l_rom == MAP_FAILED)
+    {
+        tm_perrorf("tm: failed to map program file '%s'", p_filename);
+        return false;
+    }
+
+    p_program->m_rom = l_rom;
+    p_program->m_rom_size = (size_t) l_stat.st_size;
+    p_program->m_mapped = true;
+    return true;
+}
+
+#else
+
+static bool tm_load_rom (tm_program_t* p_program, const char* p_filename)
+{
     // Attempt to open the program file.
     FILE* l_file = fopen(p_filename, "rb");
     if (l_file == nullptr)
@@ -42,17 +98,8 @@ bool tm_init_program (tm_program_t* p_program, const char* p_filename)
         fclose(l_file);
         return false;
     }
-    else if (l_rom_size < TM_ROM_MINIMUM_SIZE)
+    else if (tm_check_rom_size(p_filename, l_rom_size) == false)
     {
-        tm_errorf("tm: program file '%s' is too small!\n", p_filename);
-        tm_errorf("tm:   minimum size is %u bytes, but file is %ld bytes.\n", TM_ROM_MINIMUM_SIZE, l_rom_size);
-        fclose(l_file);
-        return false;
-    }
-    else if (l_rom_size > TM_ROM_SIZE)
-    {
-        tm_errorf("tm: program file '%s' is too large!\n", p_filename);
-        tm_errorf("tm:   maximum size is %u bytes, but file is %ld bytes.\n", TM_ROM_SIZE, l_rom_size);
         fclose(l_file);
         return false;
     }
@@ -70,7 +117,7 @@ bool tm_init_program (tm_program_t* p_program, const char* p_filename)
         fclose(l_file);
         return false;
     }
-    
+
     // Attempt to read the program ROM from the file.
     size_t read_size = fread(p_program->m_rom, sizeof(byte_t), p_program->m_rom_size, l_file);
     if (read_size != p_program->m_rom_size)
@@ -81,6 +128,57 @@ bool tm_init_program (tm_program_t* p_program, const char* p_filename)
         return false;
     }
 
+    fclose(l_file);
+    return true;
+}
+
+#endif
+
+static void tm_release_rom (tm_program_t* p_program)
+{
+    #if defined(TM_MAPPED_ROM)
+        if (p_program->m_mapped == true)
+        {
+            munmap(p_program->m_rom, p_program->m_rom_size);
+            p_program->m_rom = nullptr;
+            p_program->m_mapped = false;
+            return;
+        }
+    #endif
+
+    tm_free(p_program->m_rom);
+}
+
+/* Public Functions ***********************************************************/
+
+tm_program_t* tm_create_program (const char* p_filename)
+{
+    tm_program_t* l_program = tm_calloc(1, tm_program_t);
+    tm_expect_p(l_program != nullptr, "tm: failed to allocate memory for program structure!\n");
+
+    if (tm_init_program(l_program, p_filename) == false)
+    {
+        tm_destroy_program(l_program);
+        return nullptr;
+    }
+
+    return l_program;
+}
+
+bool tm_init_program (tm_program_t* p_program, const char* p_filename)
+{
+    // Validate input parameters.
+    tm_expect(p_program != nullptr, "tm: program structure is null!\n");
+    tm_expect(p_filename != nullptr, "tm: program filename is null!\n");
+    tm_expect(p_filename[0] != '\0', "tm: program filename is empty!\n");
+
+    // Attempt to load the program ROM from the file. Only the pages holding
+    // the header are read from a mapped file here.
+    if (tm_load_rom(p_program, p_filename) == false)
+    {
+        return false;
+    }
+
     // Validate the magic number from the ROM.
     if (
         (p_program->m_rom[TM_MAGIC_NUMBER_ADDRESS + 0] != 'T') ||
@@ -90,8 +188,7 @@ bool tm_init_program (tm_program_t* p_program, const char* p_filename)
     )
     {
         tm_errorf("tm: program file '%s' is not a valid tm program.\n", p_filename);
-        tm_free(p_program->m_rom);
-        fclose(l_file);
+        tm_release_rom(p_program);
         return false;
     }
 
@@ -104,8 +201,7 @@ bool tm_init_program (tm_program_t* p_program, const char* p_filename)
     else
     {
         tm_errorf("tm: program file '%s' is too small to contain a valid program name.\n", p_filename);
-        tm_free(p_program->m_rom);
-        fclose(l_file);
+        tm_release_rom(p_program);
         return false;
     }
 
@@ -118,12 +214,10 @@ bool tm_init_program (tm_program_t* p_program, const char* p_filename)
     else
     {
         tm_errorf("tm: program file '%s' is too small to contain a valid program author.\n", p_filename);
-        tm_free(p_program->m_rom);
-        fclose(l_file);
+        tm_release_rom(p_program);
         return false;
     }
 
-    fclose(l_file);
     return true;
 }
 
@@ -131,8 +225,7 @@ void tm_destroy_program (tm_program_t* p_program)
 {
     if (p_program != nullptr)
     {
-        tm_free(p_program->m_rom);
-        p_program->m_rom = nullptr;
+        tm_release_rom(p_program);
         tm_free(p_program);
         p_program = nullptr;
     }
@@ -167,4 +260,103 @@ bool tm_write_rom_byte (tm_program_t* p_program, addr_t p_address, byte_t p_byte
 
     p_program->m_rom[p_address] = p_byte;
     return true;
-}
\ No newline at end of file
+}
+
+/* Public Functions - ROM Spans ***********************************************/
+
+const byte_t* tm_get_rom_span (tm_program_t* p_program, addr_t p_address, size_t p_size)
+{
+    // Use this function to access `p_size` bytes of the program's ROM, from
+    // `p_address`, in place. The range is checked once, rather than per byte,
+    // so hosts and tools can read whole ranges at a time.
+    //
+    // Returns `nullptr`, without logging anything, if the range does not lie
+    // entirely within the ROM.
+
+    tm_assert(p_program != nullptr && p_program->m_rom != nullptr);
+
+    if (p_size > p_program->m_rom_size || p_address > p_program->m_rom_size - p_size)
+    {
+        return nullptr;
+    }
+
+    return p_program->m_rom + p_address;
+}
+
+bool tm_read_rom (tm_program_t* p_program, addr_t p_address, byte_t* p_buffer, size_t p_size)
+{
+    // Use this function to copy `p_size` bytes of the program's ROM, from
+    // `p_address`, into `p_buffer`. Returns false, copying nothing, if the
+    // range does not lie entirely within the ROM.
+
+    tm_assert(p_buffer != nullptr || p_size == 0);
+
+    const byte_t* l_span = tm_get_rom_span(p_program, p_address, p_size);
+    if (l_span == nullptr)
+    {
+        return false;
+    }
+
+    memcpy(p_buffer, l_span, p_size);
+    return true;
+}
+
+bool tm_write_rom (tm_program_t* p_program, addr_t p_address, const byte_t* p_buffer,
+    size_t p_size)
+{
+    // Use this function to patch `p_size` bytes of the program's ROM, from
+    // `p_address`, with the bytes in `p_buffer`. Returns false, patching
+    // nothing, if the range does not lie entirely within the ROM.
+    //
+    // CPUs with the program mapped may have decoded the old bytes already, so
+    // flush their decode caches after patching code.
+
+    tm_assert(p_buffer != nullptr || p_size == 0);
+
+    const byte_t* l_span = tm_get_rom_span(p_program, p_address, p_size);
+    if (l_span == nullptr)
+    {
+        return false;
+    }
+
+    memmove(p_program->m_rom + p_address, p_buffer, p_size);
+    return true;
+}
+
+bool tm_read_rom_word (tm_program_t* p_program, addr_t p_address, word_t* p_value)
+{
+    // Use this function to read the word at `p_address` in the program's ROM.
+    // Like the CPU's bus, the most significant byte comes first. Returns false
+    // if the word does not lie entirely within the ROM.
+
+    tm_assert(p_value != nullptr);
+
+    const byte_t* l_span = tm_get_rom_span(p_program, p_address, sizeof(word_t));
+    if (l_span == nullptr)
+    {
+        return false;
+    }
+
+    *p_value = (word_t) ((l_span[0] << 8) | l_span[1]);
+    return true;
+}
+
+bool tm_read_rom_long (tm_program_t* p_program, addr_t p_address, long_t* p_value)
+{
+    // Use this function to read the long at `p_address` in the program's ROM,
+    // most significant byte first. Returns false if the long does not lie
+    // entirely within the ROM.
+
+    tm_assert(p_value != nullptr);
+
+    const byte_t* l_span = tm_get_rom_span(p_program, p_address, sizeof(long_t));
+    if (l_span == nullptr)
+    {
+        return false;
+    }
+
+    *p_value =
+        ((long_t) l_span[0] << 24) | ((long_t) l_span[1] << 16) |
+        ((long_t) l_span[2] << 8) | l_span[3];
+    return true;
+}
@@ -0,0 +1,462 @@
+/// @file tm.runner.c
+
+#include <tm.runner.h>
+#include <stdatomic.h>
+
+// Instances are spread across worker threads on systems with POSIX threads;
+// elsewhere, they all run on the calling thread.
+#if defined(TM_LINUX)
+    #define TM_RUNNER_THREADS
+    #include <pthread.h>
+    #include <sched.h>
+    #include <unistd.h>
+#endif
+
+/* Private Constants **********************************************************/
+
+#define TM_RUNNER_QUEUE_DEPTH       4       // Instances a worker takes turns running.
+#define TM_RUNNER_MAX_THREADS       256
+
+/* Private Structures *********************************************************/
+
+typedef struct tm_runner tm_runner_t;
+
+typedef struct tm_runner_instance
+{
+    tm_cpu_t*           m_cpu;              // Created when the instance first runs.
+    uint64_t            m_executed;
+} tm_runner_instance_t;
+
+// Each worker keeps a short queue of the instances it takes turns running.
+// The worker takes instances from the front of its own queue, and puts them
+// back at the end once their time slice is up. Workers with nothing left to
+// run steal from the end of another worker's queue.
+typedef struct tm_runner_worker
+{
+    tm_runner_t*        m_runner;
+    size_t              m_queue[TM_RUNNER_QUEUE_DEPTH];
+    size_t              m_head;
+    size_t              m_count;
+    #if defined(TM_RUNNER_THREADS)
+        pthread_mutex_t m_lock;
+        pthread_t       m_thread;
+    #endif
+} tm_runner_worker_t;
+
+struct tm_runner
+{
+    tm_program_t*           m_program;
+    tm_runner_options_t     m_options;
+    tm_instance_result_t*   m_results;
+    tm_runner_instance_t*   m_instances;
+    tm_runner_worker_t*     m_workers;
+    size_t                  m_worker_count;
+    _Atomic(size_t)         m_next_instance;    // The next instance no worker has taken yet.
+    _Atomic(size_t)         m_remaining;        // Instances which have not finished yet.
+};
+
+/* Static Functions - Instance Bus ********************************************/
+
+// Instances run from the program's ROM and their own built-in memory, so the
+// callbacks only see the IO port registers, writes to ROM and accesses to
+// unmapped memory. There are no devices behind the ports: reads return zero,
+// and writes are ignored. Anything else is a bus error.
+
+static bool tm_runner_read (void* p_user_data, addr_t p_address, long_t* p_value)
+{
+    (void) p_user_data;
+
+    *p_value = 0;
+    return p_address >= TM_IO_START;
+}
+
+static bool tm_runner_write (void* p_user_data, addr_t p_address, long_t p_value)
+{
+    (void) p_user_data;
+    (void) p_value;
+
+    return p_address >= TM_IO_START;
+}
+
+static bool tm_runner_cycle (void* p_user_data)
+{
+    (void) p_user_data;
+    return true;
+}
+
+static bool tm_runner_cycles (void* p_user_data, size_t p_count)
+{
+    (void) p_user_data;
+    (void) p_count;
+    return true;
+}
+
+/* Static Functions - Worker Queues *******************************************/
+
+static void tm_lock_queue (tm_runner_worker_t* p_worker)
+{
+    #if defined(TM_RUNNER_THREADS)
+        pthread_mutex_lock(&p_worker->m_lock);
+    #else
+        (void) p_worker;
+    #endif
+}
+
+static void tm_unlock_queue (tm_runner_worker_t* p_worker)
+{
+    #if defined(TM_RUNNER_THREADS)
+        pthread_mutex_unlock(&p_worker->m_lock);
+    #else
+        (void) p_worker;
+    #endif
+}
+
+static bool tm_push_instance (tm_runner_worker_t* p_worker, size_t p_instance)
+{
+    bool l_pushed = false;
+
+    tm_lock_queue(p_worker);
+    if (p_worker->m_count < TM_RUNNER_QUEUE_DEPTH)
+    {
+        p_worker->m_queue[(p_worker->m_head + p_worker->m_count) % TM_RUNNER_QUEUE_DEPTH] =
+            p_instance;
+        p_worker->m_count++;
+        l_pushed = true;
+    }
+    tm_unlock_queue(p_worker);
+
+    return l_pushed;
+}
+
+static bool tm_pop_instance (tm_runner_worker_t* p_worker, size_t* p_instance)
+{
+    bool l_popped = false;
+
+    tm_lock_queue(p_worker);
+    if (p_worker->m_count > 0)
+    {
+        *p_instance = p_worker->m_queue[p_worker->m_head];
+        p_worker->m_head = (p_worker->m_head + 1) % TM_RUNNER_QUEUE_DEPTH;
+        p_worker->m_count--;
+        l_popped = true;
+    }
+    tm_unlock_queue(p_worker);
+
+    return l_popped;
+}
+
+static bool tm_steal_instance (tm_runner_worker_t* p_worker, size_t* p_instance)
+{
+    bool l_stolen = false;
+
+    tm_lock_queue(p_worker);
+    if (p_worker->m_count > 0)
+    {
+        p_worker->m_count--;
+        *p_instance =
+            p_worker->m_queue[(p_worker->m_head + p_worker->m_count) % TM_RUNNER_QUEUE_DEPTH];
+        l_stolen = true;
+    }
+    tm_unlock_queue(p_worker);
+
+    return l_stolen;
+}
+
+static bool tm_has_room (tm_runner_worker_t* p_worker)
+{
+    tm_lock_queue(p_worker);
+    bool l_room = p_worker->m_count < TM_RUNNER_QUEUE_DEPTH;
+    tm_unlock_queue(p_worker);
+
+    return l_room;
+}
+
+static void tm_claim_instances (tm_runner_worker_t* p_worker)
+{
+    // Tops up the worker's queue with instances no worker has taken yet. Only
+    // the worker itself adds to its queue, so the room it finds stays there.
+
+    tm_runner_t* l_runner = p_worker->m_runner;
+    while (tm_has_room(p_worker) == true)
+    {
+        size_t l_next = atomic_load_explicit(&l_runner->m_next_instance, memory_order_relaxed);
+        do
+        {
+            if (l_next >= l_runner->m_options.m_instances)
+            {
+                return;
+            }
+        }
+        while (
+            atomic_compare_exchange_weak_explicit(&l_runner->m_next_instance, &l_next,
+                l_next + 1, memory_order_relaxed, memory_order_relaxed) == false
+        );
+
+        tm_push_instance(p_worker, l_next);
+    }
+}
+
+static bool tm_find_instance (tm_runner_worker_t* p_worker, size_t* p_instance)
+{
+    tm_runner_t* l_runner = p_worker->m_runner;
+
+    tm_claim_instances(p_worker);
+    if (tm_pop_instance(p_worker, p_instance) == true)
+    {
+        return true;
+    }
+
+    // Nothing left of our own, so look for the instances still waiting in
+    // another worker's queue, starting with the worker after this one.
+    size_t l_self = p_worker - l_runner->m_workers;
+    for (size_t i = 1; i < l_runner->m_worker_count; ++i)
+    {
+        tm_runner_worker_t* l_victim = &l_runner->m_workers[(l_self + i) % l_runner->m_worker_count];
+        if (tm_steal_instance(l_victim, p_instance) == true)
+        {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+/* Static Functions - Instances ***********************************************/
+
+static void tm_start_instance (tm_runner_t* p_runner, size_t p_index)
+{
+    tm_runner_instance_t* l_instance = &p_runner->m_instances[p_index];
+
+    // The program's ROM is mapped into every instance, but never written, so
+    // they can all share it. RAM and the stacks are built-in memory which
+    // each instance allocates for itself.
+    l_instance->m_cpu = tm_create_cpu_ctx(tm_runner_read, tm_runner_write, tm_runner_cycle,
+        nullptr);
+    tm_batch_cycles(l_instance->m_cpu, tm_runner_cycles, SIZE_MAX);
+    tm_map_program(l_instance->m_cpu, p_runner->m_program);
+
+    if (p_runner->m_options.m_setup != nullptr)
+    {
+        p_runner->m_options.m_setup(l_instance->m_cpu, p_index, p_runner->m_options.m_user_data);
+    }
+}
+
+static void tm_finish_instance (tm_runner_t* p_runner, size_t p_index, enum_t p_status)
+{
+    tm_runner_instance_t* l_instance = &p_runner->m_instances[p_index];
+    tm_instance_result_t* l_result = &p_runner->m_results[p_index];
+    tm_cpu_t* l_cpu = l_instance->m_cpu;
+
+    l_result->m_status = p_status;
+    l_result->m_ec = tm_get_error_code(l_cpu);
+    l_result->m_flags = 0;
+    for (enum_t i = TM_FLAG_Z; i <= TM_FLAG_S; ++i)
+    {
+        l_result->m_flags |= (tm_read_cpu_flag(l_cpu, i) == true) ? (1 << i) : 0;
+    }
+
+    tm_read_cpu_register(l_cpu, TM_REGISTER_A, &l_result->m_registers[0]);
+    tm_read_cpu_register(l_cpu, TM_REGISTER_B, &l_result->m_registers[1]);
+    tm_read_cpu_register(l_cpu, TM_REGISTER_C, &l_result->m_registers[2]);
+    tm_read_cpu_register(l_cpu, TM_REGISTER_D, &l_result->m_registers[3]);
+    l_result->m_pc = tm_get_program_counter(l_cpu);
+    l_result->m_cycles = tm_get_cycle_count(l_cpu);
+    l_result->m_instructions = l_instance->m_executed - tm_get_halted_cycles(l_cpu);
+
+    tm_destroy_cpu(l_cpu);
+    l_instance->m_cpu = nullptr;
+    atomic_fetch_sub_explicit(&p_runner->m_remaining, 1, memory_order_release);
+}
+
+static bool tm_run_slice (tm_runner_t* p_runner, size_t p_index)
+{
+    // Runs one time slice of the instance. Returns false once it has
+    // finished, in which case its results have been collected.
+
+    tm_runner_instance_t* l_instance = &p_runner->m_instances[p_index];
+    if (l_instance->m_cpu == nullptr)
+    {
+        tm_start_instance(p_runner, p_index);
+    }
+
+    uint64_t l_budget = p_runner->m_options.m_slice;
+    if (p_runner->m_options.m_limit != 0 &&
+        p_runner->m_options.m_limit - l_instance->m_executed < l_budget)
+    {
+        l_budget = p_runner->m_options.m_limit - l_instance->m_executed;
+    }
+
+    // An instance halted with nothing left to wake it is finished, and is not
+    // run any further, so that its results do not depend on the slice size.
+    tm_cpu_t* l_cpu = l_instance->m_cpu;
+    if (tm_read_cpu_flag(l_cpu, TM_FLAG_L) == true && tm_get_idle_cycles(l_cpu) == UINT64_MAX)
+    {
+        tm_finish_instance(p_runner, p_index, TM_INSTANCE_HALTED);
+        return false;
+    }
+
+    l_instance->m_executed += tm_run_cpu(l_cpu, l_budget);
+
+    if (tm_read_cpu_flag(l_cpu, TM_FLAG_S) == true)
+    {
+        tm_finish_instance(p_runner, p_index, TM_INSTANCE_STOPPED);
+        return false;
+    }
+    else if (tm_read_cpu_flag(l_cpu, TM_FLAG_L) == true && tm_get_idle_cycles(l_cpu) == UINT64_MAX)
+    {
+        tm_finish_instance(p_runner, p_index, TM_INSTANCE_HALTED);
+        return false;
+    }
+    else if (p_runner->m_options.m_limit != 0 &&
+        l_instance->m_executed >= p_runner->m_options.m_limit)
+    {
+        tm_finish_instance(p_runner, p_index, TM_INSTANCE_LIMIT);
+        return false;
+    }
+
+    return true;
+}
+
+/* Static Functions - Workers *************************************************/
+
+static void* tm_run_worker (void* p_worker)
+{
+    tm_runner_worker_t* l_worker = p_worker;
+    tm_runner_t* l_runner = l_worker->m_runner;
+
+    while (atomic_load_explicit(&l_runner->m_remaining, memory_order_acquire) > 0)
+    {
+        size_t l_index = 0;
+        if (tm_find_instance(l_worker, &l_index) == false)
+        {
+            // Every instance left is running on another worker right now.
+            #if defined(TM_RUNNER_THREADS)
+                sched_yield();
+            #endif
+            continue;
+        }
+
+        if (tm_run_slice(l_runner, l_index) == true)
+        {
+            tm_push_instance(l_worker, l_index);
+        }
+    }
+
+    return nullptr;
+}
+
+static size_t tm_count_workers (const tm_runner_options_t* p_options)
+{
+    size_t l_count = p_options->m_threads;
+    #if defined(TM_RUNNER_THREADS)
+        if (l_count == 0)
+        {
+            long l_cores = sysconf(_SC_NPROCESSORS_ONLN);
+            l_count = (l_cores > 0) ? (size_t) l_cores : 1;
+        }
+    #else
+        l_count = 1;
+    #endif
+
+    if (l_count > TM_RUNNER_MAX_THREADS) { l_count = TM_RUNNER_MAX_THREADS; }
+    if (l_count > p_options->m_instances) { l_count = p_options->m_instances; }
+    return l_count;
+}
+
+/* Public Functions ***********************************************************/
+
+bool tm_run_instances (tm_program_t* p_program, const tm_runner_options_t* p_options,
+    tm_instance_result_t* p_results)
+{
+    // Use this function to run `m_instances` independent instances of one
+    // program to completion, spread across worker threads - one per core,
+    // unless `m_threads` says otherwise. Every instance runs on a CPU of its
+    // own, from the program's ROM, which is shared between them, and its own
+    // built-in RAM. There are no devices behind the IO port registers.
+    //
+    // Workers take turns running the instances in their queues, a time slice
+    // of `m_slice` instructions at a time, and steal from each other's queues
+    // once they run out, so that long-running instances do not keep the
+    // others waiting. `m_setup` is called with each instance's CPU before it
+    // first runs - registers and memory can be seeded there - on whichever
+    // worker thread started it, so it must be safe to call from several
+    // threads at once.
+    //
+    // An instance finishes once it stops, halts with nothing left to wake it,
+    // or has executed `m_limit` instructions. Its results are then written to
+    // its entry in `p_results`, which must have room for every instance.
+    //
+    // Returns false if there is nothing to run, or the worker threads could
+    // not be started.
+
+    tm_assert(p_program != nullptr);
+    tm_assert(p_options != nullptr);
+    tm_assert(p_results != nullptr);
+
+    if (p_program->m_rom == nullptr || p_options->m_instances == 0)
+    {
+        tm_errorf("tm: expected a program and at least one instance to run!\n");
+        return false;
+    }
+
+    tm_runner_t l_runner = { .m_program = p_program, .m_options = *p_options,
+        .m_results = p_results };
+    if (l_runner.m_options.m_slice == 0)
+    {
+        l_runner.m_options.m_slice = TM_RUNNER_DEFAULT_SLICE;
+    }
+
+    atomic_init(&l_runner.m_next_instance, 0);
+    atomic_init(&l_runner.m_remaining, p_options->m_instances);
+    l_runner.m_worker_count = tm_count_workers(p_options);
+
+    l_runner.m_instances = tm_calloc(p_options->m_instances, tm_runner_instance_t);
+    tm_expect_p(l_runner.m_instances != nullptr, "tm: could not allocate runner instances");
+
+    l_runner.m_workers = tm_calloc(l_runner.m_worker_count, tm_runner_worker_t);
+    tm_expect_p(l_runner.m_workers != nullptr, "tm: could not allocate runner workers");
+
+    for (size_t i = 0; i < l_runner.m_worker_count; ++i)
+    {
+        l_runner.m_workers[i].m_runner = &l_runner;
+        #if defined(TM_RUNNER_THREADS)
+            pthread_mutex_init(&l_runner.m_workers[i].m_lock, nullptr);
+        #endif
+    }
+
+    // The calling thread is the first worker.
+    bool l_ok = true;
+    size_t l_started = 1;
+    #if defined(TM_RUNNER_THREADS)
+        for (; l_started < l_runner.m_worker_count; ++l_started)
+        {
+            tm_runner_worker_t* l_worker = &l_runner.m_workers[l_started];
+            if (pthread_create(&l_worker->m_thread, nullptr, tm_run_worker, l_worker) != 0)
+            {
+                tm_perrorf("tm: could not start runner worker thread");
+                l_ok = false;
+                break;
+            }
+        }
+    #endif
+
+    // If some threads failed to start, the ones which did still finish the
+    // work; it just takes longer.
+    tm_run_worker(&l_runner.m_workers[0]);
+
+    #if defined(TM_RUNNER_THREADS)
+        for (size_t i = 1; i < l_started; ++i)
+        {
+            pthread_join(l_runner.m_workers[i].m_thread, nullptr);
+        }
+
+        for (size_t i = 0; i < l_runner.m_worker_count; ++i)
+        {
+            pthread_mutex_destroy(&l_runner.m_workers[i].m_lock);
+        }
+    #endif
+
+    tm_free(l_runner.m_workers);
+    tm_free(l_runner.m_instances);
+    return l_ok;
+}
@@ -0,0 +1,523 @@
+/// @file tm.trace.c
+
+#include <tm.trace.h>
+
+// Encoded records are written out by a thread of their own on systems with
+// POSIX threads; elsewhere, they are written out by the thread tracing.
+#if defined(TM_LINUX)
+    #define TM_TRACE_THREADS
+    #include <pthread.h>
+#endif
+
+/* Private Constants **********************************************************/
+
+#define TM_TRACE_MAGIC              "TMTR"
+#define TM_TRACE_VERSION            1
+#define TM_TRACE_BUFFER_SIZE        0x10000
+#define TM_TRACE_MAX_RECORD_SIZE    256     // Upper bound on the bytes encoded per record.
+#define TM_TRACE_CACHE_SIZE         256     // Must be a power of two.
+
+#define TM_TRACE_HAS_INSTRUCTION    0x01    // `CI` differs from the one cached for `IA`.
+#define TM_TRACE_HAS_REGISTERS      0x02
+#define TM_TRACE_HAS_WRITES         0x04
+
+/* Trace Format ***************************************************************/
+
+// A trace starts with the magic number `TMTR` and a version byte, followed by
+// one record per instruction:
+//
+//  - A tag byte, made of the `TM_TRACE_HAS_*` flags.
+//  - `IA`, as the difference from the previous record's `IA`.
+//  - `CI`, as two bytes, only if it is not the one last seen at that `IA`.
+//  - The cycles the instruction took.
+//  - With `TM_TRACE_HAS_REGISTERS`, a mask of the registers changed, then the
+//    difference between each one's old and new value, in register order.
+//  - With `TM_TRACE_HAS_WRITES`, the number of memory writes, then for each,
+//    its address as the difference from the previous write's, its size as a
+//    byte, then the value written.
+//
+// Numbers are unsigned LEB128 varints; differences are zigzag-encoded first,
+// so that small negative ones stay small too. Both ends of a trace keep the
+// same state - the previous record, and a small cache of the `CI` last seen at
+// each `IA` - so instructions executed before need no `CI` at all.
+
+typedef struct tm_trace_state
+{
+    addr_t              m_address;
+    addr_t              m_write_address;
+    long_t              m_registers[TM_TRACE_REGISTER_COUNT];
+    addr_t              m_cached_addresses[TM_TRACE_CACHE_SIZE];
+    word_t              m_cached_instructions[TM_TRACE_CACHE_SIZE];
+    bool                m_cached[TM_TRACE_CACHE_SIZE];
+} tm_trace_state_t;
+
+/* Private Structures *********************************************************/
+
+struct tm_trace_writer
+{
+    FILE*               m_file;
+    tm_trace_state_t    m_state;
+    byte_t*             m_buffers[2];
+    size_t              m_front;            // Buffer being filled with records.
+    size_t              m_used;             // Bytes used in the front buffer.
+    bool                m_failed;           // Set once writing has failed, as far as the tracing thread knows.
+    #if defined(TM_TRACE_THREADS)
+        pthread_t       m_thread;
+        pthread_mutex_t m_lock;
+        pthread_cond_t  m_signal;
+        byte_t*         m_pending;          // Buffer handed to the thread, until written.
+        size_t          m_pending_size;
+        bool            m_write_failed;     // Set by the thread once writing has failed.
+        bool            m_closing;
+    #endif
+};
+
+struct tm_trace_reader
+{
+    FILE*               m_file;
+    tm_trace_state_t    m_state;
+    bool                m_failed;
+};
+
+/* Static Functions - Encoding ************************************************/
+
+static inline size_t tm_trace_cache_index (addr_t p_address)
+{
+    return (p_address >> 1) & (TM_TRACE_CACHE_SIZE - 1);
+}
+
+static inline uint32_t tm_zigzag (long_t p_difference)
+{
+    int32_t l_value = (int32_t) p_difference;
+    return ((uint32_t) l_value << 1) ^ (uint32_t) (l_value >> 31);
+}
+
+static inline long_t tm_unzigzag (uint32_t p_value)
+{
+    return (long_t) ((p_value >> 1) ^ (0u - (p_value & 1)));
+}
+
+static inline byte_t* tm_put_varint (byte_t* p_cursor, uint32_t p_value)
+{
+    while (p_value >= 0x80)
+    {
+        *p_cursor++ = (byte_t) (p_value | 0x80);
+        p_value >>= 7;
+    }
+
+    *p_cursor++ = (byte_t) p_value;
+    return p_cursor;
+}
+
+static size_t tm_encode_record (tm_trace_state_t* p_state, tm_trace_record_t* p_record,
+    byte_t* p_buffer)
+{
+    // Encodes a record into `p_buffer`, which must have room for at least
+    // `TM_TRACE_MAX_RECORD_SIZE` bytes, and returns the number of bytes used.
+    // Works out which registers the record changed on the way.
+    byte_t* l_cursor = p_buffer + 1;
+    byte_t l_tag = 0;
+
+    l_cursor = tm_put_varint(l_cursor, tm_zigzag(p_record->m_address - p_state->m_address));
+    p_state->m_address = p_record->m_address;
+
+    size_t l_index = tm_trace_cache_index(p_record->m_address);
+    if (
+        p_state->m_cached[l_index] == false ||
+        p_state->m_cached_addresses[l_index] != p_record->m_address ||
+        p_state->m_cached_instructions[l_index] != p_record->m_instruction
+    )
+    {
+        l_tag |= TM_TRACE_HAS_INSTRUCTION;
+        *l_cursor++ = (p_record->m_instruction >> 8) & 0xFF;
+        *l_cursor++ = p_record->m_instruction & 0xFF;
+        p_state->m_cached[l_index] = true;
+        p_state->m_cached_addresses[l_index] = p_record->m_address;
+        p_state->m_cached_instructions[l_index] = p_record->m_instruction;
+    }
+
+    l_cursor = tm_put_varint(l_cursor, p_record->m_cycles);
+
+    p_record->m_changed = 0;
+    for (size_t i = 0; i < TM_TRACE_REGISTER_COUNT; ++i)
+    {
+        if (p_record->m_registers[i] != p_state->m_registers[i])
+        {
+            p_record->m_changed |= (1 << i);
+        }
+    }
+
+    if (p_record->m_changed != 0)
+    {
+        l_tag |= TM_TRACE_HAS_REGISTERS;
+        l_cursor = tm_put_varint(l_cursor, p_record->m_changed);
+        for (size_t i = 0; i < TM_TRACE_REGISTER_COUNT; ++i)
+        {
+            if ((p_record->m_changed & (1 << i)) != 0)
+            {
+                l_cursor = tm_put_varint(l_cursor,
+                    tm_zigzag(p_record->m_registers[i] - p_state->m_registers[i]));
+                p_state->m_registers[i] = p_record->m_registers[i];
+            }
+        }
+    }
+
+    if (p_record->m_write_count > 0)
+    {
+        l_tag |= TM_TRACE_HAS_WRITES;
+        l_cursor = tm_put_varint(l_cursor, p_record->m_write_count);
+        for (size_t i = 0; i < p_record->m_write_count; ++i)
+        {
+            const tm_trace_write_t* l_write = &p_record->m_writes[i];
+            l_cursor = tm_put_varint(l_cursor,
+                tm_zigzag(l_write->m_address - p_state->m_write_address));
+            *l_cursor++ = l_write->m_size;
+            l_cursor = tm_put_varint(l_cursor, l_write->m_value);
+            p_state->m_write_address = l_write->m_address;
+        }
+    }
+
+    p_buffer[0] = l_tag;
+    return l_cursor - p_buffer;
+}
+
+/* Static Functions - Writer Thread *******************************************/
+
+#if defined(TM_TRACE_THREADS)
+
+static void* tm_run_trace_writer (void* p_writer)
+{
+    tm_trace_writer_t* l_writer = p_writer;
+
+    pthread_mutex_lock(&l_writer->m_lock);
+    for (;;)
+    {
+        while (l_writer->m_pending == nullptr && l_writer->m_closing == false)
+        {
+            pthread_cond_wait(&l_writer->m_signal, &l_writer->m_lock);
+        }
+
+        if (l_writer->m_pending == nullptr)
+        {
+            break;
+        }
+
+        // Write the buffer out without holding the lock, so that the tracing
+        // thread can carry on filling the other one meanwhile.
+        byte_t* l_buffer = l_writer->m_pending;
+        size_t l_size = l_writer->m_pending_size;
+        pthread_mutex_unlock(&l_writer->m_lock);
+        bool l_written = fwrite(l_buffer, 1, l_size, l_writer->m_file) == l_size;
+        pthread_mutex_lock(&l_writer->m_lock);
+
+        l_writer->m_write_failed = l_writer->m_write_failed || l_written == false;
+        l_writer->m_pending = nullptr;
+        pthread_cond_broadcast(&l_writer->m_signal);
+    }
+    pthread_mutex_unlock(&l_writer->m_lock);
+
+    return nullptr;
+}
+
+#endif
+
+static void tm_flush_trace_writer (tm_trace_writer_t* p_writer)
+{
+    // Hands the front buffer over to be written out, then starts filling the
+    // other one. Only waits if the other one has not been written out yet.
+    if (p_writer->m_used == 0)
+    {
+        return;
+    }
+
+    #if defined(TM_TRACE_THREADS)
+        pthread_mutex_lock(&p_writer->m_lock);
+        while (p_writer->m_pending != nullptr)
+        {
+            pthread_cond_wait(&p_writer->m_signal, &p_writer->m_lock);
+        }
+
+        p_writer->m_pending = p_writer->m_buffers[p_writer->m_front];
+        p_writer->m_pending_size = p_writer->m_used;
+        p_writer->m_failed = p_writer->m_write_failed;
+        pthread_cond_broadcast(&p_writer->m_signal);
+        pthread_mutex_unlock(&p_writer->m_lock);
+    #else
+        if (fwrite(p_writer->m_buffers[p_writer->m_front], 1, p_writer->m_used, p_writer->m_file) !=
+            p_writer->m_used)
+        {
+            p_writer->m_failed = true;
+        }
+    #endif
+
+    p_writer->m_front ^= 1;
+    p_writer->m_used = 0;
+}
+
+/* Public Functions - Trace Writer ********************************************/
+
+tm_trace_writer_t* tm_create_trace_writer (const char* p_filename)
+{
+    // Use this function to start writing a trace to the file `p_filename`,
+    // replacing it if it exists. Returns `nullptr` if the file could not be
+    // created.
+
+    tm_assert(p_filename != nullptr);
+
+    FILE* l_file = fopen(p_filename, "wb");
+    if (l_file == nullptr)
+    {
+        tm_perrorf("tm: failed to create trace file '%s'", p_filename);
+        return nullptr;
+    }
+
+    tm_trace_writer_t* l_writer = tm_calloc(1, tm_trace_writer_t);
+    tm_expect_p(l_writer != nullptr, "tm: could not allocate trace writer");
+    l_writer->m_file = l_file;
+
+    for (size_t i = 0; i < 2; ++i)
+    {
+        l_writer->m_buffers[i] = tm_malloc(TM_TRACE_BUFFER_SIZE, byte_t);
+        tm_expect_p(l_writer->m_buffers[i] != nullptr, "tm: could not allocate trace buffers");
+    }
+
+    memcpy(l_writer->m_buffers[0], TM_TRACE_MAGIC, 4);
+    l_writer->m_buffers[0][4] = TM_TRACE_VERSION;
+    l_writer->m_used = 5;
+
+    #if defined(TM_TRACE_THREADS)
+        pthread_mutex_init(&l_writer->m_lock, nullptr);
+        pthread_cond_init(&l_writer->m_signal, nullptr);
+        if (pthread_create(&l_writer->m_thread, nullptr, tm_run_trace_writer, l_writer) != 0)
+        {
+            tm_perrorf("tm: could not start trace writer thread");
+            pthread_cond_destroy(&l_writer->m_signal);
+            pthread_mutex_destroy(&l_writer->m_lock);
+            tm_free(l_writer->m_buffers[0]);
+            tm_free(l_writer->m_buffers[1]);
+            tm_free(l_writer);
+            fclose(l_file);
+            return nullptr;
+        }
+    #endif
+
+    return l_writer;
+}
+
+bool tm_write_trace_record (tm_trace_writer_t* p_writer, tm_trace_record_t* p_record)
+{
+    // Use this function to append a record to the trace. The record's
+    // `m_changed` mask is worked out from the registers of the record before
+    // it, and filled in. Records are buffered, and written out in the
+    // background, so this only waits for the file when writing falls behind.
+    //
+    // Returns false if writing to the file has failed.
+
+    tm_assert(p_writer != nullptr);
+    tm_assert(p_record != nullptr && p_record->m_write_count <= TM_TRACE_MAX_WRITES);
+
+    if (p_writer->m_used + TM_TRACE_MAX_RECORD_SIZE > TM_TRACE_BUFFER_SIZE)
+    {
+        tm_flush_trace_writer(p_writer);
+    }
+
+    p_writer->m_used += tm_encode_record(&p_writer->m_state, p_record,
+        p_writer->m_buffers[p_writer->m_front] + p_writer->m_used);
+
+    // A failure to write a buffer out in the background is only reported
+    // once the next buffer is handed over.
+    return p_writer->m_failed == false;
+}
+
+bool tm_destroy_trace_writer (tm_trace_writer_t* p_writer)
+{
+    // Use this function to write out the rest of the trace, then close it.
+    // Returns false if anything could not be written.
+
+    if (p_writer == nullptr)
+    {
+        return true;
+    }
+
+    tm_flush_trace_writer(p_writer);
+
+    #if defined(TM_TRACE_THREADS)
+        pthread_mutex_lock(&p_writer->m_lock);
+        p_writer->m_closing = true;
+        pthread_cond_broadcast(&p_writer->m_signal);
+        pthread_mutex_unlock(&p_writer->m_lock);
+        pthread_join(p_writer->m_thread, nullptr);
+        pthread_cond_destroy(&p_writer->m_signal);
+        pthread_mutex_destroy(&p_writer->m_lock);
+        p_writer->m_failed = p_writer->m_write_failed;
+    #endif
+
+    bool l_good = p_writer->m_failed == false;
+    l_good = (fclose(p_writer->m_file) == 0) && l_good;
+    tm_free(p_writer->m_buffers[0]);
+    tm_free(p_writer->m_buffers[1]);
+    tm_free(p_writer);
+    return l_good;
+}
+
+/* Static Functions - Decoding ************************************************/
+
+static byte_t tm_get_trace_byte (tm_trace_reader_t* p_reader)
+{
+    int l_byte = getc(p_reader->m_file);
+    if (l_byte == EOF)
+    {
+        p_reader->m_failed = true;
+        return 0;
+    }
+
+    return (byte_t) l_byte;
+}
+
+static uint32_t tm_get_varint (tm_trace_reader_t* p_reader)
+{
+    uint32_t l_value = 0;
+    for (size_t l_shift = 0; l_shift < 35 && p_reader->m_failed == false; l_shift += 7)
+    {
+        byte_t l_byte = tm_get_trace_byte(p_reader);
+        l_value |= (uint32_t) (l_byte & 0x7F) << l_shift;
+        if ((l_byte & 0x80) == 0)
+        {
+            return l_value;
+        }
+    }
+
+    p_reader->m_failed = true;
+    return 0;
+}
+
+/* Public Functions - Trace Reader ********************************************/
+
+tm_trace_reader_t* tm_create_trace_reader (const char* p_filename)
+{
+    // Use this function to open a trace written by a trace writer. Returns
+    // `nullptr` if the file could not be opened, or is not a trace.
+
+    tm_assert(p_filename != nullptr);
+
+    FILE* l_file = fopen(p_filename, "rb");
+    if (l_file == nullptr)
+    {
+        tm_perrorf("tm: failed to open trace file '%s'", p_filename);
+        return nullptr;
+    }
+
+    byte_t l_header[5] = { 0 };
+    if (
+        fread(l_header, 1, sizeof(l_header), l_file) != sizeof(l_header) ||
+        memcmp(l_header, TM_TRACE_MAGIC, 4) != 0 ||
+        l_header[4] != TM_TRACE_VERSION
+    )
+    {
+        tm_errorf("tm: file '%s' is not a version %d tm trace.\n", p_filename, TM_TRACE_VERSION);
+        fclose(l_file);
+        return nullptr;
+    }
+
+    tm_trace_reader_t* l_reader = tm_calloc(1, tm_trace_reader_t);
+    tm_expect_p(l_reader != nullptr, "tm: could not allocate trace reader");
+    l_reader->m_file = l_file;
+    return l_reader;
+}
+
+bool tm_read_trace_record (tm_trace_reader_t* p_reader, tm_trace_record_t* p_record)
+{
+    // Use this function to read the next record from the trace, with every
+    // register's value after the instruction filled in, changed or not.
+    //
+    // Returns false at the end of the trace, or if the trace is damaged or
+    // cut short, which `tm_trace_reader_failed` tells apart.
+
+    tm_assert(p_reader != nullptr);
+    tm_assert(p_record != nullptr);
+
+    tm_trace_state_t* l_state = &p_reader->m_state;
+    int l_tag = getc(p_reader->m_file);
+    if (l_tag == EOF || p_reader->m_failed == true)
+    {
+        return false;
+    }
+
+    p_record->m_address = l_state->m_address + tm_unzigzag(tm_get_varint(p_reader));
+    l_state->m_address = p_record->m_address;
+
+    size_t l_index = tm_trace_cache_index(p_record->m_address);
+    if ((l_tag & TM_TRACE_HAS_INSTRUCTION) != 0)
+    {
+        p_record->m_instruction = tm_get_trace_byte(p_reader) << 8;
+        p_record->m_instruction |= tm_get_trace_byte(p_reader);
+        l_state->m_cached[l_index] = true;
+        l_state->m_cached_addresses[l_index] = p_record->m_address;
+        l_state->m_cached_instructions[l_index] = p_record->m_instruction;
+    }
+    else if (l_state->m_cached[l_index] == true &&
+        l_state->m_cached_addresses[l_index] == p_record->m_address)
+    {
+        p_record->m_instruction = l_state->m_cached_instructions[l_index];
+    }
+    else
+    {
+        p_reader->m_failed = true;
+    }
+
+    p_record->m_cycles = tm_get_varint(p_reader);
+
+    p_record->m_changed = 0;
+    if ((l_tag & TM_TRACE_HAS_REGISTERS) != 0)
+    {
+        p_record->m_changed = tm_get_varint(p_reader) & ((1 << TM_TRACE_REGISTER_COUNT) - 1);
+        for (size_t i = 0; i < TM_TRACE_REGISTER_COUNT; ++i)
+        {
+            if ((p_record->m_changed & (1 << i)) != 0)
+            {
+                l_state->m_registers[i] += tm_unzigzag(tm_get_varint(p_reader));
+            }
+        }
+    }
+
+    memcpy(p_record->m_registers, l_state->m_registers, sizeof(l_state->m_registers));
+
+    p_record->m_write_count = 0;
+    if ((l_tag & TM_TRACE_HAS_WRITES) != 0)
+    {
+        p_record->m_write_count = tm_get_varint(p_reader);
+        if (p_record->m_write_count > TM_TRACE_MAX_WRITES)
+        {
+            p_reader->m_failed = true;
+            return false;
+        }
+
+        for (size_t i = 0; i < p_record->m_write_count; ++i)
+        {
+            tm_trace_write_t* l_write = &p_record->m_writes[i];
+            l_write->m_address = l_state->m_write_address + tm_unzigzag(tm_get_varint(p_reader));
+            l_write->m_size = tm_get_trace_byte(p_reader);
+            l_write->m_value = tm_get_varint(p_reader);
+            l_state->m_write_address = l_write->m_address;
+        }
+    }
+
+    return p_reader->m_failed == false;
+}
+
+bool tm_trace_reader_failed (const tm_trace_reader_t* p_reader)
+{
+    // Returns true if the trace turned out to be damaged or cut short.
+
+    tm_assert(p_reader != nullptr);
+    return p_reader->m_failed;
+}
+
+void tm_destroy_trace_reader (tm_trace_reader_t* p_reader)
+{
+    if (p_reader != nullptr)
+    {
+        fclose(p_reader->m_file);
+        tm_free(p_reader);
+    }
+}
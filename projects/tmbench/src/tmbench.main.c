@@ -0,0 +1,304 @@
+/// @file tmbench.main.c
+/// @brief Measures the host time spent per guest instruction by the TM CPU.
+
+#include <tm.arguments.h>
+#include <tm.cpu.h>
+
+/* Benchmark Machine **********************************************************/
+
+#define TMBENCH_ROM_SIZE            0x4000
+#define TMBENCH_RAM_SIZE            0x1000
+#define TMBENCH_DEFAULT_COUNT       10000000
+#define TMBENCH_CYCLE_BATCH         1000
+
+static byte_t s_rom[TMBENCH_ROM_SIZE];
+static byte_t s_ram[TMBENCH_RAM_SIZE];
+static byte_t s_stack[TM_STACK_SIZE];
+static byte_t s_call_stack[TM_CALL_STACK_SIZE];
+
+static byte_t* tmbench_map (addr_t p_address)
+{
+    if (p_address < TMBENCH_ROM_SIZE)
+    {
+        return &s_rom[p_address];
+    }
+    else if (p_address >= TM_RAM_START && p_address < TM_RAM_START + TMBENCH_RAM_SIZE)
+    {
+        return &s_ram[p_address - TM_RAM_START];
+    }
+    else if (p_address >= TM_STACK_START && p_address <= TM_STACK_END)
+    {
+        return &s_stack[p_address - TM_STACK_START];
+    }
+    else if (p_address >= TM_CALL_STACK_START && p_address <= TM_CALL_STACK_END)
+    {
+        return &s_call_stack[p_address - TM_CALL_STACK_START];
+    }
+
+    return nullptr;
+}
+
+static bool tmbench_bus_read (void* p_user_data, addr_t p_address, long_t* p_value)
+{
+    byte_t* l_byte = tmbench_map(p_address);
+    if (l_byte == nullptr) { return false; }
+
+    *p_value = *l_byte;
+    return true;
+}
+
+static bool tmbench_bus_write (void* p_user_data, addr_t p_address, long_t p_value)
+{
+    byte_t* l_byte = tmbench_map(p_address);
+    if (l_byte == nullptr) { return false; }
+
+    *l_byte = p_value & 0xFF;
+    return true;
+}
+
+static bool tmbench_bus_read_long (void* p_user_data, addr_t p_address, long_t* p_value)
+{
+    byte_t* l_bytes = tmbench_map(p_address);
+    if (l_bytes == nullptr || tmbench_map(p_address + 3) != l_bytes + 3) { return false; }
+
+    *p_value =
+        ((long_t) l_bytes[0] << 24) | ((long_t) l_bytes[1] << 16) |
+        ((long_t) l_bytes[2] << 8) | l_bytes[3];
+    return true;
+}
+
+static bool tmbench_bus_write_long (void* p_user_data, addr_t p_address, long_t p_value)
+{
+    byte_t* l_bytes = tmbench_map(p_address);
+    if (l_bytes == nullptr || tmbench_map(p_address + 3) != l_bytes + 3) { return false; }
+
+    l_bytes[0] = (p_value >> 24) & 0xFF;
+    l_bytes[1] = (p_value >> 16) & 0xFF;
+    l_bytes[2] = (p_value >> 8) & 0xFF;
+    l_bytes[3] = p_value & 0xFF;
+    return true;
+}
+
+static bool tmbench_bus_read_word (void* p_user_data, addr_t p_address, long_t* p_value)
+{
+    byte_t* l_bytes = tmbench_map(p_address);
+    if (l_bytes == nullptr || tmbench_map(p_address + 1) != l_bytes + 1) { return false; }
+
+    *p_value = (l_bytes[0] << 8) | l_bytes[1];
+    return true;
+}
+
+static bool tmbench_bus_write_word (void* p_user_data, addr_t p_address, long_t p_value)
+{
+    byte_t* l_bytes = tmbench_map(p_address);
+    if (l_bytes == nullptr || tmbench_map(p_address + 1) != l_bytes + 1) { return false; }
+
+    l_bytes[0] = (p_value >> 8) & 0xFF;
+    l_bytes[1] = p_value & 0xFF;
+    return true;
+}
+
+static bool tmbench_bus_cycle (void* p_user_data)
+{
+    return true;
+}
+
+static bool tmbench_bus_cycles (void* p_user_data, size_t p_count)
+{
+    return true;
+}
+
+/* Workloads ******************************************************************/
+
+// All workloads are endless loops, hand-assembled with opcodes and operands
+// stored most-significant byte first.
+
+static const byte_t s_alu_loop[] =
+{
+    0x30, 0x00,                             // $3000: INC A
+    0x34, 0x00, 0x00, 0x00, 0x00, 0x03,     // $3002: ADD A, 3
+    0x32, 0x80,                             // $3008: DEC C
+    0x49, 0x00, 0x00, 0x00, 0x10, 0x00,     // $300A: CMP A, 0x1000
+    0x20, 0x40, 0x00, 0x00, 0x30, 0x00,     // $3010: JMP ZC, $3000
+    0x10, 0x00, 0x00, 0x00, 0x00, 0x00,     // $3016: LD A, 0
+    0x27, 0x00,                             // $301C: JPS
+};
+
+static const byte_t s_memory_loop[] =
+{
+    0x11, 0x00, 0x80, 0x00, 0x00, 0x00,     // $3000: LD A, [$80000000]
+    0x30, 0x00,                             // $3006: INC A
+    0x17, 0x00, 0x80, 0x00, 0x00, 0x00,     // $3008: ST [$80000000], A
+    0x1E, 0x00,                             // $300E: PUSH A
+    0x1F, 0x40,                             // $3010: POP B
+    0x20, 0x00, 0x00, 0x00, 0x30, 0x00,     // $3012: JMP NC, $3000
+};
+
+static const byte_t s_counter_loop[] =
+{
+    0x10, 0x70, 0x40,                       // $3000: LD BL, 0x40
+    0x32, 0x70,                             // $3003: DEC BL
+    0x22, 0x40, 0xFF, 0xFA,                 // $3005: JPB ZC, -6
+    0x30, 0x80,                             // $3009: INC C
+    0x20, 0x00, 0x00, 0x00, 0x30, 0x00,     // $300B: JMP NC, $3000
+};
+
+typedef struct tmbench_workload
+{
+    const char*     m_name;
+    const byte_t*   m_code;
+    size_t          m_size;
+} tmbench_workload_t;
+
+static const tmbench_workload_t s_workloads[] =
+{
+    { "alu",              s_alu_loop,     sizeof(s_alu_loop) },
+    { "memory",           s_memory_loop,  sizeof(s_memory_loop) },
+    { "counter",          s_counter_loop, sizeof(s_counter_loop) },
+};
+
+/* Execution Modes ************************************************************/
+
+typedef struct tmbench_mode
+{
+    const char*     m_name;
+    bool            m_decode_cache;
+    bool            m_run;              // Run through `tm_run_cpu` instead of `tm_step_cpu`.
+    bool            m_block_cache;      // Translate blocks in `tm_run_cpu`.
+    bool            m_unfused;          // Execute blocks without superoperators.
+    bool            m_jit;              // Compile hot blocks into native code.
+    bool            m_memory;           // Use the CPU's built-in memory instead of the callbacks.
+    bool            m_batch;            // Pass cycles to the host in batches.
+    bool            m_wide;             // Give the CPU word- and long-wide bus callbacks.
+    bool            m_profile;          // Count instructions and cycles per address.
+} tmbench_mode_t;
+
+static const tmbench_mode_t s_modes[] =
+{
+    { "interpreter",      false,  false,  false,  false,  false,  false,  false,  false,  false },
+    { "decode-cache",     true,   false,  false,  false,  false,  false,  false,  false,  false },
+    { "run-loop",         true,   true,   false,  false,  false,  false,  false,  false,  false },
+    { "blocks",           true,   true,   true,   false,  false,  false,  false,  false,  false },
+    { "jit",              true,   true,   true,   false,  true,   false,  false,  false,  false },
+    { "wide",             true,   true,   true,   false,  false,  false,  false,  true,   false },
+    { "wide-jit",         true,   true,   true,   false,  true,   false,  false,  true,   false },
+    { "mapped",           true,   true,   true,   false,  false,  true,   false,  false,  false },
+    { "mapped-jit",       true,   true,   true,   false,  true,   true,   false,  false,  false },
+    { "batched",          true,   true,   true,   false,  false,  true,   true,   false,  false },
+    { "batched-unfused",  true,   true,   true,   true,   false,  true,   true,   false,  false },
+    { "batched-jit",      true,   true,   true,   false,  true,   true,   true,   false,  false },
+    { "profiled",         true,   true,   true,   false,  false,  true,   true,   false,  true },
+};
+
+/* Benchmark Functions ********************************************************/
+
+static double tmbench_now ()
+{
+    struct timespec l_time;
+    clock_gettime(CLOCK_MONOTONIC, &l_time);
+    return (double) l_time.tv_sec * 1e9 + (double) l_time.tv_nsec;
+}
+
+static void tmbench_run (const tmbench_workload_t* p_workload, const tmbench_mode_t* p_mode,
+    size_t p_count)
+{
+    memset(s_rom, 0x00, sizeof(s_rom));
+    memset(s_ram, 0x00, sizeof(s_ram));
+    memcpy(s_rom + TM_PROGRAM_START, p_workload->m_code, p_workload->m_size);
+
+    tm_cpu_t* l_cpu = tm_create_cpu_ctx(tmbench_bus_read, tmbench_bus_write, tmbench_bus_cycle, nullptr);
+    tm_enable_decode_cache(l_cpu, p_mode->m_decode_cache);
+    tm_enable_block_cache(l_cpu, p_mode->m_block_cache);
+    tm_enable_superoperators(l_cpu, p_mode->m_unfused == false);
+
+    if (p_mode->m_batch == true)
+    {
+        tm_batch_cycles(l_cpu, tmbench_bus_cycles, TMBENCH_CYCLE_BATCH);
+    }
+
+    if (p_mode->m_wide == true)
+    {
+        tm_set_wide_bus(l_cpu, tmbench_bus_read_word, tmbench_bus_write_word,
+            tmbench_bus_read_long, tmbench_bus_write_long);
+    }
+
+    tm_enable_profiler(l_cpu, p_mode->m_profile);
+
+    tm_program_t l_program = { .m_rom = s_rom, .m_rom_size = sizeof(s_rom) };
+    if (p_mode->m_memory == true)
+    {
+        tm_map_program(l_cpu, &l_program);
+    }
+
+    if (p_mode->m_jit == true && tm_enable_jit(l_cpu, true) == false)
+    {
+        tm_printf("%-10s %-16s %12s\n", p_workload->m_name, p_mode->m_name, "unavailable");
+        tm_destroy_cpu(l_cpu);
+        return;
+    }
+
+    size_t l_executed = 0;
+    double l_start = tmbench_now();
+    if (p_mode->m_run == true)
+    {
+        l_executed = tm_run_cpu(l_cpu, p_count);
+    }
+    else
+    {
+        while (l_executed < p_count && tm_step_cpu(l_cpu) == true)
+        {
+            l_executed++;
+        }
+    }
+    double l_elapsed = tmbench_now() - l_start;
+
+    if (tm_has_error(l_cpu) == true)
+    {
+        tm_errorf("tmbench: workload '%s' failed: %s\n", p_workload->m_name, tm_get_error(l_cpu));
+    }
+
+    tm_printf("%-10s %-16s %12zu %14.2f\n", p_workload->m_name, p_mode->m_name, l_executed,
+        (l_executed > 0) ? l_elapsed / (double) l_executed : 0.0);
+    tm_destroy_cpu(l_cpu);
+}
+
+/* Main Function **************************************************************/
+
+static void tmbench_atexit ()
+{
+    tm_release_arguments();
+}
+
+int main (int p_argc, char** p_argv)
+{
+    atexit(tmbench_atexit);
+    tm_capture_arguments(p_argc, p_argv);
+
+    if (tm_has_argument("help", 'h'))
+    {
+        tm_printf("Usage: tmbench [options]\n");
+        tm_printf("Options:\n");
+        tm_printf("  -n, --instructions <count>   Guest instructions per run (default %d).\n",
+            TMBENCH_DEFAULT_COUNT);
+        tm_printf("  -h, --help                   Display this help message.\n");
+        return EXIT_SUCCESS;
+    }
+
+    size_t l_count = TMBENCH_DEFAULT_COUNT;
+    const char* l_count_string = tm_get_argument_value("instructions", 'n');
+    if (l_count_string != nullptr)
+    {
+        l_count = strtoull(l_count_string, nullptr, 10);
+    }
+
+    tm_printf("%-10s %-16s %12s %14s\n", "workload", "mode", "instructions", "ns/instruction");
+    for (size_t i = 0; i < sizeof(s_workloads) / sizeof(s_workloads[0]); ++i)
+    {
+        for (size_t j = 0; j < sizeof(s_modes) / sizeof(s_modes[0]); ++j)
+        {
+            tmbench_run(&s_workloads[i], &s_modes[j], l_count);
+        }
+    }
+
+    return EXIT_SUCCESS;
+}
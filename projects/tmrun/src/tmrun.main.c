@@ -0,0 +1,127 @@
+/// @file tmrun.main.c
+/// @brief Runs many independent instances of one TM program across all cores.
+
+#include <tm.arguments.h>
+#include <tm.runner.h>
+
+/* Helper Functions ***********************************************************/
+
+static const char* s_status_names[] =
+{
+    [TM_INSTANCE_STOPPED]   = "stopped",
+    [TM_INSTANCE_HALTED]    = "halted",
+    [TM_INSTANCE_LIMIT]     = "limit",
+};
+
+static double tmrun_now ()
+{
+    struct timespec l_time;
+    clock_gettime(CLOCK_MONOTONIC, &l_time);
+    return (double) l_time.tv_sec + (double) l_time.tv_nsec / 1e9;
+}
+
+static size_t tmrun_get_count (const char* p_longform, const char p_shortform, size_t p_default)
+{
+    const char* l_string = tm_get_argument_value(p_longform, p_shortform);
+    return (l_string != nullptr) ? strtoull(l_string, nullptr, 10) : p_default;
+}
+
+static int tmrun_print_help (bool p_error)
+{
+    FILE* l_output = p_error ? stderr : stdout;
+
+    if (p_error == false)
+    {
+        fprintf(l_output, "tmrun - TM CPU Multi-Instance Runner\n\n");
+    }
+
+    fprintf(l_output, "Usage: tmrun [options]\n");
+    fprintf(l_output, "Options:\n");
+    fprintf(l_output, "  -i, --input-file <filename>  Specify the program to run.\n");
+    fprintf(l_output, "  -n, --instances <count>      Instances to run (default 1).\n");
+    fprintf(l_output, "  -t, --threads <count>        Worker threads (default one per core).\n");
+    fprintf(l_output, "  -s, --slice <count>          Instructions per time slice (default %d).\n",
+        TM_RUNNER_DEFAULT_SLICE);
+    fprintf(l_output, "  -l, --limit <count>          Instructions per instance (default no limit).\n");
+    fprintf(l_output, "  -h, --help                   Display this help message.\n");
+    return p_error ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+/* Main Function **************************************************************/
+
+static void tmrun_atexit ()
+{
+    tm_release_arguments();
+}
+
+int main (int p_argc, char** p_argv)
+{
+    atexit(tmrun_atexit);
+    tm_capture_arguments(p_argc, p_argv);
+
+    if (tm_has_argument("help", 'h'))
+    {
+        return tmrun_print_help(false);
+    }
+
+    const char* l_input_file = tm_get_argument_value("input-file", 'i');
+    if (l_input_file == nullptr)
+    {
+        tm_errorf("tmrun: no input file specified.\n");
+        return tmrun_print_help(true);
+    }
+
+    tm_runner_options_t l_options =
+    {
+        .m_instances    = tmrun_get_count("instances", 'n', 1),
+        .m_threads      = tmrun_get_count("threads", 't', 0),
+        .m_slice        = tmrun_get_count("slice", 's', 0),
+        .m_limit        = tmrun_get_count("limit", 'l', 0),
+    };
+
+    if (l_options.m_instances == 0)
+    {
+        tm_errorf("tmrun: expected at least one instance.\n");
+        return EXIT_FAILURE;
+    }
+
+    tm_program_t* l_program = tm_create_program(l_input_file);
+    if (l_program == nullptr)
+    {
+        tm_errorf("tmrun: failed to load program '%s'.\n", l_input_file);
+        return EXIT_FAILURE;
+    }
+
+    tm_instance_result_t* l_results = tm_calloc(l_options.m_instances, tm_instance_result_t);
+    tm_expect_p(l_results != nullptr, "tmrun: could not allocate instance results");
+
+    double l_start = tmrun_now();
+    bool l_ok = tm_run_instances(l_program, &l_options, l_results);
+    double l_elapsed = tmrun_now() - l_start;
+
+    uint64_t l_instructions = 0;
+    size_t l_failed = 0;
+    tm_printf("%8s %-8s %4s %10s %10s %10s %10s %10s %14s %14s\n", "instance", "status", "ec",
+        "a", "b", "c", "d", "pc", "cycles", "instructions");
+    for (size_t i = 0; i < l_options.m_instances; ++i)
+    {
+        const tm_instance_result_t* l_result = &l_results[i];
+        tm_printf("%8zu %-8s %4u %10X %10X %10X %10X %10X %14llu %14llu\n", i,
+            s_status_names[l_result->m_status], l_result->m_ec,
+            l_result->m_registers[0], l_result->m_registers[1],
+            l_result->m_registers[2], l_result->m_registers[3], l_result->m_pc,
+            (unsigned long long) l_result->m_cycles,
+            (unsigned long long) l_result->m_instructions);
+
+        l_instructions += l_result->m_instructions;
+        l_failed += (l_result->m_ec != TM_ERROR_OK) ? 1 : 0;
+    }
+
+    tm_printf("\n%zu instances, %zu with errors, %llu instructions in %.3f s (%.1f M/s)\n",
+        l_options.m_instances, l_failed, (unsigned long long) l_instructions, l_elapsed,
+        (l_elapsed > 0.0) ? (double) l_instructions / l_elapsed / 1e6 : 0.0);
+
+    tm_free(l_results);
+    tm_destroy_program(l_program);
+    return (l_ok == true && l_failed == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
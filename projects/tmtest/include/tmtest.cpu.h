@@ -0,0 +1,36 @@
+/// @file tmtest.cpu.h
+/// @brief Unit tests for the TM virtual CPU.
+
+#pragma once
+#include <tm.runner.h>
+
+void tmtest_test_decode_cache ();
+void tmtest_test_decode_cache_self_modifying ();
+void tmtest_test_interpreter_loop ();
+void tmtest_test_block_cache ();
+void tmtest_test_block_cache_self_modifying ();
+void tmtest_test_block_cache_failure ();
+void tmtest_test_jit ();
+void tmtest_test_built_in_memory ();
+void tmtest_test_vector_pages ();
+void tmtest_test_memory_regions ();
+void tmtest_test_cycle_batching ();
+void tmtest_test_event_scheduler ();
+void tmtest_test_halt_fast_forward ();
+void tmtest_test_halt_wake_from_cycle ();
+void tmtest_test_interrupts ();
+void tmtest_test_lazy_flags ();
+void tmtest_test_wide_bus ();
+void tmtest_test_superoperators ();
+void tmtest_test_operand_widths ();
+void tmtest_test_saved_state ();
+void tmtest_test_fork ();
+void tmtest_test_runner ();
+void tmtest_test_program_loading ();
+void tmtest_test_rom_spans ();
+void tmtest_test_profiler ();
+void tmtest_test_statistics ();
+void tmtest_test_trace ();
+void tmtest_test_record_and_replay ();
+void tmtest_test_debugger ();
+void tmtest_test_user_data ();
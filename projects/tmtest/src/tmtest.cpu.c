@@ -0,0 +1,1962 @@
+/// @file tmtest.cpu.c
+
+#include <tmtest.cpu.h>
+
+/* Test Machine ***************************************************************/
+
+// A tiny host machine for the CPU under test. ROM is a flat buffer starting at
+// address zero; RAM, XRAM and the stacks are small buffers at the start of
+// their respective regions. Programs are hand-assembled, with opcodes and
+// operands stored most-significant byte first, as the CPU's bus expects.
+
+#define TMTEST_ROM_SIZE     0x4000
+#define TMTEST_RAM_SIZE     0x1000
+
+static byte_t   s_rom[TMTEST_ROM_SIZE];
+static byte_t   s_ram[TMTEST_RAM_SIZE];
+static byte_t   s_xram[TMTEST_RAM_SIZE];
+static byte_t   s_stack[TM_STACK_SIZE];
+static byte_t   s_call_stack[TM_CALL_STACK_SIZE];
+static byte_t   s_qram[TM_QRAM_SIZE];
+static size_t   s_reads = 0;
+static size_t   s_cycles = 0;
+static size_t   s_io_writes = 0;
+static size_t   s_io_cycles = 0;    // Sum of `s_cycles` as seen by each IO port register write.
+
+static byte_t* tmtest_map (addr_t p_address)
+{
+    if (p_address < TMTEST_ROM_SIZE)
+    {
+        return &s_rom[p_address];
+    }
+    else if (p_address >= TM_RAM_START && p_address < TM_RAM_START + TMTEST_RAM_SIZE)
+    {
+        return &s_ram[p_address - TM_RAM_START];
+    }
+    else if (p_address >= TM_XRAM_START && p_address < TM_XRAM_START + TMTEST_RAM_SIZE)
+    {
+        return &s_xram[p_address - TM_XRAM_START];
+    }
+    else if (p_address >= TM_STACK_START && p_address <= TM_STACK_END)
+    {
+        return &s_stack[p_address - TM_STACK_START];
+    }
+    else if (p_address >= TM_CALL_STACK_START && p_address <= TM_CALL_STACK_END)
+    {
+        return &s_call_stack[p_address - TM_CALL_STACK_START];
+    }
+    else if (p_address >= TM_QRAM_START)
+    {
+        return &s_qram[p_address - TM_QRAM_START];
+    }
+
+    return nullptr;
+}
+
+static bool tmtest_bus_read (addr_t p_address, long_t* p_value)
+{
+    byte_t* l_byte = tmtest_map(p_address);
+    if (l_byte == nullptr) { return false; }
+
+    s_reads++;
+    *p_value = *l_byte;
+    return true;
+}
+
+static bool tmtest_bus_write (addr_t p_address, long_t p_value)
+{
+    byte_t* l_byte = tmtest_map(p_address);
+    if (l_byte == nullptr || p_address < TMTEST_ROM_SIZE) { return false; }
+    if (p_address >= TM_IO_START)
+    {
+        s_io_writes++;
+        s_io_cycles += s_cycles;
+    }
+
+    *l_byte = p_value & 0xFF;
+    return true;
+}
+
+static bool tmtest_bus_cycle ()
+{
+    s_cycles++;
+    return true;
+}
+
+static void tmtest_reset_machine ()
+{
+    memset(s_rom, 0x00, sizeof(s_rom));
+    memset(s_ram, 0x00, sizeof(s_ram));
+    memset(s_xram, 0x00, sizeof(s_xram));
+    s_reads = 0;
+    s_cycles = 0;
+    s_io_writes = 0;
+    s_io_cycles = 0;
+}
+
+static void tmtest_load (addr_t p_address, const byte_t* p_code, size_t p_size)
+{
+    for (size_t i = 0; i < p_size; ++i)
+    {
+        byte_t* l_byte = tmtest_map(p_address + i);
+        tm_assert(l_byte != nullptr);
+        *l_byte = p_code[i];
+    }
+}
+
+static size_t tmtest_run (tm_cpu_t* p_cpu, size_t p_limit)
+{
+    size_t l_steps = 0;
+    while (l_steps < p_limit && tm_step_cpu(p_cpu) == true)
+    {
+        l_steps++;
+    }
+
+    return l_steps;
+}
+
+/* Test Programs **************************************************************/
+
+// `examples/basic_counter.asm`: counts `AW` up from zero until it wraps around.
+static const byte_t s_basic_counter[] =
+{
+    0x10, 0x10, 0x00, 0x00,                 // $3000: LD AW, 0x0000
+    0x23, 0x00, 0x00, 0x00, 0x30, 0x0C,     // $3004: CALL NC, counter
+    0x01, 0x00,                             // $300A: STOP
+                                            // counter:
+    0x30, 0x10,                             // $300C: INC AW
+    0x25, 0x30,                             // $300E: RET ZS
+    0x22, 0x00, 0xFF, 0xF8,                 // $3010: JPB NC, counter
+};
+
+/* Tests - Decode Cache *******************************************************/
+
+void tmtest_test_decode_cache ()
+{
+    // Run the same program with and without the decode cache. The results,
+    // including the number of cycles, must be identical, while the cache
+    // should spare almost all of the bus reads.
+    long_t l_aw[2] = { 0 };
+    size_t l_cycles[2] = { 0 };
+    size_t l_reads[2] = { 0 };
+    for (int i = 0; i < 2; ++i)
+    {
+        tmtest_reset_machine();
+        tmtest_load(TM_PROGRAM_START, s_basic_counter, sizeof(s_basic_counter));
+
+        tm_cpu_t* l_cpu = tm_create_cpu(tmtest_bus_read, tmtest_bus_write, tmtest_bus_cycle);
+        tm_enable_decode_cache(l_cpu, i == 1);
+        tmtest_run(l_cpu, 1000000);
+
+        tm_assert(tm_has_error(l_cpu) == false);
+        tm_read_cpu_register(l_cpu, TM_REGISTER_AW, &l_aw[i]);
+        l_cycles[i] = s_cycles;
+        l_reads[i] = s_reads;
+        tm_destroy_cpu(l_cpu);
+    }
+
+    tm_assert(l_aw[0] == 0 && l_aw[1] == 0);
+    tm_assert(l_cycles[0] == l_cycles[1]);
+    tm_assert(l_reads[1] < l_reads[0] / 4);
+}
+
+void tmtest_test_decode_cache_self_modifying ()
+{
+    // Call a subroutine in XRAM, overwrite its first instruction, then call it
+    // again. The second call must execute the new instruction.
+    static const byte_t l_program[] =
+    {
+        0x23, 0x00, 0xC0, 0x00, 0x00, 0x00,     // $3000: CALL NC, $C0000000
+        0x10, 0x50, 0x32, 0x00,                 // $3006: LD BW, 0x3200
+        0x17, 0x05, 0xC0, 0x00, 0x00, 0x00,     // $300A: ST [$C0000000], BW
+        0x23, 0x00, 0xC0, 0x00, 0x00, 0x00,     // $3010: CALL NC, $C0000000
+        0x01, 0x00,                             // $3016: STOP
+    };
+    static const byte_t l_subroutine[] =
+    {
+        0x30, 0x00,                             // $C0000000: INC A
+        0x25, 0x00,                             // $C0000002: RET NC
+    };
+
+    tmtest_reset_machine();
+    tmtest_load(TM_PROGRAM_START, l_program, sizeof(l_program));
+    tmtest_load(TM_XRAM_START, l_subroutine, sizeof(l_subroutine));
+
+    tm_cpu_t* l_cpu = tm_create_cpu(tmtest_bus_read, tmtest_bus_write, tmtest_bus_cycle);
+    tmtest_run(l_cpu, 100);
+
+    long_t l_a = 0xFFFFFFFF;
+    tm_assert(tm_has_error(l_cpu) == false);
+    tm_read_cpu_register(l_cpu, TM_REGISTER_A, &l_a);
+    tm_assert(l_a == 0);
+    tm_destroy_cpu(l_cpu);
+}
+
+/* Tests - Interpreter Loop ***************************************************/
+
+void tmtest_test_interpreter_loop ()
+{
+    // Run the same program one step at a time, then through the interpreter
+    // loop in `tm_run_cpu`, with the block cache disabled, in small enough
+    // slices that the loop runs out of budget many times. Both must execute
+    // the same number of steps, cycles and bus reads, and end up in the same
+    // state.
+    long_t l_aw[2] = { 0 };
+    size_t l_steps[2] = { 0 };
+    size_t l_cycles[2] = { 0 };
+    size_t l_reads[2] = { 0 };
+    for (int i = 0; i < 2; ++i)
+    {
+        tmtest_reset_machine();
+        tmtest_load(TM_PROGRAM_START, s_basic_counter, sizeof(s_basic_counter));
+
+        tm_cpu_t* l_cpu = tm_create_cpu(tmtest_bus_read, tmtest_bus_write, tmtest_bus_cycle);
+        tm_enable_block_cache(l_cpu, false);
+        if (i == 0)
+        {
+            l_steps[i] = tmtest_run(l_cpu, 1000000);
+        }
+        else
+        {
+            size_t l_executed = 0;
+            do
+            {
+                l_executed = tm_run_cpu(l_cpu, 1000);
+                l_steps[i] += l_executed;
+            } while (l_executed == 1000);
+        }
+
+        tm_assert(tm_has_error(l_cpu) == false);
+        tm_read_cpu_register(l_cpu, TM_REGISTER_AW, &l_aw[i]);
+        l_cycles[i] = s_cycles;
+        l_reads[i] = s_reads;
+        tm_destroy_cpu(l_cpu);
+    }
+
+    tm_assert(l_aw[0] == 0 && l_aw[1] == 0);
+    tm_assert(l_steps[0] == l_steps[1]);
+    tm_assert(l_cycles[0] == l_cycles[1]);
+    tm_assert(l_reads[0] == l_reads[1]);
+}
+
+/* Tests - Block Cache ********************************************************/
+
+void tmtest_test_block_cache ()
+{
+    // Run the same program one step at a time, then through translated blocks.
+    // Both must execute the same number of steps and cycles, and end up in the
+    // same state.
+    long_t l_aw[2] = { 0 };
+    size_t l_steps[2] = { 0 };
+    size_t l_cycles[2] = { 0 };
+    size_t l_reads[2] = { 0 };
+    for (int i = 0; i < 2; ++i)
+    {
+        tmtest_reset_machine();
+        tmtest_load(TM_PROGRAM_START, s_basic_counter, sizeof(s_basic_counter));
+
+        tm_cpu_t* l_cpu = tm_create_cpu(tmtest_bus_read, tmtest_bus_write, tmtest_bus_cycle);
+        tm_enable_decode_cache(l_cpu, false);
+        l_steps[i] = (i == 0) ?
+            tmtest_run(l_cpu, 1000000) :
+            tm_run_cpu(l_cpu, 1000000);
+
+        tm_assert(tm_has_error(l_cpu) == false);
+        tm_read_cpu_register(l_cpu, TM_REGISTER_AW, &l_aw[i]);
+        l_cycles[i] = s_cycles;
+        l_reads[i] = s_reads;
+        tm_destroy_cpu(l_cpu);
+    }
+
+    tm_assert(l_aw[0] == 0 && l_aw[1] == 0);
+    tm_assert(l_steps[0] == l_steps[1]);
+    tm_assert(l_cycles[0] == l_cycles[1]);
+    tm_assert(l_reads[1] < l_reads[0] / 4);
+}
+
+void tmtest_test_block_cache_self_modifying ()
+{
+    // Call a subroutine in XRAM three times. Each call overwrites the opcode
+    // of the subroutine's third instruction, so from the second call on, the
+    // block translated from it writes over itself. Before the third call, the
+    // program also patches the opcode the subroutine writes.
+    static const byte_t l_program[] =
+    {
+        0x23, 0x00, 0xC0, 0x00, 0x00, 0x00,     // $3000: CALL NC, $C0000000
+        0x23, 0x00, 0xC0, 0x00, 0x00, 0x00,     // $3006: CALL NC, $C0000000
+        0x10, 0x90, 0x34, 0x00,                 // $300C: LD CW, 0x3400
+        0x17, 0x09, 0xC0, 0x00, 0x00, 0x02,     // $3010: ST [$C0000002], CW
+        0x23, 0x00, 0xC0, 0x00, 0x00, 0x00,     // $3016: CALL NC, $C0000000
+        0x01, 0x00,                             // $301C: STOP
+    };
+    static const byte_t l_subroutine[] =
+    {
+        0x10, 0x50, 0x3A, 0x00,                 // $C0000000: LD BW, 0x3A00
+        0x17, 0x05, 0xC0, 0x00, 0x00, 0x0A,     // $C0000004: ST [$C000000A], BW
+        0x34, 0x00, 0x00, 0x00, 0x00, 0x01,     // $C000000A: ADD A, 1
+        0x25, 0x00,                             // $C0000010: RET NC
+    };
+
+    long_t l_a[2] = { 0 };
+    size_t l_steps[2] = { 0 };
+    size_t l_cycles[2] = { 0 };
+    for (int i = 0; i < 2; ++i)
+    {
+        tmtest_reset_machine();
+        tmtest_load(TM_PROGRAM_START, l_program, sizeof(l_program));
+        tmtest_load(TM_XRAM_START, l_subroutine, sizeof(l_subroutine));
+
+        tm_cpu_t* l_cpu = tm_create_cpu(tmtest_bus_read, tmtest_bus_write, tmtest_bus_cycle);
+        l_steps[i] = (i == 0) ?
+            tmtest_run(l_cpu, 100) :
+            tm_run_cpu(l_cpu, 100);
+
+        tm_assert(tm_has_error(l_cpu) == false);
+        tm_read_cpu_register(l_cpu, TM_REGISTER_A, &l_a[i]);
+        l_cycles[i] = s_cycles;
+        tm_destroy_cpu(l_cpu);
+    }
+
+    // The subroutine subtracts 1 from `A` on the first two calls, and adds 1
+    // on the third.
+    tm_assert(l_a[0] == 0xFFFFFFFF && l_a[1] == 0xFFFFFFFF);
+    tm_assert(l_steps[0] == l_steps[1]);
+    tm_assert(l_cycles[0] == l_cycles[1]);
+}
+
+void tmtest_test_block_cache_failure ()
+{
+    // Loading through a register too narrow to hold an address fails without
+    // stopping the CPU or setting an error code. Stepping, the interpreter
+    // loop and translated blocks must all give up on the program at that
+    // instruction, rather than carry on past it.
+    static const byte_t l_code[] =
+    {
+        0x30, 0x00,                             // $3000: INC A
+        0x12, 0x01,                             // $3002: LD A, [AW]
+        0x30, 0x00,                             // $3004: INC A
+        0x01, 0x00,                             // $3006: STOP
+    };
+
+    long_t l_a[3] = { 0 };
+    size_t l_steps[3] = { 0 };
+    size_t l_cycles[3] = { 0 };
+    for (int i = 0; i < 3; ++i)
+    {
+        tmtest_reset_machine();
+        tmtest_load(TM_PROGRAM_START, l_code, sizeof(l_code));
+
+        tm_cpu_t* l_cpu = tm_create_cpu(tmtest_bus_read, tmtest_bus_write, tmtest_bus_cycle);
+        tm_enable_block_cache(l_cpu, i == 2);
+        l_steps[i] = (i == 0) ?
+            tmtest_run(l_cpu, 1000) :
+            tm_run_cpu(l_cpu, 1000);
+
+        tm_assert(tm_has_error(l_cpu) == false);
+        tm_assert(tm_read_cpu_flag(l_cpu, TM_FLAG_S) == false);
+        tm_read_cpu_register(l_cpu, TM_REGISTER_A, &l_a[i]);
+        l_cycles[i] = s_cycles;
+        tm_destroy_cpu(l_cpu);
+    }
+
+    for (int i = 0; i < 3; ++i)
+    {
+        tm_assert(l_a[i] == 1 && l_steps[i] == 1);
+        tm_assert(l_cycles[i] == l_cycles[0]);
+    }
+}
+
+/* Tests - JIT Compiler *******************************************************/
+
+void tmtest_test_jit ()
+{
+    // Run a loop of register arithmetic one step at a time, then with the JIT
+    // compiler enabled. The loop's blocks are hot enough to be compiled, except
+    // for the one containing `SCF`, which the JIT compiler does not support.
+    // The conditional branches which jump to the next instruction either way
+    // make the cycle count depend on the flags. The program starts with `NOP`
+    // on the first two runs, and with `EI` on the last two, so the code
+    // compiled for interrupts enabled is tested, too.
+    static byte_t l_program[] =
+    {
+        0x00, 0x00,                             // $3000: NOP / EI
+        0x10, 0x10, 0x08, 0x00,                 // $3002: LD AW, 0x0800
+        0x10, 0x40, 0x12, 0x34, 0x56, 0x78,     // $3006: LD B, 0x12345678
+        0x10, 0x80, 0x89, 0xAB, 0xCD, 0xEF,     // $300C: LD C, 0x89ABCDEF
+        0x10, 0xC0, 0xFF, 0xFF, 0xFF, 0xFF,     // $3012: LD D, 0xFFFFFFFF
+                                                // loop:
+        0x35, 0xB7,                             // $3018: ADD CL, BL
+        0x38, 0xC4,                             // $301A: ADC D, B
+        0x37, 0xA0, 0x7F,                       // $301C: ADC CH, 0x7F
+        0x47, 0x48,                             // $301F: XOR B, C
+        0x3E, 0xD9,                             // $3021: SBC DW, CW
+        0x34, 0xE0, 0xC3,                       // $3023: ADD DH, 0xC3
+        0x22, 0x10, 0x00, 0x00,                 // $3026: JPB CS, 0
+        0x44, 0x7F,                             // $302A: OR BL, DL
+        0x40, 0x90, 0xF0, 0xF0,                 // $302C: AND CW, 0xF0F0
+        0x30, 0x60,                             // $3030: INC BH
+        0x1D, 0xF2,                             // $3032: MV DL, AH
+        0x4A, 0xBF,                             // $3034: CMP CL, DL
+        0x22, 0x50, 0x00, 0x00,                 // $3036: JPB OS, 0
+        0x0B, 0x00,                             // $303A: SCF
+        0x3D, 0xB0, 0x01,                       // $303C: SBC CL, 0x01
+        0x22, 0x60, 0x00, 0x00,                 // $303F: JPB US, 0
+        0x32, 0x10,                             // $3043: DEC AW
+        0x20, 0x40, 0x00, 0x00, 0x30, 0x18,     // $3045: JMP ZC, loop
+        0x01, 0x00,                             // $304B: STOP
+    };
+
+    long_t l_registers[4][4] = { 0 };
+    size_t l_steps[4] = { 0 };
+    size_t l_cycles[4] = { 0 };
+    for (int i = 0; i < 4; ++i)
+    {
+        l_program[0] = (i < 2) ? 0x00 : 0x06;
+        tmtest_reset_machine();
+        tmtest_load(TM_PROGRAM_START, l_program, sizeof(l_program));
+
+        tm_cpu_t* l_cpu = tm_create_cpu(tmtest_bus_read, tmtest_bus_write, tmtest_bus_cycle);
+        if (i % 2 == 0)
+        {
+            l_steps[i] = tmtest_run(l_cpu, 1000000);
+        }
+        else
+        {
+            tm_enable_jit(l_cpu, true);
+            l_steps[i] = tm_run_cpu(l_cpu, 1000000);
+        }
+
+        tm_assert(tm_has_error(l_cpu) == false);
+        tm_read_cpu_register(l_cpu, TM_REGISTER_A, &l_registers[i][0]);
+        tm_read_cpu_register(l_cpu, TM_REGISTER_B, &l_registers[i][1]);
+        tm_read_cpu_register(l_cpu, TM_REGISTER_C, &l_registers[i][2]);
+        tm_read_cpu_register(l_cpu, TM_REGISTER_D, &l_registers[i][3]);
+        l_cycles[i] = s_cycles;
+        tm_destroy_cpu(l_cpu);
+    }
+
+    for (int i = 0; i < 4; i += 2)
+    {
+        tm_assert(memcmp(l_registers[i], l_registers[i + 1], sizeof(l_registers[i])) == 0);
+        tm_assert(l_steps[i] == l_steps[i + 1]);
+        tm_assert(l_cycles[i] == l_cycles[i + 1]);
+    }
+}
+
+/* Tests - Built-In Memory ****************************************************/
+
+void tmtest_test_built_in_memory ()
+{
+    // Run a program which touches RAM, QRAM, both stacks and the IO port
+    // registers, first through the test machine's callbacks, then with the
+    // test machine's ROM mapped into the CPU's built-in memory. The results
+    // must be the same, but with the memory mapped, only the IO port
+    // registers may be accessed through the callbacks.
+    static const byte_t l_code[] =
+    {
+        0x10, 0x00, 0x11, 0x22, 0x33, 0x44,     // $3000: LD A, 0x11223344
+        0x17, 0x00, 0x80, 0x00, 0x00, 0x10,     // $3006: ST [$80000010], A
+        0x11, 0x50, 0x80, 0x00, 0x00, 0x11,     // $300C: LD BW, [$80000011]
+        0x19, 0x05, 0x00, 0x04,                 // $3012: STQ [$0004], BW
+        0x13, 0x80, 0x00, 0x02,                 // $3016: LDQ C, [$0002]
+        0x1B, 0x03, 0x10,                       // $301A: STH [$10], AL
+        0x15, 0xF0, 0x11,                       // $301D: LDH DL, [$11]
+        0x1E, 0x00,                             // $3020: PUSH A
+        0x1F, 0x40,                             // $3022: POP B
+        0x23, 0x00, 0x00, 0x00, 0x30, 0x30,     // $3024: CALL NC, $3030
+        0x01, 0x00,                             // $302A: STOP
+        0x00, 0x00, 0x00, 0x00,
+        0x30, 0xB0,                             // $3030: INC CL
+        0x25, 0x00,                             // $3032: RET NC
+    };
+
+    long_t l_registers[2][4] = { 0 };
+    size_t l_cycles[2] = { 0 };
+    for (int i = 0; i < 2; ++i)
+    {
+        tmtest_reset_machine();
+        memset(s_qram, 0x00, sizeof(s_qram));
+        tmtest_load(TM_PROGRAM_START, l_code, sizeof(l_code));
+
+        tm_program_t l_program = { .m_rom = s_rom, .m_rom_size = sizeof(s_rom) };
+        tm_cpu_t* l_cpu = tm_create_cpu(tmtest_bus_read, tmtest_bus_write, tmtest_bus_cycle);
+        if (i == 1)
+        {
+            tm_map_program(l_cpu, &l_program);
+        }
+
+        tmtest_run(l_cpu, 100);
+        tm_assert(tm_has_error(l_cpu) == false);
+        for (int j = 0; j < 4; ++j)
+        {
+            tm_read_cpu_register(l_cpu, TM_REGISTER_A + (j << 2), &l_registers[i][j]);
+        }
+
+        l_cycles[i] = s_cycles;
+        if (i == 1)
+        {
+            // Only the `LDH` instruction read through the callbacks, and only
+            // the IO port registers were written through them.
+            long_t l_value = 0;
+            tm_assert(s_reads == 1);
+            tm_assert(s_ram[0x10] == 0x00 && s_qram[0xFF11] == 0x44);
+            tm_assert(tm_read_long(l_cpu, 0x80000010, &l_value) == true && l_value == 0x11223344);
+        }
+
+        tm_destroy_cpu(l_cpu);
+    }
+
+    tm_assert(memcmp(l_registers[0], l_registers[1], sizeof(l_registers[0])) == 0);
+    tm_assert(l_registers[1][2] == 0x00002234 && l_registers[1][3] == 0x44);
+    tm_assert(l_cycles[0] == l_cycles[1]);
+}
+
+void tmtest_test_vector_pages ()
+{
+    // The restart and interrupt vector pages can be read from, but not written
+    // to. The metadata before them can be neither.
+    static const byte_t l_code[] =
+    {
+        0x11, 0x00, 0x00, 0x00, 0x10, 0x00,     // $3000: LD A, [$00001000]
+        0x11, 0x40, 0x00, 0x00, 0x2F, 0xFC,     // $3006: LD B, [$00002FFC]
+        0x17, 0x00, 0x00, 0x00, 0x10, 0x00,     // $300C: ST [$00001000], A
+        0x01, 0x00,                             // $3012: STOP
+    };
+    static const byte_t l_metadata_code[] =
+    {
+        0x11, 0x00, 0x00, 0x00, 0x0F, 0xFC,     // $3000: LD A, [$00000FFC]
+        0x01, 0x00,                             // $3006: STOP
+    };
+
+    tmtest_reset_machine();
+    memset(s_rom + TM_RST_START, 0x5A, TM_PROGRAM_START - TM_RST_START);
+    tmtest_load(TM_PROGRAM_START, l_code, sizeof(l_code));
+
+    long_t l_a = 0, l_b = 0;
+    tm_cpu_t* l_cpu = tm_create_cpu(tmtest_bus_read, tmtest_bus_write, tmtest_bus_cycle);
+    tmtest_run(l_cpu, 100);
+    tm_read_cpu_register(l_cpu, TM_REGISTER_A, &l_a);
+    tm_read_cpu_register(l_cpu, TM_REGISTER_B, &l_b);
+    tm_assert(l_a == 0x5A5A5A5A && l_b == 0x5A5A5A5A);
+    tm_assert(tm_get_error_code(l_cpu) == TM_ERROR_WRITE_ACCESS_VIOLATION);
+    tm_destroy_cpu(l_cpu);
+
+    tmtest_load(TM_PROGRAM_START, l_metadata_code, sizeof(l_metadata_code));
+    l_cpu = tm_create_cpu(tmtest_bus_read, tmtest_bus_write, tmtest_bus_cycle);
+    tmtest_run(l_cpu, 100);
+    tm_assert(tm_get_error_code(l_cpu) == TM_ERROR_READ_ACCESS_VIOLATION);
+    tm_destroy_cpu(l_cpu);
+}
+
+/* Tests - Memory Regions *****************************************************/
+
+// A memory-mapped device with four byte-wide registers, repeated across the
+// page it is mapped to.
+typedef struct tmtest_device
+{
+    byte_t      m_registers[4];
+    size_t      m_reads;
+    size_t      m_writes;
+} tmtest_device_t;
+
+static bool tmtest_device_read (void* p_user_data, addr_t p_address, long_t* p_value)
+{
+    tmtest_device_t* l_device = p_user_data;
+    l_device->m_reads++;
+    *p_value = l_device->m_registers[p_address & 3];
+    return true;
+}
+
+static bool tmtest_device_write (void* p_user_data, addr_t p_address, long_t p_value)
+{
+    tmtest_device_t* l_device = p_user_data;
+    l_device->m_writes++;
+    l_device->m_registers[p_address & 3] = p_value & 0xFF;
+    return true;
+}
+
+void tmtest_test_memory_regions ()
+{
+    // Map a framebuffer into XRAM, a device into RAM, a subroutine into RAM
+    // which is made executable, and a page of RAM which is made read-only,
+    // before the program itself. The regions must stay mapped on top of the
+    // program's memory, and their access flags must replace the memory map's.
+    static const byte_t l_code[] =
+    {
+        0x10, 0x00, 0x11, 0x22, 0x33, 0x44,     // $3000: LD A, 0x11223344
+        0x17, 0x00, 0xC0, 0x01, 0x00, 0x00,     // $3006: ST [$C0010000], A
+        0x17, 0x00, 0x80, 0x10, 0x00, 0x00,     // $300C: ST [$80100000], A
+        0x11, 0x40, 0x80, 0x10, 0x00, 0x04,     // $3012: LD B, [$80100004]
+        0x23, 0x00, 0x80, 0x20, 0x00, 0x00,     // $3018: CALL NC, $80200000
+        0x17, 0x00, 0x80, 0x30, 0x00, 0x00,     // $301E: ST [$80300000], A
+        0x01, 0x00,                             // $3024: STOP
+    };
+
+    static const byte_t l_subroutine[] =
+    {
+        0x30, 0x80,                             // $80200000: INC C
+        0x25, 0x00,                             // $80200002: RET NC
+    };
+
+    static byte_t l_framebuffer[TM_PAGE_SIZE];
+    static byte_t l_executable[TM_PAGE_SIZE];
+    static byte_t l_read_only[TM_PAGE_SIZE];
+    tmtest_device_t l_device = { 0 };
+
+    tmtest_reset_machine();
+    tmtest_load(TM_PROGRAM_START, l_code, sizeof(l_code));
+    memset(l_framebuffer, 0x00, sizeof(l_framebuffer));
+    memcpy(l_executable, l_subroutine, sizeof(l_subroutine));
+    memset(l_read_only, 0xAA, sizeof(l_read_only));
+
+    const tm_region_t l_regions[] =
+    {
+        {
+            .m_start = TM_XRAM_START + 0x10000, .m_size = sizeof(l_framebuffer),
+            .m_access = TM_ACCESS_READ | TM_ACCESS_WRITE, .m_host = l_framebuffer
+        },
+        {
+            .m_start = TM_RAM_START + 0x100000, .m_size = TM_PAGE_SIZE,
+            .m_access = TM_ACCESS_READ | TM_ACCESS_WRITE,
+            .m_read = tmtest_device_read, .m_write = tmtest_device_write, .m_user_data = &l_device
+        },
+        {
+            .m_start = TM_RAM_START + 0x200000, .m_size = sizeof(l_executable),
+            .m_access = TM_ACCESS_READ | TM_ACCESS_EXECUTE, .m_host = l_executable
+        },
+        {
+            .m_start = TM_RAM_START + 0x300000, .m_size = sizeof(l_read_only),
+            .m_access = TM_ACCESS_READ, .m_host = l_read_only
+        },
+    };
+
+    tm_program_t l_program = { .m_rom = s_rom, .m_rom_size = sizeof(s_rom) };
+    tm_cpu_t* l_cpu = tm_create_cpu(tmtest_bus_read, tmtest_bus_write, tmtest_bus_cycle);
+    for (size_t i = 0; i < sizeof(l_regions) / sizeof(l_regions[0]); ++i)
+    {
+        tm_assert(tm_map_region(l_cpu, &l_regions[i]) == true);
+    }
+
+    tm_map_program(l_cpu, &l_program);
+    tmtest_run(l_cpu, 100);
+
+    // The run ends on the store to the read-only region, without the host's
+    // callbacks having been called at all.
+    long_t l_b = 0, l_c = 0, l_value = 0;
+    tm_read_cpu_register(l_cpu, TM_REGISTER_B, &l_b);
+    tm_read_cpu_register(l_cpu, TM_REGISTER_C, &l_c);
+    tm_assert(tm_has_error(l_cpu) == true);
+    tm_assert(strstr(tm_get_error(l_cpu), "non-writable memory address $80300000") != nullptr);
+    tm_assert(s_reads == 0);
+    tm_assert(l_framebuffer[0] == 0x11 && l_framebuffer[3] == 0x44);
+    tm_assert(l_device.m_writes == 4 && l_device.m_reads == 4 && l_b == 0x11223344);
+    tm_assert(l_c == 1 && l_read_only[0] == 0xAA);
+
+    // Unmapping the framebuffer leaves the memory the CPU allocates in its
+    // place, while regions which are not page-aligned are refused.
+    tm_region_t l_misaligned = l_regions[0];
+    l_misaligned.m_start += 0x10;
+    tm_assert(tm_map_region(l_cpu, &l_misaligned) == false);
+    tm_assert(tm_unmap_region(l_cpu, TM_XRAM_START + 0x10000) == true);
+    tm_assert(tm_unmap_region(l_cpu, TM_XRAM_START + 0x10000) == false);
+    tm_assert(tm_read_long(l_cpu, TM_XRAM_START + 0x10000, &l_value) == true && l_value == 0);
+    tm_assert(tm_write_long(l_cpu, TM_XRAM_START + 0x10000, 0x55667788) == true);
+    tm_assert(l_framebuffer[0] == 0x11 && s_xram[0] == 0x00);
+
+    tm_destroy_cpu(l_cpu);
+}
+
+/* Tests - Cycle Batching ****************************************************/
+
+static size_t s_batches = 0;
+
+static bool tmtest_bus_cycles (void* p_user_data, size_t p_count)
+{
+    s_batches++;
+    s_cycles += p_count;
+    return true;
+}
+
+static bool tmtest_failing_cycles (void* p_user_data, size_t p_count)
+{
+    s_batches++;
+    return false;
+}
+
+void tmtest_test_cycle_batching ()
+{
+    // Run a loop which writes to an IO port register on every iteration, once
+    // with a call to the cycle callback for every cycle, then with cycles
+    // batched. The host must see the same number of cycles in the end, and
+    // the same number of cycles at every IO port register write, but in far
+    // fewer calls.
+    static const byte_t l_code[] =
+    {
+        0x10, 0x10, 0x00, 0x00,                 // $3000: LD AW, 0x0000
+        0x30, 0x10,                             // $3004: INC AW
+        0x1B, 0x03, 0x10,                       // $3006: STH [$10], AL
+        0x20, 0x00, 0x00, 0x00, 0x30, 0x04,     // $3009: JMP NC, $3004
+    };
+
+    size_t l_cycles[2] = { 0 };
+    size_t l_io_cycles[2] = { 0 };
+    for (int i = 0; i < 2; ++i)
+    {
+        tmtest_reset_machine();
+        tmtest_load(TM_PROGRAM_START, l_code, sizeof(l_code));
+        s_batches = 0;
+
+        tm_cpu_t* l_cpu = tm_create_cpu(tmtest_bus_read, tmtest_bus_write, tmtest_bus_cycle);
+        if (i == 1)
+        {
+            tm_batch_cycles(l_cpu, tmtest_bus_cycles, 1000);
+        }
+
+        tm_assert(tm_run_cpu(l_cpu, 3001) == 3001);
+        tm_assert(tm_has_error(l_cpu) == false && s_io_writes == 2000);
+        l_cycles[i] = s_cycles;
+        l_io_cycles[i] = s_io_cycles;
+        tm_destroy_cpu(l_cpu);
+    }
+
+    tm_assert(l_cycles[0] == l_cycles[1]);
+    tm_assert(l_io_cycles[0] == l_io_cycles[1]);
+    tm_assert(s_batches <= 1001 && s_batches * 10 < l_cycles[1]);
+
+    // If the host fails to take the cycles counted before an IO port register
+    // write, the CPU stops with a hardware error, and the write is not made.
+    tmtest_reset_machine();
+    tmtest_load(TM_PROGRAM_START, l_code, sizeof(l_code));
+    s_batches = 0;
+
+    tm_cpu_t* l_cpu = tm_create_cpu(tmtest_bus_read, tmtest_bus_write, tmtest_bus_cycle);
+    tm_batch_cycles(l_cpu, tmtest_failing_cycles, SIZE_MAX);
+    tm_assert(tm_run_cpu(l_cpu, 3001) == 2);
+    tm_assert(tm_get_error_code(l_cpu) == TM_ERROR_HARDWARE);
+    tm_assert(s_batches == 1 && s_io_writes == 0);
+    tm_destroy_cpu(l_cpu);
+}
+
+/* Tests - Event Scheduler ***************************************************/
+
+static size_t s_ticks = 0;
+
+static bool tmtest_tick (tm_cpu_t* p_cpu, void* p_user_data, uint64_t p_cycle)
+{
+    // A periodic timer, which schedules its own next tick.
+    s_ticks++;
+    tm_schedule_event(p_cpu, p_cycle + 100, tmtest_tick, p_user_data);
+    return true;
+}
+
+static bool tmtest_fail (tm_cpu_t* p_cpu, void* p_user_data, uint64_t p_cycle)
+{
+    return false;
+}
+
+void tmtest_test_event_scheduler ()
+{
+    // Halt the CPU until an interrupt scheduled at cycle 1000 wakes it up,
+    // with a timer ticking every 100 cycles meanwhile. An event which would
+    // fail the CPU is scheduled, then cancelled before it is due.
+    static const byte_t l_code[] =
+    {
+        0x02, 0x00,                             // $3000: HALT
+        0x10, 0x00, 0x00, 0x00, 0x00, 0x01,     // $3002: LD A, 1
+        0x01, 0x00,                             // $3008: STOP
+    };
+
+    tmtest_reset_machine();
+    tmtest_load(TM_PROGRAM_START, l_code, sizeof(l_code));
+    s_ticks = 0;
+
+    tm_cpu_t* l_cpu = tm_create_cpu(tmtest_bus_read, tmtest_bus_write, tmtest_bus_cycle);
+    tm_schedule_event(l_cpu, 100, tmtest_tick, nullptr);
+    tm_schedule_interrupt(l_cpu, 1000, 3);
+    size_t l_failure = tm_schedule_event(l_cpu, 500, tmtest_fail, nullptr);
+    tm_assert(tm_cancel_event(l_cpu, l_failure) == true);
+    tm_assert(tm_cancel_event(l_cpu, l_failure) == false);
+
+    tm_run_cpu(l_cpu, 10000);
+
+    long_t l_a = 0;
+    tm_read_cpu_register(l_cpu, TM_REGISTER_A, &l_a);
+    tm_assert(tm_has_error(l_cpu) == false && l_a == 1);
+    tm_assert(tm_get_cycle_count(l_cpu) == s_cycles);
+    tm_assert(s_cycles > 1000 && s_cycles < 1100 && s_ticks == 10);
+
+    tm_destroy_cpu(l_cpu);
+}
+
+/* Tests - Halt Fast-Forward **************************************************/
+
+void tmtest_test_halt_fast_forward ()
+{
+    // Halt the CPU until an interrupt scheduled far ahead wakes it up, with
+    // cycles batched. The idle cycles are skipped in bulk, and passed to the
+    // host in a single call, instead of one per deadline's worth of cycles.
+    static const byte_t l_code[] =
+    {
+        0x02, 0x00,                             // $3000: HALT
+        0x10, 0x00, 0x00, 0x00, 0x00, 0x01,     // $3002: LD A, 1
+        0x01, 0x00,                             // $3008: STOP
+    };
+
+    tmtest_reset_machine();
+    tmtest_load(TM_PROGRAM_START, l_code, sizeof(l_code));
+    s_batches = 0;
+
+    tm_cpu_t* l_cpu = tm_create_cpu(tmtest_bus_read, tmtest_bus_write, tmtest_bus_cycle);
+    tm_batch_cycles(l_cpu, tmtest_bus_cycles, 1000);
+    tm_schedule_interrupt(l_cpu, 1000000, 3);
+    tm_assert(tm_get_idle_cycles(l_cpu) == 0);
+
+    tm_step_cpu(l_cpu);
+    tm_assert(tm_get_idle_cycles(l_cpu) == 1000000 - tm_get_cycle_count(l_cpu));
+
+    tm_assert(tm_run_cpu(l_cpu, 2000000) < 2000000);
+
+    long_t l_a = 0;
+    tm_read_cpu_register(l_cpu, TM_REGISTER_A, &l_a);
+    tm_assert(tm_has_error(l_cpu) == false && l_a == 1);
+    tm_assert(tm_get_cycle_count(l_cpu) == s_cycles && s_cycles > 1000000);
+    tm_assert(s_batches <= 3);
+
+    tm_destroy_cpu(l_cpu);
+}
+
+static tm_cpu_t* s_waking_cpu = nullptr;
+
+static bool tmtest_waking_cycle ()
+{
+    if (++s_cycles == 100)
+    {
+        tm_request_interrupt(s_waking_cpu, 1);
+    }
+
+    return true;
+}
+
+void tmtest_test_halt_wake_from_cycle ()
+{
+    // Without batching, the cycle callback may request an interrupt on any
+    // cycle, so the halted CPU wakes as soon as it does, rather than skipping
+    // the rest of the budget.
+    static const byte_t l_vector1[] =
+    {
+        0x10, 0x00, 0x00, 0x00, 0x00, 0x01,     // $2100: LD A, 1
+        0x01, 0x00,                             // $2106: STOP
+    };
+
+    static const byte_t l_code[] =
+    {
+        0x06, 0x00,                             // $3000: EI
+        0x02, 0x00,                             // $3002: HALT
+    };
+
+    tmtest_reset_machine();
+    tmtest_load(TM_INT_START + 0x100, l_vector1, sizeof(l_vector1));
+    tmtest_load(TM_PROGRAM_START, l_code, sizeof(l_code));
+
+    s_waking_cpu = tm_create_cpu(tmtest_bus_read, tmtest_bus_write, tmtest_waking_cycle);
+    tm_enable_interrupts(s_waking_cpu, 1 << 1);
+    tm_assert(tm_run_cpu(s_waking_cpu, 100000000) < 200);
+
+    long_t l_a = 0;
+    tm_read_cpu_register(s_waking_cpu, TM_REGISTER_A, &l_a);
+    tm_assert(tm_has_error(s_waking_cpu) == false && l_a == 1);
+    tm_assert(tm_get_cycle_count(s_waking_cpu) == s_cycles && s_cycles < 200);
+
+    tm_destroy_cpu(s_waking_cpu);
+    s_waking_cpu = nullptr;
+}
+
+/* Tests - Interrupts *********************************************************/
+
+void tmtest_test_interrupts ()
+{
+    // Spin with interrupts enabled while three interrupts are requested, of
+    // which only two are enabled. The lower one is handled first; the higher
+    // one as soon as `RETI` re-enables them, and the third never is.
+    static const byte_t l_vector1[] =
+    {
+        0x10, 0x00, 0x00, 0x00, 0x00, 0x01,     // $2100: LD A, 1
+        0x26, 0x00,                             // $2106: RETI
+    };
+
+    static const byte_t l_vector3[] =
+    {
+        0x10, 0x40, 0x00, 0x00, 0x00, 0x03,     // $2300: LD B, 3
+        0x01, 0x00,                             // $2306: STOP
+    };
+
+    static const byte_t l_code[] =
+    {
+        0x06, 0x00,                             // $3000: EI
+        0x22, 0x00, 0xFF, 0xFC,                 // $3002: JPB NC, $3002
+    };
+
+    tmtest_reset_machine();
+    tmtest_load(TM_INT_START + 0x100, l_vector1, sizeof(l_vector1));
+    tmtest_load(TM_INT_START + 0x300, l_vector3, sizeof(l_vector3));
+    tmtest_load(TM_PROGRAM_START, l_code, sizeof(l_code));
+
+    tm_cpu_t* l_cpu = tm_create_cpu(tmtest_bus_read, tmtest_bus_write, tmtest_bus_cycle);
+    tm_enable_interrupts(l_cpu, 0b1010);
+    tm_request_interrupt_async(l_cpu, 5);
+    tm_request_interrupt_async(l_cpu, 3);
+    tm_request_interrupt_async(l_cpu, 1);
+    tm_run_cpu(l_cpu, 100);
+
+    long_t l_a = 0, l_b = 0;
+    tm_read_cpu_register(l_cpu, TM_REGISTER_A, &l_a);
+    tm_read_cpu_register(l_cpu, TM_REGISTER_B, &l_b);
+    tm_assert(tm_has_error(l_cpu) == false && l_a == 1 && l_b == 3);
+
+    tm_destroy_cpu(l_cpu);
+}
+
+/* Tests - Lazy Flags *********************************************************/
+
+void tmtest_test_lazy_flags ()
+{
+    // Arithmetic instructions only record their operands; the flags are
+    // worked out when a condition, or the host, asks for them.
+    static const byte_t l_code[] =
+    {
+        0x10, 0x00, 0x00, 0x00, 0x00, 0x05,     // $3000: LD A, 5
+        0x49, 0x00, 0x00, 0x00, 0x00, 0x05,     // $3006: CMP A, 5
+        0x34, 0x30, 0xFF,                       // $300C: ADD AL, 0xFF
+        0x22, 0x10, 0x00, 0x06,                 // $300F: JPB CS, $3019
+        0x10, 0x00, 0x00, 0x00, 0x00, 0x00,     // $3013: LD A, 0
+        0x01, 0x00,                             // $3019: STOP
+    };
+
+    tmtest_reset_machine();
+    tmtest_load(TM_PROGRAM_START, l_code, sizeof(l_code));
+
+    tm_cpu_t* l_cpu = tm_create_cpu(tmtest_bus_read, tmtest_bus_write, tmtest_bus_cycle);
+    tmtest_run(l_cpu, 2);
+    tm_assert(tm_read_cpu_flag(l_cpu, TM_FLAG_Z) == true);
+    tm_assert(tm_read_cpu_flag(l_cpu, TM_FLAG_N) == true);
+    tm_assert(tm_read_cpu_flag(l_cpu, TM_FLAG_C) == false);
+
+    tmtest_run(l_cpu, 1);
+    tm_assert(tm_read_cpu_flag(l_cpu, TM_FLAG_Z) == false);
+    tm_assert(tm_read_cpu_flag(l_cpu, TM_FLAG_N) == false);
+    tm_assert(tm_read_cpu_flag(l_cpu, TM_FLAG_H) == true);
+    tm_assert(tm_read_cpu_flag(l_cpu, TM_FLAG_C) == true);
+    tm_assert(tm_read_cpu_flag(l_cpu, TM_FLAG_O) == true);
+
+    tmtest_run(l_cpu, 10);
+
+    long_t l_a = 0;
+    tm_read_cpu_register(l_cpu, TM_REGISTER_A, &l_a);
+    tm_assert(tm_has_error(l_cpu) == false && l_a == 0x04);
+
+    tm_destroy_cpu(l_cpu);
+}
+
+/* Tests - Wide Bus ***********************************************************/
+
+static size_t s_wide_reads = 0;
+static size_t s_wide_writes = 0;
+
+static bool tmtest_read_wide (addr_t p_address, long_t* p_value, size_t p_size)
+{
+    *p_value = 0;
+    for (size_t i = 0; i < p_size; ++i)
+    {
+        byte_t* l_byte = tmtest_map(p_address + i);
+        if (l_byte == nullptr) { return false; }
+
+        *p_value = (*p_value << 8) | *l_byte;
+    }
+
+    s_wide_reads++;
+    return true;
+}
+
+static bool tmtest_write_wide (addr_t p_address, long_t p_value, size_t p_size)
+{
+    for (size_t i = 0; i < p_size; ++i)
+    {
+        byte_t* l_byte = tmtest_map(p_address + i);
+        if (l_byte == nullptr || p_address < TMTEST_ROM_SIZE) { return false; }
+
+        *l_byte = (p_value >> ((p_size - 1 - i) * 8)) & 0xFF;
+    }
+
+    s_wide_writes++;
+    return true;
+}
+
+static bool tmtest_read_word (void* p_user_data, addr_t p_address, long_t* p_value)
+{
+    return tmtest_read_wide(p_address, p_value, 2);
+}
+
+static bool tmtest_write_word (void* p_user_data, addr_t p_address, long_t p_value)
+{
+    return tmtest_write_wide(p_address, p_value, 2);
+}
+
+static bool tmtest_read_long (void* p_user_data, addr_t p_address, long_t* p_value)
+{
+    return tmtest_read_wide(p_address, p_value, 4);
+}
+
+static bool tmtest_write_long (void* p_user_data, addr_t p_address, long_t p_value)
+{
+    return tmtest_write_wide(p_address, p_value, 4);
+}
+
+void tmtest_test_wide_bus ()
+{
+    // With wide callbacks given, an instruction with a 32-bit operand, which
+    // then moves a long through memory and the data stack, makes one bus call
+    // per access instead of four.
+    static const byte_t l_code[] =
+    {
+        0x10, 0x00, 0x12, 0x34, 0x56, 0x78,     // $3000: LD A, 0x12345678
+        0x17, 0x00, 0x80, 0x00, 0x00, 0x00,     // $3006: ST [$80000000], A
+        0x11, 0x40, 0x80, 0x00, 0x00, 0x00,     // $300C: LD B, [$80000000]
+        0x1E, 0x40,                             // $3012: PUSH B
+        0x1F, 0x80,                             // $3014: POP C
+        0x01, 0x00,                             // $3016: STOP
+    };
+
+    tmtest_reset_machine();
+    tmtest_load(TM_PROGRAM_START, l_code, sizeof(l_code));
+    s_wide_reads = 0;
+    s_wide_writes = 0;
+
+    tm_cpu_t* l_cpu = tm_create_cpu(tmtest_bus_read, tmtest_bus_write, tmtest_bus_cycle);
+    tm_set_wide_bus(l_cpu, tmtest_read_word, tmtest_write_word, tmtest_read_long,
+        tmtest_write_long);
+    tmtest_run(l_cpu, 10);
+
+    long_t l_c = 0;
+    tm_read_cpu_register(l_cpu, TM_REGISTER_C, &l_c);
+    tm_assert(tm_has_error(l_cpu) == false && l_c == 0x12345678);
+    tm_assert(s_ram[0] == 0x12 && s_ram[3] == 0x78);
+    tm_assert(s_wide_writes == 2);
+
+    // Six opcode words, three 32-bit operands, and the long read by each of
+    // `LD` and `POP`, with nothing left for the byte-wide callbacks.
+    tm_assert(s_wide_reads == 11 && s_reads == 0);
+
+    tm_destroy_cpu(l_cpu);
+}
+
+/* Tests - Superoperators *****************************************************/
+
+void tmtest_test_superoperators ()
+{
+    // Run a loop made of fusable pairs of instructions with superoperators
+    // enabled, then disabled. Both runs must have the same outcome, down to
+    // the number of steps and cycles.
+    static const byte_t l_code[] =
+    {
+        0x10, 0x00, 0x00, 0x00, 0x00, 0x00,     // $3000: LD A, 0
+        0x10, 0xC0, 0x80, 0x00, 0x00, 0x04,     // $3006: LD D, $80000004
+        0x10, 0xB0, 0x03,                       // $300C: LD CL, 3
+        0x32, 0xB0,                             // $300F: DEC CL
+        0x22, 0x40, 0xFF, 0xFA,                 // $3011: JPB ZC, -6
+        0x31, 0x2C,                             // $3015: INC [D]
+        0x20, 0x40, 0x00, 0x00, 0x30, 0x1D,     // $3017: JMP ZC, $301D
+        0x30, 0x10,                             // $301D: INC AW
+        0x49, 0x10, 0x00, 0x80,                 // $301F: CMP AW, 0x80
+        0x20, 0x40, 0x00, 0x00, 0x30, 0x0C,     // $3023: JMP ZC, $300C
+        0x01, 0x00,                             // $3029: STOP
+    };
+
+    size_t l_steps[2] = { 0 };
+    size_t l_cycles[2] = { 0 };
+    for (int i = 0; i < 2; ++i)
+    {
+        tmtest_reset_machine();
+        tmtest_load(TM_PROGRAM_START, l_code, sizeof(l_code));
+
+        tm_cpu_t* l_cpu = tm_create_cpu(tmtest_bus_read, tmtest_bus_write, tmtest_bus_cycle);
+        tm_enable_superoperators(l_cpu, i == 0);
+        l_steps[i] = tm_run_cpu(l_cpu, 100000);
+
+        long_t l_a = 0, l_c = 0;
+        tm_read_cpu_register(l_cpu, TM_REGISTER_A, &l_a);
+        tm_read_cpu_register(l_cpu, TM_REGISTER_C, &l_c);
+        tm_assert(tm_has_error(l_cpu) == false && l_a == 0x80 && l_c == 0);
+        l_cycles[i] = s_cycles;
+        tm_destroy_cpu(l_cpu);
+    }
+
+    tm_assert(l_steps[0] == l_steps[1] && l_cycles[0] == l_cycles[1]);
+}
+
+/* Tests - Operand Widths *****************************************************/
+
+void tmtest_test_operand_widths ()
+{
+    // Run instructions on long, word and byte registers, one step at a time
+    // without the decode cache, then in blocks. Both runs must pick the same
+    // operand widths, down to the number of cycles spent.
+    static const byte_t l_code[] =
+    {
+        0x10, 0x00, 0x12, 0x34, 0x56, 0x78,     // $3000: LD A, 0x12345678
+        0x10, 0x50, 0xFF, 0xFF,                 // $3006: LD BW, 0xFFFF
+        0x30, 0x50,                             // $300A: INC BW
+        0x10, 0xB0, 0x7F,                       // $300C: LD CL, 0x7F
+        0x34, 0x30, 0x88,                       // $300F: ADD AL, 0x88
+        0x17, 0x01, 0x80, 0x00, 0x00, 0x00,     // $3012: ST [$80000000], AW
+        0x01, 0x00,                             // $3018: STOP
+    };
+
+    size_t l_cycles[2] = { 0 };
+    for (int i = 0; i < 2; ++i)
+    {
+        tmtest_reset_machine();
+        tmtest_load(TM_PROGRAM_START, l_code, sizeof(l_code));
+
+        tm_cpu_t* l_cpu = tm_create_cpu(tmtest_bus_read, tmtest_bus_write, tmtest_bus_cycle);
+        if (i == 0)
+        {
+            tm_enable_decode_cache(l_cpu, false);
+            while (tm_step_cpu(l_cpu) == true) {}
+        }
+        else
+        {
+            tm_run_cpu(l_cpu, 100);
+        }
+
+        long_t l_a = 0, l_b = 0, l_c = 0;
+        tm_read_cpu_register(l_cpu, TM_REGISTER_A, &l_a);
+        tm_read_cpu_register(l_cpu, TM_REGISTER_B, &l_b);
+        tm_read_cpu_register(l_cpu, TM_REGISTER_C, &l_c);
+        tm_assert(tm_has_error(l_cpu) == false);
+        tm_assert(l_a == 0x12345600 && l_b == 0 && l_c == 0x7F);
+        tm_assert(tm_read_cpu_flag(l_cpu, TM_FLAG_Z) == true);
+        tm_assert(tm_read_cpu_flag(l_cpu, TM_FLAG_C) == true);
+        tm_assert(s_ram[0] == 0x56 && s_ram[1] == 0x00);
+        l_cycles[i] = s_cycles;
+        tm_destroy_cpu(l_cpu);
+    }
+
+    tm_assert(l_cycles[0] == l_cycles[1]);
+}
+
+/* Tests - Saved State ********************************************************/
+
+// Counts up in `A` and in the long at `$80000000`, three instructions per
+// iteration.
+static const byte_t s_counter_code[] =
+{
+    0x30, 0x00,                             // $3000: INC A
+    0x17, 0x00, 0x80, 0x00, 0x00, 0x00,     // $3002: ST [$80000000], A
+    0x20, 0x00, 0x00, 0x00, 0x30, 0x00,     // $3008: JMP NC, $3000
+};
+
+static void tmtest_check_counter (tm_cpu_t* p_cpu, long_t p_expected)
+{
+    long_t l_a = 0, l_value = 0;
+    tm_read_cpu_register(p_cpu, TM_REGISTER_A, &l_a);
+    tm_assert(tm_has_error(p_cpu) == false);
+    tm_assert(l_a == p_expected);
+    tm_assert(tm_read_long(p_cpu, 0x80000000, &l_value) == true && l_value == p_expected);
+}
+
+void tmtest_test_saved_state ()
+{
+    // Save the state of a CPU which has counted to 10, let it count on, then
+    // restore the state and count again. Restoring the state on another CPU
+    // must work the same way, but only if that CPU has a program mapped.
+    tmtest_reset_machine();
+    tmtest_load(TM_PROGRAM_START, s_counter_code, sizeof(s_counter_code));
+
+    tm_program_t l_program = { .m_rom = s_rom, .m_rom_size = sizeof(s_rom) };
+    tm_cpu_t* l_cpu = tm_create_cpu(tmtest_bus_read, tmtest_bus_write, tmtest_bus_cycle);
+    tm_map_program(l_cpu, &l_program);
+    tm_run_cpu(l_cpu, 30);
+    tmtest_check_counter(l_cpu, 10);
+    tm_assert(tm_write_long(l_cpu, TM_XRAM_START + TM_PAGE_SIZE, 0x11223344) == true);
+
+    size_t l_size = tm_save_state(l_cpu, nullptr, 0);
+    byte_t* l_state = tm_calloc(l_size, byte_t);
+    tm_assert(tm_save_state(l_cpu, l_state, l_size) == l_size);
+    uint64_t l_cycle_count = tm_get_cycle_count(l_cpu);
+
+    // A state listing the same page twice is rejected. Each page is saved as
+    // its address followed by its contents, the last page last.
+    byte_t* l_duplicate = tm_calloc(l_size, byte_t);
+    memcpy(l_duplicate, l_state, l_size);
+    byte_t* l_last = l_duplicate + l_size - (4 + TM_PAGE_SIZE);
+    memcpy(l_last, l_last - (4 + TM_PAGE_SIZE), 4);
+    tm_assert(tm_load_state(l_cpu, l_duplicate, l_size) == false);
+    tm_free(l_duplicate);
+
+    tm_run_cpu(l_cpu, 30);
+    tmtest_check_counter(l_cpu, 20);
+    tm_assert(tm_load_state(l_cpu, l_state, l_size) == true);
+    tmtest_check_counter(l_cpu, 10);
+    tm_assert(tm_get_cycle_count(l_cpu) == l_cycle_count);
+    tm_run_cpu(l_cpu, 30);
+    tmtest_check_counter(l_cpu, 20);
+
+    tm_cpu_t* l_other = tm_create_cpu(tmtest_bus_read, tmtest_bus_write, tmtest_bus_cycle);
+    tm_assert(tm_load_state(l_other, l_state, l_size) == false);
+    tm_map_program(l_other, &l_program);
+    tm_assert(tm_load_state(l_other, l_state, l_size - 1) == false);
+    tm_assert(tm_load_state(l_other, l_state, l_size) == true);
+    tm_run_cpu(l_other, 30);
+    tmtest_check_counter(l_other, 20);
+
+    tm_free(l_state);
+    tm_destroy_cpu(l_other);
+    tm_destroy_cpu(l_cpu);
+}
+
+void tmtest_test_fork ()
+{
+    // Fork a CPU which has counted to 10, then let both count on separately.
+    // Neither may see the other's writes to the memory they share, and the
+    // fork must keep its memory once the CPU it was forked from is destroyed.
+    tmtest_reset_machine();
+    tmtest_load(TM_PROGRAM_START, s_counter_code, sizeof(s_counter_code));
+
+    tm_program_t l_program = { .m_rom = s_rom, .m_rom_size = sizeof(s_rom) };
+    tm_cpu_t* l_cpu = tm_create_cpu(tmtest_bus_read, tmtest_bus_write, tmtest_bus_cycle);
+    tm_map_program(l_cpu, &l_program);
+    tm_run_cpu(l_cpu, 30);
+
+    tm_cpu_t* l_fork = tm_fork_cpu(l_cpu);
+    tmtest_check_counter(l_fork, 10);
+    tm_assert(tm_get_cycle_count(l_fork) == tm_get_cycle_count(l_cpu));
+
+    tm_run_cpu(l_fork, 30);
+    tmtest_check_counter(l_fork, 20);
+    tmtest_check_counter(l_cpu, 10);
+
+    tm_run_cpu(l_cpu, 60);
+    tmtest_check_counter(l_cpu, 30);
+    tmtest_check_counter(l_fork, 20);
+
+    tm_destroy_cpu(l_cpu);
+    tm_run_cpu(l_fork, 30);
+    tmtest_check_counter(l_fork, 30);
+    tm_destroy_cpu(l_fork);
+}
+
+/* Tests - Runner *************************************************************/
+
+static void tmtest_runner_setup (tm_cpu_t* p_cpu, size_t p_index, void* p_user_data)
+{
+    // Count down from a different value in each instance, and leave each one
+    // its index in RAM, where the others would overwrite it if they shared it.
+    tm_write_cpu_register(p_cpu, TM_REGISTER_B, (p_index + 1) * 100);
+    tm_assert(p_user_data == s_rom);
+    tm_write_long(p_cpu, TM_RAM_START, p_index);
+}
+
+void tmtest_test_runner ()
+{
+    static const byte_t l_code[] =
+    {
+        0x11, 0x80, 0x80, 0x00, 0x00, 0x00,     // $3000: LD C, [$80000000]
+        0x30, 0x00,                             // $3006: INC A
+        0x32, 0x40,                             // $3008: DEC B
+        0x20, 0x40, 0x00, 0x00, 0x30, 0x06,     // $300A: JMP ZC, $3006
+        0x01, 0x00,                             // $3010: STOP
+    };
+
+    tmtest_reset_machine();
+    tmtest_load(TM_PROGRAM_START, l_code, sizeof(l_code));
+    tm_program_t l_program = { .m_rom = s_rom, .m_rom_size = sizeof(s_rom) };
+
+    // Run more instances than there are workers, with short time slices, so
+    // that they are moved between queues and workers while they run.
+    tm_instance_result_t l_results[16] = { 0 };
+    tm_runner_options_t l_options =
+    {
+        .m_instances = 16, .m_threads = 4, .m_slice = 50,
+        .m_setup = tmtest_runner_setup, .m_user_data = s_rom
+    };
+
+    tm_assert(tm_run_instances(&l_program, &l_options, l_results) == true);
+    for (size_t i = 0; i < 16; ++i)
+    {
+        tm_assert(l_results[i].m_status == TM_INSTANCE_STOPPED);
+        tm_assert(l_results[i].m_ec == TM_ERROR_OK);
+        tm_assert(l_results[i].m_registers[0] == (i + 1) * 100);
+        tm_assert(l_results[i].m_registers[1] == 0);
+        tm_assert(l_results[i].m_registers[2] == i);
+        tm_assert(l_results[i].m_pc == 0x3012);
+        tm_assert(l_results[i].m_instructions == (i + 1) * 300 + 2);
+        tm_assert((l_results[i].m_flags & (1 << TM_FLAG_S)) != 0);
+    }
+
+    // Instances still running when they reach the limit are cut off there.
+    l_options.m_limit = 500;
+    tm_assert(tm_run_instances(&l_program, &l_options, l_results) == true);
+    for (size_t i = 0; i < 16; ++i)
+    {
+        tm_assert(l_results[i].m_status == (i == 0 ? TM_INSTANCE_STOPPED : TM_INSTANCE_LIMIT));
+        tm_assert(l_results[i].m_instructions == (i == 0 ? 302 : 500));
+    }
+
+    // The program's ROM was only ever read.
+    tm_assert(memcmp(s_rom + TM_PROGRAM_START, l_code, sizeof(l_code)) == 0);
+
+    // Instances halted with nothing left to wake them finish where they
+    // halted, whatever the size of their time slices.
+    static const byte_t l_halting_code[] =
+    {
+        0x30, 0x00,                             // $3000: INC A
+        0x02, 0x00,                             // $3002: HALT
+    };
+
+    tmtest_load(TM_PROGRAM_START, l_halting_code, sizeof(l_halting_code));
+    static const size_t l_slices[] = { 1, 50, 100000 };
+    tm_instance_result_t l_halted[3] = { 0 };
+    for (size_t i = 0; i < 3; ++i)
+    {
+        tm_runner_options_t l_halting_options =
+            { .m_instances = 1, .m_threads = 1, .m_slice = l_slices[i] };
+        tm_assert(tm_run_instances(&l_program, &l_halting_options, &l_halted[i]) == true);
+        tm_assert(l_halted[i].m_status == TM_INSTANCE_HALTED);
+        tm_assert(l_halted[i].m_registers[0] == 1);
+        tm_assert(l_halted[i].m_instructions == 2);
+        tm_assert(l_halted[i].m_cycles == l_halted[0].m_cycles);
+    }
+}
+
+/* Tests - Program Loading ****************************************************/
+
+void tmtest_test_program_loading ()
+{
+    // Write a program file with a valid header, and run it straight from the
+    // loaded ROM.
+    static const char* l_filename = "tmtest.program.tm";
+    static const byte_t l_code[] =
+    {
+        0x10, 0x00, 0x00, 0x00, 0x00, 0x2A,     // $3000: LD A, 42
+        0x01, 0x00,                             // $3006: STOP
+    };
+
+    tmtest_reset_machine();
+    memcpy(s_rom + TM_MAGIC_NUMBER_ADDRESS, "TM08", 4);
+    memcpy(s_rom + TM_PROGRAM_NAME_ADDRESS, "tmtest", 6);
+    tmtest_load(TM_PROGRAM_START, l_code, sizeof(l_code));
+
+    FILE* l_file = fopen(l_filename, "wb");
+    tm_assert(l_file != nullptr);
+    tm_assert(fwrite(s_rom, 1, sizeof(s_rom), l_file) == sizeof(s_rom));
+    fclose(l_file);
+
+    tm_program_t* l_program = tm_create_program(l_filename);
+    tm_assert(l_program != nullptr);
+    tm_assert(l_program->m_rom_size == sizeof(s_rom));
+    tm_assert(strcmp(l_program->m_name, "tmtest") == 0);
+    #if defined(TM_LINUX)
+        tm_assert(l_program->m_mapped == true);
+    #endif
+
+    // Writes to the ROM stay in this process's copy of it.
+    tm_assert(tm_write_rom_byte(l_program, TM_PROGRAM_START + 5, 0x2B) == true);
+
+    tm_cpu_t* l_cpu = tm_create_cpu(tmtest_bus_read, tmtest_bus_write, tmtest_bus_cycle);
+    tm_map_program(l_cpu, l_program);
+    tm_run_cpu(l_cpu, 10);
+
+    long_t l_a = 0;
+    tm_read_cpu_register(l_cpu, TM_REGISTER_A, &l_a);
+    tm_assert(tm_has_error(l_cpu) == false);
+    tm_assert(l_a == 0x2B);
+    tm_destroy_cpu(l_cpu);
+    tm_destroy_program(l_program);
+
+    l_file = fopen(l_filename, "rb");
+    tm_assert(l_file != nullptr);
+    tm_assert(fseek(l_file, TM_PROGRAM_START + 5, SEEK_SET) == 0);
+    tm_assert(fgetc(l_file) == 0x2A);
+    fclose(l_file);
+
+    // Files without the magic number are rejected.
+    s_rom[TM_MAGIC_NUMBER_ADDRESS] = 'X';
+    l_file = fopen(l_filename, "wb");
+    tm_assert(l_file != nullptr);
+    tm_assert(fwrite(s_rom, 1, sizeof(s_rom), l_file) == sizeof(s_rom));
+    fclose(l_file);
+    tm_assert(tm_create_program(l_filename) == nullptr);
+
+    remove(l_filename);
+}
+
+/* Tests - ROM Spans **********************************************************/
+
+void tmtest_test_rom_spans ()
+{
+    tmtest_reset_machine();
+    tm_program_t l_program = { .m_rom = s_rom, .m_rom_size = sizeof(s_rom) };
+
+    // Spans are only handed out for ranges entirely within the ROM.
+    tm_assert(tm_get_rom_span(&l_program, 0, sizeof(s_rom)) == s_rom);
+    tm_assert(tm_get_rom_span(&l_program, sizeof(s_rom) - 4, 4) == s_rom + sizeof(s_rom) - 4);
+    tm_assert(tm_get_rom_span(&l_program, sizeof(s_rom) - 3, 4) == nullptr);
+    tm_assert(tm_get_rom_span(&l_program, 0xFFFFFFFF, 2) == nullptr);
+    tm_assert(tm_get_rom_span(&l_program, 0, sizeof(s_rom) + 1) == nullptr);
+
+    // Words and longs are read most significant byte first, like the bus.
+    static const byte_t l_patch[] = { 0x12, 0x34, 0x56, 0x78 };
+    tm_assert(tm_write_rom(&l_program, 0x100, l_patch, sizeof(l_patch)) == true);
+    tm_assert(tm_write_rom(&l_program, sizeof(s_rom) - 2, l_patch, sizeof(l_patch)) == false);
+    tm_assert(s_rom[sizeof(s_rom) - 2] == 0x00);
+
+    word_t l_word = 0;
+    long_t l_long = 0;
+    tm_assert(tm_read_rom_word(&l_program, 0x101, &l_word) == true && l_word == 0x3456);
+    tm_assert(tm_read_rom_long(&l_program, 0x100, &l_long) == true && l_long == 0x12345678);
+    tm_assert(tm_read_rom_long(&l_program, sizeof(s_rom) - 3, &l_long) == false);
+
+    byte_t l_buffer[4] = { 0 };
+    tm_assert(tm_read_rom(&l_program, 0x100, l_buffer, sizeof(l_buffer)) == true);
+    tm_assert(memcmp(l_buffer, l_patch, sizeof(l_patch)) == 0);
+}
+
+/* Tests - Profiler ***********************************************************/
+
+static const tm_profile_entry_t* tmtest_find_profile_entry (const tm_profile_entry_t* p_entries,
+    size_t p_count, addr_t p_address)
+{
+    for (size_t i = 0; i < p_count; ++i)
+    {
+        if (p_entries[i].m_address == p_address)
+        {
+            return &p_entries[i];
+        }
+    }
+
+    return nullptr;
+}
+
+void tmtest_test_profiler ()
+{
+    // The main loop calls a routine three times, which calls another.
+    static const byte_t l_main[] =
+    {
+        0x10, 0x80, 0x00, 0x00, 0x00, 0x03,     // $3000: LD C, 3
+        0x23, 0x00, 0x00, 0x00, 0x30, 0x20,     // $3006: CALL $3020
+        0x32, 0x80,                             // $300C: DEC C
+        0x20, 0x40, 0x00, 0x00, 0x30, 0x06,     // $300E: JMP ZC, $3006
+        0x01, 0x00,                             // $3014: STOP
+    };
+
+    static const byte_t l_routines[] =
+    {
+        0x30, 0x00,                             // $3020: INC A
+        0x23, 0x00, 0x00, 0x00, 0x30, 0x30,     // $3022: CALL $3030
+        0x25, 0x00,                             // $3028: RET
+        0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        0x30, 0x40,                             // $3030: INC B
+        0x25, 0x00,                             // $3032: RET
+    };
+
+    tmtest_reset_machine();
+    tmtest_load(TM_PROGRAM_START, l_main, sizeof(l_main));
+    tmtest_load(0x3020, l_routines, sizeof(l_routines));
+
+    tm_cpu_t* l_cpu = tm_create_cpu(tmtest_bus_read, tmtest_bus_write, tmtest_bus_cycle);
+    tm_assert(tm_get_profile(l_cpu, nullptr, 0) == 0);
+    tm_enable_profiler(l_cpu, true);
+    size_t l_steps = tm_run_cpu(l_cpu, 1000);
+    tm_assert(tm_has_error(l_cpu) == false);
+
+    long_t l_a = 0, l_b = 0;
+    tm_read_cpu_register(l_cpu, TM_REGISTER_A, &l_a);
+    tm_read_cpu_register(l_cpu, TM_REGISTER_B, &l_b);
+    tm_assert(l_a == 3 && l_b == 3);
+
+    // Every instruction and cycle is accounted for, against its address, and
+    // the entries come sorted by cycles.
+    tm_profile_entry_t l_entries[16] = { 0 };
+    size_t l_count = tm_get_profile(l_cpu, l_entries, 16);
+    tm_assert(l_count == 10);
+
+    uint64_t l_instructions = 0, l_cycles = 0;
+    for (size_t i = 0; i < l_count; ++i)
+    {
+        l_instructions += l_entries[i].m_instructions;
+        l_cycles += l_entries[i].m_cycles;
+        tm_assert(i == 0 || l_entries[i].m_cycles <= l_entries[i - 1].m_cycles);
+    }
+
+    tm_assert(l_instructions == l_steps);
+    tm_assert(l_cycles == tm_get_cycle_count(l_cpu));
+
+    const tm_profile_entry_t* l_entry = tmtest_find_profile_entry(l_entries, l_count, 0x3006);
+    tm_assert(l_entry != nullptr && l_entry->m_instructions == 3 && l_entry->m_calls == 0);
+    l_entry = tmtest_find_profile_entry(l_entries, l_count, 0x3020);
+    tm_assert(l_entry != nullptr && l_entry->m_instructions == 3 && l_entry->m_calls == 3);
+    l_entry = tmtest_find_profile_entry(l_entries, l_count, 0x3030);
+    tm_assert(l_entry != nullptr && l_entry->m_instructions == 3 && l_entry->m_calls == 3);
+
+    // Each calling context gets a line of its own.
+    char l_stacks[256] = { 0 };
+    FILE* l_file = tmpfile();
+    tm_assert(l_file != nullptr);
+    tm_assert(tm_write_profile_stacks(l_cpu, l_file) == true);
+    rewind(l_file);
+    tm_assert(fread(l_stacks, 1, sizeof(l_stacks) - 1, l_file) > 0);
+    fclose(l_file);
+
+    tm_assert(strstr(l_stacks, "$00003000 ") != nullptr);
+    tm_assert(strstr(l_stacks, "$00003000;$00003020 ") != nullptr);
+    tm_assert(strstr(l_stacks, "$00003000;$00003020;$00003030 ") != nullptr);
+
+    // Resetting starts the profile over; disabling discards it.
+    tm_reset_profile(l_cpu);
+    tm_assert(tm_get_profile(l_cpu, nullptr, 0) == 0);
+    tm_enable_profiler(l_cpu, false);
+    tm_assert(tm_write_profile(l_cpu, stdout, 0) == false);
+    tm_destroy_cpu(l_cpu);
+}
+
+/* Tests - Statistics *********************************************************/
+
+void tmtest_test_statistics ()
+{
+    static const byte_t l_code[] =
+    {
+        0x10, 0x00, 0x00, 0x00, 0x00, 0x05,     // $3000: LD A, 5
+        0x32, 0x00,                             // $3006: DEC A
+        0x20, 0x40, 0x00, 0x00, 0x30, 0x06,     // $3008: JMP ZC, $3006
+        0x01, 0x00,                             // $300E: STOP
+    };
+
+    tmtest_reset_machine();
+    tmtest_load(TM_PROGRAM_START, l_code, sizeof(l_code));
+
+    // Time every instruction, so that each one is sampled.
+    tm_opcode_statistics_t l_stats = { 0 };
+    tm_cpu_t* l_cpu = tm_create_cpu(tmtest_bus_read, tmtest_bus_write, tmtest_bus_cycle);
+    tm_assert(tm_get_opcode_statistics(l_cpu, 0x32, &l_stats) == false);
+    tm_enable_statistics(l_cpu, true, 1);
+    tm_run_cpu(l_cpu, 1000);
+    tm_assert(tm_has_error(l_cpu) == false);
+
+    // `DEC` takes 2 cycles, and `JMP` 7 when taken, 6 when not.
+    tm_assert(tm_get_opcode_statistics(l_cpu, 0x32, &l_stats) == true);
+    tm_assert(l_stats.m_executions == 5 && l_stats.m_cycles == 10 && l_stats.m_samples == 5);
+    tm_assert(tm_get_opcode_statistics(l_cpu, 0x20, &l_stats) == true);
+    tm_assert(l_stats.m_executions == 5 && l_stats.m_cycles == 4 * 7 + 6);
+    tm_assert(tm_get_opcode_statistics(l_cpu, 0x01, &l_stats) == true);
+    tm_assert(l_stats.m_executions == 1);
+
+    char l_json[1024] = { 0 };
+    FILE* l_file = tmpfile();
+    tm_assert(l_file != nullptr);
+    tm_assert(tm_write_statistics(l_cpu, l_file, true) == true);
+    rewind(l_file);
+    tm_assert(fread(l_json, 1, sizeof(l_json) - 1, l_file) > 0);
+    fclose(l_file);
+    tm_assert(strstr(l_json, "\"handler\": \"dec_reg\", \"executions\": 5, \"cycles\": 10") != nullptr);
+
+    // Without a sample period, nothing is timed.
+    tm_reset_statistics(l_cpu);
+    tm_enable_statistics(l_cpu, true, 0);
+    tm_init_cpu(l_cpu);
+    tm_run_cpu(l_cpu, 1000);
+    tm_assert(tm_get_opcode_statistics(l_cpu, 0x32, &l_stats) == true);
+    tm_assert(l_stats.m_executions == 5 && l_stats.m_samples == 0);
+
+    tm_enable_statistics(l_cpu, false, 0);
+    tm_assert(tm_get_opcode_statistics(l_cpu, 0x32, &l_stats) == false);
+    tm_destroy_cpu(l_cpu);
+}
+
+/* Tests - Trace **************************************************************/
+
+void tmtest_test_trace ()
+{
+    static const char* l_filename = "tmtest.trace.tmtr";
+    static const byte_t l_code[] =
+    {
+        0x10, 0x00, 0x00, 0x00, 0x00, 0x04,     // $3000: LD A, 4
+        0x32, 0x00,                             // $3006: DEC A
+        0x17, 0x00, 0xC0, 0x00, 0x00, 0x00,     // $3008: ST [$C0000000], A
+        0x20, 0x40, 0x00, 0x00, 0x30, 0x06,     // $300E: JMP ZC, $3006
+        0x01, 0x00,                             // $3014: STOP
+    };
+
+    tmtest_reset_machine();
+    tmtest_load(TM_PROGRAM_START, l_code, sizeof(l_code));
+
+    tm_cpu_t* l_cpu = tm_create_cpu(tmtest_bus_read, tmtest_bus_write, tmtest_bus_cycle);
+    tm_assert(tm_start_trace(l_cpu, l_filename) == true);
+    tm_run_cpu(l_cpu, 1000);
+    tm_assert(tm_has_error(l_cpu) == false);
+    tm_assert(tm_stop_trace(l_cpu) == true);
+    tm_destroy_cpu(l_cpu);
+
+    // The loop runs four times, between `LD` and `STOP`.
+    tm_trace_reader_t* l_reader = tm_create_trace_reader(l_filename);
+    tm_assert(l_reader != nullptr);
+
+    tm_trace_record_t l_record;
+    tm_assert(tm_read_trace_record(l_reader, &l_record) == true);
+    tm_assert(l_record.m_address == 0x3000 && l_record.m_instruction == 0x1000);
+    tm_assert((l_record.m_changed & (1 << TM_TRACE_A)) != 0 && l_record.m_registers[TM_TRACE_A] == 4);
+    tm_assert(l_record.m_write_count == 0);
+
+    for (int i = 3; i >= 0; --i)
+    {
+        tm_assert(tm_read_trace_record(l_reader, &l_record) == true);
+        tm_assert(l_record.m_address == 0x3006 && l_record.m_instruction == 0x3200);
+        tm_assert(l_record.m_cycles == 2 && l_record.m_registers[TM_TRACE_A] == i);
+        tm_assert((l_record.m_changed & (1 << TM_TRACE_A)) != 0);
+
+        tm_assert(tm_read_trace_record(l_reader, &l_record) == true);
+        tm_assert(l_record.m_address == 0x3008 && l_record.m_instruction == 0x1700);
+        tm_assert(l_record.m_changed == 0 && l_record.m_write_count == 1);
+        tm_assert(l_record.m_writes[0].m_address == TM_XRAM_START);
+        tm_assert(l_record.m_writes[0].m_size == 4 && l_record.m_writes[0].m_value == i);
+
+        tm_assert(tm_read_trace_record(l_reader, &l_record) == true);
+        tm_assert(l_record.m_address == 0x300E && l_record.m_instruction == 0x2040);
+        tm_assert(l_record.m_cycles == ((i > 0) ? 7 : 6));
+    }
+
+    tm_assert(tm_read_trace_record(l_reader, &l_record) == true);
+    tm_assert(l_record.m_address == 0x3014 && l_record.m_instruction == 0x0100);
+    tm_assert(tm_read_trace_record(l_reader, &l_record) == false);
+    tm_assert(tm_trace_reader_failed(l_reader) == false);
+    tm_destroy_trace_reader(l_reader);
+
+    remove(l_filename);
+}
+
+/* Tests - Record and Replay **************************************************/
+
+static bool tmtest_replay_read (addr_t p_address, long_t* p_value)
+{
+    // The IO port registers read as a value which depends on the time, which
+    // keeps moving on while the CPU is rewound.
+    if (p_address >= TM_IO_START)
+    {
+        *p_value = (s_cycles * 7) & 0xFF;
+        return true;
+    }
+
+    return tmtest_bus_read(p_address, p_value);
+}
+
+void tmtest_test_record_and_replay ()
+{
+    static const byte_t l_code[] =
+    {
+        0x06, 0x00,                             // $3000: EI
+        0x10, 0x80, 0x00, 0x00, 0x00, 0x28,     // $3002: LD C, 40
+        0x15, 0x70, 0x00,                       // $3008: LDH BL, [$00]
+        0x17, 0x40, 0x80, 0x00, 0x00, 0x00,     // $300B: ST [$80000000], B
+        0x20, 0x00, 0x00, 0x00, 0x30, 0x17,     // $3011: JMP $3017
+        0x32, 0x80,                             // $3017: DEC C
+        0x20, 0x40, 0x00, 0x00, 0x30, 0x08,     // $3019: JMP ZC, $3008
+        0x01, 0x00,                             // $301F: STOP
+    };
+
+    static const byte_t l_handler[] =
+    {
+        0x20, 0x00, 0x00, 0x00, 0x23, 0x06,     // $2300: JMP $2306
+        0x30, 0xC0,                             // $2306: INC D
+        0x26, 0x00,                             // $2308: RETI
+    };
+
+    tmtest_reset_machine();
+    tmtest_load(TM_PROGRAM_START, l_code, sizeof(l_code));
+    tmtest_load(TM_INT_START + 0x300, l_handler, sizeof(l_handler));
+
+    tm_program_t l_program = { .m_rom = s_rom, .m_rom_size = sizeof(s_rom) };
+    tm_cpu_t* l_cpu = tm_create_cpu(tmtest_replay_read, tmtest_bus_write, tmtest_bus_cycle);
+    tm_map_program(l_cpu, &l_program);
+    tm_enable_interrupts(l_cpu, 1 << 3);
+    tm_assert(tm_rewind_cpu(l_cpu, 0) == false);
+
+    // Record the state after every step, with interrupt 3 requested by the
+    // host now and then. Checkpoints are taken often enough to be thinned out.
+    enum { TMTEST_MAX_STEPS = 512 };
+    static uint64_t l_cycles[TMTEST_MAX_STEPS];
+    static long_t l_b[TMTEST_MAX_STEPS], l_d[TMTEST_MAX_STEPS], l_ram[TMTEST_MAX_STEPS];
+    size_t l_steps = 0;
+
+    tm_start_recording(l_cpu, 4);
+    do
+    {
+        tm_assert(l_steps < TMTEST_MAX_STEPS);
+        if (l_steps % 50 == 25)
+        {
+            tm_request_interrupt(l_cpu, 3);
+        }
+
+        l_cycles[l_steps] = tm_get_cycle_count(l_cpu);
+        tm_read_cpu_register(l_cpu, TM_REGISTER_B, &l_b[l_steps]);
+        tm_read_cpu_register(l_cpu, TM_REGISTER_D, &l_d[l_steps]);
+        tm_read_long(l_cpu, TM_RAM_START, &l_ram[l_steps]);
+        l_steps++;
+    } while (tm_step_cpu(l_cpu) == true);
+
+    tm_assert(tm_has_error(l_cpu) == false && l_d[l_steps - 1] >= 3);
+    tm_assert(tm_rewind_cpu(l_cpu, l_cycles[l_steps - 1] + 1) == false);
+
+    // Rewinding, in any order, restores the state as it was at that cycle.
+    const size_t l_targets[] = { l_steps / 2, 1, l_steps - 1, 30, l_steps / 3, 0, 27 };
+    for (size_t i = 0; i < sizeof(l_targets) / sizeof(l_targets[0]); ++i)
+    {
+        size_t l_step = l_targets[i];
+        long_t l_value = 0;
+
+        tm_assert(tm_rewind_cpu(l_cpu, l_cycles[l_step]) == true);
+        tm_assert(tm_get_cycle_count(l_cpu) == l_cycles[l_step]);
+        tm_read_cpu_register(l_cpu, TM_REGISTER_B, &l_value);
+        tm_assert(l_value == l_b[l_step]);
+        tm_read_cpu_register(l_cpu, TM_REGISTER_D, &l_value);
+        tm_assert(l_value == l_d[l_step]);
+        tm_read_long(l_cpu, TM_RAM_START, &l_value);
+        tm_assert(l_value == l_ram[l_step]);
+    }
+
+    // Running on from there replays the rest of the recording, ignoring the
+    // host's requests, and ends where the recording did.
+    tm_request_interrupt(l_cpu, 3);
+    tm_run_cpu(l_cpu, 10000);
+    long_t l_value = 0;
+    tm_assert(tm_has_error(l_cpu) == false);
+    tm_assert(tm_get_cycle_count(l_cpu) == l_cycles[l_steps - 1]);
+    tm_read_cpu_register(l_cpu, TM_REGISTER_D, &l_value);
+    tm_assert(l_value == l_d[l_steps - 1]);
+
+    tm_stop_recording(l_cpu);
+    tm_assert(tm_rewind_cpu(l_cpu, 0) == false);
+    tm_destroy_cpu(l_cpu);
+
+    // Without a program mapped, instructions are fetched through the
+    // callbacks as well, unless they are replayed from the decode cache. The
+    // recording ends on a write which the host refuses, which rewinding gets
+    // back to.
+    static const byte_t l_faulting_code[] =
+    {
+        0x10, 0x80, 0x00, 0x00, 0x00, 0x14,     // $3000: LD C, 20
+        0x15, 0x70, 0x00,                       // $3006: LDH BL, [$00]
+        0x17, 0x40, 0x80, 0x00, 0x00, 0x00,     // $3009: ST [$80000000], B
+        0x20, 0x00, 0x00, 0x00, 0x30, 0x15,     // $300F: JMP $3015
+        0x32, 0x80,                             // $3015: DEC C
+        0x20, 0x40, 0x00, 0x00, 0x30, 0x06,     // $3017: JMP ZC, $3006
+        0x17, 0x40, 0x80, 0x00, 0x10, 0x00,     // $301D: ST [$80001000], B
+    };
+
+    tmtest_reset_machine();
+    tmtest_load(TM_PROGRAM_START, l_faulting_code, sizeof(l_faulting_code));
+    l_cpu = tm_create_cpu(tmtest_replay_read, tmtest_bus_write, tmtest_bus_cycle);
+
+    l_steps = 0;
+    tm_start_recording(l_cpu, 4);
+    do
+    {
+        tm_assert(l_steps < TMTEST_MAX_STEPS);
+        l_cycles[l_steps] = tm_get_cycle_count(l_cpu);
+        tm_read_cpu_register(l_cpu, TM_REGISTER_B, &l_b[l_steps]);
+        tm_read_cpu_register(l_cpu, TM_REGISTER_C, &l_d[l_steps]);
+        tm_read_long(l_cpu, TM_RAM_START, &l_ram[l_steps]);
+        l_steps++;
+    } while (tm_step_cpu(l_cpu) == true);
+
+    uint64_t l_end = tm_get_cycle_count(l_cpu);
+    tm_assert(tm_get_error_code(l_cpu) == TM_ERROR_BUS_WRITE);
+
+    const size_t l_faulting_targets[] = { l_steps / 2, l_steps - 1, 3, l_steps / 3, 0 };
+    for (size_t i = 0; i < sizeof(l_faulting_targets) / sizeof(l_faulting_targets[0]); ++i)
+    {
+        size_t l_step = l_faulting_targets[i];
+
+        tm_assert(tm_rewind_cpu(l_cpu, l_cycles[l_step]) == true);
+        tm_assert(tm_has_error(l_cpu) == false);
+        tm_assert(tm_get_cycle_count(l_cpu) == l_cycles[l_step]);
+        tm_read_cpu_register(l_cpu, TM_REGISTER_B, &l_value);
+        tm_assert(l_value == l_b[l_step]);
+        tm_read_cpu_register(l_cpu, TM_REGISTER_C, &l_value);
+        tm_assert(l_value == l_d[l_step]);
+        tm_read_long(l_cpu, TM_RAM_START, &l_value);
+        tm_assert(l_value == l_ram[l_step]);
+    }
+
+    tm_assert(tm_rewind_cpu(l_cpu, l_end) == true);
+    tm_assert(tm_get_cycle_count(l_cpu) == l_end);
+    tm_assert(tm_get_error_code(l_cpu) == TM_ERROR_BUS_WRITE);
+    tm_destroy_cpu(l_cpu);
+}
+
+/* Tests - Debugger ***********************************************************/
+
+void tmtest_test_debugger ()
+{
+    static const byte_t l_code[] =
+    {
+        0x10, 0x80, 0x00, 0x00, 0x00, 0x05,     // $3000: LD C, 5
+        0x30, 0x00,                             // $3006: INC A
+        0x17, 0x00, 0x80, 0x00, 0x00, 0x10,     // $3008: ST [$80000010], A
+        0x20, 0x00, 0x00, 0x00, 0x30, 0x14,     // $300E: JMP $3014
+        0x11, 0x40, 0x80, 0x00, 0x00, 0x10,     // $3014: LD B, [$80000010]
+        0x32, 0x80,                             // $301A: DEC C
+        0x20, 0x40, 0x00, 0x00, 0x30, 0x06,     // $301C: JMP ZC, $3006
+        0x01, 0x00,                             // $3022: STOP
+    };
+
+    tmtest_reset_machine();
+    tmtest_load(TM_PROGRAM_START, l_code, sizeof(l_code));
+
+    tm_program_t l_program = { .m_rom = s_rom, .m_rom_size = sizeof(s_rom) };
+    tm_cpu_t* l_cpu = tm_create_cpu(tmtest_bus_read, tmtest_bus_write, tmtest_bus_cycle);
+    tm_map_program(l_cpu, &l_program);
+
+    // A conditional breakpoint stops the run before the instruction, only once
+    // its condition holds, and the next run carries on from there.
+    tm_break_t l_break;
+    long_t l_a = 0, l_b = 0;
+    tm_break_condition_t l_condition = { TM_REGISTER_A, TM_COMPARE_EQ, 3 };
+    tm_break_condition_t l_invalid = { TM_REGISTER_A, TM_COMPARE_GE + 1, 3 };
+    tm_assert(tm_add_breakpoint(l_cpu, 0x3014, &l_invalid) == 0);
+    size_t l_breakpoint = tm_add_breakpoint(l_cpu, 0x3014, &l_condition);
+    tm_assert(l_breakpoint != 0);
+
+    tm_run_cpu(l_cpu, 1000);
+    tm_read_cpu_register(l_cpu, TM_REGISTER_A, &l_a);
+    tm_read_cpu_register(l_cpu, TM_REGISTER_B, &l_b);
+    tm_assert(tm_has_error(l_cpu) == false && tm_get_break(l_cpu, &l_break) == true);
+    tm_assert(l_break.m_reason == TM_BREAK_BREAKPOINT && l_break.m_id == l_breakpoint);
+    tm_assert(l_break.m_address == 0x3014 && tm_get_program_counter(l_cpu) == 0x3014);
+    tm_assert(l_a == 3 && l_b == 2);
+
+    tm_run_cpu(l_cpu, 1000);
+    tm_read_cpu_register(l_cpu, TM_REGISTER_B, &l_b);
+    tm_assert(tm_get_break(l_cpu, &l_break) == false && l_b == 5);
+    tm_assert(tm_remove_breakpoint(l_cpu, l_breakpoint) == true);
+    tm_assert(tm_remove_breakpoint(l_cpu, l_breakpoint) == false);
+
+    // Watchpoints stop the run after the instruction accessing the watched
+    // memory, whichever part of it the access overlaps. Neither fetching the
+    // instructions nor the host's own accesses are watched.
+    tm_init_cpu(l_cpu);
+    size_t l_written = tm_add_watchpoint(l_cpu, 0x80000010, 4, TM_ACCESS_WRITE);
+    size_t l_read = tm_add_watchpoint(l_cpu, 0x80000013, 1, TM_ACCESS_READ);
+    size_t l_fetched = tm_add_watchpoint(l_cpu, 0x3000, sizeof(l_code), TM_ACCESS_READ);
+    tm_assert(tm_add_watchpoint(l_cpu, 0x80000010, 0, TM_ACCESS_READ) == 0);
+    tm_assert(tm_add_watchpoint(l_cpu, 0x80000010, 4, TM_ACCESS_EXECUTE) == 0);
+
+    tm_assert(tm_run_cpu(l_cpu, 1000) == 3);
+    tm_assert(tm_get_break(l_cpu, &l_break) == true && l_break.m_reason == TM_BREAK_WATCHPOINT);
+    tm_assert(l_break.m_id == l_written && l_break.m_address == 0x80000010);
+    tm_assert(l_break.m_access == TM_ACCESS_WRITE && l_break.m_size == 4 && l_break.m_value == 1);
+    tm_assert(tm_get_program_counter(l_cpu) == 0x300E);
+
+    tm_assert(tm_run_cpu(l_cpu, 1000) == 2);
+    tm_read_cpu_register(l_cpu, TM_REGISTER_B, &l_b);
+    tm_assert(tm_get_break(l_cpu, &l_break) == true && l_break.m_id == l_read);
+    tm_assert(l_break.m_access == TM_ACCESS_READ && l_break.m_value == 1 && l_b == 1);
+    tm_assert(tm_write_long(l_cpu, 0x80000010, 1) == true);
+    tm_assert(tm_get_break(l_cpu, &l_break) == true && l_break.m_id == l_read);
+
+    // Once they are removed, the program runs to the end.
+    tm_assert(tm_remove_watchpoint(l_cpu, l_written) == true);
+    tm_assert(tm_remove_watchpoint(l_cpu, l_read) == true);
+    tm_run_cpu(l_cpu, 1000);
+    tm_read_cpu_register(l_cpu, TM_REGISTER_B, &l_b);
+    tm_assert(tm_has_error(l_cpu) == false && tm_get_break(l_cpu, &l_break) == false);
+    tm_assert(l_b == 5);
+    tm_assert(tm_remove_watchpoint(l_cpu, l_fetched) == true);
+
+    tm_destroy_cpu(l_cpu);
+}
+
+/* Tests - User Data **********************************************************/
+
+// A machine whose state is passed to its callbacks, rather than kept in
+// globals. It has nothing but a small ROM at the start of the program space.
+typedef struct tmtest_machine
+{
+    byte_t      m_rom[0x100];
+    size_t      m_cycles;
+} tmtest_machine_t;
+
+static bool tmtest_machine_read (void* p_user_data, addr_t p_address, long_t* p_value)
+{
+    tmtest_machine_t* l_machine = p_user_data;
+    if (p_address < TM_PROGRAM_START || p_address >= TM_PROGRAM_START + sizeof(l_machine->m_rom))
+    {
+        return false;
+    }
+
+    *p_value = l_machine->m_rom[p_address - TM_PROGRAM_START];
+    return true;
+}
+
+static bool tmtest_machine_write (void* p_user_data, addr_t p_address, long_t p_value)
+{
+    return false;
+}
+
+static bool tmtest_machine_cycle (void* p_user_data)
+{
+    tmtest_machine_t* l_machine = p_user_data;
+    l_machine->m_cycles++;
+    return true;
+}
+
+void tmtest_test_user_data ()
+{
+    // Step two CPUs in turn, each running the same countdown loop on its own
+    // machine, from a different starting value. Each machine must only see
+    // the cycles of its own CPU.
+    static const byte_t l_program[] =
+    {
+        0x10, 0x00, 0x00, 0x00, 0x00, 0x00,     // $3000: LD A, count
+        0x32, 0x00,                             // $3006: DEC A
+        0x20, 0x40, 0x00, 0x00, 0x30, 0x06,     // $3008: JMP ZC, $3006
+        0x01, 0x00,                             // $300E: STOP
+    };
+
+    tmtest_machine_t l_machines[2] = { 0 };
+    tm_cpu_t* l_cpus[2] = { nullptr };
+    for (int i = 0; i < 2; ++i)
+    {
+        memcpy(l_machines[i].m_rom, l_program, sizeof(l_program));
+        l_machines[i].m_rom[5] = 10 * (i + 1);
+        l_cpus[i] = tm_create_cpu_ctx(tmtest_machine_read, tmtest_machine_write,
+            tmtest_machine_cycle, &l_machines[i]);
+        tm_assert(tm_get_user_data(l_cpus[i]) == &l_machines[i]);
+    }
+
+    bool l_running = true;
+    while (l_running == true)
+    {
+        l_running = false;
+        for (int i = 0; i < 2; ++i)
+        {
+            l_running = tm_step_cpu(l_cpus[i]) || l_running;
+        }
+    }
+
+    for (int i = 0; i < 2; ++i)
+    {
+        long_t l_a = 0xFFFFFFFF;
+        tm_assert(tm_has_error(l_cpus[i]) == false);
+        tm_read_cpu_register(l_cpus[i], TM_REGISTER_A, &l_a);
+        tm_assert(l_a == 0);
+        tm_destroy_cpu(l_cpus[i]);
+    }
+
+    // Each pass through the loop takes 2 cycles for `DEC`, and 7 for the
+    // `JMP` taken back to it.
+    tm_assert(l_machines[1].m_cycles - l_machines[0].m_cycles == 10 * 9);
+
+    // CPUs created without user data report none.
+    tm_cpu_t* l_cpu = tm_create_cpu(tmtest_bus_read, tmtest_bus_write, tmtest_bus_cycle);
+    tm_assert(tm_get_user_data(l_cpu) == nullptr);
+    tm_destroy_cpu(l_cpu);
+}
@@ -1,4 +1,5 @@
 #include <tm.arguments.h>
+#include <tmtest.cpu.h>
 
 void tmtest_atexit ()
 {
@@ -45,6 +46,36 @@ int main() {
     tmtest_test_has_argument();
     tmtest_test_get_argument_value();
     tmtest_test_get_argument_value_at();
+    tmtest_test_decode_cache();
+    tmtest_test_decode_cache_self_modifying();
+    tmtest_test_interpreter_loop();
+    tmtest_test_block_cache();
+    tmtest_test_block_cache_self_modifying();
+    tmtest_test_block_cache_failure();
+    tmtest_test_jit();
+    tmtest_test_built_in_memory();
+    tmtest_test_vector_pages();
+    tmtest_test_memory_regions();
+    tmtest_test_cycle_batching();
+    tmtest_test_event_scheduler();
+    tmtest_test_halt_fast_forward();
+    tmtest_test_halt_wake_from_cycle();
+    tmtest_test_interrupts();
+    tmtest_test_lazy_flags();
+    tmtest_test_wide_bus();
+    tmtest_test_superoperators();
+    tmtest_test_operand_widths();
+    tmtest_test_saved_state();
+    tmtest_test_fork();
+    tmtest_test_runner();
+    tmtest_test_program_loading();
+    tmtest_test_rom_spans();
+    tmtest_test_profiler();
+    tmtest_test_statistics();
+    tmtest_test_trace();
+    tmtest_test_record_and_replay();
+    tmtest_test_debugger();
+    tmtest_test_user_data();
 
     printf("All tests passed!\n");
     return 0;
@@ -0,0 +1,139 @@
+/// @file tmtrace.main.c
+/// @brief Prints, and filters, the execution traces recorded by the TM CPU.
+
+#include <tm.arguments.h>
+#include <tm.trace.h>
+
+/* Helper Functions ***********************************************************/
+
+static const char* s_register_names[TM_TRACE_REGISTER_COUNT] =
+{
+    [TM_TRACE_A]        = "A",
+    [TM_TRACE_B]        = "B",
+    [TM_TRACE_C]        = "C",
+    [TM_TRACE_D]        = "D",
+    [TM_TRACE_SP]       = "SP",
+    [TM_TRACE_RP]       = "RP",
+    [TM_TRACE_FLAGS]    = "FLAGS",
+    [TM_TRACE_EC]       = "EC",
+    [TM_TRACE_IE]       = "IE",
+    [TM_TRACE_IF]       = "IF",
+};
+
+static bool tmtrace_get_number (const char* p_longform, const char p_shortform, int p_base,
+    unsigned long long* p_value)
+{
+    const char* l_string = tm_get_argument_value(p_longform, p_shortform);
+    if (l_string == nullptr)
+    {
+        return false;
+    }
+
+    *p_value = strtoull(l_string, nullptr, p_base);
+    return true;
+}
+
+static void tmtrace_print_record (uint64_t p_index, const tm_trace_record_t* p_record)
+{
+    tm_printf("%10llu  $%08X  %04X  %3u", (unsigned long long) p_index, p_record->m_address,
+        p_record->m_instruction, p_record->m_cycles);
+
+    for (size_t i = 0; i < TM_TRACE_REGISTER_COUNT; ++i)
+    {
+        if ((p_record->m_changed & (1 << i)) != 0)
+        {
+            tm_printf("  %s=%X", s_register_names[i], p_record->m_registers[i]);
+        }
+    }
+
+    for (size_t i = 0; i < p_record->m_write_count; ++i)
+    {
+        const tm_trace_write_t* l_write = &p_record->m_writes[i];
+        tm_printf("  [$%08X]=%0*X", l_write->m_address, l_write->m_size * 2, l_write->m_value);
+    }
+
+    tm_printf("\n");
+}
+
+static int tmtrace_print_help (bool p_error)
+{
+    FILE* l_output = p_error ? stderr : stdout;
+
+    if (p_error == false)
+    {
+        fprintf(l_output, "tmtrace - TM CPU Trace Decoder\n\n");
+    }
+
+    fprintf(l_output, "Usage: tmtrace [options]\n");
+    fprintf(l_output, "Options:\n");
+    fprintf(l_output, "  -i, --input-file <filename>  Specify the trace to print.\n");
+    fprintf(l_output, "  -a, --address <hex>          Only print instructions at this address.\n");
+    fprintf(l_output, "  -o, --opcode <hex>           Only print instructions with this opcode.\n");
+    fprintf(l_output, "  -n, --count <count>          Print at most this many instructions.\n");
+    fprintf(l_output, "  -h, --help                   Display this help message.\n");
+    return p_error ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+/* Main Function **************************************************************/
+
+static void tmtrace_atexit ()
+{
+    tm_release_arguments();
+}
+
+int main (int p_argc, char** p_argv)
+{
+    atexit(tmtrace_atexit);
+    tm_capture_arguments(p_argc, p_argv);
+
+    if (tm_has_argument("help", 'h'))
+    {
+        return tmtrace_print_help(false);
+    }
+
+    const char* l_input_file = tm_get_argument_value("input-file", 'i');
+    if (l_input_file == nullptr)
+    {
+        tm_errorf("tmtrace: no input file specified.\n");
+        return tmtrace_print_help(true);
+    }
+
+    unsigned long long l_address = 0, l_opcode = 0, l_limit = UINT64_MAX;
+    bool l_by_address = tmtrace_get_number("address", 'a', 16, &l_address);
+    bool l_by_opcode = tmtrace_get_number("opcode", 'o', 16, &l_opcode);
+    tmtrace_get_number("count", 'n', 10, &l_limit);
+
+    tm_trace_reader_t* l_reader = tm_create_trace_reader(l_input_file);
+    if (l_reader == nullptr)
+    {
+        return EXIT_FAILURE;
+    }
+
+    // Every record is decoded, filtered or not, since each one is encoded
+    // relative to the records before it.
+    tm_trace_record_t l_record;
+    uint64_t l_index = 0, l_printed = 0;
+    while (l_printed < l_limit && tm_read_trace_record(l_reader, &l_record) == true)
+    {
+        if (
+            (l_by_address == false || l_record.m_address == l_address) &&
+            (l_by_opcode == false || (l_record.m_instruction >> 8) == l_opcode)
+        )
+        {
+            tmtrace_print_record(l_index, &l_record);
+            l_printed++;
+        }
+
+        l_index++;
+    }
+
+    bool l_failed = tm_trace_reader_failed(l_reader);
+    if (l_failed == true)
+    {
+        tm_errorf("tmtrace: trace '%s' is damaged, or cut short, after %llu instructions.\n",
+            l_input_file, (unsigned long long) l_index);
+    }
+
+    tm_destroy_trace_reader(l_reader);
+    return (l_failed == false) ? EXIT_SUCCESS : EXIT_FAILURE;
+}